@@ -6,6 +6,8 @@ function(target_add_httplib target_name)
         URL_HASH SHA256=2d4fb5544da643e5d0a82585555d8b7502b4137eb321a4abbb075e21d2f00e96
         DOWNLOAD_EXTRACT_TIMESTAMP true
     )
+    # gzip responses (e.g. /targets/all) for clients that send Accept-Encoding: gzip
+    set(HTTPLIB_REQUIRE_ZLIB ON CACHE BOOL "" FORCE)
     FetchContent_MakeAvailable(httplib)
     target_link_libraries(${target_name} PRIVATE
         httplib
@@ -0,0 +1,56 @@
+#ifndef INCLUDE_CAMERA_FRAME_POOL_HPP_
+#define INCLUDE_CAMERA_FRAME_POOL_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+/**
+ * Fixed-size pool of cv::Mat buffers for camera frames.
+ *
+ * The pool keeps one reference to every buffer it allocates. A buffer is
+ * handed out again once every other cv::Mat header pointing at it (the
+ * ImageData that was moved through the aggregator, the annotated image
+ * waiting for the GCS, etc.) has been destroyed, i.e. once OpenCV's own
+ * refcount drops back to the pool's single reference. This means a frame
+ * is allocated once and recycled instead of being freed and re-malloc'd
+ * for every picture.
+ *
+ * If every buffer is still in use and the pool is at capacity, acquire()
+ * falls back to a normal heap allocation so capture never blocks.
+ */
+class FramePool {
+ public:
+    FramePool(int rows, int cols, int type, std::size_t max_frames);
+
+    /**
+     * Get a buffer of rows x cols x type. Contents are whatever the
+     * previous user left in it, so callers must overwrite every pixel.
+     */
+    cv::Mat acquire();
+
+    // Number of buffers the pool has allocated (in use + free)
+    std::size_t size();
+
+    // Number of buffers that could be handed out without allocating
+    std::size_t available();
+
+    // Number of acquire() calls that had to fall back to a heap allocation
+    std::size_t overflows();
+
+ private:
+    const int rows;
+    const int cols;
+    const int type;
+    const std::size_t max_frames;
+
+    std::mutex mut;
+    std::vector<cv::Mat> frames;
+    std::size_t num_overflows;
+
+    static bool isFree(const cv::Mat& frame);
+};
+
+#endif  // INCLUDE_CAMERA_FRAME_POOL_HPP_
@@ -0,0 +1,91 @@
+#ifndef INCLUDE_CAMERA_IMAGE_SINK_HPP_
+#define INCLUDE_CAMERA_IMAGE_SINK_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include <opencv2/core/mat.hpp>
+
+#include "camera/interface.hpp"
+
+/**
+ * Writes images (and their telemetry) to disk on a background thread, so the
+ * CV workers and the tick loop never wait on JPEG encoding or storage I/O.
+ *
+ * Writes are queued up to a fixed depth. If the disk can't keep up, new writes
+ * are dropped (and counted) instead of stalling the caller. Files are flushed to
+ * disk with one syncfs() per batch of writes, or whenever the queue runs dry,
+ * rather than an fsync() per file.
+ *
+ * The queued cv::Mat shares its buffer with the caller, so don't draw on or
+ * otherwise modify an image after handing it to the sink. Clone it first if
+ * it is going to keep changing.
+ */
+class ImageSink {
+ public:
+    ImageSink(std::size_t max_queue_size, std::size_t fsync_batch_size);
+
+    // Writes out everything still queued before returning
+    ~ImageSink();
+
+    /**
+     * Queue an image to be encoded (based on the file extension) and written
+     * to image_path.
+     *
+     * @returns false if the queue is full and the image was dropped
+     */
+    bool write(const std::filesystem::path& image_path, cv::Mat image);
+
+    /**
+     * Queue an ImageData to be written as <directory>/<timestamp>.jpg, plus
+     * <directory>/<timestamp>.json with its telemetry if it has any. Same layout
+     * as ImageData::saveToFile.
+     *
+     * @returns false if the image is empty or the queue is full
+     */
+    bool save(const ImageData& image, const std::filesystem::path& directory);
+
+    // Block until everything queued so far has been written and synced
+    void flush();
+
+    std::size_t numWritten() const;
+    std::size_t numDropped() const;
+
+ private:
+    struct Job {
+        std::filesystem::path image_path;
+        cv::Mat image;
+        std::optional<ImageTelemetry> telemetry;
+        std::filesystem::path telemetry_path;
+    };
+
+    const std::size_t max_queue_size;
+    const std::size_t fsync_batch_size;
+
+    std::mutex mut;
+    std::condition_variable queue_cv;  // signaled when a job is queued or on shutdown
+    std::condition_variable idle_cv;   // signaled when the worker has synced an empty queue
+    std::deque<Job> queue;
+    bool stop;
+    bool busy;
+
+    std::atomic<std::size_t> num_written;
+    std::atomic<std::size_t> num_dropped;
+
+    std::thread worker;
+
+    bool enqueue(Job&& job);
+    void writeLoop();
+    bool writeJob(const Job& job);
+    // Flush everything written so far on the filesystem holding directory
+    void syncDirectory(const std::filesystem::path& directory);
+};
+
+#endif  // INCLUDE_CAMERA_IMAGE_SINK_HPP_
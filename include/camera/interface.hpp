@@ -16,6 +16,7 @@
 // Forward declaration to avoid circular dependency
 // #include "network/mavlink.hpp"
 class MavlinkClient;
+#include "camera/yuv.hpp"
 #include "utilities/datatypes.hpp"
 #include "utilities/obc_config.hpp"
 
@@ -43,10 +44,21 @@ struct ImageTelemetry {
 std::optional<ImageTelemetry> queryMavlinkImageTelemetry(
     std::shared_ptr<MavlinkClient> mavlinkClient);
 
+/**
+ * Same as above, but for a frame captured at timestamp_ms (unix time). Uses
+ * the telemetry interpolated to that moment if the mavlink client still has
+ * it, and the latest telemetry otherwise.
+*/
+std::optional<ImageTelemetry> queryMavlinkImageTelemetry(
+    std::shared_ptr<MavlinkClient> mavlinkClient, uint64_t timestamp_ms);
+
 struct ImageData {
     cv::Mat DATA;
     uint64_t TIMESTAMP;
     std::optional<ImageTelemetry> TELEMETRY;
+    // The camera's native planes DATA was converted from, if it has them, so
+    // consumers that can work in YUV don't need DATA's BGR pixels
+    std::optional<YUVImage> YUV;
 
     /**
      * Saves the image to a file
@@ -60,9 +72,17 @@ std::string cvMatToBase64(cv::Mat image);
 
 void saveImageToFile(cv::Mat image, const std::filesystem::path& filepath);
 
+json imageTelemetryToJson(const ImageTelemetry& telemetry);
+
 void saveImageTelemetryToFile(const ImageTelemetry& telemetry,
                               const std::filesystem::path& filepath);
 
+/**
+ * Reads back telemetry written by saveImageTelemetryToFile.
+ * Returns nullopt if the file is missing or malformed.
+ */
+std::optional<ImageTelemetry> loadImageTelemetryFromFile(const std::filesystem::path& filepath);
+
 class CameraInterface {
  protected:
     CameraConfig config;
@@ -0,0 +1,45 @@
+#ifndef INCLUDE_CAMERA_JPEG_ENCODER_HPP_
+#define INCLUDE_CAMERA_JPEG_ENCODER_HPP_
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "utilities/obc_config.hpp"
+
+/*
+ Encodes images for the GCS (scaled down, optionally denoised, then JPEG)
+ straight to the bytes that get sent. Replaces going through compressImg,
+ which encoded, decoded and then encoded the image again.
+
+ Keeps its scratch images and output buffer between calls, so after the
+ first image of a size nothing is allocated. Not thread safe, give each
+ thread its own.
+ */
+class JpegEncoder {
+ public:
+    explicit JpegEncoder(const ImageEncodingConfig& config);
+
+    /**
+     * JPEG of image, or nullopt if OpenCV couldn't encode it. The bytes are
+     * only valid until the next call.
+     */
+    std::optional<std::span<const uint8_t>> encode(const cv::Mat& image);
+
+    // encode() as base64, empty if it failed
+    std::string encodeBase64(const cv::Mat& image);
+
+ private:
+    const ImageEncodingConfig config;
+    const std::vector<int> params;
+
+    cv::Mat scaled;
+    cv::Mat denoised;
+    std::vector<uchar> buffer;
+};
+
+#endif  // INCLUDE_CAMERA_JPEG_ENCODER_HPP_
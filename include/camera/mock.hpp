@@ -3,8 +3,10 @@
 
 #include <httplib.h>
 
+#include <atomic>
 #include <thread>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
 #include <deque>
 #include <vector>
@@ -65,6 +67,11 @@ class MockCamera : public CameraInterface {
     std::thread captureThread;
 
     httplib::Client cli;
+    // httplib::Client isn't safe to use from several threads at once, and
+    // isConnected can be called by the connection monitor mid capture
+    std::mutex cli_mut;
+    // Result of the last isConnected that got to ask the server
+    std::atomic_bool connected;
 
     std::string session_id;
 };
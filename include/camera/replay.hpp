@@ -0,0 +1,71 @@
+#ifndef INCLUDE_CAMERA_REPLAY_HPP_
+#define INCLUDE_CAMERA_REPLAY_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "camera/interface.hpp"
+#include "network/mavlink.hpp"
+
+/*
+ Camera that plays back the frames saved on a recorded flight, for replaying
+ it (tests/integration/replay.cpp). Frames are the <unix ms>.jpg/.png files
+ in a directory, like the ones ImageData::saveToFile and ImageSink write.
+
+ A picture taken at getUnixTime_ms() (see ReplayClock) is the newest frame
+ from at or before then that hasn't been taken yet, tagged with the mavlink
+ client's telemetry at its timestamp, or with its saved .json if the client
+ doesn't have any.
+ */
+class ReplayCamera : public CameraInterface {
+ public:
+    ReplayCamera(const CameraConfig& config, const std::filesystem::path& image_dir);
+    ~ReplayCamera();
+
+    void connect() override;
+    bool isConnected() override;
+
+    void startTakingPictures(const std::chrono::milliseconds& interval,
+                             std::shared_ptr<MavlinkClient> mavlinkClient) override;
+    void stopTakingPictures() override;
+
+    std::optional<ImageData> getLatestImage() override;
+    std::deque<ImageData> getAllImages() override;
+
+    void startStreaming() override;
+
+    std::optional<ImageData> takePicture(const std::chrono::milliseconds& timeout,
+                                         std::shared_ptr<MavlinkClient> mavlinkClient) override;
+
+    // How many frames there are to play back
+    std::size_t numFrames() const;
+
+ private:
+    struct Frame {
+        uint64_t timestamp;
+        std::filesystem::path path;
+    };
+    std::vector<Frame> frames;  // oldest first
+
+    std::mutex frames_mut;
+    std::size_t next_frame;  // frames before this have been taken or skipped
+
+    std::atomic_bool isTakingPictures;
+    std::thread captureThread;
+    void captureEvery(const std::chrono::milliseconds& interval,
+                      std::shared_ptr<MavlinkClient> mavlinkClient);
+
+    std::mutex imageQueueLock;
+    std::deque<ImageData> imageQueue;
+};
+
+#endif  // INCLUDE_CAMERA_REPLAY_HPP_
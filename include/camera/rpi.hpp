@@ -1,15 +1,20 @@
 #ifndef INCLUDE_CAMERA_RPI_HPP_
 #define INCLUDE_CAMERA_RPI_HPP_
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
 #include <string>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <shared_mutex>
 #include <thread>
 #include <deque>
-#include <vector>
 
 #include <nlohmann/json.hpp>
+#include "camera/frame_pool.hpp"
 #include "camera/interface.hpp"
 #include "network/mavlink.hpp"
 #include "network/udp_client.hpp"
@@ -31,32 +36,93 @@ class RPICamera : public CameraInterface {
         UDPClient client;
         asio::io_context io_context_;
         std::atomic_bool connected;
+        // Held for every request/response on the socket, so a ping from
+        // isConnected can't land in the middle of a frame transfer
+        std::mutex socket_mut;
+
+        // Recycled BGR output frames, handed off to the CV pipeline by move
+        FramePool bgr_pool;
+        // Recycled buffers the Y, U, V planes are received straight into, laid
+        // out for YUVImage::fromPlanes. They ride along with the BGR frame as
+        // ImageData::YUV, so they go back to the pool once the pipeline is done.
+        FramePool yuv_pool;
+
+        // One frame's planes as they came off the wire
+        struct RawFrame {
+            cv::Mat buffer;  // from yuv_pool
+            uint64_t timestamp;
+        };
+
+        /*
+         Streaming (startTakingPictures) runs as two stages so consecutive frames
+         overlap: the receive thread requests and reassembles the next frame while
+         the convert thread turns the previous one into BGR. The receive thread
+         waits once RPI_STREAM_RAW_FRAMES frames are waiting to be converted.
+         */
+        bool taking_pictures;  // guarded by stream_mut
+        std::mutex stream_mut;
+        std::condition_variable stream_cv;
+        std::deque<RawFrame> received_frames;  // waiting to be converted
+        std::thread receive_thread;
+        std::thread convert_thread;
+
+        // Converted frames waiting for getLatestImage/getAllImages
+        std::mutex image_mut;
+        std::deque<ImageData> images;
+        std::size_t num_dropped;
+
+        void receiveLoop(std::chrono::milliseconds interval);
+        void convertLoop(std::shared_ptr<MavlinkClient> mavlinkClient);
 
         /**
-         * Converts the 3-plane raw data to BGR cv::Mat, handling stride/padding
+         * Converts a received frame to BGR, straight from the strided planes.
+         * The returned Mat is backed by a buffer from bgr_pool.
          */
-        std::optional<cv::Mat> imgConvert(const std::vector<std::vector<uint8_t>>& planes);
+        cv::Mat imgConvert(const YUVImage& yuv);
 
         /**
-         * Reads the 3 planes (Y, U, V) from the camera
+         * Reads the 3 planes (Y, U, V) from the camera straight into buffer, a
+         * buffer from yuv_pool. Returns false if any are missing.
          */
-        std::vector<std::vector<uint8_t>> readImage();
+        bool readImage(const cv::Mat& buffer);
+
+        // Views the planes readImage put in buffer
+        static YUVImage planesOf(const cv::Mat& buffer);
 
  public:
         explicit RPICamera(CameraConfig config, asio::io_context* io_context_);
         ~RPICamera();
 
         void connect() override;
+        /**
+         * Pings the camera, unless the socket is busy with a frame, in which
+         * case the last known state is returned right away
+         */
         bool isConnected() override;
 
-        std::optional<ImageData> getLatestImage() override {return std::nullopt;}
-        std::deque<ImageData> getAllImages() override {return std::deque<ImageData>();}
+        /**
+         * Newest frame taken by startTakingPictures, removed from the buffer.
+         * Older frames are left for getAllImages.
+         */
+        std::optional<ImageData> getLatestImage() override;
+        // Every frame taken by startTakingPictures since the last call, oldest first
+        std::deque<ImageData> getAllImages() override;
 
+        /**
+         * Can't be used while startTakingPictures is running, since both would
+         * be reading frames off the same socket.
+         */
         std::optional<ImageData> takePicture(const std::chrono::milliseconds& timeout,
                                              std::shared_ptr<MavlinkClient> mavlinkClient) override;
 
+        /**
+         * Requests a frame every interval (or back to back if the camera can't
+         * keep up) on a background thread. Only the newest RPI_STREAM_QUEUE_SIZE
+         * converted frames are kept.
+         */
         void startTakingPictures(const std::chrono::milliseconds& interval,
                                  std::shared_ptr<MavlinkClient> mavlinkClient) override;
+        // Waits for the frame in flight to be received and converted
         void stopTakingPictures() override;
         void startStreaming() override;
         bool ping(const std::chrono::milliseconds& timeout);
@@ -0,0 +1,50 @@
+#ifndef INCLUDE_CAMERA_YUV_HPP_
+#define INCLUDE_CAMERA_YUV_HPP_
+
+#include <opencv2/core/mat.hpp>
+
+/**
+ * A frame in the camera's native I420 (YUV 4:2:0) layout: a full resolution
+ * Y plane and half resolution U and V planes, each with its own row stride, so
+ * the planes libcamera hands over can be used as is.
+ *
+ * y, u and v are views. buffer owns the memory behind them (for a camera
+ * frame, a buffer from the camera's FramePool) and keeps it alive for as long
+ * as any copy of the YUVImage is around.
+ */
+struct YUVImage {
+    cv::Mat y;
+    cv::Mat u;
+    cv::Mat v;
+    cv::Mat buffer;
+
+    /**
+     * Views the planes inside one buffer laid out like the camera sends them:
+     * height rows of stride_y bytes of Y, then height / 2 rows of stride_uv
+     * bytes of U, then the same of V.
+     */
+    static YUVImage fromPlanes(const cv::Mat& buffer, int width, int height, int stride_y,
+                               int stride_uv);
+
+    // Bytes needed for fromPlanes
+    static std::size_t bufferSize(int height, int stride_y, int stride_uv);
+
+    cv::Size size() const;
+    bool empty() const;
+
+    /**
+     * View of part of the image, without copying. The rect is shrunk to even
+     * coordinates so the chroma planes line up; the returned image's
+     * origin in this one is the shrunk rect's top left.
+     */
+    YUVImage crop(const cv::Rect& rect, cv::Point* origin = nullptr) const;
+};
+
+/**
+ * Converts straight from the (strided) planes to BGR, the same BT.601 math as
+ * cv::COLOR_YUV2BGR_I420 but without first packing the planes into one
+ * contiguous buffer. Writes into dst if it already has the right size and type.
+ */
+void yuvToBgr(const YUVImage& image, cv::Mat& dst);
+
+#endif  // INCLUDE_CAMERA_YUV_HPP_
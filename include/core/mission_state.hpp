@@ -13,11 +13,14 @@
 #include <vector>
 #include <boost/asio.hpp>
 
+#include "camera/image_sink.hpp"
 #include "camera/interface.hpp"
 #include "core/mission_parameters.hpp"
 #include "cv/aggregator.hpp"
+#include "cv/mosaic_ingest.hpp"
 #include "cv/utilities.hpp"
 #include "network/airdrop_client.hpp"
+#include "network/connection_monitor.hpp"
 #include "network/mavlink.hpp"
 #include "pathing/cartesian.hpp"
 #include "pathing/mission_path.hpp"
@@ -25,6 +28,8 @@
 #include "ticks/ids.hpp"
 #include "utilities/constants.hpp"
 #include "utilities/datatypes.hpp"
+#include "utilities/event_broker.hpp"
+#include "utilities/job_queue.hpp"
 #include "utilities/lockptr.hpp"
 #include "utilities/locks.hpp"
 #include "utilities/logging.hpp"
@@ -114,6 +119,41 @@ class MissionState {
     std::shared_ptr<CameraInterface> getCamera();
     void setCamera(std::shared_ptr<CameraInterface> camera);
 
+    /*
+     * Gets a shared_ptr to the image sink, which writes captured
+     * images to disk in the background so the tick loop doesn't
+     * have to wait on encoding or storage.
+     */
+    std::shared_ptr<ImageSink> getImageSink();
+
+    /*
+     * Gets a shared_ptr to the mapper, which builds the map from the
+     * frames the CV aggregator hands it. nullptr if mapping is
+     * disabled in the config.
+     */
+    std::shared_ptr<MosaicIngest> getMapper();
+
+    /*
+     * Gets a shared_ptr to the event broker, where state changes are
+     * published for the GCS's /events stream. The tick is published
+     * here whenever it changes, under the "tick" topic.
+     */
+    std::shared_ptr<EventBroker> getEvents();
+
+    /*
+     * Gets a shared_ptr to the connection monitor, which keeps the
+     * latest connection status of the camera, MAVLink and airdrop.
+     * nullptr until the GCS server sets it up.
+     */
+    std::shared_ptr<ConnectionMonitor> getConnectionMonitor();
+    void setConnectionMonitor(std::shared_ptr<ConnectionMonitor> monitor);
+
+    /*
+     * Gets a shared_ptr to the job queue, which runs slow GCS requests
+     * in the background so the GCS can poll for the result.
+     */
+    std::shared_ptr<JobQueue> getJobs();
+
     // Getters and setters for mapping status.
     bool getMappingIsDone();
     void setMappingIsDone(bool isDone);
@@ -158,6 +198,11 @@ class MissionState {
     CVStatus cv_status = CVStatus::None;
 
     std::shared_ptr<CameraInterface> camera;
+    std::shared_ptr<ImageSink> image_sink;
+    std::shared_ptr<MosaicIngest> mapper;
+    std::shared_ptr<EventBroker> events;
+    std::shared_ptr<ConnectionMonitor> connection_monitor;
+    std::shared_ptr<JobQueue> jobs;
 
     std::mutex cv_mut;
     // Represents a single detected target used in pipeline
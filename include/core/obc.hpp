@@ -4,11 +4,16 @@
 #include <string>
 #include <memory>
 #include <cstdint>
+#include <chrono>
+#include <functional>
 
+#include "camera/interface.hpp"
 #include "core/mission_parameters.hpp"
 #include "core/mission_state.hpp"
 #include "network/gcs.hpp"
 #include "network/mavlink.hpp"
+#include "ticks/ids.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/obc_config.hpp"
 
 /*
@@ -19,9 +24,35 @@ class OBC {
  public:
     explicit OBC(OBCConfig config);
 
+    // With the given mavlink client and camera instead of connecting to the
+    // plane and making the one in the config, e.g. to replay a recorded flight.
+    // Either can be nullptr to get the usual one. Without connect_airdrop there
+    // is no airdrop client, since connecting one waits for the payload.
+    OBC(OBCConfig config, std::shared_ptr<MavlinkClient> mav,
+        std::shared_ptr<CameraInterface> camera, bool connect_airdrop);
+    ~OBC();
+
+    // What happened on one run through the tick loop
+    struct TickReport {
+        TickID ran;                         // tick that ran
+        TickID next;                        // tick that runs next
+        std::chrono::microseconds took;     // how long doTick took
+        std::chrono::milliseconds wait;     // how long the tick asked to wait for
+    };
+
+    // Runs ticks forever, waiting however long each one asks for
     void run();
 
+    // Runs ticks until between_ticks returns false. It's called after every
+    // tick and does the waiting itself, instead of sleeping for report.wait.
+    void run(std::function<bool(const TickReport& report)> between_ticks);
+
+    std::shared_ptr<MissionState> getState();
+
  private:
+    // First so it's open before anything can record, and closed after
+    std::unique_ptr<FlightRecorder> recorder;
+
     std::shared_ptr<MissionState> state;
 
     std::unique_ptr<GCSServer> gcs_server;
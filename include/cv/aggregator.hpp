@@ -3,6 +3,7 @@
 
 #include <atomic>
 #include <cmath>
+#include <deque>
 #include <functional>
 #include <future>
 #include <map>
@@ -13,21 +14,28 @@
 #include <unordered_map>
 #include <vector>
 
+#include "camera/jpeg_encoder.hpp"
+#include "cv/clustering.hpp"
+#include "cv/mosaic_ingest.hpp"
 #include "cv/pipeline.hpp"
+#include "cv/run_history.hpp"
 #include "cv/utilities.hpp"
 #include "protos/obc.pb.h"
 #include "utilities/constants.hpp"
 #include "utilities/lockptr.hpp"
+#include "utilities/obc_config.hpp"
 
 struct AggregatedRun {
     int run_id;                    // Unique integer ID for this pipeline run
-    cv::Mat annotatedImage;        // The "big image" with bounding boxes drawn
     std::vector<Bbox> bboxes;      // All bounding boxes in that image
     std::vector<GPSCoord> coords;  // Matching lat-longs for each bounding box
 };
 
 struct CVResults {
-    std::vector<AggregatedRun> runs;  // Each pipeline invocation => 1 run
+    // Each pipeline invocation => 1 run. Only the last CV_RESULTS_MAX_RUNS are kept, oldest first
+    std::deque<AggregatedRun> runs;
+    std::size_t total_runs = 0;        // every run so far, including ones no longer kept
+    std::size_t total_detections = 0;  // bounding boxes across all of those runs
 };
 
 struct MatchedResults {
@@ -36,11 +44,16 @@ struct MatchedResults {
 
 class CVAggregator {
  public:
-    explicit CVAggregator(Pipeline&& p);
+    // If mapper is set, every frame is also handed to it to be added to the map.
+    // picture_encoding is how annotated images are encoded for the GCS, by
+    // default the same quality 60 denoised JPEG as compressImg.
+    explicit CVAggregator(Pipeline&& p, std::shared_ptr<MosaicIngest> mapper = nullptr,
+                          ImageEncodingConfig picture_encoding = {60, 0, true});
     ~CVAggregator();
 
-    // Spawn a thread to run the pipeline on the given imageData
-    void runPipeline(const ImageData& image);
+    // Spawn a thread to run the pipeline on the given imageData. The image is
+    // moved through the worker and pipeline so the frame buffer is never copied.
+    void runPipeline(ImageData&& image);
 
     // Stop accepting work, discard queued images, and wait for active workers to finish
     void terminate();
@@ -48,17 +61,33 @@ class CVAggregator {
     // Lockable pointer to retrieve aggregator results
     LockPtr<CVResults> getResults();
 
-    // Lockable pointer to retrieve matched results (after manual match)
+    // Lockable pointer to retrieve matched results. Until the GCS posts its manual
+    // match, each airdrop's coordinate is kept at the center of the strongest
+    // detection cluster for that type.
     LockPtr<MatchedResults> getMatchedResults();
 
-    // For the endpoint to reset the current list of structs
-    std::vector<AggregatedRun> popAllRuns();
+    // Current detection clusters for one airdrop type
+    std::vector<TargetCluster> getClusters(AirdropType type);
+
+    /**
+     * Every recent run as it is sent to the GCS (an IdentifiedTarget with the
+     * annotated image already compressed and encoded), for GET /targets/all
+     * to page through. Encoding happens on the worker when the run finishes,
+     * which also lets the frame go back to the camera's pool right away.
+     */
+    RunHistory& getRunHistory();
 
     // gets the record of all cv results
     LockPtr<std::map<int, IdentifiedTarget>> getCVRecord();
 
     void updateRecords(std::vector<IdentifiedTarget>& new_values);
 
+    // Images being run through the pipeline or waiting in the overflow queue
+    std::size_t pending();
+
+    // Time the pipeline has spent in each stage so far
+    PipelineStageStats getPipelineStageStats() const;
+
  private:
     std::mutex cv_record_mut;
 
@@ -67,6 +96,8 @@ class CVAggregator {
     void worker(ImageData image, int thread_num);
 
     Pipeline pipeline;
+    std::shared_ptr<MosaicIngest> mapper;
+    const ImageEncodingConfig picture_encoding;
 
     std::mutex mut;
     std::atomic<int> num_worker_threads;
@@ -79,8 +110,23 @@ class CVAggregator {
     // Shared aggregator results
     std::shared_ptr<CVResults> results;
 
+    RunHistory run_history;
+
     // Shared matched results
     std::shared_ptr<MatchedResults> matched_results;
+
+    // Groups every localized detection across runs, guarded by mut
+    OnlineClustering clustering;
+
+    // The run as sent to the GCS, with the annotated image encoded by the worker's
+    // encoder and base64'd. run_id is left for the RunHistory to fill in.
+    static IdentifiedTarget toIdentifiedTarget(const AggregatedRun& run,
+                                               const cv::Mat& annotatedImage,
+                                               JpegEncoder* encoder);
+
+    // Feeds a pipeline's detections into the clustering and refreshes matched_results.
+    // Must be called with mut held.
+    void updateClusters(const std::vector<DetectedTarget>& targets);
 };
 
 #endif  // INCLUDE_CV_AGGREGATOR_HPP_
@@ -1,5 +1,8 @@
 #ifndef INCLUDE_CV_CLUSTERING_HPP_
 #define INCLUDE_CV_CLUSTERING_HPP_
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
 #include <vector>
 #include "protos/obc.pb.h"
 
@@ -9,4 +12,70 @@ class Clustering {
     std::vector<GPSCoord> FindClustersCenter(const std::vector<std::vector<GPSCoord>>& points);
 };
 
+// Snapshot of one cluster built by OnlineClustering
+struct TargetCluster {
+    GPSCoord center;      // confidence weighted mean of every detection in the cluster
+    double total_weight;  // sum of detection confidences
+    int num_detections;
+};
+
+/*
+ Groups localized detections into clusters as they arrive, instead of waiting
+ for every run to finish and grouping them all at once.
+
+ Detections are projected onto a flat grid (meters from the first detection) and
+ bucketed by grid cell. A new detection joins the nearest cluster of the same
+ AirdropType whose center is within cluster_radius_m, which only requires looking
+ at the 3x3 cells around it, otherwise it starts a new cluster. Cluster centers
+ are running confidence weighted means, so adding a detection is O(1) amortized.
+
+ Not thread safe, callers need to hold their own lock.
+ */
+class OnlineClustering {
+ public:
+    explicit OnlineClustering(double cluster_radius_m);
+
+    // Adds a detection and returns the index of the cluster it was put in
+    int addDetection(AirdropType type, const GPSCoord& coord, double confidence);
+
+    // Center of the cluster with the most total confidence for this type,
+    // or nullopt if nothing of this type has been seen yet
+    std::optional<GPSCoord> bestEstimate(AirdropType type) const;
+
+    std::vector<TargetCluster> getClusters(AirdropType type) const;
+
+    void reset();
+
+ private:
+    struct Cluster {
+        double x_m;  // current center, meters east of origin
+        double y_m;  // current center, meters north of origin
+        double sum_w;
+        double sum_wx;
+        double sum_wy;
+        int count;
+        int64_t cell;  // grid cell the center is indexed under
+    };
+
+    struct TypeIndex {
+        std::vector<Cluster> clusters;
+        std::unordered_map<int64_t, std::vector<int>> grid;
+        int best = -1;
+    };
+
+    double cluster_radius_m;
+
+    // Local tangent plane origin, set from the first detection
+    bool has_origin;
+    double origin_lat_deg;
+    double origin_lon_deg;
+    double meters_per_deg_lon;
+
+    std::unordered_map<int, TypeIndex> by_type;
+
+    int64_t cellKey(int64_t cell_x, int64_t cell_y) const;
+    int64_t cellOf(double x_m, double y_m) const;
+    GPSCoord toGPS(double x_m, double y_m) const;
+};
+
 #endif  // INCLUDE_CV_CLUSTERING_HPP_
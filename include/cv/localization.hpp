@@ -1,7 +1,12 @@
 #ifndef INCLUDE_CV_LOCALIZATION_HPP_
 #define INCLUDE_CV_LOCALIZATION_HPP_
 
+#include <span>
 #include <tuple>
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
 #include "cv/utilities.hpp"
 #include "camera/interface.hpp"
 #include "utilities/datatypes.hpp"
@@ -35,6 +40,14 @@ class Localization {
     // focal length, and image width/height
     virtual GPSCoord localize(const ImageTelemetry& telemetry, const Bbox& targetBbox) = 0;
 
+    // Batch version of localize for every detection in one image. Everything
+    // that only depends on the telemetry is worked out once, then the
+    // latitude/longitude of bboxes[i] is written to latitudes[i]/longitudes[i].
+    //
+    // Throws std::invalid_argument if latitudes or longitudes are shorter than bboxes.
+    virtual void localize(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                          std::span<double> latitudes, std::span<double> longitudes) = 0;
+
  protected:
     struct CameraIntrinsics {
         double pixelSize;    // mm
@@ -55,6 +68,8 @@ class Localization {
 class ECEFLocalization : Localization {
  public:
     GPSCoord localize(const ImageTelemetry& telemetry, const Bbox& targetBbox) override;
+    void localize(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                  std::span<double> latitudes, std::span<double> longitudes) override;
 
  private:
     // ECEF - Earth Centered, Earth Fixed coordinate system. 0,0,0 is the center of the Earth.
@@ -88,12 +103,28 @@ class ECEFLocalization : Localization {
         double targetX,
         double targetY);
     ENUCoordinates AngleToENU(CameraVector target, GPSCoord aircraft, double terrainHeight);
+
+    // Both localize overloads. The target altitudes are also written to
+    // altitudes, unless it's empty.
+    void localizeAll(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                     std::span<double> latitudes, std::span<double> longitudes,
+                     std::span<double> altitudes);
 };
 
 // Localization using GSD (ground sample distance) ratio
 class GSDLocalization : Localization {
  public:
     GPSCoord localize(const ImageTelemetry& telemetry, const Bbox& targetBbox) override;
+    void localize(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                  std::span<double> latitudes, std::span<double> longitudes) override;
+
+    // Inverse of localize: projects real world coordinates into the image taken
+    // with the given telemetry. Returns pixel coordinates in the same image space
+    // that localize expects bounding boxes in, so a pixel inside the projected
+    // shape localizes back to a point inside the original shape. Points can land
+    // outside the image bounds.
+    std::vector<cv::Point2f> projectToImage(const ImageTelemetry& telemetry,
+                                            const std::vector<GPSCoord>& coords);
     GPSCoord CalcOffset(const double offset_x, const double offset_y,
                         const double lat, const double lon);
 
@@ -1,28 +1,45 @@
 #ifndef INCLUDE_CV_MAPPING_HPP_
 #define INCLUDE_CV_MAPPING_HPP_
 
+#include <mutex>
 #include <string>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "opencv2/opencv.hpp"
+#include "cv/mosaic.hpp"
+#include "cv/stitching.hpp"
+#include "utilities/constants.hpp"
 
 // Mapping is responsible for stitching images incrementally in a two-pass approach:
 //
 //   1) firstPass:
 //      - finds new images in 'input_path' that haven't been processed yet
 //      - splits them into chunks
-//      - stitches each chunk, saves result on disk (not in memory)
+//      - stitches the chunks in parallel, saves results on disk (not in memory)
+//      - features are cached per image, so images shared by overlapping chunks
+//        are only analysed once
 //      - frees memory after processing
 //      - **New:** Saves partial results in a new timestamped subfolder within the given run_subdir.
 //   2) secondPass:
-//      - scans for all chunk files in the timestamped run folder
-//      - merges them into one final panorama
+//      - if the chunk camera estimates line up, chains them together and does
+//        one global bundle adjustment over the original images (cached features,
+//        only matching images from neighboring chunks)
+//      - otherwise scans for all chunk files in the timestamped run folder
+//        and merges them into one final panorama
 //      - saves final panorama to the same folder
 //
+// incrementalPass is the alternative for images that have telemetry saved next
+// to them: each new image is placed on an IncrementalMosaic as it shows up, so
+// nothing is ever re-stitched and the map can be saved at any time.
+//
 class Mapping {
  public:
-    Mapping() = default;
+    // num_threads: how many chunks firstPass stitches at once
+    // mosaic_params: settings for the incrementalPass mosaic, including its memory budget
+    explicit Mapping(int num_threads = MAPPING_STITCH_THREADS,
+                     const MosaicParams& mosaic_params = MosaicParams());
     ~Mapping() = default;
 
     // First pass:
@@ -42,6 +59,22 @@ class Mapping {
     void secondPass(const std::string& run_subdir, cv::Stitcher::Mode mode, int max_dim,
                     bool preprocess = true);
 
+    // Incremental pass:
+    //   - Scans input_path for new images with a telemetry file next to them
+    //     (<timestamp>.jpg + <timestamp>.json, as written by ImageData::saveToFile)
+    //   - Places each one on the mosaic using its telemetry, see IncrementalMosaic
+    //   - Writes the mosaic tiles that changed to <output_path>/tiles
+    // Returns the number of images added to the mosaic.
+    int incrementalPass(const std::string& input_path, const std::string& output_path,
+                        int max_dim, bool preprocess = true);
+
+    // Renders the mosaic built by incrementalPass into <output_path>/mosaic_<time>.jpg
+    // Returns false if there's nothing to save or the write failed.
+    bool saveMosaic(const std::string& output_path);
+
+    // Time spent in each stitching stage so far (summed over every chunk / pass)
+    StitchTimings getTimings() const;
+
     // Optional: reset tracking so you can reuse this object for new sets of images.
     // This clears the counters but does NOT delete your saved chunk images on disk.
     void reset();
@@ -69,11 +102,25 @@ class Mapping {
     // Helper: generate a timestamp string like "2025-01-24-12-34-56"
     static std::string currentDateTimeStr();
 
+    // Helper: feature cache key for an image file loaded with these settings
+    static std::string featureKey(const std::string& filename, int max_dim, bool preprocess);
+
+    // Helper: load an image the way the passes expect it (cropped and resized if preprocess)
+    static cv::Mat loadImage(const std::string& filename, int max_dim, bool preprocess);
+
     // Internal: process a single chunk of images, store result on disk,
-    //           and free them from memory.
-    // Added parameter 'preprocess' to determine if images should be pre-processed.
-    void processChunk(const std::vector<cv::Mat>& chunk_images, const std::string& run_subdir,
-                      cv::Stitcher::Mode mode, int max_dim, bool preprocess);
+    //           and free them from memory. Safe to call from several threads at once.
+    // keys are the feature cache keys of chunk_images.
+    void processChunk(const std::vector<cv::Mat>& chunk_images,
+                      const std::vector<std::string>& keys, int chunk_number,
+                      const std::string& run_subdir, cv::Stitcher::Mode mode);
+
+    // Internal: secondPass using the chunk camera estimates from firstPass.
+    // Returns false if they can't be used, so the chunk images need to be stitched instead.
+    bool stitchFromChunkCameras(const std::string& folder, cv::Stitcher::Mode mode,
+                                int max_dim, bool preprocess);
+
+    void addTimings(const StitchTimings& stage_timings);
 
  private:
     // All recognized image filenames in the directory (sorted)
@@ -88,9 +135,24 @@ class Mapping {
     // For naming the chunk files we produce
     int chunk_counter = 0;
 
+    int num_threads;
+
+    // Features of every image stitched so far, keyed by featureKey
+    FeatureCache feature_cache;
+
+    // Protects chunk_cameras and timings, which chunk workers write to
+    mutable std::mutex mut;
+    // Cameras estimated for each chunk, indexed by chunk number - 1
+    std::vector<ChunkCameras> chunk_cameras;
+    StitchTimings timings;
+
     // New: the timestamped folder (inside the given run_subdir) for this run.
     // This ensures that subsequent calls (e.g. secondPass) use only the current run's files.
     std::string current_run_folder;
+
+    // Map built by incrementalPass, and the images already added to it
+    IncrementalMosaic mosaic;
+    std::unordered_set<std::string> mosaic_filenames;
 };
 
 #endif  // INCLUDE_CV_MAPPING_HPP_
@@ -0,0 +1,239 @@
+#ifndef INCLUDE_CV_MOSAIC_HPP_
+#define INCLUDE_CV_MOSAIC_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "camera/interface.hpp"
+#include "protos/obc.pb.h"
+#include "utilities/obc_config.hpp"
+
+struct MosaicParams {
+    MosaicParams() = default;
+
+    explicit MosaicParams(const CVConfig& config)
+        : meters_per_px(config.mapping.meters_per_px),
+          memory_budget_bytes(static_cast<std::size_t>(config.mapping.memory_budget_mb) << 20),
+          spill_dir(std::filesystem::path(config.mapping.output_dir) / "spill") {}
+
+    // Ground distance covered by one canvas pixel
+    double meters_per_px = 0.05;
+    // Side length of a canvas tile in pixels
+    int tile_size = 512;
+    // Most previously placed frames a new frame is matched against
+    int max_neighbors = 4;
+    // Features are found on a copy downscaled so its largest side is this long
+    int feature_max_dim = 800;
+    int max_features = 1000;
+    // Matches that have to agree with the refined homography for it to be used
+    int min_inliers = 25;
+    // A refined placement that moves any frame corner further than this from
+    // where the telemetry put it is treated as a bad match and thrown out
+    double max_correction_m = 15.0;
+    // Most memory tiles and frame features can take up, 0 for no limit. Past
+    // this the least recently used ones are moved to spill_dir until needed again.
+    std::size_t memory_budget_bytes = 0;
+    // Owned by the mosaic, emptied on reset() and destruction
+    std::filesystem::path spill_dir;
+};
+
+// Running totals for IncrementalMosaic::addFrame
+struct MosaicStats {
+    std::size_t frames_added;    // frames blended into the canvas
+    std::size_t frames_refined;  // frames whose placement was corrected by feature matching
+    std::size_t frames_skipped;  // frames that couldn't be placed (bad telemetry / empty)
+    std::size_t tiles;           // canvas tiles touched so far
+    std::size_t tiles_spilled;   // tiles currently moved out of memory
+    std::size_t resident_bytes;  // memory held by tiles and frame features
+};
+
+/*
+ Builds a map one frame at a time instead of re-running cv::Stitcher over every
+ image each time new ones show up.
+
+ The canvas is a flat grid over the ground, centered on the position of the
+ first frame, with +x east and +y south (image style) at meters_per_px. Each
+ new frame is:
+
+   1) placed using its telemetry. The same nadir camera model as
+      GSDLocalization gives a homography from image pixels to canvas pixels.
+   2) refined against the frames already on the canvas that overlap it. These
+      are found through a tile index, so only spatial neighbors are looked at
+      no matter how many frames came before. Features on each placed frame are
+      stored in canvas coordinates, so matching the new frame against them
+      gives the corrected image -> canvas homography directly.
+   3) feather blended into the canvas tiles it covers.
+
+ Adding a frame costs the same whether it's the 5th or the 500th, and the map is
+ usable (render / saveDirtyTiles) at any point during the flight.
+
+ With a memory budget set, tiles and frame features that haven't been used in a
+ while are written to spill_dir and dropped from memory once the budget is
+ exceeded, and read back in when a new frame lands on them. Memory use stays
+ flat however long the flight is. The const accessors read spilled tiles
+ straight from disk without bringing them back into memory.
+
+ Not thread safe, callers need to hold their own lock.
+ */
+class IncrementalMosaic {
+ public:
+    explicit IncrementalMosaic(const MosaicParams& params = MosaicParams());
+    ~IncrementalMosaic();
+
+    IncrementalMosaic(const IncrementalMosaic&) = delete;
+    IncrementalMosaic& operator=(const IncrementalMosaic&) = delete;
+
+    /**
+     * Places a frame on the canvas and blends it in.
+     *
+     * @param image BGR image covering the full camera sensor (it can be scaled)
+     * @param telemetry telemetry from when the image was taken
+     * @returns false if the frame couldn't be placed
+     */
+    bool addFrame(const cv::Mat& image, const ImageTelemetry& telemetry);
+
+    /**
+     * Homography from pixels of an image of image_size taken with this telemetry
+     * to canvas pixels, based on telemetry alone. Until the first frame is added
+     * the canvas is centered on this telemetry's position.
+     */
+    cv::Matx33d seedHomography(const cv::Size& image_size,
+                               const ImageTelemetry& telemetry) const;
+
+    // Canvas pixel <-> real world coordinates
+    cv::Point2d toCanvas(double latitude_deg, double longitude_deg) const;
+    GPSCoord toGPS(const cv::Point2d& canvas_px) const;
+
+    // Canvas pixels covered so far
+    cv::Rect bounds() const;
+
+    /**
+     * Stitches every tile together into one image covering bounds().
+     *
+     * @param max_dim if > 0, the output is scaled down so its largest side is at
+     *        most this, which keeps it from growing with the map
+     */
+    cv::Mat render(int max_dim = 0) const;
+
+    /**
+     * Just the part of the canvas inside canvas_rect, as BGRA. Pixels no frame
+     * has covered yet are fully transparent.
+     */
+    cv::Mat renderRegion(const cv::Rect& canvas_rect) const;
+
+    /**
+     * Canvas rects of the tiles changed since the last call, for keeping
+     * derived outputs (e.g. a TilePyramid) up to date. Separate from the
+     * tracking saveDirtyTiles does.
+     */
+    std::vector<cv::Rect> takeChangedRegions();
+
+    /**
+     * Writes every tile changed since the last call to
+     * <directory>/tile_<x>_<y>.png, where x/y are tile indices (tile x covers
+     * canvas pixels [x * tile_size, (x + 1) * tile_size)).
+     *
+     * @returns number of tiles written
+     */
+    std::size_t saveDirtyTiles(const std::filesystem::path& directory);
+
+    MosaicStats getStats() const;
+    const MosaicParams& getParams() const;
+
+    void reset();
+
+ private:
+    // A tile or frame whose data is in memory, see lru
+    struct Resident {
+        bool is_tile;
+        int64_t id;  // tile key or frame id
+    };
+
+    struct Frame {
+        cv::Matx33d to_canvas;  // image pixels -> canvas pixels
+        cv::Rect bounds;        // canvas pixels covered by the frame
+        std::vector<cv::Point2f> keypoints;  // feature locations in canvas pixels
+        cv::Mat descriptors;
+        bool spilled;        // keypoints / descriptors are in spill_dir, not memory
+        uint64_t last_used;  // use_clock when last matched against
+        std::list<Resident>::iterator lru_entry;  // only while not spilled
+    };
+
+    struct Tile {
+        cv::Mat color;   // CV_8UC3
+        cv::Mat weight;  // CV_32FC1, total blend weight laid down on each pixel
+        bool dirty;      // not saved since it changed
+        bool changed;    // not returned by takeChangedRegions since it changed
+        bool spilled;    // color / weight are in spill_dir, not memory
+        uint64_t last_used;  // use_clock when last blended into
+        std::list<Resident>::iterator lru_entry;  // only while in memory
+    };
+
+    MosaicParams params;
+
+    bool has_origin;
+    double origin_lat_deg;
+    double origin_lon_deg;
+
+    std::vector<Frame> frames;
+    // Tile key -> indices of the frames overlapping that tile
+    std::unordered_map<int64_t, std::vector<int>> frame_index;
+    std::unordered_map<int64_t, Tile> tiles;
+
+    // Feather weights for the last image size blended, recomputed when it changes
+    cv::Mat feather;
+
+    cv::Rect canvas_bounds;
+    std::size_t frames_refined;
+    std::size_t frames_skipped;
+
+    // Ticks once per added frame, for finding the least recently used tiles / features
+    uint64_t use_clock;
+    bool has_spilled;
+
+    // Everything in memory, most recently used first, so spilling pops from the back
+    std::list<Resident> lru;
+    // Memory held by tiles and frame features, kept up to date as they're loaded / spilled
+    std::size_t resident_bytes;
+    std::size_t tiles_spilled;
+
+    int64_t tileKey(int tile_x, int tile_y) const;
+    // Range of tile indices overlapping a canvas rect, as a rect of tile indices
+    cv::Rect tileRange(const cv::Rect& canvas_rect) const;
+
+    // Frames already on the canvas that overlap area, most overlap first
+    std::vector<int> findNeighbors(const cv::Rect& area) const;
+
+    // Tries to improve seed by matching against neighbors, nullopt if it can't
+    std::optional<cv::Matx33d> refine(const cv::Matx33d& seed, const cv::Size& image_size,
+                                      const std::vector<cv::Point2f>& keypoints,
+                                      const cv::Mat& descriptors,
+                                      const std::vector<int>& neighbors) const;
+
+    void blend(const cv::Mat& image, const cv::Matx33d& to_canvas, const cv::Rect& area);
+
+    // Tile at these indices, created or read back from spill_dir as needed
+    Tile& residentTile(int tile_x, int tile_y);
+    // A tile's pixels without bringing it back into memory if it's spilled
+    void readTile(int64_t key, const Tile& tile, cv::Mat& color, cv::Mat& weight) const;
+    // Reads a frame's features back from spill_dir if they were moved there
+    void loadFeatures(int frame_id);
+
+    static std::size_t residentBytes(const Tile& tile);
+    static std::size_t residentBytes(const Frame& frame);
+    // Marks something as just used (moves it to the front of lru), adding it if it just
+    // came into memory
+    void touch(std::list<Resident>::iterator* entry, bool is_tile, int64_t id, bool added);
+    // Spills the least recently used tiles / features until within the memory budget
+    void enforceBudget();
+    void clearSpill();
+};
+
+#endif  // INCLUDE_CV_MOSAIC_HPP_
@@ -0,0 +1,101 @@
+#ifndef INCLUDE_CV_MOSAIC_INGEST_HPP_
+#define INCLUDE_CV_MOSAIC_INGEST_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include <opencv2/core/mat.hpp>
+
+#include "camera/interface.hpp"
+#include "cv/mosaic.hpp"
+#include "cv/tile_pyramid.hpp"
+
+/**
+ * Feeds captured frames straight into an IncrementalMosaic on a background
+ * thread, instead of saving them as JPEGs and having Mapping find and decode
+ * them again later.
+ *
+ * push() downscales the frame to max_dim right away on the caller's thread, so
+ * the queue only ever holds small private copies and the caller is free to keep
+ * using (and drawing on) the original. If tile_dir is set, the parts of the map
+ * that changed are written there every few frames and on flush(), so the map
+ * survives on disk without ever writing the raw frames. The pyramid, if given,
+ * is updated at the same time for the GCS to view.
+ */
+class MosaicIngest {
+ public:
+    /**
+     * @param params mosaic settings
+     * @param max_dim frames are downscaled so their largest side is at most this
+     * @param preprocess crop the camera's green bar off the right side of each frame
+     * @param max_queue_size frames that can be waiting before new ones are dropped
+     * @param tile_dir where to persist map tiles, empty to keep everything in memory
+     * @param pyramid map tiles for the GCS to keep up to date, can be nullptr
+     */
+    MosaicIngest(const MosaicParams& params, int max_dim, bool preprocess,
+                 std::size_t max_queue_size, std::filesystem::path tile_dir = {},
+                 std::shared_ptr<TilePyramid> pyramid = nullptr);
+
+    // Processes everything still queued before returning
+    ~MosaicIngest();
+
+    /**
+     * Queue a frame to be added to the map.
+     *
+     * @returns false if it has no telemetry or the queue is full
+     */
+    bool push(const ImageData& image);
+
+    // Block until every frame pushed so far is on the map (and on disk, if persisting)
+    void flush();
+
+    // Stitches the map built so far into one image, see IncrementalMosaic::render
+    cv::Mat render(int max_dim = 0);
+
+    MosaicStats getStats();
+    std::size_t numDropped() const;
+    std::shared_ptr<TilePyramid> getPyramid() const;
+
+    // Throws away the map (and the pyramid, but not the tiles in tile_dir) to start a new one
+    void reset();
+
+ private:
+    struct Frame {
+        cv::Mat image;
+        ImageTelemetry telemetry;
+    };
+
+    const int max_dim;
+    const bool preprocess;
+    const std::size_t max_queue_size;
+    const std::filesystem::path tile_dir;
+    const std::shared_ptr<TilePyramid> pyramid;
+
+    std::mutex mut;
+    std::condition_variable queue_cv;  // signaled when a frame is queued or on shutdown
+    std::condition_variable idle_cv;   // signaled when the worker has emptied the queue
+    std::deque<Frame> queue;
+    bool stop;
+    bool busy;
+
+    std::atomic<std::size_t> num_dropped;
+
+    // Guards mosaic, which the worker writes and render/getStats read
+    std::mutex mosaic_mut;
+    IncrementalMosaic mosaic;
+    std::size_t frames_since_save;
+
+    std::thread worker;
+
+    void ingestLoop();
+    // Must be called with mosaic_mut held
+    void saveTiles();
+};
+
+#endif  // INCLUDE_CV_MOSAIC_INGEST_HPP_
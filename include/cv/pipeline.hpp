@@ -1,7 +1,10 @@
 #ifndef INCLUDE_CV_PIPELINE_HPP_
 #define INCLUDE_CV_PIPELINE_HPP_
 
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <string>
@@ -10,12 +13,14 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "camera/image_sink.hpp"
 #include "camera/interface.hpp"
 #include "cv/localization.hpp"
 #include "cv/preprocess.hpp"
 #include "cv/utilities.hpp"
 #include "cv/yolo.hpp"
 #include "protos/obc.pb.h"
+#include "utilities/obc_config.hpp"
 
 // Processed image holds all predictions made concerning a given image.
 struct PipelineResults {
@@ -29,6 +34,38 @@ struct PipelineResults {
     std::vector<DetectedTarget> targets;
 };
 
+// Sliced inference settings. When enabled the frame is split into overlapping
+// tiles that are run through YOLO at native resolution (plus the whole frame),
+// instead of letterboxing the full frame down to the model input size.
+struct TilingParams {
+    bool enabled = false;
+    int tileSize = 640;
+    float overlap = 0.2f;
+    // Intersection over smaller box above which two detections are merged
+    float mergeThreshold = 0.5f;
+};
+
+// Running totals for the region-of-interest gate, see Pipeline::searchRegion
+struct RoiGateStats {
+    uint64_t frames_gated;    // frames checked against the search boundary
+    uint64_t frames_skipped;  // frames with no overlap, YOLO never ran on them
+    uint64_t pixels_skipped;  // pixels cropped away or skipped before YOLO
+};
+
+// Running totals of the time Pipeline::run spends in each stage
+struct PipelineStageStats {
+    struct Stage {
+        uint64_t count;  // times the stage ran
+        std::chrono::microseconds total;
+        std::chrono::microseconds max;
+    };
+    Stage preprocess;  // cropping the frame
+    Stage roi_gate;    // projecting the search boundary into the frame
+    Stage detect;      // YOLO
+    Stage localize;    // building targets and localizing them
+    Stage annotate;    // drawing detections and queueing the output image
+};
+
 struct PipelineParams {
     // yoloModelPath is optional; when absent, no CV models will be loaded.
     explicit PipelineParams(std::optional<std::string> yoloModelPath,
@@ -36,13 +73,24 @@ struct PipelineParams {
                             int inputWidth,
                             int inputHeight,
                             std::string outputPath = "",
-                            bool do_preprocess = true)
+                            bool do_preprocess = true,
+                            TilingParams tiling = TilingParams())
         : yoloModelPath{std::move(yoloModelPath)},
           detection_threshold{detection_threshold},
           inputWidth(inputWidth),
           inputHeight(inputHeight),
           outputPath(std::move(outputPath)),
-          do_preprocess(do_preprocess) {}
+          do_preprocess(do_preprocess),
+          tiling(tiling) {}
+
+    // Build params from the cv section of the OBC config
+    explicit PipelineParams(const CVConfig& config)
+        : PipelineParams(config.yolo_model_dir, config.detection_threshold,
+                         config.input_width, config.input_height) {
+        tiling.enabled = config.tiling.enabled;
+        tiling.tileSize = config.tiling.tile_size;
+        tiling.overlap = config.tiling.overlap;
+    }
 
     std::optional<std::string> yoloModelPath;
     float detection_threshold;
@@ -50,21 +98,74 @@ struct PipelineParams {
     int inputHeight;
     bool do_preprocess;
     std::string outputPath;
+    TilingParams tiling;
+    // Area targets can be in (the airdrop boundary). When set, frames that don't
+    // see any of it are skipped and the rest are cropped to the part that does.
+    // Empty means every frame is searched in full.
+    std::vector<GPSCoord> searchBoundary;
 };
 
 // Pipeline handles YOLO + localization (and now optional preprocessing and output saving)
 class Pipeline {
  public:
     explicit Pipeline(const PipelineParams& p);
-    PipelineResults run(const ImageData& imageData);
+
+    // Takes ownership of the image: detections are drawn onto imageData.DATA
+    // in place and the same buffer is returned in PipelineResults.
+    PipelineResults run(ImageData imageData);
+
+    RoiGateStats getRoiGateStats() const;
+
+    PipelineStageStats getStageStats() const;
 
  private:
+    // Projects the search boundary into the image and returns the part of the
+    // image that overlaps it (plus a margin), or nullopt if there is no overlap.
+    std::optional<cv::Rect> searchRegion(const ImageTelemetry& telemetry,
+                                         const cv::Size& imageSize);
+
+    // Queues the image to be written to outputPath (numbered) if one was given
+    void saveOutput(const cv::Mat& image);
+
+    // Runs YOLO on the image, either directly or tile by tile depending on tiling
+    std::vector<Detection> detect(const cv::Mat& image);
+
     std::unique_ptr<YOLO> yoloDetector;
     // ECEFLocalization ecefLocalizer;
     GSDLocalization gsdLocalizer;
     bool do_preprocess;       // Flag to enable/disable preprocessing
     Preprocess preprocessor;  // Preprocess utility instance
     std::string outputPath;   // New member to hold output image path
+    std::unique_ptr<ImageSink> imageSink;  // Writes output images off the worker thread
+    TilingParams tiling;      // Sliced inference settings
+    std::vector<GPSCoord> searchBoundary;
+
+    struct RoiGateCounters {
+        std::atomic<uint64_t> frames_gated{0};
+        std::atomic<uint64_t> frames_skipped{0};
+        std::atomic<uint64_t> pixels_skipped{0};
+    };
+    // Behind a pointer so Pipeline stays movable into the CVAggregator
+    std::unique_ptr<RoiGateCounters> roiGateCounters;
+
+    struct StageCounter {
+        std::atomic<uint64_t> count{0};
+        std::atomic<uint64_t> total_us{0};
+        std::atomic<uint64_t> max_us{0};
+
+        // Adds the time since start
+        void record(std::chrono::steady_clock::time_point start);
+        PipelineStageStats::Stage get() const;
+    };
+    struct StageCounters {
+        StageCounter preprocess;
+        StageCounter roi_gate;
+        StageCounter detect;
+        StageCounter localize;
+        StageCounter annotate;
+    };
+    // Behind a pointer for the same reason
+    std::unique_ptr<StageCounters> stageCounters;
 };
 
 #endif  // INCLUDE_CV_PIPELINE_HPP_
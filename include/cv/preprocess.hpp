@@ -13,6 +13,10 @@ class Preprocess {
     // Returns a new cv::Mat containing the cropped image.
     cv::Mat cropRight(const cv::Mat &image) const;
 
+    // Same crop as cropRight, but returns a view that shares the
+    // underlying buffer with image instead of copying it.
+    cv::Mat cropRightView(const cv::Mat &image) const;
+
  private:
     const int crop_pixels_ = 20;
 };
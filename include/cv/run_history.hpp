@@ -0,0 +1,69 @@
+#ifndef INCLUDE_CV_RUN_HISTORY_HPP_
+#define INCLUDE_CV_RUN_HISTORY_HPP_
+
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "protos/obc.pb.h"
+
+// One run's IdentifiedTarget, serialized once when it's added so serving it
+// to the GCS is just a copy
+struct EncodedRun {
+    int run_id;
+    std::string json;   // MessageToJsonString
+    std::string proto;  // SerializeToString
+};
+
+// A page of runs, oldest first
+struct RunPage {
+    std::vector<std::shared_ptr<const EncodedRun>> runs;
+    int next_since;  // pass back as since to get the runs after these
+    bool more;       // there were more runs after since than fit in the page
+};
+
+/*
+ The last capacity runs the CV aggregator produced, for GET /targets/all to
+ page through with a cursor (the last run ID the GCS has). Run IDs are handed
+ out in the order runs are added, so everything after a cursor is exactly
+ what the GCS hasn't seen yet. Runs older than the history are dropped and
+ skipped over by the cursor.
+
+ Thread safe.
+ */
+class RunHistory {
+ public:
+    explicit RunHistory(std::size_t capacity);
+
+    // Gives target the next run ID, serializes it and adds it. Returns the ID.
+    int add(IdentifiedTarget target);
+
+    // Up to limit runs with IDs after since
+    RunPage since(int run_id, std::size_t limit) const;
+
+    // Up to limit runs after the last one returned by unsent(), for callers
+    // that don't keep a cursor of their own
+    RunPage unsent(std::size_t limit);
+
+    std::size_t size() const;
+
+    // ID of the last run added, nullopt if there are none yet
+    std::optional<int> newestRunId() const;
+
+ private:
+    const std::size_t capacity;
+
+    mutable std::mutex mut;
+    std::deque<std::shared_ptr<const EncodedRun>> runs;
+    int next_run_id;
+    int unsent_cursor;
+
+    // Must be called with mut held
+    RunPage page(int run_id, std::size_t limit) const;
+};
+
+#endif  // INCLUDE_CV_RUN_HISTORY_HPP_
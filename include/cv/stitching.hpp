@@ -0,0 +1,119 @@
+#ifndef INCLUDE_CV_STITCHING_HPP_
+#define INCLUDE_CV_STITCHING_HPP_
+
+#include <cstddef>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "opencv2/opencv.hpp"
+#include "opencv2/stitching.hpp"
+#include "opencv2/stitching/detail/camera.hpp"
+#include "opencv2/stitching/detail/matchers.hpp"
+
+/*
+ The cv::Stitcher pipeline broken out into its stages, so that features can be
+ shared between stitches and so that each stage can be timed.
+
+ cv::Stitcher redoes feature detection for every image on every call. With
+ overlapping chunks most images are part of two or more stitches, so here the
+ features are looked up in a FeatureCache first and only computed on a miss.
+ */
+
+// Wall clock time spent in each stage of a stitch, in milliseconds
+struct StitchTimings {
+    double find_features_ms = 0;
+    double matching_ms = 0;
+    double bundle_adjust_ms = 0;  // includes the initial camera estimate
+    double warp_ms = 0;
+    double blend_ms = 0;
+
+    StitchTimings& operator+=(const StitchTimings& other);
+    double total_ms() const;
+};
+
+// Thread safe store of image features, shared between stitches
+class FeatureCache {
+ public:
+    std::optional<cv::detail::ImageFeatures> get(const std::string& key) const;
+    void put(const std::string& key, const cv::detail::ImageFeatures& features);
+
+    std::size_t size() const;
+    std::size_t hits() const;
+    std::size_t misses() const;
+    void clear();
+
+ private:
+    mutable std::mutex mut;
+    std::unordered_map<std::string, cv::detail::ImageFeatures> features;
+    mutable std::size_t num_hits = 0;
+    mutable std::size_t num_misses = 0;
+};
+
+// Scale images are brought down to before finding features (~0.6MP, like cv::Stitcher)
+double registrationScale(const cv::Size& image_size);
+
+/**
+ * Features of image at work_scale. If key is non empty and cache isn't nullptr,
+ * the cache is checked first and filled on a miss.
+ */
+cv::detail::ImageFeatures findFeatures(const cv::Mat& image, const std::string& key,
+                                       double work_scale, FeatureCache* cache);
+
+struct StitchResult {
+    cv::Stitcher::Status status;
+    cv::Mat pano;
+    // Indices (into the input images) of the images that made it into the pano
+    std::vector<int> indices;
+    // Camera for each image in indices, at registration scale
+    std::vector<cv::detail::CameraParams> cameras;
+    StitchTimings timings;
+};
+
+/**
+ * Stitches images the same way cv::Stitcher does for the given mode (minus
+ * exposure compensation and seam finding, the multi-band blend hides seams well
+ * enough for mapping).
+ *
+ * @param images images to stitch. Features are found on a copy scaled down to
+ *        ~0.6MP, compositing is done at the size given.
+ * @param keys feature cache key for each image, or empty to skip the cache.
+ *        A key has to identify the image contents, e.g. filename + preprocessing.
+ * @param cache where features are looked up / stored, can be nullptr
+ * @param initial_cameras if there's one per image, used instead of estimating
+ *        cameras from scratch. Bundle adjustment still refines them.
+ * @param match_mask optional n x n CV_8U, nonzero where a pair of images
+ *        should be matched. Pairs left out are assumed not to overlap.
+ */
+StitchResult stitchImages(const std::vector<cv::Mat>& images, const std::vector<std::string>& keys,
+                          cv::Stitcher::Mode mode, FeatureCache* cache,
+                          const std::vector<cv::detail::CameraParams>& initial_cameras = {},
+                          const cv::Mat& match_mask = cv::Mat());
+
+// Cameras estimated while stitching one chunk, keyed by feature cache key
+struct ChunkCameras {
+    std::vector<std::string> keys;
+    std::vector<cv::detail::CameraParams> cameras;
+};
+
+struct ChainedCamera {
+    cv::detail::CameraParams camera;
+    int chunk;  // index of the first chunk the image was registered in
+};
+
+/**
+ * Brings the cameras of overlapping chunks into the frame of the first chunk.
+ * Each chunk is estimated relative to its own reference image, but chunks share
+ * images, so the camera of a shared image in both chunks gives the transform
+ * from one chunk's frame into the other's.
+ *
+ * Chunks with no cameras (failed stitches) are skipped.
+ *
+ * @returns nullopt if some chunk doesn't share an image with the ones before it
+ */
+std::optional<std::unordered_map<std::string, ChainedCamera>> chainChunkCameras(
+    const std::vector<ChunkCameras>& chunks);
+
+#endif  // INCLUDE_CV_STITCHING_HPP_
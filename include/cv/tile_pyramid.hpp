@@ -0,0 +1,85 @@
+#ifndef INCLUDE_CV_TILE_PYRAMID_HPP_
+#define INCLUDE_CV_TILE_PYRAMID_HPP_
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "cv/mosaic.hpp"
+#include "protos/obc.pb.h"
+
+/*
+ Slippy map tiles (the XYZ scheme Leaflet / OpenLayers / Google Maps use) cut
+ from an IncrementalMosaic, so the GCS can show the map zoomed out or zoomed in
+ on one spot without the full resolution map ever being rendered or sent.
+
+ Tiles are TILE_SIZE x TILE_SIZE Web Mercator tiles, saved as
+ <directory>/<z>/<x>/<y>.png with transparency wherever the mosaic has no
+ coverage. The most zoomed in level is the one closest to the mosaic's own
+ resolution, and every level below it is built by shrinking 4 tiles from the
+ level above, down to min_zoom. Each level's tiles are made in parallel.
+
+ <directory>/metadata.json has the zoom range and the lat/lon bounds of the map.
+
+ Tiles are written to a temporary file and renamed into place, so they can be
+ served while the pyramid is being updated.
+ */
+class TilePyramid {
+ public:
+    static constexpr int TILE_SIZE = 256;
+
+    /**
+     * @param directory where tiles are saved
+     * @param min_zoom most zoomed out level to make
+     * @param num_threads tiles made at once
+     */
+    TilePyramid(std::filesystem::path directory, int min_zoom, int num_threads);
+
+    /**
+     * Remakes every tile, at every zoom, that overlaps one of the changed
+     * canvas rects (see IncrementalMosaic::takeChangedRegions). mosaic must
+     * not be modified until this returns.
+     *
+     * @returns number of tiles written
+     */
+    std::size_t update(const IncrementalMosaic& mosaic, const std::vector<cv::Rect>& changed);
+
+    // Deletes every tile, to start over with a new mosaic
+    void clear();
+
+    std::filesystem::path tilePath(int zoom, int x, int y) const;
+    std::filesystem::path metadataPath() const;
+
+    // Most zoomed in level, nullopt until the first update
+    std::optional<int> getMaxZoom() const;
+    int getMinZoom() const;
+
+    /**
+     * Most zoomed in level that isn't finer than meters_per_px at latitude_deg,
+     * so the top level never has to upscale the mosaic.
+     */
+    static int maxZoomFor(double meters_per_px, double latitude_deg);
+
+    // Web Mercator pixel coordinates (across the whole world) at a zoom level
+    static cv::Point2d toPixel(double latitude_deg, double longitude_deg, int zoom);
+    static GPSCoord toGPS(const cv::Point2d& pixel, int zoom);
+
+ private:
+    std::filesystem::path directory;
+    int min_zoom;
+    int num_threads;
+    std::optional<int> max_zoom;
+
+    // Cuts a top level tile out of the mosaic, false if the mosaic doesn't cover it
+    bool renderTile(const IncrementalMosaic& mosaic, int zoom, int x, int y) const;
+    // Shrinks the 4 tiles above into one, false if none of them exist
+    bool mergeTile(int zoom, int x, int y) const;
+
+    bool writeTile(int zoom, int x, int y, const cv::Mat& tile) const;
+    void writeMetadata(const IncrementalMosaic& mosaic) const;
+};
+
+#endif  // INCLUDE_CV_TILE_PYRAMID_HPP_
@@ -0,0 +1,46 @@
+#ifndef INCLUDE_CV_TILING_HPP_
+#define INCLUDE_CV_TILING_HPP_
+
+#include <vector>
+
+#include <opencv2/core/types.hpp>
+
+#include "cv/yolo.hpp"
+
+/*
+ * Helpers for sliced (SAHI-style) inference: the frame is cut into overlapping
+ * tiles at native resolution so small targets aren't shrunk away by the
+ * letterbox, then detections from every tile are merged back together.
+ */
+
+/**
+ * Splits an image of the given size into overlapping tileSize x tileSize regions.
+ * Adjacent tiles share roughly overlap * tileSize pixels. The last tile on each
+ * axis is shifted back so it ends exactly on the image border instead of
+ * hanging off the edge. If the image is smaller than a tile on some axis, that
+ * axis gets a single tile spanning the whole image.
+ *
+ * @param imageSize size of the full frame
+ * @param tileSize  side length of each tile in pixels
+ * @param overlap   fraction of a tile shared with its neighbor, in [0, 1)
+ */
+std::vector<cv::Rect> makeTiles(const cv::Size& imageSize, int tileSize, float overlap);
+
+/**
+ * Moves detections made inside a tile back into full-frame coordinates.
+ */
+void offsetDetections(std::vector<Detection>& detections, const cv::Point& tileOrigin);
+
+/**
+ * Merges duplicate detections of the same object coming from different tiles.
+ *
+ * Regular IoU based NMS doesn't work well across tiles, because a target that
+ * straddles a seam shows up as one full box and one clipped box whose IoU is low.
+ * Instead, two boxes of the same class are considered the same object when their
+ * intersection covers more than matchThreshold of the smaller box. The higher
+ * confidence detection is kept and grown to the union of both boxes.
+ */
+std::vector<Detection> mergeTileDetections(std::vector<Detection> detections,
+                                           float matchThreshold);
+
+#endif  // INCLUDE_CV_TILING_HPP_
@@ -2,6 +2,7 @@
 #define INCLUDE_CV_UTILITIES_HPP_
 
 #include <optional>
+#include <string>
 #include <vector>
 #include <opencv2/opencv.hpp>
 
@@ -41,4 +42,10 @@ cv::Mat crop(const cv::Mat& original, const Bbox& bbox);
  */
 std::optional<cv::Mat> compressImg(const cv::Mat& img, int quality = 60);
 
+/**
+ * Inserts _<number> before the file extension of path, e.g. out.jpg -> out_3.jpg.
+ * If path has no extension, .jpg is appended: out -> out_3.jpg
+ */
+std::string numberedOutputPath(const std::string& path, int number);
+
 #endif  // INCLUDE_CV_UTILITIES_HPP_
@@ -8,6 +8,8 @@
 
 #include <opencv2/opencv.hpp>
 
+#include "camera/yuv.hpp"
+
 /// Simple struct to store a detection result
 struct Detection {
     float x1;
@@ -45,6 +47,30 @@ class YOLO {
      */
     std::vector<Detection> detect(const cv::Mat& image);
 
+    /**
+     * @brief Perform inference straight on the camera's YUV planes.
+     *
+     * Letterboxing, color conversion and normalization happen in one pass
+     * over the planes, so there's no BGR image or intermediate resize to
+     * allocate. Boxes are in the image's coordinates, same as detect(cv::Mat).
+     *
+     * @param image Input image (I420 planes)
+     * @return std::vector<Detection> A list of detections
+     */
+    std::vector<Detection> detect(const YUVImage& image);
+
+    /**
+     * @brief Perform inference on several images at once (e.g. the tiles of one frame).
+     *
+     * Images are preprocessed in parallel. If the model was exported with a dynamic
+     * batch dimension they are sent through the network as one batch, otherwise one
+     * inference per image is run in parallel. Safe to call from multiple threads.
+     *
+     * @param images Input images (cv::Mat in BGR format), may be different sizes
+     * @return std::vector<std::vector<Detection>> Detections for each image, in input order
+     */
+    std::vector<std::vector<Detection>> detectBatch(const std::vector<cv::Mat>& images);
+
     /**
      * @brief Draws and prints the given detections on the image.
      *
@@ -62,8 +88,60 @@ class YOLO {
     void processAndSaveImage(const cv::Mat& image, const std::string& outputFile);
 
  private:
-    /// Preprocess a cv::Mat to match the model's input shape and format
-    std::vector<float> preprocess(const cv::Mat& image);
+    /// How an image was scaled and padded by letterbox(), needed to map boxes back
+    struct LetterboxInfo {
+        float scale = 1.f;
+        int padLeft = 0;
+        int padTop = 0;
+    };
+
+    /**
+     * @brief Preprocess a cv::Mat to match the model's input shape and format.
+     *
+     * @param image The original BGR image
+     * @param dst   Where to write the 3 x inputHeight_ x inputWidth_ CHW float tensor
+     * @return LetterboxInfo The scale/padding applied to the image
+     */
+    LetterboxInfo preprocess(const cv::Mat& image, float* dst) const;
+
+    /**
+     * @brief Same as above, sampling the YUV planes directly.
+     *
+     * Bilinearly samples luma and chroma at each letterboxed pixel, converts
+     * to RGB with BT.601 and writes it normalized into the tensor.
+     *
+     * @param image The original I420 image
+     * @param dst   Where to write the 3 x inputHeight_ x inputWidth_ CHW float tensor
+     * @return LetterboxInfo The scale/padding applied to the image
+     */
+    LetterboxInfo preprocess(const YUVImage& image, float* dst) const;
+
+    /// The scale/padding letterbox() applies to an image of this size
+    LetterboxInfo letterboxFor(const cv::Size& imageSize) const;
+
+    /**
+     * @brief Run the session on an already preprocessed batch and decode the output.
+     *
+     * @param input       batchSize preprocessed images laid out back to back
+     * @param batchSize   Number of images in input
+     * @param letterboxes Letterbox info for each image in the batch
+     * @param imageSizes  Sizes of the original images (used for clamping boxes)
+     */
+    std::vector<std::vector<Detection>> infer(float* input, size_t batchSize,
+                                              const LetterboxInfo* letterboxes,
+                                              const cv::Size* imageSizes);
+
+    /**
+     * @brief Turn the raw network output for one image into detections in image space.
+     *
+     * @param output    Start of this image's output, laid out as [C, N] or [N, C]
+     * @param d1        First output dimension
+     * @param d2        Second output dimension
+     * @param lb        How the image was letterboxed
+     * @param imageSize Size of the original image
+     */
+    std::vector<Detection> decode(const float* output, int64_t d1, int64_t d2,
+                                  const LetterboxInfo& lb, const cv::Size& imageSize) const;
 
     /**
      * @brief Resize + pad the image to maintain aspect ratio as typical YOLO does.
@@ -75,7 +153,7 @@ class YOLO {
      * @return cv::Mat  The letterboxed image of size [newHeight x newWidth]
      */
     cv::Mat letterbox(const cv::Mat& src, int newWidth, int newHeight,
-                      const cv::Scalar& color = cv::Scalar(114, 114, 114));
+                      const cv::Scalar& color = cv::Scalar(114, 114, 114)) const;
 
  private:
     Ort::Env env_;
@@ -86,9 +164,8 @@ class YOLO {
     float nmsThreshold_;
     int inputWidth_;
     int inputHeight_;
-    float scale_ = 1.f;
-    int padTop_ = 0;
-    int padLeft_ = 0;
+    // Whether the model accepts any batch size, or only batches of 1
+    bool dynamicBatch_ = false;
 
     // Input/Output node information
     std::vector<std::string> inputNames_;
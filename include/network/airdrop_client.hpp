@@ -3,30 +3,51 @@
 
 #include <array>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <future>
 #include <list>
 #include <mutex>
 #include <optional>
-#include <queue>
 #include <utility>
+#include <vector>
 
 extern "C" {
 #include "network/airdrop_sockets.h"
+#include "network/packet_ring.h"
 #include "udp_squared/protocol.h"
 }
 #include "protos/obc.pb.h"
 #include "utilities/constants.hpp"
+#include "utilities/obc_config.hpp"
 
 class AirdropClient {
  public:
     // Blocking until we receive SET_MODE packets from the payloads
-    explicit AirdropClient(ad_socket_t socket);
+    explicit AirdropClient(ad_socket_t socket,
+                           AirdropLinkConfig config = {AIRDROP_DEFAULT_REDUNDANCY,
+                                                       AIRDROP_DEFAULT_RETRANSMIT_MS,
+                                                       AIRDROP_DEFAULT_MAX_RETRANSMITS});
     ~AirdropClient();
 
-    bool send(packet_t packet);
+    /**
+     * Sends config.redundancy copies of packet back to back.
+     *
+     * If ack_header is set, the packet is also resent every retransmit_ms
+     * until a packet with that header comes back from the airdrop it was
+     * sent to (any airdrop for UDP2_ALL), or it has been resent
+     * max_retransmits times. Returns right away either way, false if it
+     * couldn't be sent at all.
+     */
+    bool send(packet_t packet, std::optional<uint8_t> ack_header = {});
+
+    // Number of packets sent with an ack_header that are still waiting on it
+    std::size_t numUnacked();
+
     // Receives oldest packet since last receive() call, ignoring any
     // HEARTBEAT packets as those are parsed by the client itself
-    // and exposed through the TODO function.
+    // and exposed through getLostConnections.
     std::optional<packet_t> receive();
 
     // Returns list of all the payloads we have not heard from for more than
@@ -38,17 +59,35 @@ class AirdropClient {
     std::optional<drop_mode_t> getMode();
 
  private:
+    const AirdropLinkConfig config;
+
     std::optional<drop_mode_t> mode{};
     ad_socket_t socket{};
 
-    std::queue<packet_t> recv_queue;
+    // Filled by the worker alone. recv_mut only makes receive() callers take
+    // turns at being the ring's one consumer, it never blocks the worker.
+    packet_ring_t* recv_ring;
     std::mutex recv_mut;
 
+    // send_ad_packet isn't thread safe, and both callers and the worker send
+    std::mutex send_mut;
+
+    // A packet sent with an ack_header that hasn't been acked yet
+    struct Unacked {
+        packet_t packet;
+        uint8_t ack_header;
+        uint8_t airdrop;  // who it was sent to
+        int retransmits;
+        std::chrono::steady_clock::time_point next_retransmit;
+    };
+    std::vector<Unacked> unacked;  // guarded by send_mut
+
     std::atomic_bool stop_worker;
     std::future<void> worker_future;
 
-    // holds unix timestamp of the last heartbeat received from every payload
-    std::array<std::chrono::milliseconds, NUM_AIRDROPS> last_heartbeat;
+    // holds unix timestamp of the last heartbeat received from every payload,
+    // as stamped when the packet arrived
+    std::array<std::atomic<std::chrono::milliseconds>, NUM_AIRDROPS> last_heartbeat;
 
     // Get initial SET_MODE msg from payloads and set up workers
     void _establishConnection();
@@ -56,8 +95,22 @@ class AirdropClient {
     // Function to run in its own thread
     void _receiveWorker();
 
-    // Blocking implementation of receive for internal use
-    packet_t _receiveBlocking();
+    /**
+     * Waits up to timeout for packets and returns the valid ones, empty on
+     * timeout or once the worker should stop. Packets that aren't the size
+     * of a packet_t are logged and dropped.
+     */
+    std::vector<ad_recv_packet_t> _receiveBatch(std::chrono::milliseconds timeout);
+
+    // Sends config.redundancy copies of packet. Must hold send_mut.
+    bool _sendCopies(const packet_t& packet);
+
+    // Resends anything due for it, giving up on packets past max_retransmits.
+    // Returns how long until the next retransmit is due.
+    std::chrono::milliseconds _retransmit();
+
+    // Clears any unacked packet that packet acknowledges
+    void _checkAcks(const packet_t& packet);
 
     // Parses packets for heartbeat information and stores it in the
     // lastHeartbeat array.
@@ -65,7 +118,7 @@ class AirdropClient {
     // it should NOT be placed in the recv_queue. Otherwise, returns
     // false, meaning that it was NOT a heartbeat and should be exposed
     // to the user of the client through the nonblocking receive function.
-    bool _parseHeartbeats(packet_t packet);
+    bool _parseHeartbeats(const ad_recv_packet_t& received);
 };
 
 #endif  // INCLUDE_NETWORK_AIRDROP_CLIENT_HPP_
@@ -1,6 +1,7 @@
 #ifndef INCLUDE_NETWORK_AIRDROP_SOCKETS_H_
 #define INCLUDE_NETWORK_AIRDROP_SOCKETS_H_
 
+#include <stdint.h>
 #include <stdlib.h>
 
 #include "udp_squared/protocol.h"
@@ -9,6 +10,8 @@ struct ad_socket {
     uint16_t send_port;
     uint16_t recv_port;
     int fd;
+    int wake_fd;   // eventfd that wake_ad_socket writes to, to interrupt recv_ad_packets
+    int epoll_fd;  // waits on fd and wake_fd
 };
 typedef struct ad_socket ad_socket_t;
 
@@ -75,6 +78,27 @@ ad_int_result_t send_ad_packet(ad_socket_t socket, packet_t packet);
 ad_int_result_t recv_ad_packet(ad_socket_t socket, void* buf, size_t buf_len);
 #define AD_RECV_NOPACKETS -1
 
+// A datagram read by recv_ad_packets
+struct ad_recv_packet {
+    packet_t packet;
+    int len;                // bytes received, only sizeof(packet_t) is a valid packet
+    uint64_t recv_time_ms;  // unix time the kernel got it, rather than when it was read
+};
+typedef struct ad_recv_packet ad_recv_packet_t;
+
+// Waits up to timeout_ms (-1 for forever) for packets, then reads as many as are
+// waiting, up to max_packets, in one call.
+// Either returns an error string or the number of packets read, which is 0 if
+// the timeout ran out, or AD_RECV_WOKEN if wake_ad_socket was called.
+// IMPORTANT: must have previously called set_recv_thread from curr thread.
+ad_int_result_t recv_ad_packets(ad_socket_t socket, ad_recv_packet_t* packets,
+                                size_t max_packets, int timeout_ms);
+#define AD_RECV_WOKEN -2
+
+// Makes the current (or next) recv_ad_packets call return AD_RECV_WOKEN, so a
+// receive thread can be told to stop without closing the socket out from under it.
+ad_int_result_t wake_ad_socket(ad_socket_t socket);
+
 ad_int_result_t close_ad_socket(ad_socket_t socket);
 
 #endif  // INCLUDE_NETWORK_AIRDROP_SOCKETS_H_
@@ -0,0 +1,75 @@
+#ifndef INCLUDE_NETWORK_CONNECTION_MONITOR_HPP_
+#define INCLUDE_NETWORK_CONNECTION_MONITOR_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "protos/obc.pb.h"
+
+class MissionState;
+
+// A snapshot of the OBC's links, never modified once published
+struct ConnectionStatus {
+    OBCConnInfo info;
+    std::string json;  // info as JSON, what GET /connections returns
+
+    // When each part of info was last probed. Default constructed (the
+    // epoch) until the first probe finishes.
+    std::chrono::steady_clock::time_point links_checked;   // MAVLink and airdrop
+    std::chrono::steady_clock::time_point camera_checked;
+};
+
+/*
+ Probes the camera, MAVLink and airdrop links on a background thread and
+ caches the result, so GET /connections and the "connections" event are just
+ a pointer copy instead of a camera ping on the caller's thread.
+
+ MAVLink and airdrop status are in-memory lookups and are refreshed often.
+ The camera is probed less often, and its isConnected() falls back to the
+ last known state while a capture is using the link, so a probe never
+ collides with image traffic.
+
+ Thread safe.
+ */
+class ConnectionMonitor {
+ public:
+    // state must outlive the monitor, or at least its stop()
+    ConnectionMonitor(MissionState* state, std::chrono::milliseconds links_interval,
+                      std::chrono::milliseconds camera_interval);
+    ~ConnectionMonitor();
+
+    void start();
+    void stop();
+
+    // Latest snapshot, never nullptr. Everything reads as disconnected until
+    // the first probe.
+    std::shared_ptr<const ConnectionStatus> latest();
+
+    // Probes every link once on the calling thread and publishes the result
+    void probeNow();
+
+ private:
+    MissionState* state;
+    const std::chrono::milliseconds links_interval;
+    const std::chrono::milliseconds camera_interval;
+
+    std::mutex status_mut;
+    std::shared_ptr<const ConnectionStatus> status;
+
+    std::mutex thread_mut;
+    std::condition_variable thread_cv;
+    std::thread thread;
+    bool running;  // guarded by thread_mut
+
+    void _run();
+
+    void _probeLinks(ConnectionStatus* status);
+    void _probeCamera(ConnectionStatus* status);
+    void _publish(ConnectionStatus status);
+};
+
+#endif  // INCLUDE_NETWORK_CONNECTION_MONITOR_HPP_
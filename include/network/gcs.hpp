@@ -3,14 +3,19 @@
 
 #include <httplib.h>
 
+#include <chrono>
+#include <condition_variable>
 #include <thread>
 #include <memory>
 #include <mutex>
 #include <cstdint>
 #include <optional>
+#include <string>
 
 #include "core/mission_parameters.hpp"
 #include "core/mission_state.hpp"
+#include "network/connection_monitor.hpp"
+#include "network/request_metrics.hpp"
 #include "protos/obc.pb.h"
 
 
@@ -27,9 +32,30 @@ class GCSServer {
     uint16_t port;
 
     std::shared_ptr<MissionState> state;
+    std::shared_ptr<ConnectionMonitor> connection_monitor;
+
+    // Handler latencies for GET /metrics, and how slow a request has to be
+    // to get logged
+    RequestMetrics metrics;
+    std::chrono::milliseconds slow_request;
+
+    // Samples telemetry, cached connection status and new CV runs for the /events
+    // stream. Ticks are published by the MissionState itself.
+    std::thread events_thread;
+    std::mutex events_mut;
+    std::condition_variable events_cv;
+    bool stopping;  // guarded by events_mut
 
     // Handler Functions
     void _bindHandlers();  // bind all the handlers to the server object
+
+    // Configures the worker pool, keep-alive, timeouts and payload limit
+    void _configureServer();
+
+    // Wraps handler to record its latency under route and log it if slow
+    httplib::Server::Handler _timed(const char* route, httplib::Server::Handler handler);
+
+    void _publishEvents();
 };
 
 #endif  // INCLUDE_NETWORK_GCS_HPP_
@@ -39,12 +39,15 @@
 
 #define BIND_PARAMS(...) \
     std::bind_front(&GCS_HANDLE(__VA_ARGS__), this->state)
+// Every handler is wrapped by GCSServer::_timed so it shows up in /metrics
 #define BIND_HANDLER_4(Method, uri1, uri2, uri3) \
-    server.Method(STRe(/uri1/uri2/uri3), BIND_PARAMS(Method, uri1, uri2, uri3))
+    server.Method(STRe(/uri1/uri2/uri3), \
+        this->_timed(STRe(/uri1/uri2/uri3), BIND_PARAMS(Method, uri1, uri2, uri3)))
 #define BIND_HANDLER_3(Method, uri1, uri2) \
-    server.Method(STRe(/uri1/uri2), BIND_PARAMS(Method, uri1, uri2))
+    server.Method(STRe(/uri1/uri2), \
+        this->_timed(STRe(/uri1/uri2), BIND_PARAMS(Method, uri1, uri2)))
 #define BIND_HANDLER_2(Method, uri1) \
-    server.Method(STRe(/uri1), BIND_PARAMS(Method, uri1))
+    server.Method(STRe(/uri1), this->_timed(STRe(/uri1), BIND_PARAMS(Method, uri1)))
 
 // Call with the same parameters as DEF_GCS_HANDLE to bind the function
 // to the http server endpoint.
@@ -20,12 +20,30 @@
 /*
  * GET /connection
  * ---
- * Returns information about the connection status of the OBC
+ * Returns information about the connection status of the OBC, as last probed
+ * by the ConnectionMonitor. Never waits on a link. X-Links-Age-Ms and
+ * X-Camera-Age-Ms say how old the MAVLink/airdrop and camera parts are.
  *
  * 200 OK: Successfully retrieved data
+ * 503 SERVICE UNAVAILABLE: Connection monitor isn't running
  */
 DEF_GCS_HANDLE(Get, connections);
 
+/*
+ * GET /jobs?id=<job id>
+ * ---
+ * Polls a job started by a slow request like POST /camera/runpipeline.
+ * Returns {"id", "name", "state": "queued" | "running" | "done",
+ * "submitted_ms"}, plus "status" and "body" (what the request would have
+ * returned) once it's done. Without an id, returns an array of every job
+ * still queued, running, or recently finished.
+ *
+ * 200 OK: Returned the job(s)
+ * 400 BAD REQUEST: id isn't a number
+ * 404 NOT FOUND: No job with that id
+ */
+DEF_GCS_HANDLE(Get, jobs);
+
 /*
  * GET /tick
  * ---
@@ -35,6 +53,28 @@ DEF_GCS_HANDLE(Get, connections);
  **/
 DEF_GCS_HANDLE(Get, tick);
 
+/*
+ * GET /events
+ * ---
+ * Server-sent event stream (text/event-stream) of state changes, so the GCS
+ * doesn't have to keep polling the routes above. Each event's name is its
+ * topic, and only the newest value of a topic is sent if several came in at
+ * once:
+ *
+ *   tick:        name of the new tick, whenever it changes
+ *   telemetry:   JSON position/attitude snapshot, at network.gcs.events.telemetry_rate_hz
+ *   connections: same JSON as GET /connections, at network.gcs.events.connections_rate_hz
+ *   targets:     {"newest_run_id": <run_id>} when new runs are ready on GET /targets/all
+ *
+ * Every topic's current value is sent first. Reconnecting with Last-Event-ID
+ * only sends what changed since that event. A comment is sent every
+ * GCS_EVENTS_KEEPALIVE_MS so proxies and the GCS can tell the stream is alive.
+ *
+ * 200 OK: stream started
+ * 400 BAD REQUEST: already GCS_MAX_EVENT_STREAMS streams open
+ */
+DEF_GCS_HANDLE(Get, events);
+
 /*
  * GET /mission
  * ---
@@ -156,9 +196,18 @@ DEF_GCS_HANDLE(Post, targets, validate);
 DEF_GCS_HANDLE(Post, targets, reject);
 
 /**
- * GET /targets/all
+ * GET /targets/all?since=<run_id>&limit=<n>
  * ---
- * get all of the targets that have been identified & send to the GCS
+ * get the targets identified since the given run ID, oldest first and at
+ * most limit (default TARGETS_PAGE_SIZE) of them. Without since, the runs
+ * that haven't been sent to a request without since yet.
+ *
+ * X-Next-Since is the since to pass next time, and X-More-Runs is "true" if
+ * there are more runs waiting after this page.
+ *
+ * JSON list of IdentifiedTarget by default (gzipped if the GCS accepts it).
+ * With format=proto or an Accept of application/x-protobuf, the same targets
+ * as length delimited binary IdentifiedTarget messages.
  */
 DEF_GCS_HANDLE(Get, targets, all);
 
@@ -207,7 +256,42 @@ DEF_GCS_HANDLE(Post, rtl);
 DEF_GCS_HANDLE(Get, oh, shit);
 
 DEF_GCS_HANDLE(Get, obcstate);
+
+/*
+ * POST /camera/runpipeline
+ * ---
+ * Takes a picture per hover stop and runs the CV pipeline on them, in the
+ * background. Returns {"job_id": N}, poll GET /jobs?id=N for the result.
+ * Posting again while a run is queued or running returns that run's job.
+ *
+ * 202 ACCEPTED: Run queued
+ */
 DEF_GCS_HANDLE(Post, camera, runpipeline);
 
+/**
+ * GET /map/metadata
+ * ---
+ * Zoom range and bounds of the map tiles. If the mission has been uploaded,
+ * also has the map corners in the mission's local (CartesianConverter) frame.
+ *
+ * 200 OK: Map metadata as JSON
+ * 400 BAD REQUEST: Mapping is disabled
+ * 404 NOT FOUND: No map tiles have been made yet
+ */
+DEF_GCS_HANDLE(Get, map, metadata);
+
+/**
+ * GET /map/tile?z={z}&x={x}&y={y}
+ * ---
+ * One 256x256 PNG map tile, using the same XYZ tile numbering as web map
+ * libraries, so the URL can be handed to Leaflet as is. Tiles are remade as
+ * the map grows, so they shouldn't be cached for long.
+ *
+ * 200 OK: The tile
+ * 400 BAD REQUEST: Missing / bad tile coordinates, or mapping is disabled
+ * 404 NOT FOUND: The map doesn't cover this tile (yet)
+ */
+DEF_GCS_HANDLE(Get, map, tile);
+
 
 #endif  // INCLUDE_NETWORK_GCS_ROUTES_HPP_
@@ -9,6 +9,7 @@
 #include <mavsdk/plugins/param/param.h>
 #include <mavsdk/plugins/telemetry/telemetry.h>
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
 #include <iostream>
@@ -20,9 +21,12 @@
 #include <utility>
 #include <vector>
 
+#include "camera/interface.hpp"
+#include "network/telemetry_history.hpp"
 #include "pathing/mission_path.hpp"
 #include "protos/obc.pb.h"
 #include "utilities/datatypes.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/obc_config.hpp"
 
 class MissionState;
@@ -36,6 +40,7 @@ class MavlinkClient {
      *   MavlinkClient("tcp://192.168.65.254:5762")
      */
     explicit MavlinkClient(OBCConfig config);
+    virtual ~MavlinkClient() = default;
 
     /*
      * BLOCKING. Continues to try to upload the mission based on the passed through MissionConfig
@@ -57,11 +62,20 @@ class MavlinkClient {
      * should never happen due to how the state machine is set up, but it is there just in case.
      */
     bool uploadMissionUntilSuccess(std::shared_ptr<MissionState> state, bool upload_geofence,
-                                   const MissionPath& waypoints) const;
+                                   const MissionPath& waypoints);
 
-    bool uploadGeofenceUntilSuccess(std::shared_ptr<MissionState> state) const;
-    bool uploadWaypointsUntilSuccess(std::shared_ptr<MissionState> state,
-                                     const MissionPath& waypoints) const;
+    virtual bool uploadGeofenceUntilSuccess(std::shared_ptr<MissionState> state) const;
+
+    /*
+     * Waypoints are diffed against the last mission uploaded successfully: an
+     * unchanged mission isn't sent at all (as long as the autopilot still has
+     * that many items), and if only some items in the middle
+     * changed just those are sent (when network.mavlink.partial_upload is set and
+     * the autopilot supports it). Each attempt waits on the autopilot's response
+     * for at most network.mavlink.upload_timeout_s.
+     */
+    virtual bool uploadWaypointsUntilSuccess(std::shared_ptr<MissionState> state,
+                                             const MissionPath& waypoints);
 
     std::pair<double, double> latlng_deg();
     double altitude_agl_m();
@@ -72,17 +86,32 @@ class MavlinkClient {
     double yaw_deg();
     double pitch_deg();
     double roll_deg();
+
+    /*
+     * Where the plane was and how it was oriented at timestamp_ms (unix time, the
+     * same clock as ImageData::TIMESTAMP), interpolated from recent telemetry.
+     * Lock free, so it is safe to call from the capture path.
+     *
+     * The position (with altitude, airspeed and heading) and the attitude are
+     * each interpolated from their own samples, since they arrive separately.
+     *
+     * Returns nullopt if timestamp_ms is older than the position or attitude
+     * still kept, or too far past the newest of either (see
+     * POSITION_HISTORY_MAX_STALENESS_MS and ATTITUDE_HISTORY_MAX_STALENESS_MS).
+     */
+    std::optional<ImageTelemetry> telemetryAt(uint64_t timestamp_ms) const;
+
     XYZCoord wind();
     bool isArmed();
     mavsdk::Telemetry::FlightMode flight_mode();
-    int32_t curr_waypoint() const;
-    bool isMissionFinished();
-    bool isAtFinalWaypoint();
-    bool setMissionItem(int item);
-    size_t totalWaypoints();
-    mavsdk::Telemetry::RcStatus get_conn_status();
-    bool armAndHover(std::shared_ptr<MissionState> state);
-    bool startMission();
+    virtual int32_t curr_waypoint() const;
+    virtual bool isMissionFinished();
+    virtual bool isAtFinalWaypoint();
+    virtual bool setMissionItem(int item);
+    virtual size_t totalWaypoints();
+    virtual mavsdk::Telemetry::RcStatus get_conn_status();
+    virtual bool armAndHover(std::shared_ptr<MissionState> state);
+    virtual bool startMission();
 
     /*
      * Triggers a relay on the ArduPilot
@@ -90,12 +119,25 @@ class MavlinkClient {
      * @param state True to turn on, false to turn off
      * @return True if successful, false otherwise
      */
-    bool triggerRelay(int relay_number, bool state);
+    virtual bool triggerRelay(int relay_number, bool state);
 
-    void KILL_THE_PLANE_DO_NOT_CALL_THIS_ACCIDENTALLY();
+    virtual void KILL_THE_PLANE_DO_NOT_CALL_THIS_ACCIDENTALLY();
 
     // rtl
-    void rtl();
+    virtual void rtl();
+
+ protected:
+    /*
+     * For clients that stand in for the autopilot (network/replay_mavlink.hpp).
+     * Sets up the telemetry, but doesn't connect to anything, so every method
+     * that talks to the autopilot has to be overridden.
+     */
+    struct Offline {};
+    explicit MavlinkClient(Offline);
+
+    // Takes a telemetry sample as if the autopilot had sent it at timestamp_ms
+    // (unix time), which is what telemetryAt looks it up by
+    void setTelemetry(const TelemetryRecord& telemetry, uint64_t timestamp_ms);
 
  private:
     mavsdk::Mavsdk mavsdk;
@@ -123,6 +165,45 @@ class MavlinkClient {
         bool armed{};
     } data;
     std::mutex data_mut;
+
+    // Snapshots of data as it changes, written by the telemetry callbacks. Only
+    // the position fields of position_history and the attitude fields of
+    // attitude_history are read, the rest are whatever they were at the time.
+    TelemetryHistory position_history;
+    TelemetryHistory attitude_history;
+
+    // What a telemetry sample updated, so which histories it goes into
+    enum class TelemetrySource { POSITION, ATTITUDE, ALL };
+
+    // Adds data to source's histories at timestamp_ms, and hands it to the
+    // flight recorder. Telemetry from the autopilot is stamped on arrival,
+    // which is the same clock the cameras stamp frames with. Must be called
+    // with data_mut held
+    void recordTelemetry(TelemetrySource source, uint64_t timestamp_ms);
+
+    const std::chrono::seconds upload_timeout;
+    const bool partial_upload;
+
+    // Held for the whole of a waypoint upload, guards uploaded_mission
+    std::mutex upload_mut;
+    // What the autopilot was last given, empty if unknown
+    std::vector<mavsdk::MissionRaw::MissionItem> uploaded_mission;
+    // Set when something else changed the mission, so uploaded_mission is wrong
+    std::atomic_bool uploaded_mission_stale{false};
+    // MissionRaw reports the ack for our own uploads as a mission change too.
+    // Changes before this (steady clock) are taken to be ours and ignored.
+    std::atomic<std::chrono::steady_clock::rep> own_mission_change_until{0};
+    // Cleared the first time the autopilot refuses a partial upload
+    std::atomic_bool partial_supported{true};
+
+    // How many items the autopilot's mission has, from MISSION_COUNT without
+    // downloading the items. nullopt if it didn't answer. Must hold upload_mut.
+    std::optional<std::size_t> autopilotMissionSize();
+    // Sends items with MissionRaw. Must hold upload_mut.
+    bool uploadAll(const std::vector<mavsdk::MissionRaw::MissionItem>& items);
+    // Sends items first through last with MISSION_WRITE_PARTIAL_LIST. Must hold upload_mut.
+    bool uploadPartial(const std::vector<mavsdk::MissionRaw::MissionItem>& items,
+                       int first, int last);
 };
 
 #endif  // INCLUDE_NETWORK_MAVLINK_HPP_
@@ -0,0 +1,35 @@
+#ifndef INCLUDE_NETWORK_MISSION_DIFF_HPP_
+#define INCLUDE_NETWORK_MISSION_DIFF_HPP_
+
+#include <mavsdk/plugins/mission_raw/mission_raw.h>
+
+#include <vector>
+
+/*
+ What has to be sent to the autopilot to turn the mission it already has into
+ a new one.
+
+ Only a run of changed items inside a mission of the same length can be sent
+ on its own (MISSION_WRITE_PARTIAL_LIST). Anything that adds or removes items,
+ or changes all of them, needs the whole mission.
+ */
+struct MissionDiff {
+    enum class Kind {
+        UNCHANGED,  // nothing to send
+        PARTIAL,    // send items first through last
+        FULL,       // send everything
+    };
+
+    Kind kind;
+    int first;  // first changed item, for PARTIAL
+    int last;   // last changed item (inclusive), for PARTIAL
+};
+
+/**
+ * @param uploaded the mission the autopilot has, empty if unknown
+ * @param next the mission it should have
+ */
+MissionDiff diffMission(const std::vector<mavsdk::MissionRaw::MissionItem>& uploaded,
+                        const std::vector<mavsdk::MissionRaw::MissionItem>& next);
+
+#endif  // INCLUDE_NETWORK_MISSION_DIFF_HPP_
@@ -0,0 +1,53 @@
+#ifndef INCLUDE_NETWORK_PACKET_RING_H_
+#define INCLUDE_NETWORK_PACKET_RING_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "udp_squared/protocol.h"
+
+/*
+ * Lock-free single-producer/single-consumer ring buffer of packets.
+ *
+ * Exactly one thread may push and one thread may pop at a time. More than
+ * one is fine as long as they take turns under a lock of their own (e.g.
+ * AirdropClient's callers), since that orders them like a single thread.
+ *
+ * The producer's and consumer's indices live on separate cache lines so the
+ * two threads don't bounce a line back and forth on every packet. Pushing
+ * onto a full ring drops the packet and counts it rather than blocking the
+ * producer, which is usually the receive thread of a socket.
+ *
+ * The struct is opaque so C++ code can use it without C11 atomics.
+ */
+typedef struct packet_ring packet_ring_t;
+
+// Makes a ring that holds at least capacity packets (rounded up to a power
+// of two). Returns NULL if it couldn't be allocated.
+packet_ring_t* packet_ring_create(size_t capacity);
+void packet_ring_destroy(packet_ring_t* ring);
+
+// Producer only. Returns 1 if packet was added, 0 if the ring was full, in
+// which case the packet is counted in packet_ring_dropped.
+int packet_ring_push(packet_ring_t* ring, const packet_t* packet);
+
+// Consumer only. Returns 1 and fills out if there was a packet, 0 if empty.
+int packet_ring_pop(packet_ring_t* ring, packet_t* out);
+
+// Consumer only. Waits up to timeout_ms (-1 for forever) for something to pop.
+// Returns 1 if there is, 0 on timeout and -1 if packet_ring_wake was called.
+int packet_ring_wait(packet_ring_t* ring, int timeout_ms);
+
+// Makes the current (or next) packet_ring_wait return -1. Any thread.
+void packet_ring_wake(packet_ring_t* ring);
+
+// Number of packets in the ring. Exact from the producer or consumer,
+// a snapshot from anywhere else.
+size_t packet_ring_size(packet_ring_t* ring);
+size_t packet_ring_capacity(packet_ring_t* ring);
+
+// Packets pushed and packets dropped because the ring was full, since creation
+uint64_t packet_ring_pushed(packet_ring_t* ring);
+uint64_t packet_ring_dropped(packet_ring_t* ring);
+
+#endif  // INCLUDE_NETWORK_PACKET_RING_H_
@@ -0,0 +1,82 @@
+#ifndef INCLUDE_NETWORK_REPLAY_MAVLINK_HPP_
+#define INCLUDE_NETWORK_REPLAY_MAVLINK_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "network/mavlink.hpp"
+#include "utilities/flight_recorder.hpp"
+
+// What the autopilot did on a recorded flight, for ReplayMavlinkClient to play back
+struct ReplayFlight {
+    // (unix ms, sample), oldest first
+    std::vector<std::pair<uint64_t, TelemetryRecord>> telemetry;
+
+    // When the recorded OBC saw each mission it flew finish (unix ms), in the
+    // order they were flown. Taken from the ticks that wait on a mission
+    // finishing: leaving FlyWaypoints or AirdropApproach, or FlySearch for CVLoiter.
+    std::vector<uint64_t> missions_finished;
+};
+
+// The ReplayFlight in a flight log (see readFlightLog)
+ReplayFlight makeReplayFlight(const std::vector<FlightRecord>& records);
+
+/*
+ Stands in for the autopilot when replaying a recorded flight. Nothing is
+ sent anywhere.
+
+ Telemetry is the recording's, up to getUnixTime_ms() (see ReplayClock) as of
+ the last update(). Missions don't follow the waypoints uploaded: the n-th
+ mission uploaded is flown from when it's started until the time the recorded
+ OBC saw its n-th mission finish (or the end of the recording), with its
+ current waypoint moving along evenly in between.
+
+ Thread safe.
+ */
+class ReplayMavlinkClient : public MavlinkClient {
+ public:
+    explicit ReplayMavlinkClient(ReplayFlight flight);
+
+    // Takes every recorded telemetry sample up to now. Call whenever the replay clock moves.
+    void update();
+
+    // Whether the replay clock is past the last telemetry sample
+    bool finished() const;
+
+    bool uploadGeofenceUntilSuccess(std::shared_ptr<MissionState> state) const override;
+    bool uploadWaypointsUntilSuccess(std::shared_ptr<MissionState> state,
+                                     const MissionPath& waypoints) override;
+
+    int32_t curr_waypoint() const override;
+    bool isMissionFinished() override;
+    bool isAtFinalWaypoint() override;
+    bool setMissionItem(int item) override;
+    size_t totalWaypoints() override;
+    mavsdk::Telemetry::RcStatus get_conn_status() override;
+    bool armAndHover(std::shared_ptr<MissionState> state) override;
+    bool startMission() override;
+    bool triggerRelay(int relay_number, bool state) override;
+    void KILL_THE_PLANE_DO_NOT_CALL_THIS_ACCIDENTALLY() override;
+    void rtl() override;
+
+ private:
+    const ReplayFlight flight;
+
+    mutable std::mutex mut;
+    std::size_t next_sample;           // next telemetry sample to take
+    int missions_uploaded;             // the current mission is number missions_uploaded - 1
+    std::size_t mission_size;          // items in the current mission
+    std::optional<uint64_t> started_ms;  // when the current mission was started
+
+    // When the current mission finishes, nullopt if it hasn't started. Must hold mut.
+    std::optional<uint64_t> finishMs() const;
+    // Progress through the current mission, from 0 to mission_size. Must hold mut.
+    int32_t progress() const;
+};
+
+#endif  // INCLUDE_NETWORK_REPLAY_MAVLINK_HPP_
@@ -0,0 +1,49 @@
+#ifndef INCLUDE_NETWORK_REQUEST_METRICS_HPP_
+#define INCLUDE_NETWORK_REQUEST_METRICS_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+
+/*
+ Latency histograms for the GCS server's routes, served on GET /metrics in
+ the Prometheus text format.
+
+ Buckets are fixed so recording a request is a few increments under a lock.
+
+ Thread safe.
+ */
+class RequestMetrics {
+ public:
+    // Upper bounds of the histogram buckets, in ms. Slower requests land in
+    // a last +Inf bucket.
+    static constexpr std::array<int, 13> BUCKETS_MS = {
+        1, 2, 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000, 10000};
+
+    struct Histogram {
+        // Not cumulative, buckets[i] counts requests in (BUCKETS_MS[i - 1], BUCKETS_MS[i]]
+        std::array<uint64_t, BUCKETS_MS.size() + 1> buckets{};
+        uint64_t count = 0;
+        uint64_t errors = 0;  // responses with a 5xx status
+        std::chrono::microseconds total{0};
+        std::chrono::microseconds max{0};
+    };
+
+    void record(const std::string& route, int status, std::chrono::microseconds duration);
+
+    // nullopt if the route hasn't been requested yet
+    std::optional<Histogram> get(const std::string& route) const;
+
+    std::string toPrometheus() const;
+
+ private:
+    mutable std::mutex mut;
+    std::map<std::string, Histogram> routes;
+};
+
+#endif  // INCLUDE_NETWORK_REQUEST_METRICS_HPP_
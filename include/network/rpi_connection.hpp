@@ -29,4 +29,72 @@ struct Header {
     uint32_t mem_size;
 };
 
+/*
+ Version 2 of the transport, used once the client and camera have agreed on it
+ with a HelloPacket (see UDPClient::negotiate). Cameras that don't answer the
+ hello keep getting served with the Header / CHUNK_SIZE protocol above.
+
+ - Chunks can be as large as the path MTU allows, up to MAX_CHUNK_SIZE
+ - Every chunk says which frame and plane it belongs to, so all 3 planes can
+   be received at once
+ - The client NACKs the chunks it is missing and the camera resends just those
+
+ Every field is sent in network byte order.
+ */
+const uint32_t HELLO_MAGIC = 0x48454c4f;  // "HELO"
+const uint32_t FRAME_MAGIC = 0x46524d45;  // "FRME"
+const uint32_t CHUNK_MAGIC = 0x43484e4b;  // "CHNK"
+const uint32_t NACK_MAGIC = 0x4e41434b;   // "NACK"
+
+const uint32_t NUM_PLANES = 3;
+// Fits a 9000 byte jumbo frame after the IP, UDP and ChunkHeader headers
+const size_t MAX_CHUNK_SIZE = 8952;
+
+// Sent by the client with the largest chunk it can take, echoed back by the
+// camera with the chunk size it will actually use
+struct HelloPacket {
+    uint32_t magic;
+    uint32_t chunk_size;
+};
+
+// Sent before each plane's chunks
+struct FrameHeader {
+    uint32_t magic;
+    uint32_t frame_id;
+    uint32_t plane;
+    uint32_t total_chunks;
+    uint32_t mem_size;
+};
+
+// Starts every chunk, followed by up to chunk_size bytes of the plane
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t frame_id;
+    uint32_t plane;
+    uint32_t chunk_idx;
+};
+
+// Followed by count chunk indices to resend. A count of 0 asks for the whole
+// plane again, header included, for when the header itself was lost.
+struct NackPacket {
+    uint32_t magic;
+    uint32_t frame_id;
+    uint32_t plane;
+    uint32_t count;
+};
+
+// Keeps NACKs well under any MTU
+const size_t MAX_NACK_INDICES = (CHUNK_SIZE - sizeof(NackPacket)) / sizeof(uint32_t);
+
+// How long the client waits for the camera to answer a HelloPacket
+const int NEGOTIATE_TIMEOUT_MS = 200;
+// How long the client goes without a datagram mid-frame before NACKing what is
+// missing, and how many times it NACKs before giving up on the frame
+const int NACK_IDLE_TIMEOUT_MS = 20;
+const int MAX_NACK_ROUNDS = 8;
+// Datagrams pulled off the socket per recvmmsg call
+const size_t RECV_BATCH_SIZE = 64;
+// Socket receive buffer, enough to hold a whole frame if the client falls behind
+const int RECV_BUFFER_BYTES = 4 * 1024 * 1024;
+
 #endif
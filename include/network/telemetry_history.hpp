@@ -0,0 +1,81 @@
+#ifndef INCLUDE_NETWORK_TELEMETRY_HISTORY_HPP_
+#define INCLUDE_NETWORK_TELEMETRY_HISTORY_HPP_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+#include "camera/interface.hpp"
+
+/*
+ Fixed size ring of timestamped telemetry samples, so the pose of the plane can
+ be looked up at the moment a frame was exposed instead of whenever the camera
+ code got around to asking mavlink.
+
+ There is exactly one writer (the mavlink telemetry callbacks) and any number
+ of readers. Each slot is guarded by its own sequence number (a seqlock), so
+ readers never block the writer or each other: a reader that races with the
+ writer over a slot sees the sequence number change and treats that slot as
+ already overwritten.
+ */
+class TelemetryHistory {
+ public:
+    /**
+     * @param capacity samples kept before the oldest ones are overwritten
+     * @param max_staleness_ms how far past the newest sample a lookup still
+     *                         returns that sample instead of nullopt
+     */
+    TelemetryHistory(std::size_t capacity, uint64_t max_staleness_ms);
+
+    // Only ever call from one thread at a time
+    void push(uint64_t timestamp_ms, const ImageTelemetry& telemetry);
+
+    /**
+     * Pose at timestamp_ms, linearly interpolated between the samples on either
+     * side of it. Angles are interpolated the short way around the circle.
+     *
+     * @returns nullopt if timestamp_ms is older than every sample still kept,
+     *          or more than max_staleness_ms newer than the newest one
+     */
+    std::optional<ImageTelemetry> at(uint64_t timestamp_ms) const;
+
+    // Timestamp of the newest sample, nullopt if nothing has been pushed
+    std::optional<uint64_t> newestTimestamp() const;
+
+    std::size_t size() const;
+
+ private:
+    // ImageTelemetry flattened out so every field can be atomic
+    static constexpr std::size_t NUM_FIELDS = 8;
+    using Fields = std::array<double, NUM_FIELDS>;
+
+    struct Slot {
+        // 2 * (index + 1) once sample index is fully written, odd while it is being written
+        std::atomic<uint64_t> seq{0};
+        std::atomic<uint64_t> timestamp_ms{0};
+        std::array<std::atomic<double>, NUM_FIELDS> fields{};
+    };
+
+    struct Sample {
+        uint64_t timestamp_ms;
+        Fields fields;
+    };
+
+    const std::size_t capacity;
+    const uint64_t max_staleness_ms;
+    std::unique_ptr<Slot[]> slots;
+    // total samples ever pushed
+    std::atomic<uint64_t> count;
+
+    // nullopt if sample index has been (or is being) overwritten
+    std::optional<Sample> read(uint64_t index) const;
+
+    static Fields toFields(const ImageTelemetry& telemetry);
+    static ImageTelemetry fromFields(const Fields& fields);
+    static Fields interpolate(const Sample& before, const Sample& after, uint64_t timestamp_ms);
+};
+
+#endif  // INCLUDE_NETWORK_TELEMETRY_HISTORY_HPP_
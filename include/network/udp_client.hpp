@@ -1,6 +1,14 @@
 #ifndef INCLUDE_NETWORK_UDP_CLIENT_HPP_
 #define INCLUDE_NETWORK_UDP_CLIENT_HPP_
 
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
@@ -12,6 +20,16 @@
 
 namespace asio = boost::asio;
 
+// How a frame's transfer went, see UDPClient::recvFrame
+struct TransferStats {
+    uint32_t chunks = 0;         // chunks across all planes
+    uint32_t chunks_lost = 0;    // missing when the camera finished sending the first time
+    uint32_t chunks_nacked = 0;  // resend requests, a chunk NACKed twice counts twice
+    uint32_t duplicates = 0;     // chunks that arrived more than once
+    uint32_t nack_rounds = 0;
+    uint32_t recv_calls = 0;     // recvmmsg syscalls
+};
+
 class UDPClient {
  private:
         asio::ip::udp::socket socket_;
@@ -19,8 +37,29 @@ class UDPClient {
         int port;
         int current_timeout_ms_ = 2000;
 
+        // Set by negotiate() if the camera speaks transport v2
+        bool negotiated_ = false;
+        size_t chunk_size_ = CHUNK_SIZE;
+        std::optional<uint32_t> last_frame_id_;
+        TransferStats last_stats_;
+
+        // recvmmsg scratch, RECV_BATCH_SIZE datagrams of up to MAX_CHUNK_SIZE each
+        std::vector<std::uint8_t> batch_buf_;
+        std::vector<iovec> batch_iovecs_;
+        std::vector<mmsghdr> batch_msgs_;
+
  private:
         bool waitForData();
+        bool waitForData(int timeout_ms);
+
+        asio::ip::udp::endpoint serverEndpoint() const;
+        // Largest chunk that fits in one datagram on the way to the server
+        size_t pathChunkSize();
+        void sendNacks(uint32_t frame_id, uint32_t plane, const std::vector<uint32_t>& missing);
+
+        // Where to reassemble a plane of mem_size bytes, nullptr to reject it
+        using PlaneBufferFn = std::function<std::uint8_t*(uint32_t plane, uint32_t mem_size)>;
+        bool recvFrameInto(const PlaneBufferFn& plane_buffer);
 
  public:
         UDPClient(asio::io_context* io_context_, std::string ip, int port);
@@ -35,7 +74,33 @@ class UDPClient {
 
         Header recvHeader();
 
+        /**
+         * Offers transport v2 to the camera (see rpi_connection.hpp), with
+         * chunks as large as the path MTU allows. Falls back to the original
+         * protocol if the camera doesn't answer within timeout_ms.
+         *
+         * @returns true if v2 is in use
+         */
+        bool negotiate(int timeout_ms);
+        bool isNegotiated() const;
+        size_t chunkSize() const;
+
+        /**
+         * Receives all 3 planes of the next frame over transport v2, NACKing
+         * missing chunks until they arrive or the receive timeout runs out.
+         * Reuses whatever planes already has allocated.
+         */
+        bool recvFrame(std::vector<std::vector<std::uint8_t>>& planes);
+        // Same as above, straight into buffers that must be exactly the planes' sizes
+        bool recvFrame(const std::array<std::span<std::uint8_t>, NUM_PLANES>& planes);
+        // Loss and retransmits of the last recvFrame
+        TransferStats lastTransferStats() const;
+
         std::vector<std::uint8_t> recvBody(const int mem_size, const int total_chunks);
+        // Same as above, but reassembles into buf so its allocation can be reused
+        bool recvBody(std::vector<std::uint8_t>& buf, const int mem_size, const int total_chunks);
+        // Same as above, into a buffer that must be exactly mem_size bytes
+        bool recvBody(std::span<std::uint8_t> buf, const int mem_size, const int total_chunks);
         char recvPing();
 };
 
@@ -1,8 +1,11 @@
 #ifndef INCLUDE_NETWORK_UDP_SERVER_HPP_
 #define INCLUDE_NETWORK_UDP_SERVER_HPP_
 
+#include <cstdint>
 #include <iostream>
+#include <random>
 #include <string>
+#include <vector>
 
 #include <boost/asio.hpp>
 #include <opencv2/opencv.hpp>
@@ -11,21 +14,53 @@
 
 namespace asio = boost::asio;
 
+/*
+ Stands in for the camera on the Pi. Serves frames over the original protocol,
+ or transport v2 once a client says hello (see rpi_connection.hpp).
+ */
 class UDPServer {
  private:
         std::string ip;
         int port;
         asio::ip::udp::socket socket_;
 
+        // I420 image served for every picture, read from disk if never set
+        cv::Mat frame;
+
+        // Fraction of chunks "lost" the first time they are sent, to exercise
+        // retransmits. Retransmitted chunks are never dropped.
+        double drop_rate;
+        std::mt19937 rng;
+
+        bool negotiated = false;
+        size_t chunk_size = CHUNK_SIZE;
+        uint32_t frame_id = 0;
+        // Planes of the last frame sent, kept around to answer NACKs
+        std::vector<std::vector<std::uint8_t>> planes;
+
         cv::Mat createBGR();
 
         cv::Mat createYUV();
 
+        // Splits the I420 frame into Y, U, V planes padded out to the libcamera strides
+        void capturePlanes();
+
+        void sendLegacy(asio::ip::udp::endpoint & endpoint);
+        void sendFrameHeader(uint32_t plane, asio::ip::udp::endpoint & endpoint);
+        bool sendChunk(uint32_t plane, uint32_t chunk_idx, asio::ip::udp::endpoint & endpoint);
+        void handleHello(const std::uint8_t* data, asio::ip::udp::endpoint & endpoint);
+        void handleNack(const std::uint8_t* data, size_t len,
+                        asio::ip::udp::endpoint & endpoint);
+
  public:
-        UDPServer(asio::io_context* io_context_, std::string ip, int port);
+        UDPServer(asio::io_context* io_context_, std::string ip, int port,
+                  double drop_rate = 0.0);
 
         bool start();
 
+        // Serve this I420 image instead of the one on disk
+        void setFrame(cv::Mat yuv);
+
         void send(asio::ip::udp::endpoint & endpoint);
 
         void recv();
@@ -19,6 +19,10 @@ class ManualLandingTick : public Tick {
 
  private:
     Tick* next_tick;
+
+    // Saves the map the CV aggregator has been streaming into the mapper.
+    // Returns false if there isn't one, so the saved images need stitching instead.
+    bool saveStreamedMap();
 };
 
 #endif  // INCLUDE_TICKS_MANUAL_LANDING_HPP_
@@ -1,9 +1,17 @@
 #ifndef INCLUDE_UTILITIES_BASE64_HPP_
 #define INCLUDE_UTILITIES_BASE64_HPP_
 
+#include <cstddef>
 #include <string>
 
 std::string base64_encode(unsigned char const* , unsigned int len);
 std::string base64_decode(std::string const& s);
 
+// Length of the padded base64 encoding of len bytes
+std::size_t base64_encoded_size(std::size_t len);
+
+// Encodes len bytes into out, which must have room for base64_encoded_size(len)
+// characters. Not null terminated.
+void base64_encode_into(unsigned char const* in, std::size_t len, char* out);
+
 #endif  // INCLUDE_UTILITIES_BASE64_HPP_
@@ -6,4 +6,10 @@
 std::chrono::seconds getUnixTime_s();
 std::chrono::milliseconds getUnixTime_ms();
 
+// Where getUnixTime_s/ms get the time from instead of the system clock, so a
+// replayed flight (utilities/replay_clock.hpp) can run the OBC on the
+// recording's clock. nullptr goes back to the system clock.
+using UnixTimeSource = std::chrono::milliseconds (*)();
+void setUnixTimeSource(UnixTimeSource source);
+
 #endif  // INCLUDE_UTILITIES_COMMON_HPP_
@@ -4,6 +4,7 @@
 #include <matplot/matplot.h>
 
 #include <chrono>
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 
@@ -15,6 +16,70 @@
 // how much is reasonable to avoid running out of memory on the Jetson.
 const size_t MAX_CV_PIPELINES = 2;
 
+// Max number of full resolution frames the camera keeps in its frame pool.
+// A frame stays checked out from the time it is captured until its annotated
+// image has been encoded for the GCS, so this needs to cover the running
+// pipelines and the overflow queue. Beyond this, frames are heap allocated
+// as usual.
+const size_t FRAME_POOL_SIZE = 16;
+
+// Received frames the RPICamera lets wait on conversion while streaming before
+// it holds off on requesting more, and how many converted frames it holds on
+// to before dropping the oldest.
+const size_t RPI_STREAM_RAW_FRAMES = 3;
+const size_t RPI_STREAM_QUEUE_SIZE = 8;
+// How long the RPICamera waits on a streamed frame before giving up on it
+const int RPI_STREAM_TIMEOUT_MS = 2000;
+
+// Detections of the same airdrop type within this many meters of a cluster's
+// center are grouped into that cluster by the CVAggregator.
+const double CV_CLUSTER_RADIUS_M = 5.0;
+
+// Runs the CVAggregator keeps encoded for GET /targets/all (each holds a
+// compressed annotated image), and how many are sent per request unless the
+// GCS asks for a different limit. A GCS that falls further behind than the
+// history skips the oldest runs.
+const size_t CV_RUN_HISTORY_SIZE = 128;
+const size_t TARGETS_PAGE_SIZE = 16;
+// Raw runs (bounding boxes and coordinates) the CVAggregator keeps in its
+// results, on top of the running totals
+const size_t CV_RESULTS_MAX_RUNS = 256;
+
+// Open GET /events streams allowed at once (each ties up one of the GCS
+// server's worker threads), and how often an idle stream sends a keepalive.
+const size_t GCS_MAX_EVENT_STREAMS = 2;
+const int GCS_EVENTS_KEEPALIVE_MS = 15000;
+
+// How often the ConnectionMonitor refreshes the MAVLink and airdrop status
+// (in-memory lookups) and pings the camera, for GET /connections
+const int CONNECTION_PROBE_INTERVAL_MS = 500;
+const int CAMERA_PROBE_INTERVAL_MS = 2000;
+
+// Finished jobs (e.g. POST /camera/runpipeline) kept around for the GCS to poll
+const size_t GCS_JOB_HISTORY_SIZE = 32;
+
+// Max number of images waiting to be written to disk by an ImageSink before
+// new ones get dropped, and how many written images are flushed to disk at once.
+const size_t IMAGE_SINK_QUEUE_SIZE = 32;
+const size_t IMAGE_SINK_FSYNC_BATCH = 8;
+
+// how many frames can wait to be added to the map, and how often map tiles are saved
+const size_t MOSAIC_INGEST_QUEUE_SIZE = 16;
+const size_t MOSAIC_TILE_SAVE_INTERVAL = 10;
+// largest side of the single image the map is saved as at the end, the full
+// resolution map is in the tile pyramid
+const int MOSAIC_MAX_RENDER_DIM = 8000;
+
+// Telemetry samples the MavlinkClient keeps around to look up where the plane
+// was when a frame was captured, and how long the newest sample is still used
+// for frames newer than it. Position comes in at telem_poll_rate (1 Hz on the
+// Jetson) and attitude at ~10 Hz, so each gets about two minutes and a bit
+// more than one update's worth of staleness.
+const size_t POSITION_HISTORY_SIZE = 128;
+const uint64_t POSITION_HISTORY_MAX_STALENESS_MS = 1500;
+const size_t ATTITUDE_HISTORY_SIZE = 1024;
+const uint64_t ATTITUDE_HISTORY_MAX_STALENESS_MS = 500;
+
 // common ratios of pi
 const double TWO_PI = 2 * M_PI;
 const double HALF_PI = M_PI / 2;
@@ -48,10 +113,31 @@ const double UNGUIDED_DROP_DISTANCE_M = 50.0;
 // mavlink
 const uint16_t WIND_COV = 231;
 
+// How long a partial mission upload waits on each item request (or the final
+// ack) from the autopilot before sending the whole mission instead, and how
+// long to wait between attempts at uploading a mission
+const std::chrono::milliseconds MAV_PARTIAL_UPLOAD_STEP_TIMEOUT = std::chrono::milliseconds(1500);
+const std::chrono::milliseconds MAV_UPLOAD_RETRY_WAIT = std::chrono::milliseconds(500);
+// How long after one of our own mission uploads ends that the autopilot's
+// "mission changed" is taken to be about it
+const std::chrono::milliseconds MAV_OWN_MISSION_CHANGE_GRACE = std::chrono::milliseconds(1000);
+
 const int DEFAULT_GCS_PORT = 5010;
 
 const int NUM_AIRDROPS = 2;
 
+// Defaults for network.airdrop in the config (for AirdropClients made
+// without one), how long the airdrop receive thread waits on the socket
+// before checking for retransmits, and how many packets it reads at once
+const int AIRDROP_DEFAULT_REDUNDANCY = 2;
+const int AIRDROP_DEFAULT_RETRANSMIT_MS = 250;
+const int AIRDROP_DEFAULT_MAX_RETRANSMITS = 8;
+const int AIRDROP_RECV_POLL_MS = 500;
+const size_t AIRDROP_RECV_BATCH = 16;
+
+// Packets from the payloads that can wait for receive() before new ones are dropped
+const size_t AIRDROP_RECV_QUEUE_SIZE = 1024;
+
 const char MISSION_CONFIG_PATH[] = "./mission-config.json";
 const double TAKEOFF_ALTITUDE_M = 30.0;
 const double COVERAGE_ALTITUDE_M = 30.0;
@@ -81,4 +167,14 @@ const std::chrono::milliseconds REFUELING_TICK_WAIT = std::chrono::milliseconds(
 
 const double EARTH_RADIUS_METERS = 6378137.0;
 
+// how many mapping chunks are stitched at the same time
+const int MAPPING_STITCH_THREADS = 4;
+
+// How often the flight recorder's writer thread moves records into the file,
+// how much each recording thread can buffer in the meantime (a power of two),
+// and how much the file grows by at a time
+const std::chrono::milliseconds FLIGHT_RECORDER_FLUSH_INTERVAL = std::chrono::milliseconds(50);
+const size_t FLIGHT_RECORDER_THREAD_BUFFER_SIZE = 256 * 1024;
+const size_t FLIGHT_RECORDER_CHUNK_SIZE = 16 * 1024 * 1024;
+
 #endif  // INCLUDE_UTILITIES_CONSTANTS_HPP_
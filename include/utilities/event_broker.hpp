@@ -0,0 +1,74 @@
+#ifndef INCLUDE_UTILITIES_EVENT_BROKER_HPP_
+#define INCLUDE_UTILITIES_EVENT_BROKER_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// The newest payload published on a topic
+struct Event {
+    std::string topic;
+    std::string data;
+    uint64_t id;  // increases with every publish, on any topic
+};
+
+/*
+ Fans out state changes (tick, telemetry, new CV runs, ...) to the GCS's
+ event streams.
+
+ Only the newest payload of each topic is kept, so a subscriber that is slow
+ or only wakes up every so often gets one event per topic that changed rather
+ than every intermediate value, and publishing never blocks on subscribers.
+ Subscribers keep a cursor (the id of the last event they got) instead of
+ a queue of their own.
+
+ Thread safe.
+ */
+class EventBroker {
+ public:
+    EventBroker();
+
+    // Replaces the topic's payload and wakes up subscribers
+    void publish(const std::string& topic, std::string data);
+
+    /**
+     * Waits up to timeout for anything newer than cursor, then returns the
+     * newest payload of every topic that changed since, oldest first, and
+     * moves cursor past them. Empty on timeout or once the broker is closed.
+     *
+     * A cursor of 0 gets the current payload of every topic, and so does one
+     * past the newest event (e.g. kept by the GCS across an OBC restart).
+     */
+    std::vector<Event> waitForEvents(uint64_t* cursor, std::chrono::milliseconds timeout);
+
+    // Wakes every subscriber for good, e.g. when the server is shutting down
+    void close();
+    bool isClosed();
+
+    /**
+     * Counts a subscriber against max_subscribers. Returns false if there
+     * are already that many, otherwise call unsubscribe when done.
+     */
+    bool trySubscribe(std::size_t max_subscribers);
+    void unsubscribe();
+
+ private:
+    std::mutex mut;
+    std::condition_variable cv;
+
+    struct Topic {
+        std::string data;
+        uint64_t id;
+    };
+    std::map<std::string, Topic> topics;
+    uint64_t last_id;
+    bool closed;
+    std::size_t num_subscribers;
+};
+
+#endif  // INCLUDE_UTILITIES_EVENT_BROKER_HPP_
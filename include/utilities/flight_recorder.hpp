@@ -0,0 +1,208 @@
+#ifndef INCLUDE_UTILITIES_FLIGHT_RECORDER_HPP_
+#define INCLUDE_UTILITIES_FLIGHT_RECORDER_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ticks/ids.hpp"
+
+/*
+ On disk format of a flight log, little endian like everything we fly:
+
+    FlightLogHeader
+    FlightRecordHeader, payload
+    FlightRecordHeader, payload
+    ...
+
+ The file grows in zero filled chunks, so a log from a run that never closed
+ it cleanly just ends at the first record with type END.
+
+ Records from different threads are written in the order they were flushed,
+ which isn't quite the order they happened in. readFlightLog sorts them.
+ */
+
+const char FLIGHT_LOG_MAGIC[8] = {'O', 'B', 'C', 'F', 'L', 'O', 'G', '\0'};
+const uint32_t FLIGHT_LOG_VERSION = 1;
+
+struct FlightLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t start_time_us;  // unix time the recorder started
+};
+static_assert(sizeof(FlightLogHeader) == 24);
+
+enum class FlightRecordType : uint16_t {
+    END = 0,
+    TELEMETRY = 1,    // TelemetryRecord
+    TICK = 2,         // TickRecord
+    DETECTIONS = 3,   // DetectionsRecord, then count DetectionRecords
+    GCS_REQUEST = 4,  // GcsRequestRecord, then "METHOD /route"
+};
+
+struct FlightRecordHeader {
+    uint32_t size;     // bytes of payload after this header
+    uint16_t type;     // FlightRecordType
+    uint16_t thread;   // which thread recorded it, numbered as they first record
+    uint64_t time_us;  // unix time
+};
+static_assert(sizeof(FlightRecordHeader) == 16);
+
+struct TelemetryRecord {
+    double latitude_deg;
+    double longitude_deg;
+    double altitude_agl_m;
+    double altitude_msl_m;
+    double groundspeed_m_s;
+    double airspeed_m_s;
+    double heading_deg;
+    double yaw_deg;
+    double pitch_deg;
+    double roll_deg;
+    uint8_t armed;
+    uint8_t flight_mode;  // mavsdk::Telemetry::FlightMode
+    uint8_t reserved[6];
+};
+static_assert(sizeof(TelemetryRecord) == 88);
+
+// A tick that isn't there (before the first one is set)
+const uint8_t FLIGHT_RECORD_NO_TICK = 0xFF;
+
+struct TickRecord {
+    uint8_t from;  // TickID
+    uint8_t to;    // TickID
+    uint8_t reserved[6];
+};
+static_assert(sizeof(TickRecord) == 8);
+
+struct DetectionsRecord {
+    int32_t run_id;
+    uint32_t count;
+    uint64_t image_time_ms;  // ImageData::TIMESTAMP of the frame they came from
+};
+static_assert(sizeof(DetectionsRecord) == 16);
+
+struct DetectionRecord {
+    double latitude_deg;
+    double longitude_deg;
+    double altitude_m;
+    int32_t x1, y1, x2, y2;  // bounding box in the frame
+};
+static_assert(sizeof(DetectionRecord) == 40);
+
+struct GcsRequestRecord {
+    uint16_t status;
+    uint16_t request_size;  // length of the "METHOD /route" after this
+    uint32_t duration_us;
+};
+static_assert(sizeof(GcsRequestRecord) == 8);
+
+/*
+ Binary flight recorder. Telemetry, tick changes, CV detections and GCS
+ commands are appended to a memory mapped file as they happen.
+
+ The record* functions are meant for hot paths. They only copy the record
+ into a ring buffer owned by the calling thread, with no locks and no
+ syscalls, and return right away if no recorder is open. A writer thread
+ moves everything from those buffers into the file every
+ FLIGHT_RECORDER_FLUSH_INTERVAL. If a thread records faster than that, the
+ records that don't fit are dropped and counted.
+
+ Only one recorder can be open at a time.
+ */
+class FlightRecorder {
+ public:
+    // Starts recording to path, replacing whatever is there. nullptr if the file
+    // can't be made or another recorder is already open.
+    static std::unique_ptr<FlightRecorder> open(const std::string& path);
+
+    // Flushes everything and trims the file to what was written
+    ~FlightRecorder();
+
+    static bool isRecording() { return recording.load(std::memory_order_relaxed); }
+
+    static void recordTelemetry(const TelemetryRecord& telemetry);
+    static void recordTick(std::optional<TickID> from, std::optional<TickID> to);
+    static void recordDetections(int run_id, uint64_t image_time_ms,
+                                 const std::vector<DetectionRecord>& detections);
+    static void recordGcsRequest(const std::string& method, const char* route, int status,
+                                 std::chrono::microseconds duration);
+
+    // Records dropped because a thread's buffer was full, since the recorder opened
+    uint64_t dropped();
+
+    // Bytes written to the file so far, including the header
+    std::size_t size();
+
+ private:
+    static std::atomic_bool recording;
+
+    int fd;
+    uint8_t* map;
+    std::size_t map_size;
+    std::size_t written;  // only touched by the writer thread, or under writer_mut
+
+    std::mutex writer_mut;
+    std::condition_variable writer_cv;
+    bool stopping;
+    std::thread writer;
+
+    FlightRecorder(int fd, uint8_t* map, std::size_t map_size);
+
+    static void _record(FlightRecordType type, const void* payload, std::size_t size,
+                        const void* extra = nullptr, std::size_t extra_size = 0);
+
+    void _writerLoop();
+
+    // Moves everything buffered so far into the file. Must hold writer_mut.
+    void _flush();
+
+    // Makes room for at least size more bytes. Must hold writer_mut.
+    bool _reserve(std::size_t size);
+};
+
+// A record read back out of a flight log
+struct FlightRecord {
+    FlightRecordType type;
+    uint16_t thread;
+    uint64_t time_us;
+    std::string payload;
+
+    // The payload as T, if it's the right size for one. For the variable
+    // length records this is just the part before the variable length data.
+    template <typename T>
+    std::optional<T> as() const {
+        if (this->payload.size() < sizeof(T)) {
+            return {};
+        }
+        T value;
+        std::memcpy(&value, this->payload.data(), sizeof(T));
+        return value;
+    }
+
+    // The DetectionRecords after a DetectionsRecord
+    std::vector<DetectionRecord> detections() const;
+
+    // The "METHOD /route" after a GcsRequestRecord
+    std::string gcsRequest() const;
+};
+
+/**
+ * Reads every record in a flight log, oldest first. Stops at the end of the
+ * log, or at the first record that is cut off if the OBC died mid write.
+ *
+ * @returns nullopt if path isn't a flight log
+ */
+std::optional<std::vector<FlightRecord>> readFlightLog(const std::string& path);
+
+#endif  // INCLUDE_UTILITIES_FLIGHT_RECORDER_HPP_
@@ -6,12 +6,14 @@
 
 enum HTTPStatus {
     OK = 200,
+    ACCEPTED = 202,
 
     BAD_REQUEST = 400,
     NOT_FOUND = 404,
 
     INTERNAL_SERVER_ERROR = 500,
     NOT_IMPLEMENTED = 501,
+    SERVICE_UNAVAILABLE = 503,
 };
 
 #define _SET_HTTP_MAPPING(msg) case HTTPStatus::msg: return #msg
@@ -19,6 +21,7 @@ constexpr const char* HTTP_STATUS_TO_STRING(HTTPStatus status) {
     switch (status) {
         // 2xx
         _SET_HTTP_MAPPING(OK);
+        _SET_HTTP_MAPPING(ACCEPTED);
 
         // 4xx
         _SET_HTTP_MAPPING(BAD_REQUEST);
@@ -27,6 +30,7 @@ constexpr const char* HTTP_STATUS_TO_STRING(HTTPStatus status) {
         // 5xx
         _SET_HTTP_MAPPING(INTERNAL_SERVER_ERROR);
         _SET_HTTP_MAPPING(NOT_IMPLEMENTED);
+        _SET_HTTP_MAPPING(SERVICE_UNAVAILABLE);
 
         default: return std::to_string(status).c_str();  // just return the straight number code
     }
@@ -35,6 +39,9 @@ constexpr const char* HTTP_STATUS_TO_STRING(HTTPStatus status) {
 namespace mime {
     const char json[] = "application/json";
     const char plaintext[] = "text/plain";
+    const char png[] = "image/png";
+    const char protobuf[] = "application/x-protobuf";
+    const char event_stream[] = "text/event-stream";
 }
 
 #endif  // INCLUDE_UTILITIES_HTTP_HPP_
@@ -0,0 +1,80 @@
+#ifndef INCLUDE_UTILITIES_JOB_QUEUE_HPP_
+#define INCLUDE_UTILITIES_JOB_QUEUE_HPP_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+// What a finished job hands back, the same shape as an HTTP response
+struct JobResult {
+    int status;
+    std::string body;
+};
+
+struct Job {
+    enum class State { Queued, Running, Done };
+
+    uint64_t id;
+    std::string name;
+    State state;
+    std::optional<JobResult> result;  // set once Done
+    std::chrono::system_clock::time_point submitted;
+};
+
+/*
+ Runs slow work (e.g. capturing and running the CV pipeline on a batch of
+ pictures) on a background thread, so the GCS handler that asked for it can
+ answer with a job ID right away instead of tying up a server thread. The
+ GCS then polls the job by ID.
+
+ Jobs run one at a time in the order they were submitted. The last
+ history_size finished jobs are kept around to be polled.
+
+ Thread safe.
+ */
+class JobQueue {
+ public:
+    explicit JobQueue(std::size_t history_size);
+    ~JobQueue();
+
+    /**
+     * Queues fn under name and returns the job's ID. If a job with the same
+     * name is already queued or running, nothing is queued and that job's ID
+     * is returned instead, so resubmitting while waiting doesn't pile up work.
+     */
+    uint64_t submit(const std::string& name, std::function<JobResult()> fn);
+
+    std::optional<Job> get(uint64_t id);
+
+    // Every job still queued, running, or in the history, oldest first
+    std::vector<Job> all();
+
+    // Waits for the running job, then fails everything still queued with a 503
+    void stop();
+
+ private:
+    const std::size_t history_size;
+
+    std::mutex mut;
+    std::condition_variable cv;
+    std::deque<Job> jobs;  // oldest first, unfinished jobs are never dropped
+    std::deque<std::pair<uint64_t, std::function<JobResult()>>> pending;
+    uint64_t next_id;
+    bool stopping;
+
+    std::thread worker;
+
+    void _run();
+    Job* _find(uint64_t id);  // must hold mut
+};
+
+#endif  // INCLUDE_UTILITIES_JOB_QUEUE_HPP_
@@ -17,17 +17,53 @@
 
 struct LoggingConfig {
     std::string dir;
+    bool flight_recorder;  // binary flight log (utilities/flight_recorder.hpp) next to the logs
+};
+
+// How an image is encoded before it's sent to the GCS
+struct ImageEncodingConfig {
+    int quality;   // JPEG quality, 0-100
+    int max_dim;   // longest side is scaled down to this, 0 keeps the full resolution
+    bool denoise;  // smaller files, but slow on full resolution frames
+};
+
+// How hard the airdrop client tries to get a packet to the payloads
+struct AirdropLinkConfig {
+    int redundancy;       // copies of every packet sent back to back
+    int retransmit_ms;    // how long to wait for an ack before sending again
+    int max_retransmits;  // then give up on it
 };
 
 struct NetworkConfig {
     struct {
         int port;
+        struct {
+            // how often the /events stream samples telemetry and connection status
+            float telemetry_rate_hz;
+            float connections_rate_hz;
+        } events;
+        struct {
+            int threads;  // worker threads, each open /events stream ties one up
+            int keep_alive_max_count;
+            int keep_alive_timeout_s;
+            int read_timeout_s;
+            int write_timeout_s;
+            int payload_max_mb;
+            int slow_request_ms;  // requests that take longer are logged
+        } server;
+        struct {
+            ImageEncodingConfig capture;  // GET /camera/capture
+            ImageEncodingConfig targets;  // pictures in GET /targets/all
+        } images;
     } gcs;
     struct {
         std::string connect;
         bool log_params;
         float telem_poll_rate;
+        int upload_timeout_s;  // cancel and retry a mission upload that takes longer
+        bool partial_upload;   // send only the changed items of a mission, if the autopilot can
     } mavlink;
+    AirdropLinkConfig airdrop;
 };
 
 struct TakeoffConfig {
@@ -42,6 +78,28 @@ struct CVConfig {
     int input_height;
     std::string not_stolen_addr;
     uint16_t not_stolen_port;
+    struct {
+        // run YOLO on overlapping native resolution tiles instead of the downscaled frame
+        bool enabled;
+        // side length of each tile in pixels
+        int tile_size;
+        // fraction of each tile shared with its neighbor
+        float overlap;
+    } tiling;
+    struct {
+        // build the map in flight from frames handed over by the CV aggregator
+        bool enabled;
+        // frames are downscaled to this size (largest side) before being mapped
+        int max_dim;
+        // ground distance covered by one map pixel
+        double meters_per_px;
+        // where map tiles and the final map are saved
+        std::string output_dir;
+        // most zoomed out level of the map tiles served to the GCS
+        int min_zoom;
+        // memory the map can hold onto before parts of it are moved to disk
+        int memory_budget_mb;
+    } mapping;
 };
 
 namespace PointFetchMethod {
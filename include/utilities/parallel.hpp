@@ -0,0 +1,32 @@
+#ifndef INCLUDE_UTILITIES_PARALLEL_HPP_
+#define INCLUDE_UTILITIES_PARALLEL_HPP_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Runs fn(i) for every i in [0, count) on up to num_threads threads
+// (the calling thread included). fn must not throw.
+template <typename Fn>
+void parallelFor(std::size_t count, int num_threads, Fn fn) {
+    std::atomic<std::size_t> next{0};
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < count; i = next++) {
+            fn(i);
+        }
+    };
+
+    std::size_t num_workers = std::min(static_cast<std::size_t>(std::max(num_threads, 1)), count);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 1; t < num_workers; t++) {
+        threads.emplace_back(worker);
+    }
+    worker();
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+}
+
+#endif  // INCLUDE_UTILITIES_PARALLEL_HPP_
@@ -0,0 +1,48 @@
+#ifndef INCLUDE_UTILITIES_REPLAY_CLOCK_HPP_
+#define INCLUDE_UTILITIES_REPLAY_CLOCK_HPP_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/*
+ The clock a replayed flight (tests/integration/replay.cpp) runs on, in the
+ recorded flight's unix time. Once installed, getUnixTime_ms() reads it, so
+ the ticks, the telemetry history and camera timestamps all see the time the
+ recording was made at.
+
+ With a speed above 0 it follows the wall clock, that many times faster. With
+ speed 0 it only moves when advance() is called, which lets a replay skip the
+ waits between ticks and run as fast as the OBC can keep up, seeing the same
+ recording at the same ticks every time.
+
+ Only one clock can be installed at a time.
+ */
+class ReplayClock {
+ public:
+    // start_ms is the unix time in the recording to start at
+    ReplayClock(uint64_t start_ms, double speed);
+
+    // Uninstalls the clock if it is installed
+    ~ReplayClock();
+
+    // Makes getUnixTime_s/ms read this clock. False if another one already is.
+    bool install();
+    void uninstall();
+
+    uint64_t nowMs() const;
+    double speed() const;
+
+    void advance(std::chrono::milliseconds by);
+
+ private:
+    static std::atomic<ReplayClock*> installed;
+    static std::chrono::milliseconds installedNow();
+
+    const uint64_t start_ms;
+    const double speed_factor;
+    const std::chrono::steady_clock::time_point started;
+    std::atomic<uint64_t> advanced_ms;
+};
+
+#endif  // INCLUDE_UTILITIES_REPLAY_CLOCK_HPP_
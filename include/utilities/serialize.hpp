@@ -3,6 +3,7 @@
 
 #include <google/protobuf/util/json_util.h>
 
+#include <cstdint>
 #include <string>
 
 #include <nlohmann/json.hpp>
@@ -38,4 +39,20 @@ std::string messagesToJson(Iterator begin, Iterator end) {
     return json;
 }
 
+/*
+ * Appends an already serialized message to out, prefixed with its size as a
+ * varint. This is protobuf's standard "delimited" framing for a stream of
+ * messages (what parseDelimitedFrom / writeDelimitedTo read and write), used
+ * when a response is a list of messages in binary.
+ */
+inline void appendDelimited(std::string* out, const std::string& serialized) {
+    uint64_t size = serialized.size();
+    while (size >= 0x80) {
+        out->push_back(static_cast<char>((size & 0x7F) | 0x80));
+        size >>= 7;
+    }
+    out->push_back(static_cast<char>(size));
+    out->append(serialized);
+}
+
 #endif  // INCLUDE_UTILITIES_SERIALIZE_HPP_
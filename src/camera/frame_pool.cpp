@@ -0,0 +1,63 @@
+#include "camera/frame_pool.hpp"
+
+#include <atomic>
+
+#include <loguru.hpp>
+
+#include "utilities/locks.hpp"
+
+FramePool::FramePool(int rows, int cols, int type, std::size_t max_frames)
+    : rows(rows), cols(cols), type(type), max_frames(max_frames), num_overflows(0) {
+    this->frames.reserve(max_frames);
+}
+
+bool FramePool::isFree(const cv::Mat& frame) {
+    // The pool's copy is the only header left pointing at the buffer.
+    // Nobody else can gain a new reference without going through acquire(),
+    // so once this reads 1 it stays 1 until we hand it out again. The last
+    // release happens on another thread with an atomic decrement (CV_XADD),
+    // so this is an acquire load to see everything done with the buffer first.
+    return frame.u != nullptr &&
+           std::atomic_ref<int>(frame.u->refcount).load(std::memory_order_acquire) == 1;
+}
+
+cv::Mat FramePool::acquire() {
+    Lock lock(this->mut);
+
+    for (const cv::Mat& frame : this->frames) {
+        if (isFree(frame)) {
+            return frame;
+        }
+    }
+
+    if (this->frames.size() < this->max_frames) {
+        this->frames.emplace_back(this->rows, this->cols, this->type);
+        return this->frames.back();
+    }
+
+    this->num_overflows++;
+    LOG_F(WARNING, "Frame pool exhausted (%zu frames in use), allocating outside the pool",
+          this->frames.size());
+    return cv::Mat(this->rows, this->cols, this->type);
+}
+
+std::size_t FramePool::size() {
+    Lock lock(this->mut);
+    return this->frames.size();
+}
+
+std::size_t FramePool::available() {
+    Lock lock(this->mut);
+    std::size_t num_free = 0;
+    for (const cv::Mat& frame : this->frames) {
+        if (isFree(frame)) {
+            num_free++;
+        }
+    }
+    return num_free;
+}
+
+std::size_t FramePool::overflows() {
+    Lock lock(this->mut);
+    return this->num_overflows;
+}
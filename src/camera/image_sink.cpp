@@ -0,0 +1,198 @@
+#include "camera/image_sink.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+namespace {
+bool writeFile(const std::filesystem::path& path, const void* data, std::size_t size) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_F(ERROR, "Failed to open %s: %s", path.c_str(), std::strerror(errno));
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::write(fd, bytes, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            LOG_F(ERROR, "Failed to write %s: %s", path.c_str(), std::strerror(errno));
+            ::close(fd);
+            return false;
+        }
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+    }
+
+    ::close(fd);
+    return true;
+}
+}  // namespace
+
+ImageSink::ImageSink(std::size_t max_queue_size, std::size_t fsync_batch_size)
+    : max_queue_size(max_queue_size),
+      fsync_batch_size(fsync_batch_size),
+      stop(false),
+      busy(false),
+      num_written(0),
+      num_dropped(0) {
+    this->worker = std::thread(&ImageSink::writeLoop, this);
+}
+
+ImageSink::~ImageSink() {
+    {
+        Lock lock(this->mut);
+        this->stop = true;
+    }
+    this->queue_cv.notify_all();
+    if (this->worker.joinable()) {
+        this->worker.join();
+    }
+}
+
+bool ImageSink::write(const std::filesystem::path& image_path, cv::Mat image) {
+    return this->enqueue(Job{
+        .image_path = image_path,
+        .image = std::move(image),
+        .telemetry = {},
+        .telemetry_path = {},
+    });
+}
+
+bool ImageSink::save(const ImageData& image, const std::filesystem::path& directory) {
+    if (image.DATA.empty() || image.TIMESTAMP == 0) {
+        LOG_F(ERROR, "Tried to save empty image");
+        return false;
+    }
+
+    std::string name = std::to_string(image.TIMESTAMP);
+    return this->enqueue(Job{
+        .image_path = directory / (name + ".jpg"),
+        .image = image.DATA,
+        .telemetry = image.TELEMETRY,
+        .telemetry_path = directory / (name + ".json"),
+    });
+}
+
+bool ImageSink::enqueue(Job&& job) {
+    {
+        Lock lock(this->mut);
+        if (this->stop) {
+            LOG_F(WARNING, "Image sink is stopping, not saving %s", job.image_path.c_str());
+            return false;
+        }
+        if (this->queue.size() >= this->max_queue_size) {
+            std::size_t dropped = this->num_dropped.fetch_add(1) + 1;
+            LOG_F(WARNING, "Image sink queue full, dropping %s (%zu dropped so far)",
+                  job.image_path.c_str(), dropped);
+            return false;
+        }
+        this->queue.push_back(std::move(job));
+    }
+    this->queue_cv.notify_one();
+    return true;
+}
+
+void ImageSink::flush() {
+    Lock lock(this->mut);
+    this->idle_cv.wait(lock, [this]() { return this->queue.empty() && !this->busy; });
+}
+
+std::size_t ImageSink::numWritten() const { return this->num_written.load(); }
+
+std::size_t ImageSink::numDropped() const { return this->num_dropped.load(); }
+
+void ImageSink::writeLoop() {
+    loguru::set_thread_name("image sink");
+
+    std::size_t unsynced = 0;
+    std::filesystem::path last_directory;
+
+    while (true) {
+        Job job;
+        {
+            Lock lock(this->mut);
+            if (this->queue.empty() && unsynced > 0) {
+                // Queue ran dry, good time to push the partial batch to disk
+                lock.unlock();
+                this->syncDirectory(last_directory);
+                unsynced = 0;
+                continue;
+            }
+
+            if (this->queue.empty()) {
+                this->busy = false;
+                this->idle_cv.notify_all();
+            }
+
+            this->queue_cv.wait(lock, [this]() { return this->stop || !this->queue.empty(); });
+            if (this->queue.empty()) {
+                // stopped and everything has been written
+                return;
+            }
+
+            job = std::move(this->queue.front());
+            this->queue.pop_front();
+            this->busy = true;
+        }
+
+        if (this->writeJob(job)) {
+            this->num_written.fetch_add(1);
+            unsynced++;
+            last_directory = job.image_path.parent_path();
+        }
+
+        if (unsynced >= this->fsync_batch_size) {
+            this->syncDirectory(last_directory);
+            unsynced = 0;
+        }
+    }
+}
+
+bool ImageSink::writeJob(const Job& job) {
+    std::vector<uchar> encoded;
+    try {
+        if (!cv::imencode(job.image_path.extension().string(), job.image, encoded)) {
+            LOG_F(ERROR, "Failed to encode image for %s", job.image_path.c_str());
+            return false;
+        }
+    } catch (const cv::Exception& e) {
+        LOG_F(ERROR, "Failed to encode image for %s: %s", job.image_path.c_str(), e.what());
+        return false;
+    }
+
+    if (!writeFile(job.image_path, encoded.data(), encoded.size())) {
+        return false;
+    }
+    VLOG_F(DEBUG, "Saved image to %s", job.image_path.c_str());
+
+    if (job.telemetry.has_value()) {
+        std::string telemetry_json = imageTelemetryToJson(job.telemetry.value()).dump();
+        writeFile(job.telemetry_path, telemetry_json.data(), telemetry_json.size());
+    }
+
+    return true;
+}
+
+void ImageSink::syncDirectory(const std::filesystem::path& directory) {
+    int fd = ::open(directory.empty() ? "." : directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) {
+        LOG_F(WARNING, "Failed to open %s for syncing: %s", directory.c_str(),
+              std::strerror(errno));
+        return;
+    }
+    if (::syncfs(fd) != 0) {
+        LOG_F(WARNING, "syncfs failed for %s: %s", directory.c_str(), std::strerror(errno));
+    }
+    ::close(fd);
+}
@@ -1,6 +1,7 @@
 #include "camera/interface.hpp"
 
 #include <filesystem>
+#include <fstream>
 #include <optional>
 #include <ostream>
 
@@ -17,21 +18,26 @@ CameraInterface::CameraInterface(const CameraConfig& config) : config(config) {}
 std::string cvMatToBase64(cv::Mat image) {
     std::vector<uchar> buf;
     cv::imencode(".jpg", image, buf);
-    auto* enc_msg = reinterpret_cast<unsigned char*>(buf.data());
-    return base64_encode(enc_msg, buf.size());
+    std::string out(base64_encoded_size(buf.size()), '\0');
+    base64_encode_into(buf.data(), buf.size(), out.data());
+    return out;
 }
 
 void saveImageToFile(cv::Mat image, const std::filesystem::path& filepath) {
     cv::imwrite(filepath, image);
 }
 
-void saveImageTelemetryToFile(const ImageTelemetry& telemetry,
-                              const std::filesystem::path& filepath) {
-    json telemetry_json = {
+json imageTelemetryToJson(const ImageTelemetry& telemetry) {
+    return json{
         {"latitude_deg", telemetry.latitude_deg},     {"longitude_deg", telemetry.longitude_deg},
         {"altitude_agl_m", telemetry.altitude_agl_m}, {"airspeed_m_s", telemetry.airspeed_m_s},
         {"heading_deg", telemetry.heading_deg},       {"yaw_deg", telemetry.yaw_deg},
         {"pitch_deg", telemetry.pitch_deg},           {"roll_deg", telemetry.roll_deg}};
+}
+
+void saveImageTelemetryToFile(const ImageTelemetry& telemetry,
+                              const std::filesystem::path& filepath) {
+    json telemetry_json = imageTelemetryToJson(telemetry);
     std::ofstream telemetry_file(filepath);
     if (!telemetry_file.is_open()) {
         LOG_F(ERROR, "Failed to save telemetry json to %s", filepath.string().c_str());
@@ -40,6 +46,30 @@ void saveImageTelemetryToFile(const ImageTelemetry& telemetry,
     telemetry_file << to_string(telemetry_json);
 }
 
+std::optional<ImageTelemetry> loadImageTelemetryFromFile(const std::filesystem::path& filepath) {
+    std::ifstream telemetry_file(filepath);
+    if (!telemetry_file.is_open()) {
+        return {};
+    }
+
+    try {
+        json telemetry_json = json::parse(telemetry_file);
+        return ImageTelemetry{
+            .latitude_deg = telemetry_json.at("latitude_deg").get<double>(),
+            .longitude_deg = telemetry_json.at("longitude_deg").get<double>(),
+            .altitude_agl_m = telemetry_json.at("altitude_agl_m").get<double>(),
+            .airspeed_m_s = telemetry_json.at("airspeed_m_s").get<double>(),
+            .heading_deg = telemetry_json.at("heading_deg").get<double>(),
+            .yaw_deg = telemetry_json.at("yaw_deg").get<double>(),
+            .pitch_deg = telemetry_json.at("pitch_deg").get<double>(),
+            .roll_deg = telemetry_json.at("roll_deg").get<double>()};
+    } catch (const json::exception& e) {
+        LOG_F(ERROR, "Failed to parse telemetry json %s: %s", filepath.string().c_str(),
+              e.what());
+        return {};
+    }
+}
+
 std::optional<ImageTelemetry> queryMavlinkImageTelemetry(
     std::shared_ptr<MavlinkClient> mavlinkClient) {
     if (mavlinkClient == nullptr) {
@@ -64,6 +94,21 @@ std::optional<ImageTelemetry> queryMavlinkImageTelemetry(
                           .roll_deg = roll_deg};
 }
 
+std::optional<ImageTelemetry> queryMavlinkImageTelemetry(
+    std::shared_ptr<MavlinkClient> mavlinkClient, uint64_t timestamp_ms) {
+    if (mavlinkClient == nullptr) {
+        return {};
+    }
+
+    std::optional<ImageTelemetry> telemetry = mavlinkClient->telemetryAt(timestamp_ms);
+    if (!telemetry.has_value()) {
+        LOG_F(WARNING, "No telemetry history around %lu, using the latest telemetry",
+              timestamp_ms);
+        return queryMavlinkImageTelemetry(mavlinkClient);
+    }
+    return telemetry;
+}
+
 bool ImageData::saveToFile(std::string directory) const {
     if (this->DATA.empty() || this->TIMESTAMP == 0) {
         LOG_F(ERROR, "Tried to save empty image");
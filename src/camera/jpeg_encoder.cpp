@@ -0,0 +1,43 @@
+#include "camera/jpeg_encoder.hpp"
+
+#include <algorithm>
+
+#include "utilities/base64.hpp"
+#include "utilities/logging.hpp"
+
+JpegEncoder::JpegEncoder(const ImageEncodingConfig& config)
+    : config(config), params{cv::IMWRITE_JPEG_QUALITY, config.quality} {}
+
+std::optional<std::span<const uint8_t>> JpegEncoder::encode(const cv::Mat& image) {
+    const cv::Mat* source = &image;
+
+    const int longest = std::max(image.cols, image.rows);
+    if (this->config.max_dim > 0 && longest > this->config.max_dim) {
+        const double scale = static_cast<double>(this->config.max_dim) / longest;
+        // INTER_AREA averages the pixels it drops instead of aliasing
+        cv::resize(image, this->scaled, cv::Size(), scale, scale, cv::INTER_AREA);
+        source = &this->scaled;
+    }
+
+    // Only after scaling, denoising a full frame takes over a second
+    if (this->config.denoise) {
+        cv::fastNlMeansDenoisingColored(*source, this->denoised);
+        source = &this->denoised;
+    }
+
+    if (!cv::imencode(".jpg", *source, this->buffer, this->params)) {
+        LOG_F(WARNING, "Unable to encode a %dx%d image as JPEG", source->cols, source->rows);
+        return {};
+    }
+    return std::span<const uint8_t>(this->buffer.data(), this->buffer.size());
+}
+
+std::string JpegEncoder::encodeBase64(const cv::Mat& image) {
+    std::optional<std::span<const uint8_t>> jpeg = this->encode(image);
+    if (!jpeg.has_value()) {
+        return {};
+    }
+    std::string out(base64_encoded_size(jpeg->size()), '\0');
+    base64_encode_into(jpeg->data(), jpeg->size(), out.data());
+    return out;
+}
@@ -19,7 +19,7 @@
 
 
 MockCamera::MockCamera(CameraConfig config)
-    : CameraInterface(config), cli("localhost", config.mock.not_stolen_port) {}
+    : CameraInterface(config), cli("localhost", config.mock.not_stolen_port), connected(false) {}
 
 MockCamera::~MockCamera() {
     cli.stop();
@@ -29,9 +29,17 @@ MockCamera::~MockCamera() {
 void MockCamera::connect() { return; }
 
 bool MockCamera::isConnected() {
+    // Busy talking to the server, so don't get in the way of the capture
+    std::unique_lock<std::mutex> lock(this->cli_mut, std::try_to_lock);
+    if (!lock.owns_lock()) {
+        return this->connected;
+    }
+
     cli.set_read_timeout(2);
     httplib::Result res = cli.Get("/");
-    return res && (res->status == 200 || res->status == 404);
+    cli.set_read_timeout(this->config.mock.connection_timeout);
+    this->connected = res && (res->status == 200 || res->status == 404);
+    return this->connected;
 }
 
 void MockCamera::startTakingPictures(const std::chrono::milliseconds& interval,
@@ -55,7 +63,9 @@ void MockCamera::stopTakingPictures() {
     nlohmann::json json;
     json["session_id"] = this->session_id;
 
+    Lock lock(this->cli_mut);
     httplib::Result res = cli.Post("/stream/stop", json.dump(), "application/json");
+    lock.unlock();
 
     if (!res || res->status != 200) {
         LOG_F(WARNING, "Failed to stop streaming session");
@@ -83,7 +93,10 @@ std::deque<ImageData> MockCamera::getAllImages() {
 void MockCamera::captureEvery(const std::chrono::milliseconds& interval,
                               std::shared_ptr<MavlinkClient> mavlinkClient) {
     loguru::set_thread_name("mock camera");
-    cli.set_read_timeout(this->config.mock.connection_timeout);
+    {
+        Lock lock(this->cli_mut);
+        cli.set_read_timeout(this->config.mock.connection_timeout);
+    }
     while (this->isTakingPictures) {
         LOG_F(INFO, "Taking picture with mock camera. Using images from port %d",
               this->config.mock.not_stolen_port);
@@ -104,7 +117,11 @@ void MockCamera::captureEvery(const std::chrono::milliseconds& interval,
 
 std::optional<ImageData> MockCamera::takePicture(const std::chrono::milliseconds& timeout,
                                                  std::shared_ptr<MavlinkClient> mavlinkClient) {
-    std::optional<ImageTelemetry> telemetryOpt = queryMavlinkImageTelemetry(mavlinkClient);
+    // The mock server renders the frame at whatever pose we ask for, so the
+    // frame was "taken" right now, at the telemetry sent with the request
+    uint64_t timestamp = getUnixTime_ms().count();
+    std::optional<ImageTelemetry> telemetryOpt =
+        queryMavlinkImageTelemetry(mavlinkClient, timestamp);
 
     if (!telemetryOpt.has_value()) {
         LOG_F(ERROR, "Could not grab telemetry data from mavlink");
@@ -113,12 +130,14 @@ std::optional<ImageData> MockCamera::takePicture(const std::chrono::milliseconds
 
     ImageTelemetry telemetry = telemetryOpt.value();
 
+    Lock lock(this->cli_mut);
     httplib::Result res = cli.Get("/stream/frame?session_id=" + this->session_id +
                                   "&lat=" + std::to_string(telemetry.latitude_deg) +
                                   "&lon=" + std::to_string(telemetry.longitude_deg) +
                                   "&alt_ft=" + std::to_string(static_cast<int>((telemetry.altitude_agl_m * 3.281))) + //NOLINT
                                   "&heading=" + std::to_string(telemetry.heading_deg) +
                                   "&format=png");
+    lock.unlock();
 
     if (!res || res->status != 200) {
         LOG_F(ERROR, "Failed to query server for images");
@@ -135,7 +154,7 @@ std::optional<ImageData> MockCamera::takePicture(const std::chrono::milliseconds
 
     ImageData img_data(
         img,
-        0,
+        timestamp,
         telemetry);
 
     return img_data;
@@ -146,7 +165,9 @@ void MockCamera::startStreaming() {
     stream_body["runway"] = this->config.mock.runway;
     stream_body["num_targets"] = this->config.mock.num_targets;
 
+    Lock lock(this->cli_mut);
     httplib::Result res = cli.Post("/stream/start", stream_body.dump(), "application/json");
+    lock.unlock();
 
     if (!res || res->status != 200) {
         LOG_F(ERROR, "Failed to grab session id from not-stolen");
@@ -0,0 +1,126 @@
+#include "camera/replay.hpp"
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "utilities/common.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+ReplayCamera::ReplayCamera(const CameraConfig& config, const std::filesystem::path& image_dir)
+    : CameraInterface(config), next_frame(0), isTakingPictures(false) {
+    std::error_code err;
+    for (const auto& entry : std::filesystem::directory_iterator(image_dir, err)) {
+        const std::filesystem::path& path = entry.path();
+        if (path.extension() != ".jpg" && path.extension() != ".png") {
+            continue;
+        }
+        try {
+            std::size_t parsed = 0;
+            uint64_t timestamp = std::stoull(path.stem().string(), &parsed);
+            if (parsed == path.stem().string().size()) {
+                this->frames.push_back(Frame{timestamp, path});
+            }
+        } catch (const std::exception&) {
+            // not one of ours
+        }
+    }
+    if (err) {
+        LOG_F(ERROR, "Could not read replay images from %s: %s", image_dir.c_str(),
+              err.message().c_str());
+    }
+
+    std::sort(this->frames.begin(), this->frames.end(),
+              [](const Frame& a, const Frame& b) { return a.timestamp < b.timestamp; });
+    LOG_F(INFO, "Replaying %lu frames from %s", this->frames.size(), image_dir.c_str());
+}
+
+ReplayCamera::~ReplayCamera() { this->stopTakingPictures(); }
+
+void ReplayCamera::connect() {}
+
+bool ReplayCamera::isConnected() { return true; }
+
+void ReplayCamera::startTakingPictures(const std::chrono::milliseconds& interval,
+                                       std::shared_ptr<MavlinkClient> mavlinkClient) {
+    if (this->isTakingPictures.exchange(true)) {
+        return;
+    }
+    this->captureThread =
+        std::thread(&ReplayCamera::captureEvery, this, interval, std::move(mavlinkClient));
+}
+
+void ReplayCamera::stopTakingPictures() {
+    if (!this->isTakingPictures.exchange(false)) {
+        return;
+    }
+    this->captureThread.join();
+}
+
+std::optional<ImageData> ReplayCamera::getLatestImage() {
+    Lock lock(this->imageQueueLock);
+    if (this->imageQueue.empty()) {
+        return {};
+    }
+    ImageData latest = std::move(this->imageQueue.back());
+    this->imageQueue.pop_back();
+    return latest;
+}
+
+std::deque<ImageData> ReplayCamera::getAllImages() {
+    Lock lock(this->imageQueueLock);
+    return std::exchange(this->imageQueue, std::deque<ImageData>());
+}
+
+void ReplayCamera::startStreaming() {}
+
+std::optional<ImageData> ReplayCamera::takePicture(const std::chrono::milliseconds& timeout,
+                                                   std::shared_ptr<MavlinkClient> mavlinkClient) {
+    Frame frame;
+    {
+        Lock lock(this->frames_mut);
+        const uint64_t now_ms = getUnixTime_ms().count();
+        auto after = std::upper_bound(
+            this->frames.begin() + this->next_frame, this->frames.end(), now_ms,
+            [](uint64_t time_ms, const Frame& frame) { return time_ms < frame.timestamp; });
+        const std::size_t taken = std::distance(this->frames.begin(), after);
+        if (taken == this->next_frame) {
+            // Nothing new since the last picture
+            return {};
+        }
+        frame = this->frames[taken - 1];
+        this->next_frame = taken;
+    }
+
+    cv::Mat image = cv::imread(frame.path.string(), cv::IMREAD_COLOR);
+    if (image.empty()) {
+        LOG_F(ERROR, "Could not read replay image %s", frame.path.c_str());
+        return {};
+    }
+
+    std::optional<ImageTelemetry> telemetry =
+        queryMavlinkImageTelemetry(mavlinkClient, frame.timestamp);
+    if (!telemetry.has_value()) {
+        telemetry = loadImageTelemetryFromFile(
+            std::filesystem::path(frame.path).replace_extension(".json"));
+    }
+
+    return ImageData{std::move(image), frame.timestamp, telemetry};
+}
+
+std::size_t ReplayCamera::numFrames() const { return this->frames.size(); }
+
+void ReplayCamera::captureEvery(const std::chrono::milliseconds& interval,
+                                std::shared_ptr<MavlinkClient> mavlinkClient) {
+    loguru::set_thread_name("replay camera");
+
+    while (this->isTakingPictures) {
+        std::optional<ImageData> image = this->takePicture(interval, mavlinkClient);
+        if (image.has_value()) {
+            Lock lock(this->imageQueueLock);
+            this->imageQueue.push_back(std::move(image.value()));
+        }
+        std::this_thread::sleep_for(interval);
+    }
+}
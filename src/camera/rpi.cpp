@@ -1,7 +1,12 @@
+#include <algorithm>
+#include <array>
 #include <chrono>
+#include <memory>
 #include <thread>
 #include <optional>
+#include <span>
 #include <string>
+#include <utility>
 #include <vector>
 #include <deque>
 
@@ -11,39 +16,56 @@
 
 #include "camera/rpi.hpp"
 #include "network/rpi_connection.hpp"
+#include "utilities/common.hpp"
+#include "utilities/constants.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
 
 // Setup Logging
 // ...
 
 RPICamera::RPICamera(CameraConfig config, asio::io_context* io_context_)
-    : CameraInterface(config), client(io_context_, SERVER_IP, SERVER_PORT) {
+    : CameraInterface(config), client(io_context_, SERVER_IP, SERVER_PORT),
+      bgr_pool(IMG_HEIGHT, IMG_WIDTH, CV_8UC3, FRAME_POOL_SIZE),
+      yuv_pool(1, YUVImage::bufferSize(IMG_HEIGHT, STRIDE_Y, STRIDE_UV), CV_8UC1,
+               FRAME_POOL_SIZE),
+      taking_pictures(false),
+      num_dropped(0) {
     // this->connected = false;
     LOG_F(INFO, "RPICamera exists");
 }
 
 void RPICamera::connect() {
     if (this->connected) return;
+    Lock lock(this->socket_mut);
 
     // Keep trying to connect/bind logic
     // For UDP, "connect" just means opening the socket which is fast
     if (client.connect()) {
         this->connected = ping(std::chrono::milliseconds(50));
+        if (this->connected) {
+            client.negotiate(NEGOTIATE_TIMEOUT_MS);
+        }
         // Optionally send CameraRequest::START if needed,
         // but 'I' usually works standalone (i think)
         // client.send(static_cast<std::uint8_t>(CameraRequest::START));
     }
 }
 
-RPICamera::~RPICamera() {}
+RPICamera::~RPICamera() { this->stopTakingPictures(); }
 
 std::optional<ImageData> RPICamera::takePicture(
     const std::chrono::milliseconds& timeout, std::shared_ptr<MavlinkClient> mavlinkClient) {
-    std::optional<ImageTelemetry> telemetryOpt = queryMavlinkImageTelemetry(mavlinkClient);
-
-    if (!telemetryOpt.has_value()) {
-        LOG_F(WARNING, "Could not grab telemetry data from mavlink");
+    {
+        Lock lock(this->stream_mut);
+        if (this->taking_pictures) {
+            LOG_F(ERROR, "Can't take a single picture while taking pictures in the background");
+            return {};
+        }
     }
 
+    Lock socket_lock(this->socket_mut);
+
     // Set timeout dynamically
     client.setReceiveTimeout(timeout.count());
 
@@ -54,14 +76,20 @@ std::optional<ImageData> RPICamera::takePicture(
         LOG_F(ERROR, "Failed to send picture request");
         return {};
     }
+    // The Pi exposes as soon as it gets the request, so this is when the frame
+    // was taken. Transferring it over afterwards can take a while at full size.
+    uint64_t timestamp = getUnixTime_ms().count();
 
     // 2. Read 3 Planes
-    std::vector<std::vector<uint8_t>> planes = readImage();
+    cv::Mat buffer = yuv_pool.acquire();
+    bool received = readImage(buffer);
+
+    socket_lock.unlock();
 
     auto end_time = std::chrono::steady_clock::now();
     auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
 
-    if (planes.size() != 3) {
+    if (!received) {
         if (elapsed >= timeout - std::chrono::milliseconds(50)) {
             LOG_F(ERROR, "Camera request timed out after %ld ms", timeout.count());
         } else {
@@ -71,24 +99,43 @@ std::optional<ImageData> RPICamera::takePicture(
     }
 
     // 3. Convert to cv::Mat
-    std::optional<cv::Mat> mat = imgConvert(planes);
+    YUVImage yuv = planesOf(buffer);
+    cv::Mat mat = imgConvert(yuv);
 
-    if (!mat.has_value()) {
-        return {};
-    }
+    // Looked up after the fact so there is telemetry from both sides of the
+    // exposure to interpolate between
+    std::optional<ImageTelemetry> telemetryOpt =
+        queryMavlinkImageTelemetry(mavlinkClient, timestamp);
 
-    uint64_t timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
-        std::chrono::system_clock::now().time_since_epoch()).count();
+    if (!telemetryOpt.has_value()) {
+        LOG_F(WARNING, "Could not grab telemetry data from mavlink");
+    }
 
     return ImageData {
-        .DATA = mat.value(),
+        .DATA = std::move(mat),
         .TIMESTAMP = timestamp,
-        .TELEMETRY = telemetryOpt
+        .TELEMETRY = telemetryOpt,
+        .YUV = std::move(yuv)
     };
 }
 
-std::vector<std::vector<uint8_t>> RPICamera::readImage() {
-    std::vector<std::vector<uint8_t>> planes;
+bool RPICamera::readImage(const cv::Mat& buffer) {
+    const std::size_t y_size = static_cast<std::size_t>(STRIDE_Y) * IMG_HEIGHT;
+    const std::size_t uv_size = static_cast<std::size_t>(STRIDE_UV) * (IMG_HEIGHT / 2);
+    const std::array<std::span<uint8_t>, NUM_PLANES> planes = {
+        std::span<uint8_t>(buffer.data, y_size),
+        std::span<uint8_t>(buffer.data + y_size, uv_size),
+        std::span<uint8_t>(buffer.data + y_size + uv_size, uv_size),
+    };
+
+    if (client.isNegotiated()) {
+        bool received = client.recvFrame(planes);
+        TransferStats stats = client.lastTransferStats();
+        VLOG_F(DEBUG, "Frame transfer: %u chunks, %u lost, %u NACKed, %u duplicates, "
+               "%u recvmmsg calls", stats.chunks, stats.chunks_lost, stats.chunks_nacked,
+               stats.duplicates, stats.recv_calls);
+        return received;
+    }
 
     // We expect exactly 3 planes: Y, U, V
     for (int i = 0; i < 3; i++) {
@@ -96,77 +143,29 @@ std::vector<std::vector<uint8_t>> RPICamera::readImage() {
 
         if (header.magic != EXPECTED_MAGIC) {
             LOG_F(ERROR, "Invalid Magic on plane %d: %x", i, header.magic);
-            return {};
+            return false;
         }
 
-        std::vector<uint8_t> planeData = client.recvBody(header.mem_size, header.total_chunks);
-        if (planeData.empty()) {
+        if (!client.recvBody(planes[i], header.mem_size, header.total_chunks)) {
             LOG_F(ERROR, "Failed to receive body for plane %d", i);
-            return {};
+            return false;
         }
-
-        planes.push_back(std::move(planeData));
     }
 
-    return planes;
+    return true;
 }
 
-std::optional<cv::Mat> RPICamera::imgConvert(const std::vector<std::vector<uint8_t>>& planes) {
+YUVImage RPICamera::planesOf(const cv::Mat& buffer) {
     // We rely on constants from rpi_connection.hpp:
     // IMG_WIDTH, IMG_HEIGHT, STRIDE_Y, STRIDE_UV
+    return YUVImage::fromPlanes(buffer, IMG_WIDTH, IMG_HEIGHT, STRIDE_Y, STRIDE_UV);
+}
 
-    if (planes.size() != 3) return {};
-
-    const std::vector<uint8_t>& p0 = planes[0];  // Y
-    const std::vector<uint8_t>& p1 = planes[1];  // U
-    const std::vector<uint8_t>& p2 = planes[2];  // V
-
-    // Create wrappers around the raw data with specific stride (Step)
-    // Note: cv::Mat constructor with data pointer does not copy data, so careful with lifetime
-    // But we copy immediately below.
-    cv::Mat y_src(IMG_HEIGHT, IMG_WIDTH, CV_8UC1,
-                  reinterpret_cast<void*>(const_cast<uint8_t*>(p0.data())), STRIDE_Y);
-    cv::Mat u_src(IMG_HEIGHT/2, IMG_WIDTH/2, CV_8UC1,
-                  reinterpret_cast<void*>(const_cast<uint8_t*>(p1.data())), STRIDE_UV);
-    cv::Mat v_src(IMG_HEIGHT/2, IMG_WIDTH/2, CV_8UC1,
-                  reinterpret_cast<void*>(const_cast<uint8_t*>(p2.data())), STRIDE_UV);
-
-    // Allocate continuous buffer for standard I420
-    cv::Mat yuv_continuous(IMG_HEIGHT + IMG_HEIGHT/2, IMG_WIDTH, CV_8UC1);
-
-    // Copy Y (Removes padding)
-    y_src.copyTo(yuv_continuous(cv::Rect(0, 0, IMG_WIDTH, IMG_HEIGHT)));
-
-    // Copy U and V (Removes padding)
-    // We need to flatten them carefully into the buffer after Y
-    size_t y_size = IMG_WIDTH * IMG_HEIGHT;
-    size_t uv_size = (IMG_WIDTH / 2) * (IMG_HEIGHT / 2);
-
-    uint8_t* u_dst = yuv_continuous.data + y_size;
-    uint8_t* v_dst = u_dst + uv_size;
-
-    // Copy U
-    if (u_src.isContinuous()) {
-        memcpy(u_dst, u_src.data, uv_size);
-    } else {
-        for (int row = 0; row < u_src.rows; ++row) {
-             memcpy(u_dst + row * (IMG_WIDTH/2), u_src.ptr(row), IMG_WIDTH/2);
-        }
-    }
-
-    // Copy V
-    if (v_src.isContinuous()) {
-        memcpy(v_dst, v_src.data, uv_size);
-    } else {
-        for (int row = 0; row < v_src.rows; ++row) {
-             memcpy(v_dst + row * (IMG_WIDTH/2), v_src.ptr(row), IMG_WIDTH/2);
-        }
-    }
-
-    // Convert I420 to BGR
-    cv::Mat bgr_img;
-    cv::cvtColor(yuv_continuous, bgr_img, cv::COLOR_YUV2BGR_I420);
-
+cv::Mat RPICamera::imgConvert(const YUVImage& yuv) {
+    // Reads the strided planes in place, so there's no packing them into a
+    // contiguous I420 buffer first, and writes straight into the pooled buffer
+    cv::Mat bgr_img = bgr_pool.acquire();
+    yuvToBgr(yuv, bgr_img);
     return bgr_img;
 }
 
@@ -197,9 +196,160 @@ bool RPICamera::ping(const std::chrono::milliseconds& timeout) {
     return true;
 }
 
-// Unused methods stubbed out
-void RPICamera::startTakingPictures(const std::chrono::milliseconds& timeout,
-                                    std::shared_ptr<MavlinkClient> mavlinkClient) {}
-void RPICamera::stopTakingPictures() {}
-void RPICamera::startStreaming() {}
-bool RPICamera::isConnected() { return ping(std::chrono::milliseconds(50)); }
+void RPICamera::startTakingPictures(const std::chrono::milliseconds& interval,
+                                    std::shared_ptr<MavlinkClient> mavlinkClient) {
+    {
+        Lock lock(this->stream_mut);
+        if (this->taking_pictures) {
+            LOG_F(WARNING, "RPICamera is already taking pictures");
+            return;
+        }
+        this->taking_pictures = true;
+    }
+
+    this->connect();
+    client.setReceiveTimeout(RPI_STREAM_TIMEOUT_MS);
+
+    this->receive_thread = std::thread(&RPICamera::receiveLoop, this, interval);
+    this->convert_thread = std::thread(&RPICamera::convertLoop, this, mavlinkClient);
+}
+
+void RPICamera::stopTakingPictures() {
+    {
+        Lock lock(this->stream_mut);
+        this->taking_pictures = false;
+    }
+    this->stream_cv.notify_all();
+
+    if (this->receive_thread.joinable()) {
+        this->receive_thread.join();
+    }
+    if (this->convert_thread.joinable()) {
+        this->convert_thread.join();
+    }
+}
+
+std::optional<ImageData> RPICamera::getLatestImage() {
+    Lock lock(this->image_mut);
+    if (this->images.empty()) {
+        return {};
+    }
+    ImageData image = std::move(this->images.back());
+    this->images.pop_back();
+    return image;
+}
+
+std::deque<ImageData> RPICamera::getAllImages() {
+    Lock lock(this->image_mut);
+    std::deque<ImageData> images = std::move(this->images);
+    this->images.clear();
+    return images;
+}
+
+void RPICamera::receiveLoop(std::chrono::milliseconds interval) {
+    loguru::set_thread_name("rpi receive");
+
+    auto next_request = std::chrono::steady_clock::now();
+    while (true) {
+        {
+            Lock lock(this->stream_mut);
+            this->stream_cv.wait_until(lock, next_request,
+                                       [this]() { return !this->taking_pictures; });
+            // Only blocks if the convert thread has fallen behind
+            this->stream_cv.wait(lock, [this]() {
+                return !this->taking_pictures ||
+                       this->received_frames.size() < RPI_STREAM_RAW_FRAMES;
+            });
+            if (!this->taking_pictures) {
+                return;
+            }
+        }
+        RawFrame frame{.buffer = this->yuv_pool.acquire(), .timestamp = 0};
+
+        // If a frame took longer than the interval, request the next one right
+        // away instead of trying to catch up with a burst
+        next_request = std::max(next_request + interval, std::chrono::steady_clock::now());
+
+        bool received;
+        {
+            Lock socket_lock(this->socket_mut);
+            received = client.send(static_cast<std::uint8_t>(CameraRequest::PICTURE));
+            if (received) {
+                // see takePicture, the Pi exposes as soon as it gets the request
+                frame.timestamp = getUnixTime_ms().count();
+                received = readImage(frame.buffer);
+            }
+        }
+        // Frames coming through is as good as a ping
+        this->connected = received;
+        if (!received) {
+            LOG_F(WARNING, "Failed to receive streamed frame from the camera");
+            continue;
+        }
+
+        {
+            Lock lock(this->stream_mut);
+            this->received_frames.push_back(std::move(frame));
+        }
+        this->stream_cv.notify_all();
+    }
+}
+
+void RPICamera::convertLoop(std::shared_ptr<MavlinkClient> mavlinkClient) {
+    loguru::set_thread_name("rpi convert");
+
+    while (true) {
+        RawFrame frame;
+        {
+            Lock lock(this->stream_mut);
+            this->stream_cv.wait(lock, [this]() {
+                return !this->taking_pictures || !this->received_frames.empty();
+            });
+            if (this->received_frames.empty()) {
+                // stopped and everything received has been converted
+                return;
+            }
+            frame = std::move(this->received_frames.front());
+            this->received_frames.pop_front();
+        }
+        // Room for the receive thread to get another frame going
+        this->stream_cv.notify_all();
+
+        YUVImage yuv = planesOf(frame.buffer);
+        cv::Mat mat = imgConvert(yuv);
+        uint64_t timestamp = frame.timestamp;
+
+        std::optional<ImageTelemetry> telemetry =
+            queryMavlinkImageTelemetry(mavlinkClient, timestamp);
+        if (mavlinkClient != nullptr && !telemetry.has_value()) {
+            LOG_F(WARNING, "Could not grab telemetry data from mavlink");
+        }
+
+        Lock lock(this->image_mut);
+        if (this->images.size() >= RPI_STREAM_QUEUE_SIZE) {
+            this->images.pop_front();
+            this->num_dropped++;
+            LOG_F(WARNING, "Nobody is taking streamed frames, dropped the oldest (%zu dropped)",
+                  this->num_dropped);
+        }
+        this->images.push_back(ImageData{std::move(mat), timestamp, telemetry, std::move(yuv)});
+    }
+}
+
+void RPICamera::startStreaming() { this->connect(); }
+bool RPICamera::isConnected() {
+    {
+        // A ping would steal a streamed frame's packets off the socket
+        Lock lock(this->stream_mut);
+        if (this->taking_pictures) {
+            return this->connected;
+        }
+    }
+
+    std::unique_lock<std::mutex> socket_lock(this->socket_mut, std::try_to_lock);
+    if (!socket_lock.owns_lock()) {
+        return this->connected;
+    }
+    this->connected = ping(std::chrono::milliseconds(50));
+    return this->connected;
+}
@@ -0,0 +1,106 @@
+#include "camera/yuv.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#include <opencv2/core.hpp>
+#include <loguru.hpp>
+
+namespace {
+// BT.601 studio swing fixed point coefficients, the same ones OpenCV's
+// COLOR_YUV2BGR_I420 uses so both conversions give the same pixels
+const int BT601_CY = 1220542;
+const int BT601_CUB = 2116026;
+const int BT601_CUG = -409993;
+const int BT601_CVG = -852492;
+const int BT601_CVR = 1673527;
+const int BT601_SHIFT = 20;
+
+inline void writeBgr(uint8_t luma, int ruv, int guv, int buv, uint8_t* dst) {
+    int y = std::max(0, static_cast<int>(luma) - 16) * BT601_CY;
+    dst[0] = cv::saturate_cast<uint8_t>((y + buv) >> BT601_SHIFT);
+    dst[1] = cv::saturate_cast<uint8_t>((y + guv) >> BT601_SHIFT);
+    dst[2] = cv::saturate_cast<uint8_t>((y + ruv) >> BT601_SHIFT);
+}
+}  // namespace
+
+YUVImage YUVImage::fromPlanes(const cv::Mat& buffer, int width, int height, int stride_y,
+                              int stride_uv) {
+    std::size_t needed = bufferSize(height, stride_y, stride_uv);
+    if (!buffer.isContinuous() || buffer.total() * buffer.elemSize() < needed ||
+        stride_y < width || stride_uv < width / 2) {
+        LOG_F(ERROR, "Buffer can't hold a %dx%d I420 image with strides %d/%d", width, height,
+              stride_y, stride_uv);
+        return {};
+    }
+
+    uint8_t* y_plane = buffer.data;
+    uint8_t* u_plane = y_plane + static_cast<std::size_t>(stride_y) * height;
+    uint8_t* v_plane = u_plane + static_cast<std::size_t>(stride_uv) * (height / 2);
+
+    YUVImage image;
+    image.y = cv::Mat(height, width, CV_8UC1, y_plane, stride_y);
+    image.u = cv::Mat(height / 2, width / 2, CV_8UC1, u_plane, stride_uv);
+    image.v = cv::Mat(height / 2, width / 2, CV_8UC1, v_plane, stride_uv);
+    image.buffer = buffer;
+    return image;
+}
+
+std::size_t YUVImage::bufferSize(int height, int stride_y, int stride_uv) {
+    return static_cast<std::size_t>(stride_y) * height +
+           2 * static_cast<std::size_t>(stride_uv) * (height / 2);
+}
+
+cv::Size YUVImage::size() const { return this->y.size(); }
+
+bool YUVImage::empty() const { return this->y.empty(); }
+
+YUVImage YUVImage::crop(const cv::Rect& rect, cv::Point* origin) const {
+    cv::Rect bounded = rect & cv::Rect(cv::Point(0, 0), this->size());
+    // Chroma is subsampled by 2 in both directions, so only even edges line up
+    int left = bounded.x & ~1;
+    int top = bounded.y & ~1;
+    int right = (bounded.x + bounded.width) & ~1;
+    int bottom = (bounded.y + bounded.height) & ~1;
+
+    if (origin != nullptr) {
+        *origin = cv::Point(left, top);
+    }
+    if (right <= left || bottom <= top) {
+        return {};
+    }
+
+    cv::Rect luma(left, top, right - left, bottom - top);
+    cv::Rect chroma(left / 2, top / 2, luma.width / 2, luma.height / 2);
+    return YUVImage{this->y(luma), this->u(chroma), this->v(chroma), this->buffer};
+}
+
+void yuvToBgr(const YUVImage& image, cv::Mat& dst) {
+    const cv::Size size = image.size();
+    dst.create(size, CV_8UC3);
+
+    // Each chroma row covers two luma rows, so rows are handed out in pairs
+    cv::parallel_for_(cv::Range(0, size.height / 2), [&](const cv::Range& rows) {
+        for (int row = rows.start; row < rows.end; row++) {
+            const uint8_t* y0 = image.y.ptr<uint8_t>(2 * row);
+            const uint8_t* y1 = image.y.ptr<uint8_t>(2 * row + 1);
+            const uint8_t* u = image.u.ptr<uint8_t>(row);
+            const uint8_t* v = image.v.ptr<uint8_t>(row);
+            uint8_t* dst0 = dst.ptr<uint8_t>(2 * row);
+            uint8_t* dst1 = dst.ptr<uint8_t>(2 * row + 1);
+
+            for (int col = 0; col < size.width / 2; col++) {
+                int uu = static_cast<int>(u[col]) - 128;
+                int vv = static_cast<int>(v[col]) - 128;
+                int ruv = (1 << (BT601_SHIFT - 1)) + BT601_CVR * vv;
+                int guv = (1 << (BT601_SHIFT - 1)) + BT601_CVG * vv + BT601_CUG * uu;
+                int buv = (1 << (BT601_SHIFT - 1)) + BT601_CUB * uu;
+
+                writeBgr(y0[2 * col], ruv, guv, buv, dst0 + 6 * col);
+                writeBgr(y0[2 * col + 1], ruv, guv, buv, dst0 + 6 * col + 3);
+                writeBgr(y1[2 * col], ruv, guv, buv, dst1 + 6 * col);
+                writeBgr(y1[2 * col + 1], ruv, guv, buv, dst1 + 6 * col + 3);
+            }
+        }
+    });
+}
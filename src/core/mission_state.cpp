@@ -1,7 +1,9 @@
 #include "core/mission_state.hpp"
 
+#include <filesystem>
 #include <memory>
 #include <mutex>
+#include <optional>
 #include <nlohmann/json.hpp>
 
 #include "camera/interface.hpp"
@@ -12,11 +14,27 @@
 #include "network/airdrop_client.hpp"
 #include "network/mavlink.hpp"
 #include "ticks/tick.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/locks.hpp"
 #include "utilities/logging.hpp"
 #include "utilities/obc_config.hpp"
 
-MissionState::MissionState(OBCConfig config) : config(config) {}
+MissionState::MissionState(OBCConfig config)
+    : config(config),
+      image_sink(std::make_shared<ImageSink>(IMAGE_SINK_QUEUE_SIZE, IMAGE_SINK_FSYNC_BATCH)),
+      events(std::make_shared<EventBroker>()),
+      jobs(std::make_shared<JobQueue>(GCS_JOB_HISTORY_SIZE)) {
+    if (config.cv.mapping.enabled) {
+        MosaicParams params(config.cv);
+        std::filesystem::path output_dir = config.cv.mapping.output_dir;
+        auto pyramid = std::make_shared<TilePyramid>(output_dir / "pyramid",
+                                                     config.cv.mapping.min_zoom,
+                                                     MAPPING_STITCH_THREADS);
+        this->mapper = std::make_shared<MosaicIngest>(
+            params, config.cv.mapping.max_dim, true, MOSAIC_INGEST_QUEUE_SIZE,
+            output_dir / "tiles", pyramid);
+    }
+}
 
 // Need to explicitly define now that Tick is no longer an incomplete class
 // See:
@@ -57,11 +75,17 @@ void MissionState::_setTick(Tick* newTick) {
     std::string new_tick_name = (newTick) ? newTick->getName() : "Null";
 
     LOG_F(INFO, "%s -> %s", old_tick_name.c_str(), new_tick_name.c_str());
+    if (FlightRecorder::isRecording()) {
+        FlightRecorder::recordTick(
+            (this->tick) ? std::optional<TickID>(this->tick->getID()) : std::nullopt,
+            (newTick) ? std::optional<TickID>(newTick->getID()) : std::nullopt);
+    }
 
     this->tick.reset(newTick);
     if (newTick != nullptr) {
         this->tick->init();
     }
+    this->events->publish("tick", new_tick_name);
 }
 
 TickID MissionState::getTickID() {
@@ -135,6 +159,22 @@ std::shared_ptr<CameraInterface> MissionState::getCamera() { return this->camera
 
 void MissionState::setCamera(std::shared_ptr<CameraInterface> camera) { this->camera = camera; }
 
+std::shared_ptr<ImageSink> MissionState::getImageSink() { return this->image_sink; }
+
+std::shared_ptr<MosaicIngest> MissionState::getMapper() { return this->mapper; }
+
+std::shared_ptr<EventBroker> MissionState::getEvents() { return this->events; }
+
+std::shared_ptr<ConnectionMonitor> MissionState::getConnectionMonitor() {
+    return this->connection_monitor;
+}
+
+void MissionState::setConnectionMonitor(std::shared_ptr<ConnectionMonitor> monitor) {
+    this->connection_monitor = monitor;
+}
+
+std::shared_ptr<JobQueue> MissionState::getJobs() { return this->jobs; }
+
 bool MissionState::getMappingIsDone() { return this->mappingIsDone; }
 
 void MissionState::setMappingIsDone(bool isDone) { this->mappingIsDone = isDone; }
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cstdint>
 #include <future>
+#include <string>
 
 #include "camera/rpi.hpp"
 #include "camera/mock.hpp"
@@ -13,6 +14,8 @@
 #include "network/gcs.hpp"
 #include "network/mavlink.hpp"
 #include "network/airdrop_client.hpp"
+#include "utilities/common.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/logging.hpp"
 #include "utilities/obc_config.hpp"
 #include "network/rpi_connection.hpp"
@@ -21,9 +24,18 @@ extern "C" {
 }
 
 // TODO: allow specifying config filename
-OBC::OBC(OBCConfig config) {
+OBC::OBC(OBCConfig config) : OBC(config, nullptr, nullptr, true) {}
+
+OBC::OBC(OBCConfig config, std::shared_ptr<MavlinkClient> mav,
+         std::shared_ptr<CameraInterface> camera, bool connect_airdrop) {
     int gcs_port = config.network.gcs.port;
 
+    if (config.logging.flight_recorder) {
+        // Named like the text logs so they sort together
+        this->recorder = FlightRecorder::open(
+            config.logging.dir + "/" + std::to_string(getUnixTime_s().count()) + ".flight");
+    }
+
     this->state = std::make_shared<MissionState>(config);
     this->state->setTick(new MissionPrepTick(this->state));
     this->state->setLapsRemaining(config.pathing.laps);
@@ -32,11 +44,19 @@ OBC::OBC(OBCConfig config) {
     // Don't need to look at these futures at all because the connect functions
     // will set the global mission state themselves when connected, which everything
     // else can check.
-    this->connectMavThread = std::thread([this, config]
-        {this->connectMavlink(config.network.mavlink.connect);});
-    this->connectAirdropThread = std::thread([this]{this->connectAirdrop();});
+    if (mav) {
+        this->state->setMav(mav);
+    } else {
+        this->connectMavThread = std::thread([this, config]
+            {this->connectMavlink(config.network.mavlink.connect);});
+    }
+    if (connect_airdrop) {
+        this->connectAirdropThread = std::thread([this]{this->connectAirdrop();});
+    }
 
-    if (this->state->config.camera.type == "mock") {
+    if (camera) {
+        this->state->setCamera(camera);
+    } else if (this->state->config.camera.type == "mock") {
         this->state->setCamera(std::make_shared<MockCamera>(this->state->config.camera));
     } else if (this->state->config.camera.type == "PiCamera") {
         this->state->setCamera(
@@ -49,13 +69,38 @@ OBC::OBC(OBCConfig config) {
     }
 }
 
+OBC::~OBC() {
+    if (this->connectMavThread.joinable()) {
+        this->connectMavThread.join();
+    }
+    if (this->connectAirdropThread.joinable()) {
+        this->connectAirdropThread.join();
+    }
+}
+
 void OBC::run() {
+    this->run([](const TickReport& report) {
+        std::this_thread::sleep_for(report.wait);
+        return true;
+    });
+}
+
+void OBC::run(std::function<bool(const TickReport& report)> between_ticks) {
     while (true) {
-        auto wait = state->doTick();
-        std::this_thread::sleep_for(wait);
+        TickID ran = this->state->getTickID();
+        auto start = std::chrono::steady_clock::now();
+        auto wait = this->state->doTick();
+        auto took = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        if (!between_ticks(TickReport{ran, this->state->getTickID(), took, wait})) {
+            break;
+        }
     }
 }
 
+std::shared_ptr<MissionState> OBC::getState() { return this->state; }
+
 void OBC::connectMavlink(std::string mavlink_url) {
     loguru::set_thread_name("mav connect");
 
@@ -80,5 +125,6 @@ void OBC::connectAirdrop() {
             result.data.err);
     }
 
-    this->state->setAirdrop(std::make_shared<AirdropClient>(result.data.res));
+    this->state->setAirdrop(
+        std::make_shared<AirdropClient>(result.data.res, this->state->config.network.airdrop));
 }
@@ -1,13 +1,23 @@
 #include "cv/aggregator.hpp"
 
 #include <exception>
+#include <optional>
+#include <utility>
+#include <vector>
 
 #include "utilities/constants.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/lockptr.hpp"
 #include "utilities/locks.hpp"
 #include "utilities/logging.hpp"
 
-CVAggregator::CVAggregator(Pipeline&& p) : pipeline(std::move(p)) {
+CVAggregator::CVAggregator(Pipeline&& p, std::shared_ptr<MosaicIngest> mapper,
+                           ImageEncodingConfig picture_encoding)
+    : pipeline(std::move(p)),
+      mapper(std::move(mapper)),
+      picture_encoding(picture_encoding),
+      run_history(CV_RUN_HISTORY_SIZE),
+      clustering(CV_CLUSTER_RADIUS_M) {
     this->num_worker_threads.store(0);
     this->accepting_images.store(true);
     this->results = std::make_shared<CVResults>();
@@ -39,6 +49,8 @@ LockPtr<MatchedResults> CVAggregator::getMatchedResults() {
     return LockPtr<MatchedResults>(this->matched_results, &this->mut);
 }
 
+RunHistory& CVAggregator::getRunHistory() { return this->run_history; }
+
 LockPtr<std::map<int, IdentifiedTarget>> CVAggregator::getCVRecord() {
     return LockPtr<std::map<int, IdentifiedTarget>>(this->cv_record, &this->cv_record_mut);
 }
@@ -52,7 +64,17 @@ void CVAggregator::updateRecords(std::vector<IdentifiedTarget>& new_values) {
         }
     }
 }
-void CVAggregator::runPipeline(const ImageData& image) {
+
+std::size_t CVAggregator::pending() {
+    Lock lock(this->mut);
+    return this->num_worker_threads.load() + this->overflow_queue.size();
+}
+
+PipelineStageStats CVAggregator::getPipelineStageStats() const {
+    return this->pipeline.getStageStats();
+}
+
+void CVAggregator::runPipeline(ImageData&& image) {
     Lock lock(this->mut);
 
     if (!this->accepting_images.load()) {
@@ -65,7 +87,7 @@ void CVAggregator::runPipeline(const ImageData& image) {
         // If we have too many running workers, just queue the new image
         LOG_F(WARNING, "Too many CVAggregator workers (%d). Pushing to overflow queue...",
               active_workers);
-        this->overflow_queue.push(image);
+        this->overflow_queue.push(std::move(image));
         LOG_F(WARNING, "Overflow queue size is now %ld", this->overflow_queue.size());
         return;
     }
@@ -73,7 +95,8 @@ void CVAggregator::runPipeline(const ImageData& image) {
     static int thread_counter = 0;
     this->num_worker_threads.fetch_add(1);
     try {
-        this->worker_threads.emplace_back(&CVAggregator::worker, this, image, ++thread_counter);
+        this->worker_threads.emplace_back(&CVAggregator::worker, this, std::move(image),
+                                          ++thread_counter);
     } catch (const std::exception& err) {
         this->num_worker_threads.fetch_sub(1);
         LOG_F(ERROR, "Failed to spawn CVAggregator worker: %s", err.what());
@@ -105,20 +128,25 @@ void CVAggregator::terminate() {
     }
 }
 
-static std::atomic<int> global_run_id{0};
-
 void CVAggregator::worker(ImageData image, int thread_num) {
     loguru::set_thread_name(("cv worker " + std::to_string(thread_num)).c_str());
     LOG_F(INFO, "New CVAggregator worker #%d spawned.", thread_num);
 
+    // Reused for every image this worker picks up from the overflow queue
+    JpegEncoder encoder(this->picture_encoding);
+
     while (true) {
+        // 0) Hand the frame to the mapper first, it takes its own small copy before
+        // the pipeline draws on the frame
+        if (this->mapper) {
+            this->mapper->push(image);
+        }
+
         // 1) Run the pipeline
-        auto pipeline_results = this->pipeline.run(image);
+        auto pipeline_results = this->pipeline.run(std::move(image));
 
         // 2) Build ONE run for all detections in that pipeline output
         AggregatedRun run;
-        run.run_id = global_run_id.fetch_add(1);
-        run.annotatedImage = pipeline_results.imageData.DATA.clone();
         run.bboxes.reserve(pipeline_results.targets.size());
         run.coords.reserve(pipeline_results.targets.size());
 
@@ -127,12 +155,45 @@ void CVAggregator::worker(ImageData image, int thread_num) {
             run.coords.push_back(det.coord);
         }
 
+        // 3) Encode it the way the GCS gets it now, rather than on the request
+        // thread, and give the frame back
+        IdentifiedTarget target =
+            toIdentifiedTarget(run, pipeline_results.imageData.DATA, &encoder);
+        pipeline_results.imageData.DATA.release();
+        run.run_id = this->run_history.add(target);
+        target.set_run_id(run.run_id);
+
+        if (FlightRecorder::isRecording()) {
+            std::vector<DetectionRecord> detections;
+            detections.reserve(pipeline_results.targets.size());
+            for (const auto& det : pipeline_results.targets) {
+                detections.push_back(DetectionRecord{
+                    det.coord.latitude(), det.coord.longitude(), det.coord.altitude(),
+                    det.bbox.x1, det.bbox.y1, det.bbox.x2, det.bbox.y2});
+            }
+            FlightRecorder::recordDetections(run.run_id, pipeline_results.imageData.TIMESTAMP,
+                                             detections);
+        }
+
+        {
+            // The record is for matching, it doesn't need the picture
+            target.clear_picture();
+            LockPtr<std::map<int, IdentifiedTarget>> records = this->getCVRecord();
+            records.data->insert_or_assign(run.run_id, std::move(target));
+        }
+
         {
             Lock lock(this->mut);
+            this->results->total_runs++;
+            this->results->total_detections += run.bboxes.size();
             this->results->runs.push_back(std::move(run));
+            if (this->results->runs.size() > CV_RESULTS_MAX_RUNS) {
+                this->results->runs.pop_front();
+            }
+            this->updateClusters(pipeline_results.targets);
         }
 
-        // 3) If no more queued images, break
+        // 4) If no more queued images, break
         {
             Lock lock(this->mut);
             if (this->overflow_queue.empty()) {
@@ -143,7 +204,7 @@ void CVAggregator::worker(ImageData image, int thread_num) {
         }
     }
 
-    // 4) Mark ourselves as finished
+    // 5) Mark ourselves as finished
     {
         const int active_workers = this->num_worker_threads.fetch_sub(1);
         LOG_F(INFO, "CVAggregator worker #%d terminating. Active threads: %d -> %d", thread_num,
@@ -151,12 +212,53 @@ void CVAggregator::worker(ImageData image, int thread_num) {
     }
 }
 
-// Empty list (for endpoint)
-std::vector<AggregatedRun> CVAggregator::popAllRuns() {
+IdentifiedTarget CVAggregator::toIdentifiedTarget(const AggregatedRun& run,
+                                                  const cv::Mat& annotatedImage,
+                                                  JpegEncoder* encoder) {
+    IdentifiedTarget target;
+    target.set_picture(encoder->encodeBase64(annotatedImage));
+
+    // Add all coordinates and bounding boxes from this run
+    for (size_t i = 0; i < run.bboxes.size(); ++i) {
+        GPSCoord* proto_coord = target.add_coordinates();
+        proto_coord->set_latitude(run.coords[i].latitude());
+        proto_coord->set_longitude(run.coords[i].longitude());
+        proto_coord->set_altitude(run.coords[i].altitude());
+
+        BboxProto* proto_bbox = target.add_bboxes();
+        proto_bbox->set_x1(run.bboxes[i].x1);
+        proto_bbox->set_y1(run.bboxes[i].y1);
+        proto_bbox->set_x2(run.bboxes[i].x2);
+        proto_bbox->set_y2(run.bboxes[i].y2);
+    }
+    return target;
+}
+
+void CVAggregator::updateClusters(const std::vector<DetectedTarget>& targets) {
+    for (const DetectedTarget& target : targets) {
+        // Targets from images without telemetry are never localized and stay at 0, 0
+        if (target.coord.latitude() == 0.0 && target.coord.longitude() == 0.0) {
+            continue;
+        }
+
+        // match_distance is the inverse of the detection confidence
+        double confidence = target.match_distance > 0 ? 1.0 / target.match_distance : 0.0;
+        this->clustering.addDetection(target.likely_airdrop, target.coord, confidence);
+
+        auto matched = this->matched_results->matched_airdrop.find(target.likely_airdrop);
+        if (matched == this->matched_results->matched_airdrop.end()) {
+            continue;
+        }
+
+        std::optional<GPSCoord> best = this->clustering.bestEstimate(target.likely_airdrop);
+        if (best.has_value()) {
+            matched->second.mutable_coordinate()->set_latitude(best->latitude());
+            matched->second.mutable_coordinate()->set_longitude(best->longitude());
+        }
+    }
+}
+
+std::vector<TargetCluster> CVAggregator::getClusters(AirdropType type) {
     Lock lock(this->mut);
-    // Move out everything
-    std::vector<AggregatedRun> out = std::move(this->results->runs);
-    // Now results->runs is empty
-    this->results->runs.clear();
-    return out;
+    return this->clustering.getClusters(type);
 }
@@ -1,8 +1,10 @@
 #include <vector>
 #include <algorithm>
+#include <cmath>
 #include "protos/obc.pb.h"
 #include "cv/localization.hpp"
 #include "cv/clustering.hpp"
+#include "utilities/constants.hpp"
 
 /*
  Takes in a list of list of points, where each list is a set of points in one cluster
@@ -24,14 +26,16 @@ std::vector<GPSCoord> Clustering::FindClustersCenter(
                 lats.push_back(cord.latitude());
                 longs.push_back(cord.longitude());
             }
-            std::sort(lats.begin(), lats.end());
-            std::sort(longs.begin(), longs.end());
+            // Only the middle element is needed, no need to fully sort
+            std::nth_element(lats.begin(), lats.begin() + lats.size()/2, lats.end());
+            std::nth_element(longs.begin(), longs.begin() + longs.size()/2, longs.end());
             avg.set_latitude(lats[lats.size()/2]);
             avg.set_longitude(longs[longs.size()/2]);
             centers.push_back(std::move(avg));
         }
         return std::move(centers);
     }
+
 // mean approach
 // std::vector<GPSCoord> Clustering::FindClustersCenter
 // (const std::vector<std::vector<GPSCoord>>& points){
@@ -51,3 +55,126 @@ std::vector<GPSCoord> Clustering::FindClustersCenter(
 //     }
 //     return std::move(centers);
 // }
+
+OnlineClustering::OnlineClustering(double cluster_radius_m)
+    : cluster_radius_m(cluster_radius_m), has_origin(false),
+      origin_lat_deg(0), origin_lon_deg(0), meters_per_deg_lon(0) {}
+
+int64_t OnlineClustering::cellKey(int64_t cell_x, int64_t cell_y) const {
+    return (cell_x << 32) | (cell_y & 0xFFFFFFFF);
+}
+
+int64_t OnlineClustering::cellOf(double x_m, double y_m) const {
+    return cellKey(static_cast<int64_t>(std::floor(x_m / this->cluster_radius_m)),
+                   static_cast<int64_t>(std::floor(y_m / this->cluster_radius_m)));
+}
+
+GPSCoord OnlineClustering::toGPS(double x_m, double y_m) const {
+    GPSCoord coord;
+    coord.set_latitude(this->origin_lat_deg + y_m / (EARTH_RADIUS_METERS * M_PI / 180));
+    coord.set_longitude(this->origin_lon_deg + x_m / this->meters_per_deg_lon);
+    coord.set_altitude(0);
+    return coord;
+}
+
+int OnlineClustering::addDetection(AirdropType type, const GPSCoord& coord,
+                                   double confidence) {
+    if (!this->has_origin) {
+        this->has_origin = true;
+        this->origin_lat_deg = coord.latitude();
+        this->origin_lon_deg = coord.longitude();
+        this->meters_per_deg_lon =
+            EARTH_RADIUS_METERS * M_PI / 180 * std::cos(coord.latitude() * M_PI / 180);
+    }
+
+    // Equirectangular projection is plenty accurate over a single search area
+    double x_m = (coord.longitude() - this->origin_lon_deg) * this->meters_per_deg_lon;
+    double y_m = (coord.latitude() - this->origin_lat_deg) * EARTH_RADIUS_METERS * M_PI / 180;
+    double w = std::max(confidence, 1e-6);
+
+    TypeIndex& index = this->by_type[static_cast<int>(type)];
+
+    // Cells are cluster_radius_m wide, so any center within the radius is in
+    // one of the 9 cells around this point
+    int64_t cell_x = static_cast<int64_t>(std::floor(x_m / this->cluster_radius_m));
+    int64_t cell_y = static_cast<int64_t>(std::floor(y_m / this->cluster_radius_m));
+    int nearest = -1;
+    double nearest_dist_sq = this->cluster_radius_m * this->cluster_radius_m;
+    for (int64_t dx = -1; dx <= 1; dx++) {
+        for (int64_t dy = -1; dy <= 1; dy++) {
+            auto cell = index.grid.find(cellKey(cell_x + dx, cell_y + dy));
+            if (cell == index.grid.end()) {
+                continue;
+            }
+            for (int id : cell->second) {
+                const Cluster& c = index.clusters[id];
+                double dist_sq = (c.x_m - x_m) * (c.x_m - x_m) + (c.y_m - y_m) * (c.y_m - y_m);
+                if (dist_sq <= nearest_dist_sq) {
+                    nearest = id;
+                    nearest_dist_sq = dist_sq;
+                }
+            }
+        }
+    }
+
+    if (nearest < 0) {
+        nearest = static_cast<int>(index.clusters.size());
+        int64_t cell = cellKey(cell_x, cell_y);
+        index.clusters.push_back(Cluster{x_m, y_m, w, w * x_m, w * y_m, 1, cell});
+        index.grid[cell].push_back(nearest);
+    } else {
+        Cluster& c = index.clusters[nearest];
+        c.sum_w += w;
+        c.sum_wx += w * x_m;
+        c.sum_wy += w * y_m;
+        c.count++;
+        c.x_m = c.sum_wx / c.sum_w;
+        c.y_m = c.sum_wy / c.sum_w;
+
+        // Re-index if the center drifted into a different cell
+        int64_t new_cell = cellOf(c.x_m, c.y_m);
+        if (new_cell != c.cell) {
+            std::vector<int>& old_ids = index.grid[c.cell];
+            old_ids.erase(std::find(old_ids.begin(), old_ids.end(), nearest));
+            if (old_ids.empty()) {
+                index.grid.erase(c.cell);
+            }
+            index.grid[new_cell].push_back(nearest);
+            c.cell = new_cell;
+        }
+    }
+
+    // Weights only ever go up, so the best cluster can be tracked incrementally
+    if (index.best < 0 || index.clusters[nearest].sum_w > index.clusters[index.best].sum_w) {
+        index.best = nearest;
+    }
+
+    return nearest;
+}
+
+std::optional<GPSCoord> OnlineClustering::bestEstimate(AirdropType type) const {
+    auto index = this->by_type.find(static_cast<int>(type));
+    if (index == this->by_type.end() || index->second.best < 0) {
+        return {};
+    }
+    const Cluster& best = index->second.clusters[index->second.best];
+    return toGPS(best.x_m, best.y_m);
+}
+
+std::vector<TargetCluster> OnlineClustering::getClusters(AirdropType type) const {
+    std::vector<TargetCluster> out;
+    auto index = this->by_type.find(static_cast<int>(type));
+    if (index == this->by_type.end()) {
+        return out;
+    }
+    out.reserve(index->second.clusters.size());
+    for (const Cluster& c : index->second.clusters) {
+        out.push_back(TargetCluster{toGPS(c.x_m, c.y_m), c.sum_w, c.count});
+    }
+    return out;
+}
+
+void OnlineClustering::reset() {
+    this->by_type.clear();
+    this->has_origin = false;
+}
@@ -1,8 +1,20 @@
 #include "cv/localization.hpp"
 #include <cmath>
+#include <stdexcept>
+
+#include <opencv2/core/matx.hpp>
 
 #define PI 3.14159265
 
+namespace {
+void checkOutputSizes(std::span<const Bbox> bboxes, std::span<double> latitudes,
+                      std::span<double> longitudes) {
+    if (latitudes.size() < bboxes.size() || longitudes.size() < bboxes.size()) {
+        throw std::invalid_argument("Localization output is smaller than the number of bboxes.");
+    }
+}
+}  // namespace
+
 // struct ECEFCoordinates;
 // struct CameraVector;
 // struct ENUCoordinates;
@@ -89,110 +101,166 @@ ECEFLocalization::ENUCoordinates ECEFLocalization::AngleToENU(
 }
 
 GPSCoord ECEFLocalization::localize(const ImageTelemetry& telemetry, const Bbox& targetBbox) {
-    double terrainHeight = 0;
+    double lat;
+    double lon;
+    double alt;
+    localizeAll(telemetry, std::span<const Bbox>(&targetBbox, 1), std::span<double>(&lat, 1),
+                std::span<double>(&lon, 1), std::span<double>(&alt, 1));
 
-    double targetX = (targetBbox.x1 + targetBbox.x2)/2;
-    double targetY = (targetBbox.y1 + targetBbox.y2)/2;
+    GPSCoord targetCoord;
+    targetCoord.set_latitude(lat);
+    targetCoord.set_longitude(lon);
+    targetCoord.set_altitude(alt);
+    return targetCoord;
+}
 
+void ECEFLocalization::localize(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                                std::span<double> latitudes, std::span<double> longitudes) {
+    localizeAll(telemetry, bboxes, latitudes, longitudes, {});
+}
 
-    CameraVector gimbalState;
-    gimbalState.roll = telemetry.roll_deg*PI/180;
-    gimbalState.pitch = telemetry.pitch_deg*PI/180;
-    gimbalState.heading = telemetry.yaw_deg*PI/180;
+void ECEFLocalization::localizeAll(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                                   std::span<double> latitudes, std::span<double> longitudes,
+                                   std::span<double> altitudes) {
+    checkOutputSizes(bboxes, latitudes, longitudes);
+    if (!altitudes.empty() && altitudes.size() < bboxes.size()) {
+        throw std::invalid_argument("Localization output is smaller than the number of bboxes.");
+    }
+
+    double terrainHeight = 0;
 
     GPSCoord aircraft;
     aircraft.set_latitude(telemetry.latitude_deg*PI/180);
     aircraft.set_longitude(telemetry.longitude_deg*PI/180);
     aircraft.set_altitude(telemetry.altitude_agl_m*1000);
-
-    CameraVector targetVector = PixelsToAngle(camera, gimbalState, targetX, targetY);
-    ENUCoordinates offset = AngleToENU(targetVector, aircraft, terrainHeight);
-    ECEFCoordinates targetLocationECEF = ENUtoECEF(offset, aircraft);
-    GPSCoord targetLocationGPS = ECEFtoGPS(targetLocationECEF);
-
-    double lat = targetLocationGPS.latitude()*180/PI;
-    double lon = targetLocationGPS.longitude()*180/PI;
-    double alt = targetLocationGPS.altitude()/1000;
-
-    GPSCoord targetCoord;
-    targetCoord.set_latitude(lat);
-    targetCoord.set_longitude(lon);
-    targetCoord.set_altitude(alt);
-    return targetCoord;
+    const double altitude = aircraft.altitude();
+
+    double heading = telemetry.yaw_deg*PI/180;
+    const double sin_heading = sin(heading);
+    const double cos_heading = cos(heading);
+
+    // ENU -> ECEF for this aircraft position, the same terms ENUtoECEF works out per call
+    const ECEFCoordinates origin = GPStoECEF(aircraft);
+    const double sin_lat = sin(aircraft.latitude());
+    const double cos_lat = cos(aircraft.latitude());
+    const double sin_lon = sin(aircraft.longitude());
+    const double cos_lon = cos(aircraft.longitude());
+    const cv::Matx33d enu_to_ecef(-sin_lon, -sin_lat*cos_lon, cos_lat*cos_lon,
+                                  cos_lon,  -sin_lat*sin_lon, cos_lat*sin_lon,
+                                  0,        cos_lon,          sin_lat);
+
+    for (std::size_t i = 0; i < bboxes.size(); i++) {
+        double targetX = (bboxes[i].x1 + bboxes[i].x2)/2;
+        double targetY = (bboxes[i].y1 + bboxes[i].y2)/2;
+
+        // Same as PixelsToAngle + AngleToENU
+        double roll = atan(camera.pixelSize*(targetX - (camera.resolutionX/2))/camera.focalLength);
+        double pitch = atan(camera.pixelSize*(targetY - (camera.resolutionY/2))/camera.focalLength);
+        double x = altitude*tan(roll);
+        double y = altitude*tan(pitch);
+        cv::Vec3d offset(x*cos_heading + y*sin_heading,
+                         -x*sin_heading + y*cos_heading,
+                         terrainHeight - altitude);
+
+        cv::Vec3d ecef = cv::Vec3d(origin.x, origin.y, origin.z) + enu_to_ecef * offset;
+        GPSCoord targetLocationGPS = ECEFtoGPS({ecef[0], ecef[1], ecef[2]});
+
+        latitudes[i] = targetLocationGPS.latitude()*180/PI;
+        longitudes[i] = targetLocationGPS.longitude()*180/PI;
+        if (!altitudes.empty()) {
+            altitudes[i] = targetLocationGPS.altitude()/1000;
+        }
+    }
 }
 
 
 GPSCoord GSDLocalization::localize(const ImageTelemetry& telemetry, const Bbox& targetBbox) {
-    GPSCoord gps;
-
-    // Ground Sample Distance (mm/pixel), 1.0~2.5cm per px is ideal aka 10mm~25mm ppx
-    // double GSD = (SENSOR_WIDTH * (telemetry.altitude_agl_m * 1000))
-    //              / (FOCAL_LENGTH_MM * IMG_WIDTH_PX);
+    double lat;
+    double lon;
+    localize(telemetry, std::span<const Bbox>(&targetBbox, 1), std::span<double>(&lat, 1),
+             std::span<double>(&lon, 1));
+
+    GPSCoord calc_coord;
+    calc_coord.set_latitude(lat);
+    calc_coord.set_longitude(lon);
+    return calc_coord;
+}
 
-    std::cout << "Pre-localization: " << telemetry.latitude_deg << " " << telemetry.longitude_deg;
+void GSDLocalization::localize(const ImageTelemetry& telemetry, std::span<const Bbox> bboxes,
+                               std::span<double> latitudes, std::span<double> longitudes) {
+    checkOutputSizes(bboxes, latitudes, longitudes);
 
-    double GSD = (ANGLE_OF_VIEW_RATIO * (telemetry.altitude_agl_m * 1000)
-                 /IMG_WIDTH_PX);
+    // Ground Sample Distance, converted from mm/px to m/px
+    // 1.0~2.5cm per px is ideal aka 10mm~25mm ppx
+    const double GSD_m = (ANGLE_OF_VIEW_RATIO * (telemetry.altitude_agl_m * 1000)
+                         /IMG_WIDTH_PX) * 0.001;
 
-    // Midpoints of the image
-    double img_mid_x = IMG_WIDTH_PX / 2;
-    double img_mid_y = IMG_HEIGHT_PX / 2;
+    // Rotating by -heading takes camera coordinates to real-world orientation
+    const double hdg_radians = telemetry.heading_deg * M_PI / 180;
+    const double cos_hdg = cos(hdg_radians);
+    const double sin_hdg = sin(hdg_radians);
 
-    // midpoints of bounding box around the target
-    double target_x = (targetBbox.x1 + targetBbox.x2)/2;
-    double target_y = (targetBbox.y1 + targetBbox.y2)/2;
+    // Same small offset approximation as CalcOffset
+    const double deg_per_m_lat = 180 / (M_PI * EARTH_RADIUS_M);
+    const double deg_per_m_lon = deg_per_m_lat / cos(M_PI * telemetry.latitude_deg / 180);
 
-    // calculations of bearing
-    // L = (distance(middle, bbox))*GSD
-    double length = (sqrt(pow((target_x - img_mid_x), 2) + pow((target_y - img_mid_y), 2) * GSD));
+    const double img_mid_x = IMG_WIDTH_PX / 2;
+    const double img_mid_y = IMG_HEIGHT_PX / 2;
 
-    // Translate Image Cordinates to Camera Cordinate (Origin to Center of Image instead of Top Left) NOLINT
-    double target_camera_cord_x = target_x - (IMG_WIDTH_PX / 2);
-    double target_camera_cord_y = (IMG_HEIGHT_PX / 2) - target_y;
+    for (std::size_t i = 0; i < bboxes.size(); i++) {
+        // midpoints of bounding box around the target
+        double target_x = (bboxes[i].x1 + bboxes[i].x2)/2;
+        double target_y = (bboxes[i].y1 + bboxes[i].y2)/2;
 
-    // Convert to polar coordinates
-    double target_camera_cord_r = sqrt((target_camera_cord_y * target_camera_cord_y)
-    + (target_camera_cord_x * target_camera_cord_x));
-    double target_camera_cord_theta;
+        // Translate to camera coordinates (origin at the center, y up)
+        double camera_x = target_x - img_mid_x;
+        double camera_y = img_mid_y - target_y;
 
-    // Check if xy coord is in quadrant 2 or 3, if so need to add pi
-    // (atan returns a value in the range -π/2 to π/2 radians)
-    // also check for if x coord == 0, if so just set theta to pi or -pi to
-    // (avoid divison by 0 in the atan function)
-    if (target_camera_cord_x < 0 && target_camera_cord_y < 0) {
-        target_camera_cord_theta = atan(target_camera_cord_y/target_camera_cord_x) + M_PI;
+        double east_m = (camera_x * cos_hdg + camera_y * sin_hdg) * GSD_m;
+        double north_m = (camera_y * cos_hdg - camera_x * sin_hdg) * GSD_m;
 
-    } else if (target_camera_cord_x < 0 && target_camera_cord_y > 0) {
-        target_camera_cord_theta = atan(target_camera_cord_y/target_camera_cord_x) + M_PI;
+        latitudes[i] = telemetry.latitude_deg + north_m * deg_per_m_lat;
+        longitudes[i] = telemetry.longitude_deg + east_m * deg_per_m_lon;
+    }
+}
 
-    } else if (target_camera_cord_x == 0) {
-        if (target_camera_cord_y > 1) {
-            target_camera_cord_theta == M_PI;
-        } else {
-            target_camera_cord_theta == -M_PI;
-        }
+std::vector<cv::Point2f> GSDLocalization::projectToImage(const ImageTelemetry& telemetry,
+                                                        const std::vector<GPSCoord>& coords) {
+    std::vector<cv::Point2f> pixels;
+    pixels.reserve(coords.size());
 
-    } else {
-        target_camera_cord_theta = atan(target_camera_cord_y/target_camera_cord_x);
+    // Same ground sample distance as localize, converted from mm/px to m/px
+    double GSD_m = (ANGLE_OF_VIEW_RATIO * (telemetry.altitude_agl_m * 1000)
+                   /IMG_WIDTH_PX) * 0.001;
+    if (GSD_m <= 0) {
+        return pixels;
     }
 
-    // Transfrom the coordinate to real-world orientation by subtracting heading angle
     double hdg_radians = telemetry.heading_deg * M_PI / 180;
-    target_camera_cord_theta = target_camera_cord_theta - hdg_radians;
-
-    // Convert back to regular coordinates
-    target_camera_cord_x = target_camera_cord_r*cos(target_camera_cord_theta);
-    target_camera_cord_y = target_camera_cord_r*sin(target_camera_cord_theta);
-
-    // Finds the offset of the bbox
-    double calc_cam_offset_x_m = target_camera_cord_x * GSD * 0.001;  // mm to M
-    double calc_cam_offset_y_m = target_camera_cord_y * GSD * 0.001;  // mm to M
-
-    // Calculates the cordinates using the offset
-    GPSCoord calc_coord = CalcOffset((calc_cam_offset_x_m), (calc_cam_offset_y_m),
-                                    (telemetry.latitude_deg), (telemetry.longitude_deg));
+    double cos_hdg = cos(hdg_radians);
+    double sin_hdg = sin(hdg_radians);
+    double lat_radians = telemetry.latitude_deg * M_PI / 180;
+
+    for (const GPSCoord& coord : coords) {
+        // Undo CalcOffset: lat/lon difference -> meters east/north of the plane
+        double offset_x_m = (coord.longitude() - telemetry.longitude_deg) * M_PI / 180
+                            * EARTH_RADIUS_M * cos(lat_radians);
+        double offset_y_m = (coord.latitude() - telemetry.latitude_deg) * M_PI / 180
+                            * EARTH_RADIUS_M;
+
+        // Meters -> pixels in the rotated frame
+        double rotated_x = offset_x_m / GSD_m;
+        double rotated_y = offset_y_m / GSD_m;
+
+        // localize subtracts the heading from the camera angle, so add it back
+        double camera_x = rotated_x * cos_hdg - rotated_y * sin_hdg;
+        double camera_y = rotated_x * sin_hdg + rotated_y * cos_hdg;
+
+        // Camera coordinates (origin at center, y up) -> image coordinates
+        pixels.emplace_back(camera_x + (IMG_WIDTH_PX / 2), (IMG_HEIGHT_PX / 2) - camera_y);
+    }
 
-    return calc_coord;
+    return pixels;
 }
 
 /*
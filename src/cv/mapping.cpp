@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <chrono>
+#include <cstdlib>
 #include <ctime>
 #include <filesystem>
 #include <iomanip>
@@ -15,10 +16,24 @@
 #include "cv/preprocess.hpp"  // include the Preprocess header
 #include "opencv2/opencv.hpp"
 #include "opencv2/stitching.hpp"
+#include "utilities/locks.hpp"
 #include "utilities/logging.hpp"
+#include "utilities/parallel.hpp"
 
 namespace fs = std::filesystem;
 
+namespace {
+void logTimings(const std::string& label, const StitchTimings& timings) {
+    LOG_F(INFO, "%s timings (ms): features %.0f, matching %.0f, bundle adjust %.0f, "
+          "warp %.0f, blend %.0f, total %.0f", label.c_str(), timings.find_features_ms,
+          timings.matching_ms, timings.bundle_adjust_ms, timings.warp_ms, timings.blend_ms,
+          timings.total_ms());
+}
+}  // namespace
+
+Mapping::Mapping(int num_threads, const MosaicParams& mosaic_params)
+    : num_threads(num_threads), mosaic(mosaic_params) {}
+
 // -----------------------------------------------------------------------------
 // Helper functions
 // -----------------------------------------------------------------------------
@@ -85,6 +100,36 @@ std::pair<cv::Stitcher::Status, cv::Mat> Mapping::globalStitch(const std::vector
     return {status, stitched};
 }
 
+std::string Mapping::featureKey(const std::string& filename, int max_dim, bool preprocess) {
+    return filename + ":" + std::to_string(max_dim) + (preprocess ? ":preprocessed" : "");
+}
+
+cv::Mat Mapping::loadImage(const std::string& filename, int max_dim, bool preprocess) {
+    cv::Mat img = cv::imread(filename);
+    if (img.empty()) {
+        return img;
+    }
+    if (preprocess) {
+        // Removes the 20px green bar from Daniel's camera processing, then
+        // shrinks the image to max_dim. Without preprocessing the image is
+        // used as is.
+        Preprocess preprocessor;
+        img = preprocessor.cropRight(img);
+        img = readAndResize(img, max_dim);
+    }
+    return img;
+}
+
+void Mapping::addTimings(const StitchTimings& stage_timings) {
+    Lock lock(mut);
+    timings += stage_timings;
+}
+
+StitchTimings Mapping::getTimings() const {
+    Lock lock(mut);
+    return timings;
+}
+
 std::string Mapping::currentDateTimeStr() {
     auto now = std::chrono::system_clock::now();
     std::time_t tt = std::chrono::system_clock::to_time_t(now);
@@ -98,30 +143,45 @@ std::string Mapping::currentDateTimeStr() {
 // -----------------------------------------------------------------------------
 // processChunk()
 // -----------------------------------------------------------------------------
-void Mapping::processChunk(const std::vector<cv::Mat>& chunk_images, const std::string& run_subdir,
-                           cv::Stitcher::Mode mode, int max_dim, bool preprocess) {
+void Mapping::processChunk(const std::vector<cv::Mat>& chunk_images,
+                           const std::vector<std::string>& keys, int chunk_number,
+                           const std::string& run_subdir, cv::Stitcher::Mode mode) {
     if (chunk_images.empty()) return;
 
-    chunk_counter++;
-    LOG_S(INFO) << "Processing chunk #" << chunk_counter << " with " << chunk_images.size()
+    LOG_S(INFO) << "Processing chunk #" << chunk_number << " with " << chunk_images.size()
                             << " images.\n";
 
-    // Stitch the chunk using the (now ignored) preprocess flag
-    auto [status, stitched] = globalStitch(chunk_images, mode, max_dim, preprocess);
+    StitchResult result = stitchImages(chunk_images, keys, mode, &feature_cache);
+    addTimings(result.timings);
+    logTimings("Chunk #" + std::to_string(chunk_number), result.timings);
+
+    // Hold on to the camera estimates so secondPass can chain chunks together
+    ChunkCameras cameras;
+    for (std::size_t i = 0; i < result.indices.size(); i++) {
+        cameras.keys.push_back(keys[result.indices[i]]);
+        cameras.cameras.push_back(result.cameras[i]);
+    }
+    {
+        Lock lock(mut);
+        if (static_cast<int>(chunk_cameras.size()) < chunk_number) {
+            chunk_cameras.resize(chunk_number);
+        }
+        chunk_cameras[chunk_number - 1] = std::move(cameras);
+    }
 
     // Build an output filename for this chunk
-    std::string chunk_filename = run_subdir + "/chunk_" + std::to_string(chunk_counter) + "_" +
+    std::string chunk_filename = run_subdir + "/chunk_" + std::to_string(chunk_number) + "_" +
                                  currentDateTimeStr() + ".jpg";
 
-    if (status == cv::Stitcher::OK && !stitched.empty()) {
-        if (cv::imwrite(chunk_filename, stitched)) {
+    if (result.status == cv::Stitcher::OK && !result.pano.empty()) {
+        if (cv::imwrite(chunk_filename, result.pano)) {
             LOG_S(INFO) << "Saved chunk result to: " << chunk_filename << "\n";
         } else {
             LOG_F(ERROR, "Failed to save chunk result to disk. This chunk will be lost.\n");
         }
     } else {
-        std::cerr << "Chunk stitching failed, status = " << static_cast<int>(status)
-                  << ". Not saving chunk.\n";
+        LOG_S(WARNING) << "Chunk stitching failed, status = " << static_cast<int>(result.status)
+                       << ". Not saving chunk.\n";
     }
 }
 
@@ -169,34 +229,64 @@ void Mapping::firstPass(const std::string& input_path, const std::string& run_su
 
     // 4. Load and preprocess new images
     images.clear();
-    Preprocess preprocessor;  // instantiate the Preprocess object
+    std::vector<std::string> keys;
     for (const auto& filename : new_files) {
-        cv::Mat img = cv::imread(filename);
+        cv::Mat img = loadImage(filename, max_dim, preprocess);
         if (!img.empty()) {
-            if (preprocess) {
-                // Apply custom preprocessing before further processing
-                img = preprocessor.cropRight(img);
-                img = readAndResize(img, max_dim);
-            }
             images.push_back(img);
+            keys.push_back(featureKey(filename, max_dim, preprocess));
         } else {
             LOG_S(WARNING) << "Warning: Failed to load image: " << filename << "\n";
         }
     }
     LOG_S(INFO) << "Loaded and preprocessed " << images.size() << " new images.\n";
+    if (images.empty()) {
+        processed_image_count = static_cast<int>(all_filenames.size());
+        return;
+    }
 
-    // 5. Chunk the preprocessed images
+    // 5. Find features for every image up front, so images shared between
+    //    overlapping chunks are only analysed once even with chunks running in parallel
+    auto features_start = std::chrono::steady_clock::now();
+    double work_scale = registrationScale(images[0].size());
+    parallelFor(images.size(), num_threads, [&](std::size_t i) {
+        try {
+            findFeatures(images[i], keys[i], work_scale, &feature_cache);
+        } catch (const cv::Exception& e) {
+            LOG_F(ERROR, "Failed to find features: %s", e.what());
+        }
+    });
+    StitchTimings feature_timings;
+    feature_timings.find_features_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - features_start).count();
+    addTimings(feature_timings);
+
+    // 6. Chunk the preprocessed images and stitch the chunks in parallel
     auto chunks = chunkListWithOverlap(static_cast<int>(images.size()), chunk_size, overlap);
-    for (auto& chunk_indices : chunks) {
+    const int first_chunk_number = chunk_counter + 1;
+    chunk_counter += static_cast<int>(chunks.size());
+    parallelFor(chunks.size(), num_threads, [&](std::size_t c) {
         std::vector<cv::Mat> chunk_imgs;
-        chunk_imgs.reserve(chunk_indices.size());
-        for (int idx : chunk_indices) {
+        std::vector<std::string> chunk_keys;
+        chunk_imgs.reserve(chunks[c].size());
+        for (int idx : chunks[c]) {
             chunk_imgs.push_back(images[idx]);
+            chunk_keys.push_back(keys[idx]);
         }
-        processChunk(chunk_imgs, current_run_folder, mode, max_dim, preprocess);
-    }
+        try {
+            processChunk(chunk_imgs, chunk_keys, first_chunk_number + static_cast<int>(c),
+                         current_run_folder, mode);
+        } catch (const std::exception& e) {
+            LOG_F(ERROR, "Chunk #%d failed: %s", first_chunk_number + static_cast<int>(c),
+                  e.what());
+        }
+    });
 
-    // 6. Update processed count and free memory
+    LOG_F(INFO, "Feature cache: %zu images, %zu hits, %zu misses", feature_cache.size(),
+          feature_cache.hits(), feature_cache.misses());
+    logTimings("Mapping", getTimings());
+
+    // 7. Update processed count and free memory
     processed_image_count = static_cast<int>(all_filenames.size());
     images.clear();
 }
@@ -208,6 +298,11 @@ void Mapping::secondPass(const std::string& run_subdir, cv::Stitcher::Mode mode,
                          bool preprocess) {
     std::string folder_to_scan = current_run_folder.empty() ? run_subdir : current_run_folder;
 
+    // Reuse what the first pass already worked out if we can
+    if (stitchFromChunkCameras(folder_to_scan, mode, max_dim, preprocess)) {
+        return;
+    }
+
     // Identify all chunk files (e.g., chunk_*.jpg)
     std::vector<std::string> chunk_files;
     for (const auto& entry : fs::directory_iterator(folder_to_scan)) {
@@ -260,6 +355,79 @@ void Mapping::secondPass(const std::string& run_subdir, cv::Stitcher::Mode mode,
     chunk_images.clear();
 }
 
+// -----------------------------------------------------------------------------
+// stitchFromChunkCameras()
+// -----------------------------------------------------------------------------
+bool Mapping::stitchFromChunkCameras(const std::string& folder, cv::Stitcher::Mode mode,
+                                     int max_dim, bool preprocess) {
+    std::optional<std::unordered_map<std::string, ChainedCamera>> chained;
+    {
+        Lock lock(mut);
+        if (chunk_cameras.empty()) {
+            return false;
+        }
+        chained = chainChunkCameras(chunk_cameras);
+    }
+    if (!chained.has_value() || chained->size() < 2) {
+        LOG_F(INFO, "Chunk camera estimates don't connect, stitching chunk images instead.");
+        return false;
+    }
+
+    // Reload every image that got registered in some chunk, in capture order
+    std::vector<cv::Mat> all_images;
+    std::vector<std::string> keys;
+    std::vector<cv::detail::CameraParams> cameras;
+    std::vector<int> chunk_of;
+    for (const auto& filename : image_filenames) {
+        std::string key = featureKey(filename, max_dim, preprocess);
+        auto camera = chained->find(key);
+        if (camera == chained->end()) continue;
+
+        cv::Mat img = loadImage(filename, max_dim, preprocess);
+        if (img.empty()) continue;
+        all_images.push_back(img);
+        keys.push_back(key);
+        cameras.push_back(camera->second.camera);
+        chunk_of.push_back(camera->second.chunk);
+    }
+    if (all_images.size() < 2) {
+        return false;
+    }
+
+    // Only images from the same or neighboring chunks can overlap, don't bother
+    // matching anything else
+    const int num_images = static_cast<int>(all_images.size());
+    cv::Mat match_mask = cv::Mat::zeros(num_images, num_images, CV_8U);
+    for (int i = 0; i < num_images; i++) {
+        for (int j = 0; j < num_images; j++) {
+            if (std::abs(chunk_of[i] - chunk_of[j]) <= 1) {
+                match_mask.at<uchar>(i, j) = 1;
+            }
+        }
+    }
+
+    LOG_S(INFO) << "Stitching " << num_images << " images from " << folder
+                << " using the chunk camera estimates...\n";
+    StitchResult result =
+        stitchImages(all_images, keys, mode, &feature_cache, cameras, match_mask);
+    addTimings(result.timings);
+    logTimings("Second pass", result.timings);
+
+    if (result.status != cv::Stitcher::OK || result.pano.empty()) {
+        LOG_S(WARNING) << "Stitching from chunk cameras failed. Status = "
+                       << static_cast<int>(result.status) << "\n";
+        return false;
+    }
+
+    std::string final_name = folder + "/final_" + currentDateTimeStr() + ".jpg";
+    if (cv::imwrite(final_name, result.pano)) {
+        LOG_S(INFO) << "Final image saved to: " << final_name << "\n";
+    } else {
+        LOG_S(WARNING) << "Failed to save final image to " << final_name << "\n";
+    }
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 // directStitch()
 // -----------------------------------------------------------------------------
@@ -346,6 +514,74 @@ void Mapping::directStitch(const std::string& input_path, const std::string& out
     all_images.clear();
 }
 
+// -----------------------------------------------------------------------------
+// incrementalPass()
+// -----------------------------------------------------------------------------
+int Mapping::incrementalPass(const std::string& input_path, const std::string& output_path,
+                             int max_dim, bool preprocess) {
+    // 1. Scan directory for images we haven't placed yet
+    std::vector<fs::path> new_files;
+    for (const auto& entry : fs::directory_iterator(input_path)) {
+        if (!entry.is_regular_file()) continue;
+        auto ext = entry.path().extension().string();
+        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+        if ((ext == ".jpg" || ext == ".jpeg" || ext == ".png") &&
+            mosaic_filenames.count(entry.path().string()) == 0) {
+            new_files.push_back(entry.path());
+        }
+    }
+
+    // 2. Sort them so frames are added in the order they were taken
+    std::sort(new_files.begin(), new_files.end());
+
+    // 3. Place each image using the telemetry saved alongside it
+    int num_added = 0;
+    for (const auto& filename : new_files) {
+        auto telemetry = loadImageTelemetryFromFile(fs::path(filename).replace_extension(".json"));
+        if (!telemetry.has_value()) {
+            // Might still be getting written, try again next pass
+            continue;
+        }
+
+        cv::Mat img = loadImage(filename.string(), max_dim, preprocess);
+        if (img.empty()) {
+            // Also might still be getting written, so it isn't marked as placed yet
+            LOG_S(WARNING) << "Warning: Failed to load image: " << filename << "\n";
+            continue;
+        }
+        mosaic_filenames.insert(filename.string());
+
+        if (mosaic.addFrame(img, telemetry.value())) {
+            num_added++;
+        }
+    }
+
+    // 4. Write out the part of the map that changed
+    std::size_t num_tiles = mosaic.saveDirtyTiles(fs::path(output_path) / "tiles");
+
+    MosaicStats stats = mosaic.getStats();
+    LOG_F(INFO, "Added %d images to mosaic, %zu tiles updated (%zu frames, %zu refined)",
+          num_added, num_tiles, stats.frames_added, stats.frames_refined);
+    return num_added;
+}
+
+bool Mapping::saveMosaic(const std::string& output_path) {
+    cv::Mat rendered = mosaic.render(MOSAIC_MAX_RENDER_DIM);
+    if (rendered.empty()) {
+        LOG_S(WARNING) << "Mosaic is empty. Nothing to save.\n";
+        return false;
+    }
+
+    fs::create_directories(output_path);
+    std::string mosaic_name = output_path + "/mosaic_" + currentDateTimeStr() + ".jpg";
+    if (!cv::imwrite(mosaic_name, rendered)) {
+        LOG_S(WARNING) << "Failed to save mosaic to " << mosaic_name << "\n";
+        return false;
+    }
+    LOG_S(INFO) << "Mosaic saved to: " << mosaic_name << "\n";
+    return true;
+}
+
 // -----------------------------------------------------------------------------
 // reset()
 // -----------------------------------------------------------------------------
@@ -355,5 +591,13 @@ void Mapping::reset() {
     processed_image_count = 0;
     chunk_counter = 0;
     current_run_folder.clear();
+    feature_cache.clear();
+    {
+        Lock lock(mut);
+        chunk_cameras.clear();
+        timings = StitchTimings();
+    }
+    mosaic.reset();
+    mosaic_filenames.clear();
     LOG_F(INFO, "Mapping state has been reset.\n");
 }
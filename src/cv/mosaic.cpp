@@ -0,0 +1,764 @@
+#include "cv/mosaic.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <list>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <opencv2/calib3d.hpp>
+#include <opencv2/features2d.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "cv/localization.hpp"
+#include "utilities/constants.hpp"
+#include "utilities/logging.hpp"
+
+namespace {
+// A frame whose footprint is wider than this many tiles has bogus telemetry
+// (e.g. altitude way off), blending it would smear it over the whole map
+const int MAX_FOOTPRINT_TILES = 16;
+
+cv::Point2d applyHomography(const cv::Matx33d& H, const cv::Point2d& p) {
+    cv::Vec3d v = H * cv::Vec3d(p.x, p.y, 1.0);
+    return {v[0] / v[2], v[1] / v[2]};
+}
+
+std::vector<cv::Point2d> imageCorners(const cv::Size& size) {
+    return {{0, 0}, {static_cast<double>(size.width), 0},
+            {static_cast<double>(size.width), static_cast<double>(size.height)},
+            {0, static_cast<double>(size.height)}};
+}
+
+// Canvas pixels covered by an image of the given size
+cv::Rect footprint(const cv::Matx33d& to_canvas, const cv::Size& size) {
+    double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+    for (const cv::Point2d& corner : imageCorners(size)) {
+        cv::Point2d p = applyHomography(to_canvas, corner);
+        min_x = std::min(min_x, p.x);
+        min_y = std::min(min_y, p.y);
+        max_x = std::max(max_x, p.x);
+        max_y = std::max(max_y, p.y);
+    }
+    if (!std::isfinite(min_x) || !std::isfinite(min_y) ||
+        !std::isfinite(max_x) || !std::isfinite(max_y)) {
+        return cv::Rect();
+    }
+    int x = static_cast<int>(std::floor(min_x));
+    int y = static_cast<int>(std::floor(min_y));
+    return cv::Rect(x, y, static_cast<int>(std::ceil(max_x)) - x,
+                    static_cast<int>(std::ceil(max_y)) - y);
+}
+
+int floorDiv(int a, int b) {
+    return static_cast<int>(std::floor(static_cast<double>(a) / b));
+}
+
+std::size_t matBytes(const cv::Mat& mat) { return mat.total() * mat.elemSize(); }
+
+// Spill files are just each mat's rows / cols / type followed by its pixels
+bool writeSpill(const std::filesystem::path& path, const std::vector<cv::Mat>& mats) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    for (const cv::Mat& mat : mats) {
+        cv::Mat continuous = mat.isContinuous() ? mat : mat.clone();
+        int32_t header[3] = {continuous.rows, continuous.cols, continuous.type()};
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(continuous.data),
+                   static_cast<std::streamsize>(matBytes(continuous)));
+    }
+    return static_cast<bool>(file);
+}
+
+std::optional<std::vector<cv::Mat>> readSpill(const std::filesystem::path& path,
+                                              std::size_t count) {
+    std::ifstream file(path, std::ios::binary);
+    std::vector<cv::Mat> mats;
+    for (std::size_t i = 0; i < count; i++) {
+        int32_t header[3];
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) {
+            return {};
+        }
+        cv::Mat mat(header[0], header[1], header[2]);
+        if (!mat.empty() && !file.read(reinterpret_cast<char*>(mat.data),
+                                       static_cast<std::streamsize>(matBytes(mat)))) {
+            return {};
+        }
+        mats.push_back(mat);
+    }
+    return mats;
+}
+
+std::string tileName(int64_t key) {
+    return std::to_string(static_cast<int32_t>(key >> 32)) + "_" +
+           std::to_string(static_cast<int32_t>(key & 0xFFFFFFFF));
+}
+}  // namespace
+
+IncrementalMosaic::IncrementalMosaic(const MosaicParams& params)
+    : params(params),
+      has_origin(false),
+      origin_lat_deg(0),
+      origin_lon_deg(0),
+      frames_refined(0),
+      frames_skipped(0),
+      use_clock(0),
+      has_spilled(false),
+      resident_bytes(0),
+      tiles_spilled(0) {}
+
+IncrementalMosaic::~IncrementalMosaic() { clearSpill(); }
+
+bool IncrementalMosaic::addFrame(const cv::Mat& image, const ImageTelemetry& telemetry) {
+    if (image.empty() || image.type() != CV_8UC3 || telemetry.altitude_agl_m <= 0) {
+        LOG_F(WARNING, "Skipping mosaic frame, empty image or bad altitude (%f m)",
+              telemetry.altitude_agl_m);
+        this->frames_skipped++;
+        return false;
+    }
+
+    cv::Matx33d seed = seedHomography(image.size(), telemetry);
+    cv::Rect seed_bounds = footprint(seed, image.size());
+    const int max_side = MAX_FOOTPRINT_TILES * this->params.tile_size;
+    if (seed_bounds.empty() || seed_bounds.width > max_side || seed_bounds.height > max_side) {
+        LOG_F(WARNING, "Skipping mosaic frame, footprint of %dx%d px is out of range",
+              seed_bounds.width, seed_bounds.height);
+        this->frames_skipped++;
+        return false;
+    }
+
+    this->use_clock++;
+
+    if (!this->has_origin) {
+        this->has_origin = true;
+        this->origin_lat_deg = telemetry.latitude_deg;
+        this->origin_lon_deg = telemetry.longitude_deg;
+    }
+
+    // Find features on a downscaled grayscale copy, then scale them back to image pixels
+    double feature_scale = std::min(1.0, static_cast<double>(this->params.feature_max_dim) /
+                                             std::max(image.cols, image.rows));
+    cv::Mat gray;
+    cv::cvtColor(image, gray, cv::COLOR_BGR2GRAY);
+    if (feature_scale < 1.0) {
+        cv::resize(gray, gray, cv::Size(), feature_scale, feature_scale, cv::INTER_AREA);
+    }
+
+    std::vector<cv::KeyPoint> keypoints;
+    cv::Mat descriptors;
+    cv::Ptr<cv::ORB> orb = cv::ORB::create(this->params.max_features);
+    orb->detectAndCompute(gray, cv::noArray(), keypoints, descriptors);
+
+    std::vector<cv::Point2f> image_points;
+    image_points.reserve(keypoints.size());
+    for (const cv::KeyPoint& kp : keypoints) {
+        image_points.emplace_back(kp.pt.x / feature_scale, kp.pt.y / feature_scale);
+    }
+
+    // Only frames near where the telemetry put us can be matched against
+    int search_margin = static_cast<int>(this->params.max_correction_m /
+                                         this->params.meters_per_px);
+    cv::Rect search_area(seed_bounds.x - search_margin, seed_bounds.y - search_margin,
+                         seed_bounds.width + 2 * search_margin,
+                         seed_bounds.height + 2 * search_margin);
+    std::vector<int> neighbors = findNeighbors(search_area);
+    for (int id : neighbors) {
+        loadFeatures(id);
+    }
+
+    cv::Matx33d to_canvas = seed;
+    std::optional<cv::Matx33d> refined =
+        refine(seed, image.size(), image_points, descriptors, neighbors);
+    if (refined.has_value()) {
+        to_canvas = refined.value();
+        this->frames_refined++;
+    }
+
+    Frame frame;
+    frame.to_canvas = to_canvas;
+    frame.bounds = footprint(to_canvas, image.size());
+    frame.descriptors = descriptors;
+    frame.spilled = false;
+    frame.last_used = this->use_clock;
+    frame.keypoints.reserve(image_points.size());
+    for (const cv::Point2f& p : image_points) {
+        cv::Point2d canvas_p = applyHomography(to_canvas, p);
+        frame.keypoints.emplace_back(static_cast<float>(canvas_p.x),
+                                     static_cast<float>(canvas_p.y));
+    }
+
+    int frame_id = static_cast<int>(this->frames.size());
+    this->resident_bytes += residentBytes(frame);
+    touch(&frame.lru_entry, false, frame_id, true);
+    cv::Rect range = tileRange(frame.bounds);
+    for (int ty = range.y; ty < range.y + range.height; ty++) {
+        for (int tx = range.x; tx < range.x + range.width; tx++) {
+            this->frame_index[tileKey(tx, ty)].push_back(frame_id);
+        }
+    }
+
+    blend(image, to_canvas, frame.bounds);
+
+    this->canvas_bounds = this->canvas_bounds.empty() ? frame.bounds
+                                                      : (this->canvas_bounds | frame.bounds);
+    this->frames.push_back(std::move(frame));
+    enforceBudget();
+
+    VLOG_F(DEBUG, "Mosaic frame %d placed (%s, %zu neighbors)", frame_id,
+           refined.has_value() ? "refined" : "telemetry only", neighbors.size());
+    return true;
+}
+
+cv::Matx33d IncrementalMosaic::seedHomography(const cv::Size& image_size,
+                                              const ImageTelemetry& telemetry) const {
+    // Same ground sample distance as GSDLocalization, converted from mm/px to m/px
+    double gsd_m = (ANGLE_OF_VIEW_RATIO * (telemetry.altitude_agl_m * 1000)
+                   / IMG_WIDTH_PX) * 0.001;
+    double scale = gsd_m / this->params.meters_per_px;
+
+    // Image pixels -> full sensor pixels with the origin at the center and y up
+    double kx = static_cast<double>(IMG_WIDTH_PX) / image_size.width;
+    double ky = static_cast<double>(IMG_HEIGHT_PX) / image_size.height;
+    cv::Matx33d to_camera(kx, 0, -IMG_WIDTH_PX / 2.0,
+                          0, -ky, IMG_HEIGHT_PX / 2.0,
+                          0, 0, 1);
+
+    // Camera -> east/north. localize subtracts the heading from the camera angle
+    double hdg_radians = telemetry.heading_deg * M_PI / 180;
+    double cos_hdg = std::cos(hdg_radians);
+    double sin_hdg = std::sin(hdg_radians);
+    cv::Matx33d rotate(cos_hdg, sin_hdg, 0,
+                       -sin_hdg, cos_hdg, 0,
+                       0, 0, 1);
+
+    // East/north (in sensor pixels) -> canvas pixels, y pointing south
+    cv::Point2d center(0, 0);
+    if (this->has_origin) {
+        center = toCanvas(telemetry.latitude_deg, telemetry.longitude_deg);
+    }
+    cv::Matx33d to_canvas(scale, 0, center.x,
+                          0, -scale, center.y,
+                          0, 0, 1);
+
+    return to_canvas * rotate * to_camera;
+}
+
+cv::Point2d IncrementalMosaic::toCanvas(double latitude_deg, double longitude_deg) const {
+    double east_m = (longitude_deg - this->origin_lon_deg) * M_PI / 180
+                    * EARTH_RADIUS_METERS * std::cos(this->origin_lat_deg * M_PI / 180);
+    double north_m = (latitude_deg - this->origin_lat_deg) * M_PI / 180 * EARTH_RADIUS_METERS;
+    return {east_m / this->params.meters_per_px, -north_m / this->params.meters_per_px};
+}
+
+GPSCoord IncrementalMosaic::toGPS(const cv::Point2d& canvas_px) const {
+    double east_m = canvas_px.x * this->params.meters_per_px;
+    double north_m = -canvas_px.y * this->params.meters_per_px;
+
+    GPSCoord coord;
+    coord.set_latitude(this->origin_lat_deg + north_m / EARTH_RADIUS_METERS * 180 / M_PI);
+    coord.set_longitude(this->origin_lon_deg + east_m /
+        (EARTH_RADIUS_METERS * std::cos(this->origin_lat_deg * M_PI / 180)) * 180 / M_PI);
+    coord.set_altitude(0);
+    return coord;
+}
+
+cv::Rect IncrementalMosaic::bounds() const { return this->canvas_bounds; }
+
+cv::Mat IncrementalMosaic::render(int max_dim) const {
+    if (this->canvas_bounds.empty()) {
+        return cv::Mat();
+    }
+
+    double scale = 1.0;
+    int largest_side = std::max(this->canvas_bounds.width, this->canvas_bounds.height);
+    if (max_dim > 0 && largest_side > max_dim) {
+        scale = static_cast<double>(max_dim) / largest_side;
+    }
+    cv::Size output_size(std::max(1, static_cast<int>(this->canvas_bounds.width * scale)),
+                         std::max(1, static_cast<int>(this->canvas_bounds.height * scale)));
+    cv::Mat output = cv::Mat::zeros(output_size, CV_8UC3);
+    const cv::Rect output_rect(cv::Point(0, 0), output_size);
+
+    // Where canvas pixel v lands in the output, along one axis
+    auto toOutput = [scale](int v, int origin) {
+        return static_cast<int>(std::floor((v - origin) * scale));
+    };
+
+    const int ts = this->params.tile_size;
+    for (const auto& [key, tile] : this->tiles) {
+        int tx = static_cast<int32_t>(key >> 32);
+        int ty = static_cast<int32_t>(key & 0xFFFFFFFF);
+        int x0 = toOutput(tx * ts, this->canvas_bounds.x);
+        int y0 = toOutput(ty * ts, this->canvas_bounds.y);
+        cv::Rect dst(x0, y0, toOutput((tx + 1) * ts, this->canvas_bounds.x) - x0,
+                     toOutput((ty + 1) * ts, this->canvas_bounds.y) - y0);
+        cv::Rect clipped = dst & output_rect;
+        if (clipped.empty()) {
+            continue;
+        }
+
+        cv::Mat color;
+        cv::Mat weight;
+        readTile(key, tile, color, weight);
+        if (color.empty()) {
+            continue;
+        }
+        cv::Mat scaled = color;
+        if (dst.size() != color.size()) {
+            cv::resize(color, scaled, dst.size(), 0, 0, cv::INTER_AREA);
+        }
+        scaled(clipped - dst.tl()).copyTo(output(clipped));
+    }
+    return output;
+}
+
+cv::Mat IncrementalMosaic::renderRegion(const cv::Rect& canvas_rect) const {
+    if (canvas_rect.empty()) {
+        return cv::Mat();
+    }
+
+    cv::Mat output = cv::Mat::zeros(canvas_rect.size(), CV_8UC4);
+    const int ts = this->params.tile_size;
+    cv::Rect range = tileRange(canvas_rect);
+    for (int ty = range.y; ty < range.y + range.height; ty++) {
+        for (int tx = range.x; tx < range.x + range.width; tx++) {
+            auto tile = this->tiles.find(tileKey(tx, ty));
+            if (tile == this->tiles.end()) {
+                continue;
+            }
+            cv::Mat color;
+            cv::Mat weight;
+            readTile(tile->first, tile->second, color, weight);
+            if (color.empty()) {
+                continue;
+            }
+            cv::Rect tile_rect(tx * ts, ty * ts, ts, ts);
+            cv::Rect overlap = tile_rect & canvas_rect;
+            cv::Rect local = overlap - tile_rect.tl();
+
+            cv::Mat bgra;
+            cv::cvtColor(color(local), bgra, cv::COLOR_BGR2BGRA);
+            cv::Mat covered = weight(local) > 0;
+            cv::Mat alpha(local.size(), CV_8UC1, cv::Scalar(0));
+            alpha.setTo(255, covered);
+            cv::insertChannel(alpha, bgra, 3);
+            bgra.copyTo(output(overlap - canvas_rect.tl()));
+        }
+    }
+    return output;
+}
+
+std::vector<cv::Rect> IncrementalMosaic::takeChangedRegions() {
+    const int ts = this->params.tile_size;
+    std::vector<cv::Rect> changed;
+    for (auto& [key, tile] : this->tiles) {
+        if (!tile.changed) {
+            continue;
+        }
+        changed.emplace_back(static_cast<int32_t>(key >> 32) * ts,
+                             static_cast<int32_t>(key & 0xFFFFFFFF) * ts, ts, ts);
+        tile.changed = false;
+    }
+    return changed;
+}
+
+std::size_t IncrementalMosaic::saveDirtyTiles(const std::filesystem::path& directory) {
+    std::filesystem::create_directories(directory);
+
+    std::size_t num_saved = 0;
+    for (auto& [key, tile] : this->tiles) {
+        if (!tile.dirty) {
+            continue;
+        }
+        cv::Mat color;
+        cv::Mat weight;
+        readTile(key, tile, color, weight);
+        if (color.empty()) {
+            continue;
+        }
+        std::filesystem::path tile_path = directory / ("tile_" + tileName(key) + ".png");
+        if (!cv::imwrite(tile_path.string(), color)) {
+            LOG_F(ERROR, "Failed to save mosaic tile to %s", tile_path.string().c_str());
+            continue;
+        }
+        tile.dirty = false;
+        num_saved++;
+    }
+    return num_saved;
+}
+
+MosaicStats IncrementalMosaic::getStats() const {
+    return MosaicStats{
+        .frames_added = this->frames.size(),
+        .frames_refined = this->frames_refined,
+        .frames_skipped = this->frames_skipped,
+        .tiles = this->tiles.size(),
+        .tiles_spilled = this->tiles_spilled,
+        .resident_bytes = this->resident_bytes,
+    };
+}
+
+const MosaicParams& IncrementalMosaic::getParams() const { return this->params; }
+
+void IncrementalMosaic::reset() {
+    this->has_origin = false;
+    this->origin_lat_deg = 0;
+    this->origin_lon_deg = 0;
+    this->frames.clear();
+    this->frame_index.clear();
+    this->tiles.clear();
+    this->feather.release();
+    this->canvas_bounds = cv::Rect();
+    this->frames_refined = 0;
+    this->frames_skipped = 0;
+    this->use_clock = 0;
+    this->lru.clear();
+    this->resident_bytes = 0;
+    this->tiles_spilled = 0;
+    clearSpill();
+}
+
+int64_t IncrementalMosaic::tileKey(int tile_x, int tile_y) const {
+    return (static_cast<int64_t>(tile_x) << 32) | (static_cast<int64_t>(tile_y) & 0xFFFFFFFF);
+}
+
+cv::Rect IncrementalMosaic::tileRange(const cv::Rect& canvas_rect) const {
+    if (canvas_rect.empty()) {
+        return cv::Rect();
+    }
+    const int ts = this->params.tile_size;
+    int x0 = floorDiv(canvas_rect.x, ts);
+    int y0 = floorDiv(canvas_rect.y, ts);
+    int x1 = floorDiv(canvas_rect.x + canvas_rect.width - 1, ts);
+    int y1 = floorDiv(canvas_rect.y + canvas_rect.height - 1, ts);
+    return cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1);
+}
+
+std::vector<int> IncrementalMosaic::findNeighbors(const cv::Rect& area) const {
+    // frame id -> pixels shared with area
+    std::unordered_map<int, int> overlaps;
+    cv::Rect range = tileRange(area);
+    for (int ty = range.y; ty < range.y + range.height; ty++) {
+        for (int tx = range.x; tx < range.x + range.width; tx++) {
+            auto cell = this->frame_index.find(tileKey(tx, ty));
+            if (cell == this->frame_index.end()) {
+                continue;
+            }
+            for (int id : cell->second) {
+                overlaps.emplace(id, (this->frames[id].bounds & area).area());
+            }
+        }
+    }
+
+    std::vector<std::pair<int, int>> ranked;  // (overlap, frame id)
+    for (const auto& [id, overlap] : overlaps) {
+        if (overlap > 0) {
+            ranked.emplace_back(overlap, id);
+        }
+    }
+    // Most overlap first, newest frame first on ties
+    std::sort(ranked.begin(), ranked.end(), std::greater<>());
+    if (static_cast<int>(ranked.size()) > this->params.max_neighbors) {
+        ranked.resize(this->params.max_neighbors);
+    }
+
+    std::vector<int> neighbors;
+    neighbors.reserve(ranked.size());
+    for (const auto& [overlap, id] : ranked) {
+        neighbors.push_back(id);
+    }
+    return neighbors;
+}
+
+std::optional<cv::Matx33d> IncrementalMosaic::refine(const cv::Matx33d& seed,
+                                                     const cv::Size& image_size,
+                                                     const std::vector<cv::Point2f>& keypoints,
+                                                     const cv::Mat& descriptors,
+                                                     const std::vector<int>& neighbors) const {
+    if (descriptors.empty() || neighbors.empty()) {
+        return {};
+    }
+
+    // Pool every neighbor's features, they're already in canvas pixels
+    std::vector<cv::Point2f> neighbor_points;
+    cv::Mat neighbor_descriptors;
+    for (int id : neighbors) {
+        const Frame& neighbor = this->frames[id];
+        if (neighbor.descriptors.empty()) {
+            continue;
+        }
+        neighbor_points.insert(neighbor_points.end(), neighbor.keypoints.begin(),
+                               neighbor.keypoints.end());
+        neighbor_descriptors.push_back(neighbor.descriptors);
+    }
+    if (neighbor_descriptors.empty()) {
+        return {};
+    }
+
+    cv::BFMatcher matcher(cv::NORM_HAMMING);
+    std::vector<std::vector<cv::DMatch>> knn_matches;
+    matcher.knnMatch(descriptors, neighbor_descriptors, knn_matches, 2);
+
+    // Ratio test, then drop anything too far from where the telemetry says it should be
+    const double max_offset_px = this->params.max_correction_m / this->params.meters_per_px;
+    std::vector<cv::Point2f> src;
+    std::vector<cv::Point2f> dst;
+    for (const std::vector<cv::DMatch>& m : knn_matches) {
+        if (m.empty() || (m.size() > 1 && m[0].distance > 0.75f * m[1].distance)) {
+            continue;
+        }
+        const cv::Point2f& p = keypoints[m[0].queryIdx];
+        const cv::Point2f& q = neighbor_points[m[0].trainIdx];
+        if (cv::norm(applyHomography(seed, p) - cv::Point2d(q)) > max_offset_px) {
+            continue;
+        }
+        src.push_back(p);
+        dst.push_back(q);
+    }
+    if (static_cast<int>(src.size()) < this->params.min_inliers) {
+        return {};
+    }
+
+    cv::Mat inliers;
+    cv::Mat H = cv::findHomography(src, dst, cv::RANSAC, 3.0, inliers);
+    if (H.empty() || cv::countNonZero(inliers) < this->params.min_inliers) {
+        return {};
+    }
+
+    cv::Matx33d refined = H;
+    for (const cv::Point2d& corner : imageCorners(image_size)) {
+        if (cv::norm(applyHomography(refined, corner) - applyHomography(seed, corner)) >
+            max_offset_px) {
+            return {};
+        }
+    }
+    return refined;
+}
+
+void IncrementalMosaic::blend(const cv::Mat& image, const cv::Matx33d& to_canvas,
+                              const cv::Rect& area) {
+    if (this->feather.size() != image.size()) {
+        // Weight falls off towards the image border so seams between frames fade out
+        cv::Mat inside(image.size(), CV_8UC1, cv::Scalar(255));
+        inside.row(0).setTo(0);
+        inside.row(inside.rows - 1).setTo(0);
+        inside.col(0).setTo(0);
+        inside.col(inside.cols - 1).setTo(0);
+        cv::distanceTransform(inside, this->feather, cv::DIST_L2, 3);
+        cv::normalize(this->feather, this->feather, 0, 1, cv::NORM_MINMAX);
+    }
+
+    const int ts = this->params.tile_size;
+    cv::Rect range = tileRange(area);
+    for (int ty = range.y; ty < range.y + range.height; ty++) {
+        for (int tx = range.x; tx < range.x + range.width; tx++) {
+            cv::Rect tile_rect(tx * ts, ty * ts, ts, ts);
+            cv::Rect overlap = tile_rect & area;
+            if (overlap.empty()) {
+                continue;
+            }
+
+            // Only warp the part of the frame that lands on this tile
+            cv::Matx33d shift(1, 0, -overlap.x,
+                              0, 1, -overlap.y,
+                              0, 0, 1);
+            cv::Matx33d warp = shift * to_canvas;
+            cv::Mat warped;
+            cv::Mat weight;
+            cv::warpPerspective(image, warped, warp, overlap.size(), cv::INTER_LINEAR,
+                                cv::BORDER_CONSTANT);
+            cv::warpPerspective(this->feather, weight, warp, overlap.size(), cv::INTER_LINEAR,
+                                cv::BORDER_CONSTANT);
+
+            Tile& tile = residentTile(tx, ty);
+            tile.dirty = true;
+            tile.changed = true;
+
+            cv::Rect local = overlap - tile_rect.tl();
+            cv::Mat color = tile.color(local);
+            cv::Mat total = tile.weight(local);
+
+            // Running weighted average: color += (new - color) * w_new / (w_old + w_new)
+            total += weight;
+            cv::Mat alpha;
+            cv::divide(weight, cv::max(total, 1e-6), alpha);
+            cv::Mat alpha3;
+            cv::merge(std::vector<cv::Mat>{alpha, alpha, alpha}, alpha3);
+
+            cv::Mat color_f;
+            cv::Mat warped_f;
+            color.convertTo(color_f, CV_32FC3);
+            warped.convertTo(warped_f, CV_32FC3);
+            color_f += (warped_f - color_f).mul(alpha3);
+            color_f.convertTo(color, CV_8UC3);
+        }
+    }
+}
+
+IncrementalMosaic::Tile& IncrementalMosaic::residentTile(int tile_x, int tile_y) {
+    const int ts = this->params.tile_size;
+    int64_t key = tileKey(tile_x, tile_y);
+    Tile& tile = this->tiles[key];
+    tile.last_used = this->use_clock;
+
+    const bool added = tile.color.empty();
+    if (tile.spilled) {
+        std::filesystem::path path = this->params.spill_dir / ("tile_" + tileName(key) + ".bin");
+        auto mats = readSpill(path, 2);
+        if (mats.has_value()) {
+            tile.color = (*mats)[0];
+            tile.weight = (*mats)[1];
+        } else {
+            LOG_F(ERROR, "Failed to read spilled mosaic tile %s, starting it over",
+                  path.c_str());
+        }
+        tile.spilled = false;
+        this->tiles_spilled--;
+    }
+    if (tile.color.empty()) {
+        tile.color = cv::Mat::zeros(ts, ts, CV_8UC3);
+        tile.weight = cv::Mat::zeros(ts, ts, CV_32FC1);
+    }
+    if (added) {
+        this->resident_bytes += residentBytes(tile);
+    }
+    touch(&tile.lru_entry, true, key, added);
+    return tile;
+}
+
+void IncrementalMosaic::readTile(int64_t key, const Tile& tile, cv::Mat& color,
+                                 cv::Mat& weight) const {
+    if (!tile.spilled) {
+        color = tile.color;
+        weight = tile.weight;
+        return;
+    }
+
+    std::filesystem::path path = this->params.spill_dir / ("tile_" + tileName(key) + ".bin");
+    auto mats = readSpill(path, 2);
+    if (!mats.has_value()) {
+        LOG_F(ERROR, "Failed to read spilled mosaic tile %s", path.c_str());
+        color.release();
+        weight.release();
+        return;
+    }
+    color = (*mats)[0];
+    weight = (*mats)[1];
+}
+
+void IncrementalMosaic::loadFeatures(int frame_id) {
+    Frame& frame = this->frames[frame_id];
+    frame.last_used = this->use_clock;
+    if (!frame.spilled) {
+        touch(&frame.lru_entry, false, frame_id, false);
+        return;
+    }
+    frame.spilled = false;
+    touch(&frame.lru_entry, false, frame_id, true);
+
+    std::filesystem::path path =
+        this->params.spill_dir / ("frame_" + std::to_string(frame_id) + ".bin");
+    auto mats = readSpill(path, 2);
+    if (!mats.has_value()) {
+        // Not worth failing over, the frame just can't be matched against anymore
+        LOG_F(ERROR, "Failed to read spilled mosaic features %s", path.c_str());
+        return;
+    }
+    const cv::Mat& points = (*mats)[0];
+    if (!points.empty()) {
+        const cv::Point2f* begin = points.ptr<cv::Point2f>();
+        frame.keypoints.assign(begin, begin + points.total());
+    }
+    frame.descriptors = (*mats)[1];
+    this->resident_bytes += residentBytes(frame);
+}
+
+std::size_t IncrementalMosaic::residentBytes(const Tile& tile) {
+    return matBytes(tile.color) + matBytes(tile.weight);
+}
+
+std::size_t IncrementalMosaic::residentBytes(const Frame& frame) {
+    return frame.keypoints.size() * sizeof(cv::Point2f) + matBytes(frame.descriptors);
+}
+
+void IncrementalMosaic::touch(std::list<Resident>::iterator* entry, bool is_tile, int64_t id,
+                              bool added) {
+    if (added) {
+        this->lru.push_front(Resident{is_tile, id});
+        *entry = this->lru.begin();
+    } else {
+        this->lru.splice(this->lru.begin(), this->lru, *entry);
+    }
+}
+
+void IncrementalMosaic::enforceBudget() {
+    if (this->params.memory_budget_bytes == 0 ||
+        this->resident_bytes <= this->params.memory_budget_bytes) {
+        return;
+    }
+
+    std::filesystem::create_directories(this->params.spill_dir);
+    this->has_spilled = true;
+
+    // Least recently used first. Anything used by the frame that was just
+    // added is at the front and stays in memory.
+    std::size_t num_spilled = 0;
+    auto entry = this->lru.end();
+    while (this->resident_bytes > this->params.memory_budget_bytes &&
+           entry != this->lru.begin()) {
+        --entry;
+        if (entry->is_tile) {
+            Tile& tile = this->tiles[entry->id];
+            if (tile.last_used == this->use_clock) {
+                break;
+            }
+            std::filesystem::path path =
+                this->params.spill_dir / ("tile_" + tileName(entry->id) + ".bin");
+            if (!writeSpill(path, {tile.color, tile.weight})) {
+                LOG_F(ERROR, "Failed to spill mosaic tile to %s", path.c_str());
+                continue;
+            }
+            this->resident_bytes -= residentBytes(tile);
+            tile.color.release();
+            tile.weight.release();
+            tile.spilled = true;
+            this->tiles_spilled++;
+        } else {
+            Frame& frame = this->frames[entry->id];
+            if (frame.last_used == this->use_clock) {
+                break;
+            }
+            std::filesystem::path path =
+                this->params.spill_dir / ("frame_" + std::to_string(entry->id) + ".bin");
+            if (!writeSpill(path, {cv::Mat(frame.keypoints), frame.descriptors})) {
+                LOG_F(ERROR, "Failed to spill mosaic features to %s", path.c_str());
+                continue;
+            }
+            this->resident_bytes -= residentBytes(frame);
+            frame.keypoints = std::vector<cv::Point2f>();
+            frame.descriptors.release();
+            frame.spilled = true;
+        }
+        entry = this->lru.erase(entry);
+        num_spilled++;
+    }
+    VLOG_F(DEBUG, "Spilled %zu mosaic tiles / features, %zu bytes still in memory",
+           num_spilled, this->resident_bytes);
+}
+
+void IncrementalMosaic::clearSpill() {
+    if (!this->has_spilled) {
+        return;
+    }
+    std::error_code err;
+    std::filesystem::remove_all(this->params.spill_dir, err);
+    if (err) {
+        LOG_F(WARNING, "Failed to clear mosaic spill directory %s: %s",
+              this->params.spill_dir.c_str(), err.message().c_str());
+    }
+    this->has_spilled = false;
+}
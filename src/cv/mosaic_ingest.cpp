@@ -0,0 +1,171 @@
+#include "cv/mosaic_ingest.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include <opencv2/imgproc.hpp>
+
+#include "cv/preprocess.hpp"
+#include "utilities/constants.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+MosaicIngest::MosaicIngest(const MosaicParams& params, int max_dim, bool preprocess,
+                           std::size_t max_queue_size, std::filesystem::path tile_dir,
+                           std::shared_ptr<TilePyramid> pyramid)
+    : max_dim(max_dim),
+      preprocess(preprocess),
+      max_queue_size(max_queue_size),
+      tile_dir(std::move(tile_dir)),
+      pyramid(std::move(pyramid)),
+      stop(false),
+      busy(false),
+      num_dropped(0),
+      mosaic(params),
+      frames_since_save(0) {
+    this->worker = std::thread(&MosaicIngest::ingestLoop, this);
+}
+
+MosaicIngest::~MosaicIngest() {
+    {
+        Lock lock(this->mut);
+        this->stop = true;
+    }
+    this->queue_cv.notify_all();
+    if (this->worker.joinable()) {
+        this->worker.join();
+    }
+}
+
+bool MosaicIngest::push(const ImageData& image) {
+    if (image.DATA.empty() || !image.TELEMETRY.has_value()) {
+        return false;
+    }
+
+    // Shrink it here so the queue never holds on to the caller's full size buffer
+    cv::Mat frame = image.DATA;
+    if (this->preprocess) {
+        frame = Preprocess().cropRightView(frame);
+    }
+    int largest_side = std::max(frame.rows, frame.cols);
+    if (largest_side > this->max_dim) {
+        double scale = static_cast<double>(this->max_dim) / largest_side;
+        cv::Mat resized;
+        cv::resize(frame, resized, cv::Size(), scale, scale, cv::INTER_AREA);
+        frame = resized;
+    } else {
+        frame = frame.clone();
+    }
+
+    {
+        // Checked and pushed under one lock so concurrent pushers can't overfill it
+        Lock lock(this->mut);
+        if (this->queue.size() >= this->max_queue_size) {
+            std::size_t dropped = this->num_dropped.fetch_add(1) + 1;
+            LOG_F(WARNING, "Mosaic ingest queue full, dropping frame (%zu dropped)", dropped);
+            return false;
+        }
+        this->queue.push_back(Frame{std::move(frame), image.TELEMETRY.value()});
+    }
+    this->queue_cv.notify_one();
+    return true;
+}
+
+void MosaicIngest::flush() {
+    Lock lock(this->mut);
+    this->idle_cv.wait(lock, [this]() { return this->queue.empty() && !this->busy; });
+}
+
+cv::Mat MosaicIngest::render(int max_dim) {
+    Lock lock(this->mosaic_mut);
+    return this->mosaic.render(max_dim);
+}
+
+MosaicStats MosaicIngest::getStats() {
+    Lock lock(this->mosaic_mut);
+    return this->mosaic.getStats();
+}
+
+std::size_t MosaicIngest::numDropped() const { return this->num_dropped.load(); }
+
+std::shared_ptr<TilePyramid> MosaicIngest::getPyramid() const { return this->pyramid; }
+
+void MosaicIngest::reset() {
+    {
+        Lock lock(this->mut);
+        this->queue.clear();
+    }
+    this->flush();
+
+    Lock lock(this->mosaic_mut);
+    this->mosaic.reset();
+    this->frames_since_save = 0;
+    if (this->pyramid) {
+        this->pyramid->clear();
+    }
+}
+
+void MosaicIngest::ingestLoop() {
+    loguru::set_thread_name("mosaic ingest");
+
+    while (true) {
+        Frame frame;
+        {
+            Lock lock(this->mut);
+            if (this->queue.empty() && this->busy) {
+                // Queue ran dry, good time to get the map onto disk
+                lock.unlock();
+                {
+                    Lock mosaic_lock(this->mosaic_mut);
+                    this->saveTiles();
+                }
+                lock.lock();
+                if (this->queue.empty()) {
+                    this->busy = false;
+                    this->idle_cv.notify_all();
+                }
+            }
+
+            this->queue_cv.wait(lock, [this]() { return this->stop || !this->queue.empty(); });
+            if (this->queue.empty()) {
+                // stopped and everything has been added
+                return;
+            }
+
+            frame = std::move(this->queue.front());
+            this->queue.pop_front();
+            this->busy = true;
+        }
+
+        Lock mosaic_lock(this->mosaic_mut);
+        this->mosaic.addFrame(frame.image, frame.telemetry);
+        if (++this->frames_since_save >= MOSAIC_TILE_SAVE_INTERVAL) {
+            this->saveTiles();
+        }
+    }
+}
+
+void MosaicIngest::saveTiles() {
+    if (this->frames_since_save == 0) {
+        return;
+    }
+    this->frames_since_save = 0;
+
+    if (!this->tile_dir.empty()) {
+        try {
+            std::size_t num_saved = this->mosaic.saveDirtyTiles(this->tile_dir);
+            VLOG_F(DEBUG, "Saved %zu mosaic tiles to %s", num_saved, this->tile_dir.c_str());
+        } catch (const std::exception& e) {
+            LOG_F(ERROR, "Failed to save mosaic tiles to %s: %s", this->tile_dir.c_str(),
+                  e.what());
+        }
+    }
+
+    if (this->pyramid) {
+        try {
+            this->pyramid->update(this->mosaic, this->mosaic.takeChangedRegions());
+        } catch (const std::exception& e) {
+            LOG_F(ERROR, "Failed to update map tile pyramid: %s", e.what());
+        }
+    }
+}
@@ -1,14 +1,27 @@
 #include "cv/pipeline.hpp"
 
 #include <atomic>
+#include <chrono>
+#include <utility>
 
+#include "cv/tiling.hpp"
 #include "protos/obc.pb.h"
+#include "utilities/constants.hpp"
 #include "utilities/logging.hpp"
 
 // Pipeline constructor: initialize YOLO detector and the preprocess flag.
 Pipeline::Pipeline(const PipelineParams& p)
     : outputPath(p.outputPath),
-      do_preprocess(p.do_preprocess) {
+      do_preprocess(p.do_preprocess),
+      tiling(p.tiling),
+      searchBoundary(p.searchBoundary),
+      roiGateCounters(std::make_unique<RoiGateCounters>()),
+      stageCounters(std::make_unique<StageCounters>()) {
+    if (!this->outputPath.empty()) {
+        this->imageSink = std::make_unique<ImageSink>(IMAGE_SINK_QUEUE_SIZE,
+                                                      IMAGE_SINK_FSYNC_BATCH);
+    }
+
     if (p.yoloModelPath.has_value() && !p.yoloModelPath->empty()) {
         yoloDetector = std::make_unique<YOLO>(
             *p.yoloModelPath, p.detection_threshold, p.inputWidth, p.inputHeight);
@@ -21,54 +34,203 @@ Pipeline::Pipeline(const PipelineParams& p)
     }
 }
 
-PipelineResults Pipeline::run(const ImageData& imageData) {
+std::vector<Detection> Pipeline::detect(const cv::Mat& image) {
+    if (!this->tiling.enabled) {
+        return this->yoloDetector->detect(image);
+    }
+
+    std::vector<cv::Rect> tiles = makeTiles(image.size(), tiling.tileSize, tiling.overlap);
+
+    // The whole frame goes in the same batch as the tiles so targets too big
+    // to fit in a single tile are still picked up.
+    std::vector<cv::Mat> batch;
+    batch.reserve(tiles.size() + 1);
+    batch.push_back(image);
+    for (const cv::Rect& tile : tiles) {
+        batch.push_back(image(tile));
+    }
+
+    std::vector<std::vector<Detection>> batchResults = this->yoloDetector->detectBatch(batch);
+
+    std::vector<Detection> detections = std::move(batchResults[0]);
+    for (size_t i = 0; i < tiles.size(); i++) {
+        offsetDetections(batchResults[i + 1], tiles[i].tl());
+        detections.insert(detections.end(), batchResults[i + 1].begin(),
+                          batchResults[i + 1].end());
+    }
+
+    std::vector<Detection> merged = mergeTileDetections(std::move(detections),
+                                                        tiling.mergeThreshold);
+    VLOG_F(DEBUG, "Tiled inference over %zu tiles found %zu targets", tiles.size(),
+           merged.size());
+    return merged;
+}
+
+std::optional<cv::Rect> Pipeline::searchRegion(const ImageTelemetry& telemetry,
+                                               const cv::Size& imageSize) {
+    // Extra pixels kept around the boundary to absorb telemetry/camera model error
+    const int margin_px = 64;
+
+    std::vector<cv::Point2f> boundary =
+        this->gsdLocalizer.projectToImage(telemetry, this->searchBoundary);
+    if (boundary.size() < 3) {
+        // Can't tell, so don't throw the frame away
+        return cv::Rect(cv::Point(0, 0), imageSize);
+    }
+
+    const cv::Rect frame(cv::Point(0, 0), imageSize);
+    cv::Rect bounds;
+    if (cv::isContourConvex(boundary)) {
+        std::vector<cv::Point2f> corners = {
+            cv::Point2f(0, 0), cv::Point2f(imageSize.width, 0),
+            cv::Point2f(imageSize.width, imageSize.height), cv::Point2f(0, imageSize.height)};
+        std::vector<cv::Point2f> overlap;
+        if (cv::intersectConvexConvex(boundary, corners, overlap) <= 0.0f) {
+            return {};
+        }
+        bounds = cv::boundingRect(overlap);
+    } else {
+        // Bounding box of a concave boundary can overlap the frame when the
+        // boundary itself doesn't, which just means we search a bit extra
+        bounds = cv::boundingRect(boundary) & frame;
+    }
+    if (bounds.empty()) {
+        return {};
+    }
+
+    bounds.x -= margin_px;
+    bounds.y -= margin_px;
+    bounds.width += 2 * margin_px;
+    bounds.height += 2 * margin_px;
+    return bounds & frame;
+}
+
+RoiGateStats Pipeline::getRoiGateStats() const {
+    return RoiGateStats{
+        .frames_gated = this->roiGateCounters->frames_gated.load(),
+        .frames_skipped = this->roiGateCounters->frames_skipped.load(),
+        .pixels_skipped = this->roiGateCounters->pixels_skipped.load(),
+    };
+}
+
+PipelineStageStats Pipeline::getStageStats() const {
+    return PipelineStageStats{
+        .preprocess = this->stageCounters->preprocess.get(),
+        .roi_gate = this->stageCounters->roi_gate.get(),
+        .detect = this->stageCounters->detect.get(),
+        .localize = this->stageCounters->localize.get(),
+        .annotate = this->stageCounters->annotate.get(),
+    };
+}
+
+void Pipeline::StageCounter::record(std::chrono::steady_clock::time_point start) {
+    const uint64_t elapsed_us = std::chrono::duration_cast<std::chrono::microseconds>(
+                                    std::chrono::steady_clock::now() - start)
+                                    .count();
+    this->count.fetch_add(1, std::memory_order_relaxed);
+    this->total_us.fetch_add(elapsed_us, std::memory_order_relaxed);
+
+    uint64_t max_us = this->max_us.load(std::memory_order_relaxed);
+    while (elapsed_us > max_us &&
+           !this->max_us.compare_exchange_weak(max_us, elapsed_us, std::memory_order_relaxed)) {
+    }
+}
+
+PipelineStageStats::Stage Pipeline::StageCounter::get() const {
+    return PipelineStageStats::Stage{
+        .count = this->count.load(),
+        .total = std::chrono::microseconds(this->total_us.load()),
+        .max = std::chrono::microseconds(this->max_us.load()),
+    };
+}
+
+void Pipeline::saveOutput(const cv::Mat& image) {
+    if (!this->imageSink) {
+        return;
+    }
+
+    // Number the files so concurrent runs don't overwrite each other
+    static std::atomic<int> file_counter{0};
+    this->imageSink->write(numberedOutputPath(this->outputPath, file_counter.fetch_add(1)), image);
+}
+
+PipelineResults Pipeline::run(ImageData imageData) {
     LOG_F(INFO, "Running pipeline on an image");
 
-    // Preprocess the image if enabled; otherwise, use the original.
+    // Preprocess the image if enabled; otherwise, use the original. We own the
+    // frame, so the crop is a view into the same buffer rather than a copy.
+    auto stage_start = std::chrono::steady_clock::now();
     cv::Mat processedImage = imageData.DATA;
     if (do_preprocess) {
-        processedImage = preprocessor.cropRight(imageData.DATA);
+        processedImage = preprocessor.cropRightView(imageData.DATA);
     }
+    this->stageCounters->preprocess.record(stage_start);
+
+    // 0) ROI GATING: only look at the part of the frame over the search area
+    cv::Rect roi(cv::Point(0, 0), processedImage.size());
+    if (!this->searchBoundary.empty() && imageData.TELEMETRY.has_value()) {
+        stage_start = std::chrono::steady_clock::now();
+        std::optional<cv::Rect> searchRoi =
+            this->searchRegion(imageData.TELEMETRY.value(), processedImage.size());
+        this->roiGateCounters->frames_gated.fetch_add(1);
+        this->stageCounters->roi_gate.record(stage_start);
+
+        if (!searchRoi.has_value()) {
+            this->roiGateCounters->frames_skipped.fetch_add(1);
+            uint64_t pixels_skipped = this->roiGateCounters->pixels_skipped.fetch_add(roi.area());
+            LOG_F(INFO, "Frame does not overlap search boundary, skipping (%lu px skipped so far)",
+                  pixels_skipped + roi.area());
 
-    // 1) YOLO DETECTION using the (possibly preprocessed) image
-    std::vector<Detection> yoloResults = this->yoloDetector->detect(processedImage);
+            imageData.DATA = std::move(processedImage);
+            imageData.YUV.reset();
+            return PipelineResults(std::move(imageData), {});
+        }
+
+        this->roiGateCounters->pixels_skipped.fetch_add(roi.area() - searchRoi->area());
+        roi = searchRoi.value();
+    }
+
+    // 1) YOLO DETECTION using the (possibly preprocessed) image. Straight from
+    // the camera's YUV planes when we have them, which skips converting the
+    // region to RGB and letterboxing it as separate passes.
+    stage_start = std::chrono::steady_clock::now();
+    std::vector<Detection> yoloResults;
+    if (imageData.YUV.has_value() && imageData.YUV->size() == imageData.DATA.size() &&
+        !this->tiling.enabled && this->yoloDetector) {
+        // Where processedImage (and so roi) sits in the full frame
+        cv::Size wholeSize;
+        cv::Point frameOffset;
+        processedImage.locateROI(wholeSize, frameOffset);
+
+        cv::Point origin;
+        YUVImage region = imageData.YUV->crop(roi + frameOffset, &origin);
+        yoloResults = this->yoloDetector->detect(region);
+        offsetDetections(yoloResults, origin - frameOffset);
+    } else {
+        yoloResults = this->detect(processedImage(roi));
+        offsetDetections(yoloResults, roi.tl());
+    }
+    // Nothing past detection needs the planes, so hand the buffer back to the camera
+    imageData.YUV.reset();
+    this->stageCounters->detect.record(stage_start);
 
     // If YOLO finds no potential targets, we can return early (still saving out the final image).
     if (yoloResults.empty()) {
         LOG_F(INFO, "No YOLO detections, terminating...");
 
-        if (!outputPath.empty()) {
-            static std::atomic<int> file_counter{0};
-            int i = file_counter.fetch_add(1);
-
-            // Build a unique filename
-            std::string uniqueOutputPath;
-            size_t dotPos = outputPath.find_last_of('.');
-            size_t sepPos = outputPath.find_last_of("/\\");
-            if (dotPos != std::string::npos && (sepPos == std::string::npos || dotPos > sepPos)) {
-                uniqueOutputPath = outputPath.substr(0, dotPos) + "_" + std::to_string(i) +
-                                   outputPath.substr(dotPos);
-            } else {
-                uniqueOutputPath = outputPath + "_" + std::to_string(i) + ".jpg";
-            }
-
-            if (!cv::imwrite(uniqueOutputPath, processedImage)) {
-                LOG_F(ERROR, "Failed to write image to %s", uniqueOutputPath.c_str());
-            } else {
-                LOG_F(INFO, "Output image saved to %s", uniqueOutputPath.c_str());
-            }
-        }
+        stage_start = std::chrono::steady_clock::now();
+        this->saveOutput(processedImage);
+        this->stageCounters->annotate.record(stage_start);
 
         // Return the processed image (with no detections)
-        ImageData processedData = imageData;
-        processedData.DATA = processedImage;
-        return PipelineResults(processedData, {});
+        imageData.DATA = std::move(processedImage);
+        return PipelineResults(std::move(imageData), {});
     }
 
     // 2) BUILD DETECTED TARGETS & LOCALIZE
-    std::vector<DetectedTarget> detectedTargets;
-    detectedTargets.reserve(yoloResults.size());
-
+    stage_start = std::chrono::steady_clock::now();
+    std::vector<Bbox> boxes;
+    boxes.reserve(yoloResults.size());
     for (const auto& det : yoloResults) {
         // Fill bounding box
         Bbox box;
@@ -76,19 +238,33 @@ PipelineResults Pipeline::run(const ImageData& imageData) {
         box.y1 = static_cast<int>(det.y1);
         box.x2 = static_cast<int>(det.x2);
         box.y2 = static_cast<int>(det.y2);
+        boxes.push_back(box);
 
         // If you want to keep cropping code, you can call:
         // cv::Mat cropped = crop(processedImage, box);
+    }
+
+    // Localize every detection at once, the per image math only has to be done once
+    std::vector<double> latitudes(boxes.size());
+    std::vector<double> longitudes(boxes.size());
+    if (imageData.TELEMETRY.has_value()) {
+        this->gsdLocalizer.localize(imageData.TELEMETRY.value(), boxes, latitudes, longitudes);
+    }
+
+    std::vector<DetectedTarget> detectedTargets;
+    detectedTargets.reserve(yoloResults.size());
+    for (std::size_t i = 0; i < yoloResults.size(); i++) {
+        const auto& det = yoloResults[i];
 
-        // Localize
         GPSCoord targetPosition;
         if (imageData.TELEMETRY.has_value()) {
-            targetPosition = this->gsdLocalizer.localize(imageData.TELEMETRY.value(), box);
+            targetPosition.set_latitude(latitudes[i]);
+            targetPosition.set_longitude(longitudes[i]);
         }
 
         // Populate your DetectedTarget
         DetectedTarget detected;
-        detected.bbox = box;
+        detected.bbox = boxes[i];
         detected.coord = targetPosition;
         detected.likely_airdrop = static_cast<AirdropType>(det.class_id);
         detected.match_distance = (det.confidence > 0.f) ? (1.0 / det.confidence) : 9999.0;
@@ -96,42 +272,26 @@ PipelineResults Pipeline::run(const ImageData& imageData) {
         detectedTargets.push_back(detected);
     }
 
+    this->stageCounters->localize.record(stage_start);
+
     // 3) DRAW DETECTIONS ON THE IMAGE
     //    (this modifies processedImage in-place)
+    stage_start = std::chrono::steady_clock::now();
     if (this->yoloDetector) {
         this->yoloDetector->drawAndPrintDetections(processedImage, yoloResults);
     }
 
     // Save the annotated image if an output path is specified
-    if (!outputPath.empty()) {
-        static std::atomic<int> file_counter{0};
-        int i = file_counter.fetch_add(1);
-        std::string uniqueOutputPath;
-
-        size_t dotPos = outputPath.find_last_of('.');
-        size_t sepPos = outputPath.find_last_of("/\\");
-        if (dotPos != std::string::npos && (sepPos == std::string::npos || dotPos > sepPos)) {
-            uniqueOutputPath =
-                outputPath.substr(0, dotPos) + "_" + std::to_string(i) + outputPath.substr(dotPos);
-        } else {
-            uniqueOutputPath = outputPath + "_" + std::to_string(i) + ".jpg";
-        }
-
-        if (!cv::imwrite(uniqueOutputPath, processedImage)) {
-            LOG_F(ERROR, "Failed to write image to %s", uniqueOutputPath.c_str());
-        } else {
-            LOG_F(INFO, "Output image saved to %s", uniqueOutputPath.c_str());
-        }
-    }
+    this->saveOutput(processedImage);
+    this->stageCounters->annotate.record(stage_start);
 
     LOG_F(INFO, "Finished Pipeline on an image");
 
     // Wrap up the final annotated image to return
-    ImageData processedData = imageData;
-    processedData.DATA = processedImage;
+    imageData.DATA = std::move(processedImage);
 
     // Return a PipelineResults that includes:
     //  1) The final big image with bounding boxes drawn
     //  2) The bounding boxes + localized GPS coords
-    return PipelineResults(processedData, detectedTargets);
+    return PipelineResults(std::move(imageData), std::move(detectedTargets));
 }
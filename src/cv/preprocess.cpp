@@ -18,3 +18,11 @@ cv::Mat Preprocess::cropRight(const cv::Mat &image) const {
     cv::Mat croppedImage = image(roi).clone();
     return croppedImage;
 }
+
+cv::Mat Preprocess::cropRightView(const cv::Mat &image) const {
+    if (image.cols <= crop_pixels_) {
+        return image;
+    }
+
+    return image(cv::Rect(0, 0, image.cols - crop_pixels_, image.rows));
+}
@@ -0,0 +1,75 @@
+#include "cv/run_history.hpp"
+
+#include <google/protobuf/util/json_util.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "utilities/locks.hpp"
+
+RunHistory::RunHistory(std::size_t capacity)
+    : capacity(capacity), next_run_id(0), unsent_cursor(-1) {}
+
+int RunHistory::add(IdentifiedTarget target) {
+    Lock lock(this->mut);
+
+    // IDs are only handed out under the lock, so runs are always in ID order
+    // and a cursor never skips one that is added late
+    const int run_id = this->next_run_id++;
+    target.set_run_id(run_id);
+
+    auto run = std::make_shared<EncodedRun>();
+    run->run_id = run_id;
+    google::protobuf::util::MessageToJsonString(target, &run->json);
+    target.SerializeToString(&run->proto);
+
+    this->runs.push_back(std::move(run));
+    if (this->runs.size() > this->capacity) {
+        this->runs.pop_front();
+    }
+    return run_id;
+}
+
+RunPage RunHistory::since(int run_id, std::size_t limit) const {
+    Lock lock(this->mut);
+    return this->page(run_id, limit);
+}
+
+RunPage RunHistory::unsent(std::size_t limit) {
+    Lock lock(this->mut);
+    RunPage out = this->page(this->unsent_cursor, limit);
+    this->unsent_cursor = out.next_since;
+    return out;
+}
+
+std::size_t RunHistory::size() const {
+    Lock lock(this->mut);
+    return this->runs.size();
+}
+
+std::optional<int> RunHistory::newestRunId() const {
+    Lock lock(this->mut);
+    if (this->next_run_id == 0) {
+        return {};
+    }
+    return this->next_run_id - 1;
+}
+
+RunPage RunHistory::page(int run_id, std::size_t limit) const {
+    // A cursor from before the OBC restarted, start the GCS over from the beginning
+    if (run_id >= this->next_run_id) {
+        run_id = -1;
+    }
+    auto first = std::upper_bound(this->runs.begin(), this->runs.end(), run_id,
+                                  [](int id, const std::shared_ptr<const EncodedRun>& run) {
+                                      return id < run->run_id;
+                                  });
+    const std::size_t num_after = std::distance(first, this->runs.end());
+    const std::size_t count = std::min(num_after, limit);
+
+    RunPage out;
+    out.runs.assign(first, first + count);
+    out.next_since = count > 0 ? out.runs.back()->run_id : run_id;
+    out.more = num_after > count;
+    return out;
+}
@@ -0,0 +1,351 @@
+#include "cv/stitching.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include "opencv2/stitching/detail/blenders.hpp"
+#include "opencv2/stitching/detail/motion_estimators.hpp"
+#include "opencv2/stitching/detail/util.hpp"
+#include "opencv2/stitching/detail/warpers.hpp"
+#include "opencv2/stitching/warpers.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+namespace {
+// Same defaults cv::Stitcher uses
+const double REGISTRATION_RESOL_MP = 0.6;
+const float MATCH_CONF = 0.3f;
+const double PANO_CONF_THRESH = 1.0;
+
+double elapsedMs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+}  // namespace
+
+// -----------------------------------------------------------------------------
+// StitchTimings
+// -----------------------------------------------------------------------------
+StitchTimings& StitchTimings::operator+=(const StitchTimings& other) {
+    find_features_ms += other.find_features_ms;
+    matching_ms += other.matching_ms;
+    bundle_adjust_ms += other.bundle_adjust_ms;
+    warp_ms += other.warp_ms;
+    blend_ms += other.blend_ms;
+    return *this;
+}
+
+double StitchTimings::total_ms() const {
+    return find_features_ms + matching_ms + bundle_adjust_ms + warp_ms + blend_ms;
+}
+
+// -----------------------------------------------------------------------------
+// FeatureCache
+// -----------------------------------------------------------------------------
+std::optional<cv::detail::ImageFeatures> FeatureCache::get(const std::string& key) const {
+    Lock lock(mut);
+    auto it = features.find(key);
+    if (it == features.end()) {
+        num_misses++;
+        return {};
+    }
+    num_hits++;
+    return it->second;
+}
+
+void FeatureCache::put(const std::string& key, const cv::detail::ImageFeatures& image_features) {
+    Lock lock(mut);
+    features[key] = image_features;
+}
+
+std::size_t FeatureCache::size() const {
+    Lock lock(mut);
+    return features.size();
+}
+
+std::size_t FeatureCache::hits() const {
+    Lock lock(mut);
+    return num_hits;
+}
+
+std::size_t FeatureCache::misses() const {
+    Lock lock(mut);
+    return num_misses;
+}
+
+void FeatureCache::clear() {
+    Lock lock(mut);
+    features.clear();
+    num_hits = 0;
+    num_misses = 0;
+}
+
+// -----------------------------------------------------------------------------
+// findFeatures()
+// -----------------------------------------------------------------------------
+double registrationScale(const cv::Size& image_size) {
+    return std::min(1.0, std::sqrt(REGISTRATION_RESOL_MP * 1e6 / image_size.area()));
+}
+
+cv::detail::ImageFeatures findFeatures(const cv::Mat& image, const std::string& key,
+                                       double work_scale, FeatureCache* cache) {
+    // Features at one scale are useless at another, so the scale is part of the key
+    std::string scaled_key;
+    if (cache != nullptr && !key.empty()) {
+        scaled_key = key + "@" + std::to_string(work_scale);
+        std::optional<cv::detail::ImageFeatures> cached = cache->get(scaled_key);
+        if (cached.has_value()) {
+            return std::move(cached.value());
+        }
+    }
+
+    cv::Mat work_img;
+    cv::resize(image, work_img, cv::Size(), work_scale, work_scale, cv::INTER_LINEAR_EXACT);
+    cv::detail::ImageFeatures features;
+    cv::detail::computeImageFeatures(cv::ORB::create(), work_img, features);
+
+    if (!scaled_key.empty()) {
+        cache->put(scaled_key, features);
+    }
+    return features;
+}
+
+// -----------------------------------------------------------------------------
+// stitchImages()
+// -----------------------------------------------------------------------------
+StitchResult stitchImages(const std::vector<cv::Mat>& images, const std::vector<std::string>& keys,
+                          cv::Stitcher::Mode mode, FeatureCache* cache,
+                          const std::vector<cv::detail::CameraParams>& initial_cameras,
+                          const cv::Mat& match_mask) {
+    StitchResult result{cv::Stitcher::ERR_NEED_MORE_IMGS, cv::Mat(), {}, {}, {}};
+    const int num_images = static_cast<int>(images.size());
+    if (num_images < 2) {
+        return result;
+    }
+    const bool scans = (mode == cv::Stitcher::SCANS);
+
+    try {
+        // 1. Find features at registration scale, reusing cached ones where we can.
+        // Like cv::Stitcher, the scale comes from the first image.
+        auto start = std::chrono::steady_clock::now();
+        double work_scale = registrationScale(images[0].size());
+        std::vector<cv::detail::ImageFeatures> features(num_images);
+        for (int i = 0; i < num_images; i++) {
+            std::string key = (i < static_cast<int>(keys.size())) ? keys[i] : "";
+            features[i] = findFeatures(images[i], key, work_scale, cache);
+            features[i].img_idx = i;
+        }
+        result.timings.find_features_ms = elapsedMs(start);
+
+        // 2. Match features between image pairs
+        start = std::chrono::steady_clock::now();
+        cv::Ptr<cv::detail::FeaturesMatcher> matcher;
+        if (scans) {
+            matcher = cv::makePtr<cv::detail::AffineBestOf2NearestMatcher>(false, false,
+                                                                            MATCH_CONF);
+        } else {
+            matcher = cv::makePtr<cv::detail::BestOf2NearestMatcher>(false, MATCH_CONF);
+        }
+        std::vector<cv::detail::MatchesInfo> pairwise_matches;
+        (*matcher)(features, pairwise_matches,
+                   match_mask.empty() ? cv::UMat() : match_mask.getUMat(cv::ACCESS_READ));
+        matcher->collectGarbage();
+        result.timings.matching_ms = elapsedMs(start);
+
+        // Keep the biggest group of images that actually connect to each other
+        std::vector<int> indices = cv::detail::leaveBiggestComponent(features, pairwise_matches,
+                                                                     PANO_CONF_THRESH);
+        if (indices.size() < 2) {
+            return result;
+        }
+
+        // 3. Estimate cameras (unless we were given a starting point) and bundle adjust
+        start = std::chrono::steady_clock::now();
+        std::vector<cv::detail::CameraParams> cameras;
+        if (static_cast<int>(initial_cameras.size()) == num_images) {
+            for (int idx : indices) {
+                cameras.push_back(initial_cameras[idx]);
+            }
+        } else {
+            cv::Ptr<cv::detail::Estimator> estimator;
+            if (scans) {
+                estimator = cv::makePtr<cv::detail::AffineBasedEstimator>();
+            } else {
+                estimator = cv::makePtr<cv::detail::HomographyBasedEstimator>();
+            }
+            if (!(*estimator)(features, pairwise_matches, cameras)) {
+                result.status = cv::Stitcher::ERR_HOMOGRAPHY_EST_FAIL;
+                return result;
+            }
+        }
+        for (cv::detail::CameraParams& camera : cameras) {
+            cv::Mat R;
+            camera.R.convertTo(R, CV_32F);
+            camera.R = R;
+        }
+
+        cv::Ptr<cv::detail::BundleAdjusterBase> adjuster;
+        if (scans) {
+            adjuster = cv::makePtr<cv::detail::BundleAdjusterAffinePartial>();
+        } else {
+            adjuster = cv::makePtr<cv::detail::BundleAdjusterRay>();
+        }
+        adjuster->setConfThresh(PANO_CONF_THRESH);
+        if (!(*adjuster)(features, pairwise_matches, cameras)) {
+            result.status = cv::Stitcher::ERR_CAMERA_PARAMS_ADJUST_FAIL;
+            return result;
+        }
+
+        if (!scans) {
+            std::vector<cv::Mat> rmats;
+            for (const cv::detail::CameraParams& camera : cameras) {
+                rmats.push_back(camera.R.clone());
+            }
+            cv::detail::waveCorrect(rmats, cv::detail::WAVE_CORRECT_HORIZ);
+            for (std::size_t i = 0; i < cameras.size(); i++) {
+                cameras[i].R = rmats[i];
+            }
+        }
+        result.timings.bundle_adjust_ms = elapsedMs(start);
+
+        result.indices = indices;
+        result.cameras = cameras;
+
+        // 4/5. Warp each image at full size and feed it to the blender, one at a time
+        // so only one warped image is in memory at once
+        std::vector<double> focals;
+        for (const cv::detail::CameraParams& camera : cameras) {
+            focals.push_back(camera.focal);
+        }
+        std::sort(focals.begin(), focals.end());
+        double warped_image_scale = focals[focals.size() / 2];
+        if (focals.size() % 2 == 0) {
+            warped_image_scale = (focals[focals.size() / 2 - 1] + focals[focals.size() / 2]) / 2;
+        }
+
+        // Cameras were estimated at work scale, composite at the scale we were given
+        const double compose_work_aspect = 1.0 / work_scale;
+        cv::Ptr<cv::WarperCreator> warper_creator;
+        if (scans) {
+            warper_creator = cv::makePtr<cv::AffineWarper>();
+        } else {
+            warper_creator = cv::makePtr<cv::SphericalWarper>();
+        }
+        cv::Ptr<cv::detail::RotationWarper> warper =
+            warper_creator->create(static_cast<float>(warped_image_scale * compose_work_aspect));
+
+        std::vector<cv::Mat> Ks(cameras.size());
+        std::vector<cv::Point> corners(cameras.size());
+        std::vector<cv::Size> sizes(cameras.size());
+        for (std::size_t i = 0; i < cameras.size(); i++) {
+            cv::detail::CameraParams camera = cameras[i];
+            camera.focal *= compose_work_aspect;
+            camera.ppx *= compose_work_aspect;
+            camera.ppy *= compose_work_aspect;
+            camera.K().convertTo(Ks[i], CV_32F);
+
+            cv::Rect roi = warper->warpRoi(images[indices[i]].size(), Ks[i], cameras[i].R);
+            corners[i] = roi.tl();
+            sizes[i] = roi.size();
+        }
+
+        cv::Ptr<cv::detail::Blender> blender =
+            cv::detail::Blender::createDefault(cv::detail::Blender::MULTI_BAND, false);
+        float blend_width = std::sqrt(static_cast<float>(
+            cv::detail::resultRoi(corners, sizes).area())) * 5 / 100.f;
+        if (blend_width < 1.f) {
+            blender = cv::detail::Blender::createDefault(cv::detail::Blender::NO, false);
+        } else {
+            auto* multi_band = dynamic_cast<cv::detail::MultiBandBlender*>(blender.get());
+            multi_band->setNumBands(
+                static_cast<int>(std::ceil(std::log(blend_width) / std::log(2.)) - 1.));
+        }
+        blender->prepare(corners, sizes);
+
+        for (std::size_t i = 0; i < cameras.size(); i++) {
+            start = std::chrono::steady_clock::now();
+            const cv::Mat& img = images[indices[i]];
+            cv::Mat warped;
+            cv::Mat warped_mask;
+            corners[i] = warper->warp(img, Ks[i], cameras[i].R, cv::INTER_LINEAR,
+                                      cv::BORDER_REFLECT, warped);
+            cv::Mat mask(img.size(), CV_8U, cv::Scalar::all(255));
+            warper->warp(mask, Ks[i], cameras[i].R, cv::INTER_NEAREST, cv::BORDER_CONSTANT,
+                         warped_mask);
+            result.timings.warp_ms += elapsedMs(start);
+
+            start = std::chrono::steady_clock::now();
+            cv::Mat warped_s;
+            warped.convertTo(warped_s, CV_16S);
+            blender->feed(warped_s, warped_mask, corners[i]);
+            result.timings.blend_ms += elapsedMs(start);
+        }
+
+        start = std::chrono::steady_clock::now();
+        cv::Mat pano;
+        cv::Mat pano_mask;
+        blender->blend(pano, pano_mask);
+        pano.convertTo(result.pano, CV_8U);
+        result.timings.blend_ms += elapsedMs(start);
+    } catch (const cv::Exception& e) {
+        LOG_F(ERROR, "[stitchImages] OpenCV exception: %s", e.what());
+        result.status = cv::Stitcher::ERR_CAMERA_PARAMS_ADJUST_FAIL;
+        result.pano.release();
+        return result;
+    }
+
+    result.status = cv::Stitcher::OK;
+    return result;
+}
+
+// -----------------------------------------------------------------------------
+// chainChunkCameras()
+// -----------------------------------------------------------------------------
+std::optional<std::unordered_map<std::string, ChainedCamera>> chainChunkCameras(
+    const std::vector<ChunkCameras>& chunks) {
+    std::unordered_map<std::string, ChainedCamera> chained;
+
+    for (std::size_t c = 0; c < chunks.size(); c++) {
+        const ChunkCameras& chunk = chunks[c];
+        if (chunk.cameras.empty()) {
+            continue;
+        }
+
+        // Transform from this chunk's frame into the chained frame
+        cv::Mat to_chained = cv::Mat::eye(3, 3, CV_32F);
+        if (!chained.empty()) {
+            bool found_shared = false;
+            for (std::size_t i = 0; i < chunk.keys.size(); i++) {
+                auto shared = chained.find(chunk.keys[i]);
+                if (shared == chained.end()) {
+                    continue;
+                }
+                cv::Mat chained_R;
+                cv::Mat chunk_R;
+                shared->second.camera.R.convertTo(chained_R, CV_32F);
+                chunk.cameras[i].R.convertTo(chunk_R, CV_32F);
+                to_chained = chained_R * chunk_R.inv();
+                found_shared = true;
+                break;
+            }
+            if (!found_shared) {
+                return {};
+            }
+        }
+
+        for (std::size_t i = 0; i < chunk.keys.size(); i++) {
+            if (chained.count(chunk.keys[i]) != 0) {
+                continue;
+            }
+            ChainedCamera camera{chunk.cameras[i], static_cast<int>(c)};
+            cv::Mat chunk_R;
+            chunk.cameras[i].R.convertTo(chunk_R, CV_32F);
+            camera.camera.R = to_chained * chunk_R;
+            chained.emplace(chunk.keys[i], std::move(camera));
+        }
+    }
+
+    return chained;
+}
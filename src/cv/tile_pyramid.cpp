@@ -0,0 +1,273 @@
+#include "cv/tile_pyramid.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <set>
+#include <string>
+#include <utility>
+
+#include <nlohmann/json.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "utilities/constants.hpp"
+#include "utilities/logging.hpp"
+#include "utilities/parallel.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+// Deeper than this a tile is a few millimeters across
+const int MAX_ZOOM_LEVEL = 24;
+
+double worldSizePx(int zoom) { return TilePyramid::TILE_SIZE * std::pow(2.0, zoom); }
+}  // namespace
+
+TilePyramid::TilePyramid(fs::path directory, int min_zoom, int num_threads)
+    : directory(std::move(directory)), min_zoom(min_zoom), num_threads(num_threads) {}
+
+std::size_t TilePyramid::update(const IncrementalMosaic& mosaic,
+                                const std::vector<cv::Rect>& changed) {
+    if (changed.empty() || mosaic.bounds().empty()) {
+        return 0;
+    }
+    if (!this->max_zoom.has_value()) {
+        // Picked once per mosaic so the top level tiles never change size under the GCS
+        GPSCoord center = mosaic.toGPS({0, 0});
+        this->max_zoom = maxZoomFor(mosaic.getParams().meters_per_px, center.latitude());
+    }
+    const int top_zoom = this->max_zoom.value();
+    const int bottom_zoom = std::min(this->min_zoom, top_zoom);
+
+    // Top level tiles under the changed parts of the canvas
+    std::set<std::pair<int, int>> level;
+    for (const cv::Rect& rect : changed) {
+        double min_x = INFINITY, min_y = INFINITY, max_x = -INFINITY, max_y = -INFINITY;
+        for (const cv::Point2d corner : {cv::Point2d(rect.tl()), cv::Point2d(rect.br()),
+                                         cv::Point2d(rect.x + rect.width, rect.y),
+                                         cv::Point2d(rect.x, rect.y + rect.height)}) {
+            GPSCoord gps = mosaic.toGPS(corner);
+            cv::Point2d px = toPixel(gps.latitude(), gps.longitude(), top_zoom);
+            min_x = std::min(min_x, px.x);
+            min_y = std::min(min_y, px.y);
+            max_x = std::max(max_x, px.x);
+            max_y = std::max(max_y, px.y);
+        }
+        for (int y = static_cast<int>(std::floor(min_y / TILE_SIZE));
+             y <= static_cast<int>(std::floor(max_y / TILE_SIZE)); y++) {
+            for (int x = static_cast<int>(std::floor(min_x / TILE_SIZE));
+                 x <= static_cast<int>(std::floor(max_x / TILE_SIZE)); x++) {
+                level.emplace(x, y);
+            }
+        }
+    }
+
+    // Work down one level at a time, each level is made from the one above it
+    std::size_t num_written = 0;
+    for (int zoom = top_zoom; zoom >= bottom_zoom; zoom--) {
+        std::vector<std::pair<int, int>> tiles(level.begin(), level.end());
+        std::atomic<std::size_t> level_written{0};
+        parallelFor(tiles.size(), this->num_threads, [&](std::size_t i) {
+            auto [x, y] = tiles[i];
+            try {
+                bool written = (zoom == top_zoom) ? renderTile(mosaic, zoom, x, y)
+                                                  : mergeTile(zoom, x, y);
+                if (written) {
+                    level_written++;
+                }
+            } catch (const cv::Exception& e) {
+                LOG_F(ERROR, "Failed to make map tile %d/%d/%d: %s", zoom, x, y, e.what());
+            }
+        });
+        num_written += level_written.load();
+
+        std::set<std::pair<int, int>> parents;
+        for (const auto& [x, y] : level) {
+            parents.emplace(x / 2, y / 2);
+        }
+        level = std::move(parents);
+    }
+
+    writeMetadata(mosaic);
+    VLOG_F(DEBUG, "Updated %zu map tiles (zoom %d-%d)", num_written, bottom_zoom, top_zoom);
+    return num_written;
+}
+
+void TilePyramid::clear() {
+    std::error_code err;
+    fs::remove_all(this->directory, err);
+    if (err) {
+        LOG_F(ERROR, "Failed to clear map tiles in %s: %s", this->directory.c_str(),
+              err.message().c_str());
+    }
+    this->max_zoom.reset();
+}
+
+fs::path TilePyramid::tilePath(int zoom, int x, int y) const {
+    return this->directory / std::to_string(zoom) / std::to_string(x) /
+           (std::to_string(y) + ".png");
+}
+
+fs::path TilePyramid::metadataPath() const { return this->directory / "metadata.json"; }
+
+std::optional<int> TilePyramid::getMaxZoom() const { return this->max_zoom; }
+
+int TilePyramid::getMinZoom() const { return this->min_zoom; }
+
+int TilePyramid::maxZoomFor(double meters_per_px, double latitude_deg) {
+    // Ground distance across one pixel at zoom 0
+    double zoom0_m_per_px = 2 * M_PI * EARTH_RADIUS_METERS *
+                            std::cos(latitude_deg * M_PI / 180) / TILE_SIZE;
+    int zoom = static_cast<int>(std::floor(std::log2(zoom0_m_per_px / meters_per_px)));
+    return std::clamp(zoom, 0, MAX_ZOOM_LEVEL);
+}
+
+cv::Point2d TilePyramid::toPixel(double latitude_deg, double longitude_deg, int zoom) {
+    double world = worldSizePx(zoom);
+    double lat_rad = latitude_deg * M_PI / 180;
+    return {(longitude_deg + 180) / 360 * world,
+            (1 - std::asinh(std::tan(lat_rad)) / M_PI) / 2 * world};
+}
+
+GPSCoord TilePyramid::toGPS(const cv::Point2d& pixel, int zoom) {
+    double world = worldSizePx(zoom);
+    GPSCoord coord;
+    coord.set_latitude(std::atan(std::sinh(M_PI * (1 - 2 * pixel.y / world))) * 180 / M_PI);
+    coord.set_longitude(pixel.x / world * 360 - 180);
+    coord.set_altitude(0);
+    return coord;
+}
+
+bool TilePyramid::renderTile(const IncrementalMosaic& mosaic, int zoom, int x, int y) const {
+    auto corner = [&](double u, double v) {
+        GPSCoord gps = toGPS({x * TILE_SIZE + u, y * TILE_SIZE + v}, zoom);
+        return mosaic.toCanvas(gps.latitude(), gps.longitude());
+    };
+    cv::Point2d tl = corner(0, 0);
+    cv::Point2d tr = corner(TILE_SIZE, 0);
+    cv::Point2d bl = corner(0, TILE_SIZE);
+    cv::Point2d br = corner(TILE_SIZE, TILE_SIZE);
+
+    double min_x = std::min({tl.x, tr.x, bl.x, br.x});
+    double min_y = std::min({tl.y, tr.y, bl.y, br.y});
+    double max_x = std::max({tl.x, tr.x, bl.x, br.x});
+    double max_y = std::max({tl.y, tr.y, bl.y, br.y});
+    int left = static_cast<int>(std::floor(min_x)) - 1;
+    int top = static_cast<int>(std::floor(min_y)) - 1;
+    cv::Rect area(left, top, static_cast<int>(std::ceil(max_x)) + 1 - left,
+                  static_cast<int>(std::ceil(max_y)) + 1 - top);
+    area &= mosaic.bounds();
+    if (area.empty()) {
+        return false;
+    }
+
+    // Over one tile Web Mercator and the canvas only differ by scale and
+    // rotation, so an affine map from tile pixels to canvas pixels is exact enough
+    cv::Matx23d to_area((tr.x - tl.x) / TILE_SIZE, (bl.x - tl.x) / TILE_SIZE, tl.x - area.x,
+                        (tr.y - tl.y) / TILE_SIZE, (bl.y - tl.y) / TILE_SIZE, tl.y - area.y);
+    cv::Mat tile;
+    cv::warpAffine(mosaic.renderRegion(area), tile, to_area, cv::Size(TILE_SIZE, TILE_SIZE),
+                   cv::INTER_LINEAR | cv::WARP_INVERSE_MAP, cv::BORDER_CONSTANT,
+                   cv::Scalar::all(0));
+
+    cv::Mat alpha;
+    cv::extractChannel(tile, alpha, 3);
+    if (cv::countNonZero(alpha) == 0) {
+        return false;
+    }
+    return writeTile(zoom, x, y, tile);
+}
+
+bool TilePyramid::mergeTile(int zoom, int x, int y) const {
+    cv::Mat merged = cv::Mat::zeros(2 * TILE_SIZE, 2 * TILE_SIZE, CV_8UC4);
+    bool has_child = false;
+    for (int dy = 0; dy < 2; dy++) {
+        for (int dx = 0; dx < 2; dx++) {
+            fs::path child_path = tilePath(zoom + 1, 2 * x + dx, 2 * y + dy);
+            if (!fs::exists(child_path)) {
+                continue;
+            }
+            cv::Mat child = cv::imread(child_path.string(), cv::IMREAD_UNCHANGED);
+            if (child.size() != cv::Size(TILE_SIZE, TILE_SIZE) || child.type() != CV_8UC4) {
+                LOG_F(WARNING, "Skipping unreadable map tile %s", child_path.c_str());
+                continue;
+            }
+            child.copyTo(merged(cv::Rect(dx * TILE_SIZE, dy * TILE_SIZE, TILE_SIZE, TILE_SIZE)));
+            has_child = true;
+        }
+    }
+    if (!has_child) {
+        return false;
+    }
+
+    cv::Mat tile;
+    cv::resize(merged, tile, cv::Size(TILE_SIZE, TILE_SIZE), 0, 0, cv::INTER_AREA);
+    return writeTile(zoom, x, y, tile);
+}
+
+bool TilePyramid::writeTile(int zoom, int x, int y, const cv::Mat& tile) const {
+    std::vector<uchar> encoded;
+    if (!cv::imencode(".png", tile, encoded)) {
+        LOG_F(ERROR, "Failed to encode map tile %d/%d/%d", zoom, x, y);
+        return false;
+    }
+
+    fs::path path = tilePath(zoom, x, y);
+    fs::path tmp_path = path;
+    tmp_path += ".tmp";
+    std::error_code err;
+    fs::create_directories(path.parent_path(), err);
+    {
+        std::ofstream file(tmp_path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(encoded.data()),
+                   static_cast<std::streamsize>(encoded.size()));
+        if (!file) {
+            LOG_F(ERROR, "Failed to write map tile %s", tmp_path.c_str());
+            return false;
+        }
+    }
+    fs::rename(tmp_path, path, err);
+    if (err) {
+        LOG_F(ERROR, "Failed to move map tile into %s: %s", path.c_str(), err.message().c_str());
+        return false;
+    }
+    return true;
+}
+
+void TilePyramid::writeMetadata(const IncrementalMosaic& mosaic) const {
+    cv::Rect bounds = mosaic.bounds();
+    GPSCoord north_west = mosaic.toGPS(bounds.tl());
+    GPSCoord south_east = mosaic.toGPS(bounds.br());
+
+    nlohmann::json metadata = {
+        {"min_zoom", std::min(this->min_zoom, this->max_zoom.value())},
+        {"max_zoom", this->max_zoom.value()},
+        {"tile_size", TILE_SIZE},
+        {"bounds", {
+            {"north", north_west.latitude()},
+            {"west", north_west.longitude()},
+            {"south", south_east.latitude()},
+            {"east", south_east.longitude()},
+        }},
+    };
+
+    fs::path path = metadataPath();
+    fs::path tmp_path = path;
+    tmp_path += ".tmp";
+    {
+        std::ofstream file(tmp_path);
+        file << metadata.dump();
+        if (!file) {
+            LOG_F(ERROR, "Failed to write map metadata %s", tmp_path.c_str());
+            return;
+        }
+    }
+    std::error_code err;
+    fs::rename(tmp_path, path, err);
+    if (err) {
+        LOG_F(ERROR, "Failed to move map metadata into %s: %s", path.c_str(),
+              err.message().c_str());
+    }
+}
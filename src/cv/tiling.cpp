@@ -0,0 +1,88 @@
+#include "cv/tiling.hpp"
+
+#include <algorithm>
+
+namespace {
+// Start positions along one axis of length `length`
+std::vector<int> tileStarts(int length, int tileSize, int stride) {
+    if (length <= tileSize) {
+        return {0};
+    }
+
+    std::vector<int> starts;
+    for (int pos = 0; pos + tileSize < length; pos += stride) {
+        starts.push_back(pos);
+    }
+    // Snap the last tile to the far edge
+    starts.push_back(length - tileSize);
+    return starts;
+}
+
+float area(const Detection& d) {
+    return std::max(0.0f, d.x2 - d.x1) * std::max(0.0f, d.y2 - d.y1);
+}
+
+// Intersection over the smaller of the two boxes
+float computeIoS(const Detection& a, const Detection& b) {
+    const float interW = std::max(0.0f, std::min(a.x2, b.x2) - std::max(a.x1, b.x1));
+    const float interH = std::max(0.0f, std::min(a.y2, b.y2) - std::max(a.y1, b.y1));
+    const float smaller = std::min(area(a), area(b));
+    if (smaller <= 0.0f) return 0.0f;
+    return (interW * interH) / smaller;
+}
+}  // namespace
+
+std::vector<cv::Rect> makeTiles(const cv::Size& imageSize, int tileSize, float overlap) {
+    std::vector<cv::Rect> tiles;
+    if (imageSize.width <= 0 || imageSize.height <= 0 || tileSize <= 0) {
+        return tiles;
+    }
+
+    overlap = std::clamp(overlap, 0.0f, 0.95f);
+    const int stride = std::max(1, static_cast<int>(tileSize * (1.0f - overlap)));
+
+    for (int y : tileStarts(imageSize.height, tileSize, stride)) {
+        for (int x : tileStarts(imageSize.width, tileSize, stride)) {
+            tiles.emplace_back(x, y, std::min(tileSize, imageSize.width),
+                               std::min(tileSize, imageSize.height));
+        }
+    }
+
+    return tiles;
+}
+
+void offsetDetections(std::vector<Detection>& detections, const cv::Point& tileOrigin) {
+    for (Detection& det : detections) {
+        det.x1 += static_cast<float>(tileOrigin.x);
+        det.x2 += static_cast<float>(tileOrigin.x);
+        det.y1 += static_cast<float>(tileOrigin.y);
+        det.y2 += static_cast<float>(tileOrigin.y);
+    }
+}
+
+std::vector<Detection> mergeTileDetections(std::vector<Detection> detections,
+                                           float matchThreshold) {
+    std::sort(detections.begin(), detections.end(),
+              [](const Detection& a, const Detection& b) { return a.confidence > b.confidence; });
+
+    std::vector<Detection> kept;
+    std::vector<char> merged(detections.size(), 0);
+    for (size_t i = 0; i < detections.size(); ++i) {
+        if (merged[i]) continue;
+
+        Detection best = detections[i];
+        for (size_t j = i + 1; j < detections.size(); ++j) {
+            if (merged[j] || detections[j].class_id != best.class_id) continue;
+            if (computeIoS(best, detections[j]) > matchThreshold) {
+                best.x1 = std::min(best.x1, detections[j].x1);
+                best.y1 = std::min(best.y1, detections[j].y1);
+                best.x2 = std::max(best.x2, detections[j].x2);
+                best.y2 = std::max(best.y2, detections[j].y2);
+                merged[j] = 1;
+            }
+        }
+        kept.push_back(best);
+    }
+
+    return kept;
+}
@@ -33,3 +33,14 @@ std::optional<cv::Mat> compressImg(const cv::Mat& img, int quality) {
 
     return std::make_optional(decodedImg);
 }
+
+std::string numberedOutputPath(const std::string& path, int number) {
+    size_t dotPos = path.find_last_of('.');
+    size_t sepPos = path.find_last_of("/\\");  // supports both UNIX and Windows paths
+
+    // If a dot exists after the last separator, assume it's a file extension.
+    if (dotPos != std::string::npos && (sepPos == std::string::npos || dotPos > sepPos)) {
+        return path.substr(0, dotPos) + "_" + std::to_string(number) + path.substr(dotPos);
+    }
+    return path + "_" + std::to_string(number) + ".jpg";
+}
@@ -2,7 +2,12 @@
 
 #include <algorithm>
 #include <atomic>
+#include <future>
 #include <unordered_map>
+#include <utility>
+
+#include "cv/utilities.hpp"
+#include "utilities/logging.hpp"
 
 // For simplicity, we are not doing advanced error handling
 // Make sure to catch and handle exceptions in production code
@@ -115,6 +120,10 @@ YOLO::YOLO(const std::string& modelPath, float confThreshold, int inputWidth, in
         auto name = session_->GetOutputNameAllocated(i, allocator);  // function for output nodes
         outputNames_[i] = std::string(name.get());
     }
+
+    // A negative batch dimension means the model was exported with a dynamic batch size
+    auto inputShape = session_->GetInputTypeInfo(0).GetTensorTypeAndShapeInfo().GetShape();
+    dynamicBatch_ = !inputShape.empty() && inputShape[0] < 0;
 }
 
 YOLO::~YOLO() {
@@ -124,20 +133,27 @@ YOLO::~YOLO() {
     }
 }
 
-std::vector<float> YOLO::preprocess(const cv::Mat& image) {
+YOLO::LetterboxInfo YOLO::letterboxFor(const cv::Size& imageSize) const {
     // Compute letterbox scale
-    float r = std::min(static_cast<float>(inputWidth_) / static_cast<float>(image.cols),
-                       static_cast<float>(inputHeight_) / static_cast<float>(image.rows));
+    float r = std::min(static_cast<float>(inputWidth_) / static_cast<float>(imageSize.width),
+                       static_cast<float>(inputHeight_) / static_cast<float>(imageSize.height));
 
-    int unpadW = std::round(image.cols * r);
-    int unpadH = std::round(image.rows * r);
+    int unpadW = std::round(imageSize.width * r);
+    int unpadH = std::round(imageSize.height * r);
     int dw = inputWidth_ - unpadW;   // total horizontal padding
     int dh = inputHeight_ - unpadH;  // total vertical padding
 
-    // We'll store these so we can "un-letterbox" later:
-    scale_ = r;
-    padLeft_ = dw / 2;  // per-side left padding
-    padTop_ = dh / 2;   // per-side top padding
+    // We'll return these so we can "un-letterbox" later. Must match the
+    // per-side padding letterbox() applies.
+    LetterboxInfo lb;
+    lb.scale = r;
+    lb.padLeft = std::round(dw / 2.0f);
+    lb.padTop = std::round(dh / 2.0f);
+    return lb;
+}
+
+YOLO::LetterboxInfo YOLO::preprocess(const cv::Mat& image, float* dst) const {
+    LetterboxInfo lb = letterboxFor(image.size());
 
     // Then call letterbox(...). This returns a new image of size (inputWidth_ x inputHeight_),
     // but we know how it was scaled & padded:
@@ -150,35 +166,181 @@ std::vector<float> YOLO::preprocess(const cv::Mat& image) {
     // Convert to float [0..1]
     resized.convertTo(resized, CV_32F, 1.0f / 255.0f);  // Normalize pixel values to [0, 1]
 
-    // HWC -> CHW
-    std::vector<float> inputData(inputWidth_ * inputHeight_ * 3);
-    size_t index = 0;
-    for (int c = 0; c < 3; c++) {
-        for (int h = 0; h < inputHeight_; h++) {
-            for (int w = 0; w < inputWidth_; w++) {
-                inputData[index++] = resized.at<cv::Vec3f>(h, w)[c];
+    // HWC -> CHW: split straight into the three planes of dst
+    const size_t planeSize = static_cast<size_t>(inputWidth_) * inputHeight_;
+    std::vector<cv::Mat> planes = {
+        cv::Mat(inputHeight_, inputWidth_, CV_32F, dst),
+        cv::Mat(inputHeight_, inputWidth_, CV_32F, dst + planeSize),
+        cv::Mat(inputHeight_, inputWidth_, CV_32F, dst + 2 * planeSize)};
+    cv::split(resized, planes);
+
+    return lb;
+}
+
+YOLO::LetterboxInfo YOLO::preprocess(const YUVImage& image, float* dst) const {
+    const cv::Size size = image.size();
+    const LetterboxInfo lb = letterboxFor(size);
+    const int unpadW = std::round(size.width * lb.scale);
+    const int unpadH = std::round(size.height * lb.scale);
+
+    // Same sample positions as cv::resize's INTER_LINEAR: pixel centers line up
+    const float fx = static_cast<float>(size.width) / static_cast<float>(unpadW);
+    const float fy = static_cast<float>(size.height) / static_cast<float>(unpadH);
+
+    // Where to sample one axis of a plane of length len for output index i,
+    // as the two neighbouring indices and the weight of the second
+    struct Tap {
+        int i0;
+        int i1;
+        float w;
+    };
+    auto tap = [](float pos, int len) {
+        pos = std::clamp(pos, 0.f, static_cast<float>(len - 1));
+        int i0 = static_cast<int>(pos);
+        return Tap{i0, std::min(i0 + 1, len - 1), pos - static_cast<float>(i0)};
+    };
+
+    // Column taps are the same for every row, so work them out once
+    std::vector<Tap> lumaCols(unpadW);
+    std::vector<Tap> chromaCols(unpadW);
+    for (int x = 0; x < unpadW; ++x) {
+        float sx = (static_cast<float>(x) + 0.5f) * fx - 0.5f;
+        lumaCols[x] = tap(sx, size.width);
+        // chroma samples sit at the center of each 2x2 block of luma
+        chromaCols[x] = tap((sx + 0.5f) * 0.5f - 0.5f, image.u.cols);
+    }
+
+    const size_t planeSize = static_cast<size_t>(inputWidth_) * inputHeight_;
+    float* rPlane = dst;
+    float* gPlane = dst + planeSize;
+    float* bPlane = dst + 2 * planeSize;
+
+    // Note: 114 is the standard YOLO background padding color (grey)
+    const float pad = 114.f / 255.f;
+    std::fill(dst, dst + 3 * planeSize, pad);
+
+    auto sample = [](const cv::Mat& plane, const Tap& row, const Tap& col) {
+        const uint8_t* r0 = plane.ptr<uint8_t>(row.i0);
+        const uint8_t* r1 = plane.ptr<uint8_t>(row.i1);
+        float top = r0[col.i0] + (r0[col.i1] - r0[col.i0]) * col.w;
+        float bottom = r1[col.i0] + (r1[col.i1] - r1[col.i0]) * col.w;
+        return top + (bottom - top) * row.w;
+    };
+
+    cv::parallel_for_(cv::Range(0, unpadH), [&](const cv::Range& rows) {
+        for (int y = rows.start; y < rows.end; ++y) {
+            float sy = (static_cast<float>(y) + 0.5f) * fy - 0.5f;
+            Tap lumaRow = tap(sy, size.height);
+            Tap chromaRow = tap((sy + 0.5f) * 0.5f - 0.5f, image.u.rows);
+
+            size_t offset = static_cast<size_t>(y + lb.padTop) * inputWidth_ + lb.padLeft;
+            for (int x = 0; x < unpadW; ++x) {
+                // BT.601 studio swing, to match cv::COLOR_YUV2BGR_I420
+                float luma = 1.164f * (sample(image.y, lumaRow, lumaCols[x]) - 16.f);
+                float u = sample(image.u, chromaRow, chromaCols[x]) - 128.f;
+                float v = sample(image.v, chromaRow, chromaCols[x]) - 128.f;
+
+                float r = luma + 1.596f * v;
+                float g = luma - 0.391f * u - 0.813f * v;
+                float b = luma + 2.018f * u;
+
+                rPlane[offset + x] = std::clamp(r, 0.f, 255.f) / 255.f;
+                gPlane[offset + x] = std::clamp(g, 0.f, 255.f) / 255.f;
+                bPlane[offset + x] = std::clamp(b, 0.f, 255.f) / 255.f;
             }
         }
-    }
+    });
 
-    return inputData;
+    return lb;
 }
 
 std::vector<Detection> YOLO::detect(const cv::Mat& image) {
-    // Preprocess (letterbox to network size, store scale_ / padLeft_ / padTop_)
-    std::vector<float> inputTensorValues = preprocess(image);
+    return detectBatch({image}).front();
+}
+
+std::vector<Detection> YOLO::detect(const YUVImage& image) {
+    if (image.empty() || session_ == nullptr) {
+        return {};
+    }
+
+    const size_t imageTensorSize = static_cast<size_t>(3) * inputHeight_ * inputWidth_;
+    std::vector<float> inputTensorValues(imageTensorSize);
+    LetterboxInfo lb = preprocess(image, inputTensorValues.data());
+
+    const cv::Size size = image.size();
+    return infer(inputTensorValues.data(), 1, &lb, &size).front();
+}
+
+std::vector<std::vector<Detection>> YOLO::detectBatch(const std::vector<cv::Mat>& images) {
+    std::vector<std::vector<Detection>> results(images.size());
+    if (images.empty() || session_ == nullptr) {
+        return results;
+    }
+
+    // Preprocess (letterbox to network size) each image into its own slice of the batch
+    const size_t imageTensorSize = static_cast<size_t>(3) * inputHeight_ * inputWidth_;
+    std::vector<float> inputTensorValues(imageTensorSize * images.size());
+    std::vector<LetterboxInfo> letterboxes(images.size());
+
+    if (images.size() == 1) {
+        letterboxes[0] = preprocess(images[0], inputTensorValues.data());
+    } else {
+        std::vector<std::future<void>> jobs;
+        jobs.reserve(images.size());
+        for (size_t i = 0; i < images.size(); ++i) {
+            jobs.push_back(std::async(std::launch::async, [&, i]() {
+                letterboxes[i] =
+                    preprocess(images[i], inputTensorValues.data() + i * imageTensorSize);
+            }));
+        }
+        for (auto& job : jobs) {
+            job.get();
+        }
+    }
+
+    std::vector<cv::Size> imageSizes;
+    imageSizes.reserve(images.size());
+    for (const cv::Mat& image : images) {
+        imageSizes.push_back(image.size());
+    }
+
+    if (dynamicBatch_ || images.size() == 1) {
+        return infer(inputTensorValues.data(), images.size(), letterboxes.data(),
+                     imageSizes.data());
+    }
+
+    // Model only takes a batch of 1, so run each image separately. Ort::Session::Run
+    // is thread-safe so these can all go at once.
+    std::vector<std::future<std::vector<std::vector<Detection>>>> runs;
+    runs.reserve(images.size());
+    for (size_t i = 0; i < images.size(); ++i) {
+        runs.push_back(std::async(std::launch::async, [&, i]() {
+            return infer(inputTensorValues.data() + i * imageTensorSize, 1, &letterboxes[i],
+                         &imageSizes[i]);
+        }));
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+        results[i] = std::move(runs[i].get().front());
+    }
+    return results;
+}
+
+std::vector<std::vector<Detection>> YOLO::infer(float* input, size_t batchSize,
+                                                const LetterboxInfo* letterboxes,
+                                                const cv::Size* imageSizes) {
+    std::vector<std::vector<Detection>> results(batchSize);
 
     // Create input tensor object from data values
-    // 1 = batch size (we only process one image at a time)
+    // batchSize = number of images processed in this run
     // 3 = number of channels (RGB)
-    std::vector<int64_t> inputShape = {1, 3, static_cast<int64_t>(inputHeight_),
+    std::vector<int64_t> inputShape = {static_cast<int64_t>(batchSize), 3,
+                                       static_cast<int64_t>(inputHeight_),
                                        static_cast<int64_t>(inputWidth_)};
-    size_t inputTensorSize = static_cast<size_t>(1) * 3 * inputHeight_ * inputWidth_;
+    size_t inputTensorSize = batchSize * 3 * inputHeight_ * inputWidth_;
 
     Ort::MemoryInfo memoryInfo = Ort::MemoryInfo::CreateCpu(OrtArenaAllocator, OrtMemTypeDefault);
-    Ort::Value inputTensor =
-        Ort::Value::CreateTensor<float>(memoryInfo, inputTensorValues.data(), inputTensorSize,
-                                        inputShape.data(), inputShape.size());
+    Ort::Value inputTensor = Ort::Value::CreateTensor<float>(
+        memoryInfo, input, inputTensorSize, inputShape.data(), inputShape.size());
 
     // Convert std::vector<std::string> to std::vector<const char*>
     std::vector<const char*> inputNamesCStr;
@@ -200,183 +362,125 @@ std::vector<Detection> YOLO::detect(const cv::Mat& image) {
 
     if (outputTensors.empty()) {
         std::cerr << "No output tensors from ONNX session.\n";
-        return {};
+        return results;
     }
 
     Ort::Value& out = outputTensors[0];
     auto shapeInfo = out.GetTensorTypeAndShapeInfo();
     auto shape = shapeInfo.GetShape();
 
-    // Expected: [1, C, N] or [1, N, C]
+    // Expected: [B, C, N] or [B, N, C]
     if (shape.size() != 3) {
         std::cerr << "Unexpected output shape: ";
         for (auto d : shape) std::cerr << d << " ";
         std::cerr << std::endl;
-        return {};
+        return results;
     }
 
     int64_t b = shape[0];
     int64_t d1 = shape[1];
     int64_t d2 = shape[2];
 
-    if (b != 1) {
-        std::cerr << "Only batch size 1 is supported, got batch = " << b << "\n";
-        return {};
+    if (b != static_cast<int64_t>(batchSize)) {
+        std::cerr << "Expected output batch of " << batchSize << ", got batch = " << b << "\n";
+        return results;
     }
 
-    float* outputData = out.GetTensorMutableData<float>();
-    std::vector<Detection> detections;
-
-    // Helper lambdas for indexing and box/class extraction
-    auto process_anchor_layout_CxN = [&](int64_t numChannels, int64_t numAnchors) {
-        // Layout: [1, C, N], contiguous in row-major:
-        // index = (c * numAnchors) + n
-        for (int64_t a = 0; a < numAnchors; ++a) {
-            auto get = [&](int64_t c) -> float { return outputData[c * numAnchors + a]; };
-
-            float x = get(0);
-            float y = get(1);
-            float w = get(2);
-            float h = get(3);
-
-            // Find best class score and ID over channels 4..(numChannels-1)
-            // Channels 0, 1, 2, 3 correspond to x, y, w, h respectively.
-            // Class probabilities start at index 4.
-            int bestClass = -1;
-            float bestScore = 0.0f;
-            for (int64_t c = 4; c < numChannels; ++c) {
-                float s = get(c);
-                if (s > bestScore) {
-                    bestScore = s;
-                    bestClass = static_cast<int>(c - 4);  // class index offset
-                }
-            }
-
-            if (bestScore < confThreshold_ || bestClass < 0) {
-                continue;
-            }
-
-            // Convert [x, y, w, h] (center in letterboxed input space) -> [x1, y1, x2, y2]
-            float x1 = x - w * 0.5f;
-            float y1 = y - h * 0.5f;
-            float x2 = x + w * 0.5f;
-            float y2 = y + h * 0.5f;
-
-            // Remove letterbox padding
-            x1 -= static_cast<float>(padLeft_);
-            y1 -= static_cast<float>(padTop_);
-            x2 -= static_cast<float>(padLeft_);
-            y2 -= static_cast<float>(padTop_);
-
-            // Scale back to original image coordinates
-            if (scale_ > 0.0f) {
-                x1 /= scale_;
-                y1 /= scale_;
-                x2 /= scale_;
-                y2 /= scale_;
-            }
-
-            // Clamp to image boundaries
-            float imgW = static_cast<float>(image.cols);
-            float imgH = static_cast<float>(image.rows);
-
-            x1 = std::max(0.0f, std::min(x1, imgW - 1.0f));
-            y1 = std::max(0.0f, std::min(y1, imgH - 1.0f));
-            x2 = std::max(0.0f, std::min(x2, imgW - 1.0f));
-            y2 = std::max(0.0f, std::min(y2, imgH - 1.0f));
+    const float* outputData = out.GetTensorMutableData<float>();
+    for (size_t i = 0; i < batchSize; ++i) {
+        std::vector<Detection> detections = decode(outputData + i * d1 * d2, d1, d2,
+                                                   letterboxes[i], imageSizes[i]);
 
-            Detection det;
-            det.x1 = x1;
-            det.y1 = y1;
-            det.x2 = x2;
-            det.y2 = y2;
-            det.confidence = bestScore;
-            det.class_id = bestClass;
+        // Apply Non-Maximum Suppression per class
+        results[i] = nmsPerClass(detections, nmsThreshold_);
+    }
 
-            detections.push_back(det);
-        }
-    };
+    return results;
+}
 
-    auto process_anchor_layout_NxC = [&](int64_t numAnchors, int64_t numChannels) {
-        // Layout: [1, N, C], contiguous:
-        // for anchor a: row pointer = outputData + a * numChannels
-        for (int64_t a = 0; a < numAnchors; ++a) {
-            float* p = outputData + a * numChannels;
-
-            float x = p[0];
-            float y = p[1];
-            float w = p[2];
-            float h = p[3];
-
-            int bestClass = -1;
-            float bestScore = 0.0f;
-            // Channels 0-3 are box coordinates, so iterate starting from 4 for class scores
-            for (int64_t c = 4; c < numChannels; ++c) {
-                float s = p[c];
-                if (s > bestScore) {
-                    bestScore = s;
-                    bestClass = static_cast<int>(c - 4);
-                }
-            }
+std::vector<Detection> YOLO::decode(const float* output, int64_t d1, int64_t d2,
+                                    const LetterboxInfo& lb, const cv::Size& imageSize) const {
+    // Choose layout based on which dimension looks like "channels".
+    // [C, N]: index = (c * numAnchors) + n
+    // [N, C]: index = (n * numChannels) + c
+    const bool channelsFirst = d1 < d2;
+    const int64_t numChannels = channelsFirst ? d1 : d2;
+    const int64_t numAnchors = channelsFirst ? d2 : d1;
+    const int64_t channelStride = channelsFirst ? numAnchors : 1;
+    const int64_t anchorStride = channelsFirst ? 1 : numChannels;
 
-            if (bestScore < confThreshold_ || bestClass < 0) {
-                continue;
-            }
+    const float imgW = static_cast<float>(imageSize.width);
+    const float imgH = static_cast<float>(imageSize.height);
 
-            float x1 = x - w * 0.5f;
-            float y1 = y - h * 0.5f;
-            float x2 = x + w * 0.5f;
-            float y2 = y + h * 0.5f;
-
-            // Remove letterbox padding
-            x1 -= static_cast<float>(padLeft_);
-            y1 -= static_cast<float>(padTop_);
-            x2 -= static_cast<float>(padLeft_);
-            y2 -= static_cast<float>(padTop_);
-
-            // Scale back to original image size
-            if (scale_ > 0.0f) {
-                x1 /= scale_;
-                y1 /= scale_;
-                x2 /= scale_;
-                y2 /= scale_;
+    std::vector<Detection> detections;
+    for (int64_t a = 0; a < numAnchors; ++a) {
+        const float* p = output + a * anchorStride;
+        auto get = [&](int64_t c) -> float { return p[c * channelStride]; };
+
+        float x = get(0);
+        float y = get(1);
+        float w = get(2);
+        float h = get(3);
+
+        // Find best class score and ID over channels 4..(numChannels-1)
+        // Channels 0, 1, 2, 3 correspond to x, y, w, h respectively.
+        // Class probabilities start at index 4.
+        int bestClass = -1;
+        float bestScore = 0.0f;
+        for (int64_t c = 4; c < numChannels; ++c) {
+            float s = get(c);
+            if (s > bestScore) {
+                bestScore = s;
+                bestClass = static_cast<int>(c - 4);  // class index offset
             }
+        }
 
-            float imgW = static_cast<float>(image.cols);
-            float imgH = static_cast<float>(image.rows);
-
-            x1 = std::max(0.0f, std::min(x1, imgW - 1.0f));
-            y1 = std::max(0.0f, std::min(y1, imgH - 1.0f));
-            x2 = std::max(0.0f, std::min(x2, imgW - 1.0f));
-            y2 = std::max(0.0f, std::min(y2, imgH - 1.0f));
-
-            Detection det;
-            det.x1 = x1;
-            det.y1 = y1;
-            det.x2 = x2;
-            det.y2 = y2;
-            det.confidence = bestScore;
-            det.class_id = bestClass;
+        if (bestScore < confThreshold_ || bestClass < 0) {
+            continue;
+        }
 
-            detections.push_back(det);
+        // Convert [x, y, w, h] (center in letterboxed input space) -> [x1, y1, x2, y2]
+        float x1 = x - w * 0.5f;
+        float y1 = y - h * 0.5f;
+        float x2 = x + w * 0.5f;
+        float y2 = y + h * 0.5f;
+
+        // Remove letterbox padding
+        x1 -= static_cast<float>(lb.padLeft);
+        y1 -= static_cast<float>(lb.padTop);
+        x2 -= static_cast<float>(lb.padLeft);
+        y2 -= static_cast<float>(lb.padTop);
+
+        // Scale back to original image coordinates
+        if (lb.scale > 0.0f) {
+            x1 /= lb.scale;
+            y1 /= lb.scale;
+            x2 /= lb.scale;
+            y2 /= lb.scale;
         }
-    };
 
-    // Choose layout based on which dimension looks like "channels"
-    if (d1 < d2) {
-        // [1, C, N]
-        process_anchor_layout_CxN(d1, d2);
-    } else {
-        // [1, N, C]
-        process_anchor_layout_NxC(d1, d2);
+        // Clamp to image boundaries
+        x1 = std::max(0.0f, std::min(x1, imgW - 1.0f));
+        y1 = std::max(0.0f, std::min(y1, imgH - 1.0f));
+        x2 = std::max(0.0f, std::min(x2, imgW - 1.0f));
+        y2 = std::max(0.0f, std::min(y2, imgH - 1.0f));
+
+        Detection det;
+        det.x1 = x1;
+        det.y1 = y1;
+        det.x2 = x2;
+        det.y2 = y2;
+        det.confidence = bestScore;
+        det.class_id = bestClass;
+
+        detections.push_back(det);
     }
 
-    // Apply Non-Maximum Suppression per class
-    detections = nmsPerClass(detections, nmsThreshold_);
     return detections;
 }
 
-cv::Mat YOLO::letterbox(const cv::Mat& src, int newWidth, int newHeight, const cv::Scalar& color) {
+cv::Mat YOLO::letterbox(const cv::Mat& src, int newWidth, int newHeight,
+                        const cv::Scalar& color) const {
     float r = std::min(static_cast<float>(newWidth) / static_cast<float>(src.cols),
                        static_cast<float>(newHeight) / static_cast<float>(src.rows));
 
@@ -402,9 +506,8 @@ void YOLO::drawAndPrintDetections(cv::Mat& image, const std::vector<Detection>&
     // Iterate through each detection and draw
     for (const auto& det : detections) {
         // Print detection info
-        std::cout << "Detected class: " << det.class_id << " conf: " << det.confidence << " box: ["
-                  << det.x1 << ", " << det.y1 << ", " << det.x2 << ", " << det.y2 << "]"
-                  << std::endl;
+        LOG_F(INFO, "Detected class: %d conf: %f box: [%f, %f, %f, %f]", det.class_id,
+              det.confidence, det.x1, det.y1, det.x2, det.y2);
 
         // Draw the bounding box
         cv::rectangle(image, cv::Point(static_cast<int>(det.x1), static_cast<int>(det.y1)),
@@ -428,21 +531,7 @@ void YOLO::processAndSaveImage(const cv::Mat& image, const std::string& outputPa
 
     // Generate a unique filename using a static atomic counter.
     static std::atomic<int> file_counter{0};
-    int counter = file_counter.fetch_add(1);
-
-    std::string uniqueOutputPath;
-    // Find the position of the last dot and the last path separator
-    size_t dotPos = outputPath.find_last_of('.');
-    size_t sepPos = outputPath.find_last_of("/\\");  // supports both UNIX and Windows paths
-
-    // If a dot exists after the last separator, assume it's a file extension.
-    if (dotPos != std::string::npos && (sepPos == std::string::npos || dotPos > sepPos)) {
-        uniqueOutputPath = outputPath.substr(0, dotPos) + "_" + std::to_string(counter) +
-                           outputPath.substr(dotPos);
-    } else {
-        // No extension found; default to appending counter and .jpg extension.
-        uniqueOutputPath = outputPath + "_" + std::to_string(counter) + ".jpg";
-    }
+    std::string uniqueOutputPath = numberedOutputPath(outputPath, file_counter.fetch_add(1));
 
     if (!cv::imwrite(uniqueOutputPath, outputImage)) {
         std::cerr << "Failed to write output image to " << uniqueOutputPath << std::endl;
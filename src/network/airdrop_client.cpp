@@ -1,9 +1,12 @@
 #include "network/airdrop_client.hpp"
 
+#include <algorithm>
 #include <future>
+#include <thread>
 
 extern "C" {
 #include "network/airdrop_sockets.h"
+#include "network/packet_ring.h"
 #include "udp_squared/protocol.h"
 }
 #include "utilities/common.hpp"
@@ -12,8 +15,14 @@ extern "C" {
 
 using namespace std::chrono_literals;  // NOLINT
 
-AirdropClient::AirdropClient(ad_socket_t socket) {
-    this->socket = socket;
+AirdropClient::AirdropClient(ad_socket_t socket, AirdropLinkConfig config)
+    : config(config),
+      socket(socket),
+      recv_ring(packet_ring_create(AIRDROP_RECV_QUEUE_SIZE)),
+      stop_worker(false) {
+    if (this->recv_ring == nullptr) {
+        LOG_F(FATAL, "Could not allocate the airdrop receive queue");
+    }
     auto time = getUnixTime_ms();
     for (int curr_airdrop = UDP2_A; curr_airdrop <= UDP2_B; curr_airdrop++) {
         this->last_heartbeat[curr_airdrop - 1] = time;
@@ -22,72 +31,114 @@ AirdropClient::AirdropClient(ad_socket_t socket) {
 }
 
 AirdropClient::~AirdropClient() {
-    // Signal before killing the socket so when the worker gets kicked out of the socket
-    // it sees that it should stop.
-    this->stop_worker = true;
     LOG_F(INFO, "Attempting to destroy AirdropClient");
 
-    auto result = close_ad_socket(this->socket);
-    if (result.is_err) {
-        LOG_F(ERROR, "Error closing airdrop socket: %s", result.data.err);
-    }
-
     if (this->mode.has_value()) {
-        // the future was started so we should make sure it is stopped
+        // the future was started so we should make sure it is stopped. Waking
+        // it up rather than closing the socket under it means it exits cleanly
+        this->stop_worker = true;
+        auto result = wake_ad_socket(this->socket);
+        if (result.is_err) {
+            LOG_F(ERROR, "Error waking airdrop receive thread: %s", result.data.err);
+        }
         LOG_F(INFO, "Waiting on background receive thread to exit...");
         this->worker_future.get();
         LOG_F(INFO, "Background receive thread exited");
     }
+
+    auto result = close_ad_socket(this->socket);
+    if (result.is_err) {
+        LOG_F(ERROR, "Error closing airdrop socket: %s", result.data.err);
+    }
+
+    packet_ring_destroy(this->recv_ring);
 }
 
 void AirdropClient::_establishConnection() {
     LOG_F(INFO, "Attempting to establish connection with the payloads...");
+    set_send_thread();
+    set_recv_thread();
 
-    std::atomic_bool stop = false;
-    std::thread send_thread([this, &stop]() {
-        loguru::set_thread_name("airdrop reset spam");
-        while (true) {
+    // Keep asking the payloads to reset until one tells us its mode
+    auto next_reset = std::chrono::steady_clock::now();
+    while (!this->mode.has_value()) {
+        auto now = std::chrono::steady_clock::now();
+        if (now >= next_reset) {
             LOG_F(INFO, "Sending reset packets to all airdrops...");
+            Lock lock(this->send_mut);
             send_ad_packet(this->socket, makeResetPacket(UDP2_ALL));
-            std::this_thread::sleep_for(10s);
-            if (stop) {
-                return;
-            }
+            next_reset = now + 10s;
         }
-    });
 
-    while (true) {
-        auto packet = this->_receiveBlocking();
-        if (packet.header == SET_MODE) {
-            auto set_mode = reinterpret_cast<mode_packet_t*>(&packet);
-            this->mode = static_cast<drop_mode_t>(set_mode->mode);
-            stop = true;
-            break;
-        }
+        auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_reset - now);
+        for (const ad_recv_packet_t& received : this->_receiveBatch(wait)) {
+            const packet_t& packet = received.packet;
+            if (this->_parseHeartbeats(received)) {
+                continue;
+            }
+            if (packet.header == SET_MODE) {
+                // Any other payload's SET_MODE is covered by the ACK_MODE sent to all
+                if (!this->mode.has_value()) {
+                    auto set_mode = reinterpret_cast<const mode_packet_t*>(&packet);
+                    this->mode = static_cast<drop_mode_t>(set_mode->mode);
+                }
+                continue;
+            }
 
-        LOG_F(WARNING, "Non SET_MODE packet received in setup phase: %d %d", packet.header,
-              packet.id);
-    }
+            if (!this->mode.has_value()) {
+                LOG_F(WARNING, "Non SET_MODE packet received in setup phase: %d %d",
+                      packet.header, packet.id);
+                continue;
+            }
 
-    send_thread.join();
+            // Came in the same batch as the SET_MODE, so it's for the receive
+            // thread once it starts
+            if (!packet_ring_push(this->recv_ring, &packet)) {
+                LOG_F(WARNING, "Airdrop receive queue full, %lu packets dropped so far",
+                      packet_ring_dropped(this->recv_ring));
+            }
+        }
+    }
 
     LOG_F(INFO, "Payload connection established in %s mode",
           (this->mode == GUIDED) ? "Guided" : "Unguided");
 
-    send_ad_packet(this->socket, makeModePacket(ACK_MODE, UDP2_ALL, OBC_NULL, *this->mode));
+    {
+        Lock lock(this->send_mut);
+        send_ad_packet(this->socket, makeModePacket(ACK_MODE, UDP2_ALL, OBC_NULL, *this->mode));
+    }
 
     this->worker_future = std::async(std::launch::async, &AirdropClient::_receiveWorker, this);
 }
 
-bool AirdropClient::send(packet_t packet) {
-    set_send_thread();
+bool AirdropClient::send(packet_t packet, std::optional<uint8_t> ack_header) {
+    // set_send_thread makes a new locale, so only do it once per thread
+    thread_local bool send_thread_set = false;
+    if (!send_thread_set) {
+        set_send_thread();
+        send_thread_set = true;
+    }
 
-    for (int i = 0; i < 8; i++) {
-        auto res = send_ad_packet(this->socket, packet);
-        if (res.is_err) {
-            LOG_F(ERROR, "%s", res.data.err);
+    {
+        Lock lock(this->send_mut);
+        if (!this->_sendCopies(packet)) {
             return false;
         }
+
+        if (ack_header.has_value()) {
+            uint8_t airdrop, state;
+            parseID(packet.id, &airdrop, &state);
+            this->unacked.push_back(Unacked{
+                packet, ack_header.value(), airdrop, 0,
+                std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(this->config.retransmit_ms)});
+        }
+    }
+
+    if (ack_header.has_value()) {
+        // So the worker picks up the new retransmit deadline instead of
+        // sleeping through it
+        wake_ad_socket(this->socket);
     }
 
     // TODO: helper to go from packet -> str
@@ -95,15 +146,18 @@ bool AirdropClient::send(packet_t packet) {
     return true;
 }
 
+std::size_t AirdropClient::numUnacked() {
+    Lock lock(this->send_mut);
+    return this->unacked.size();
+}
+
 std::optional<packet_t> AirdropClient::receive() {
     Lock lock(this->recv_mut);
 
-    if (this->recv_queue.empty()) {
+    packet_t packet;
+    if (!packet_ring_pop(this->recv_ring, &packet)) {
         return {};
     }
-
-    auto packet = this->recv_queue.front();
-    this->recv_queue.pop();
     LOG_F(INFO, "Pulled packet from queue: %hhu %hhu", packet.header, packet.id);
     return packet;
 }
@@ -114,7 +168,7 @@ std::list<std::pair<AirdropType, std::chrono::milliseconds>> AirdropClient::getL
     auto time = getUnixTime_ms();
 
     for (int i = 0; i < this->last_heartbeat.size(); i++) {
-        auto time_since_last_heartbeat = time - this->last_heartbeat[i];
+        auto time_since_last_heartbeat = time - this->last_heartbeat[i].load();
         if (time_since_last_heartbeat >= threshold) {
             list.push_back({static_cast<AirdropType>(i + 1), time_since_last_heartbeat});
         }
@@ -125,78 +179,135 @@ std::list<std::pair<AirdropType, std::chrono::milliseconds>> AirdropClient::getL
 
 std::optional<drop_mode_t> AirdropClient::getMode() { return this->mode; }
 
-packet_t AirdropClient::_receiveBlocking() {
-    packet_t packet = {0};
-
-    while (true) {
-        VLOG_F(TRACE, "Airdrop worker waiting for airdrop packet...");
-        auto result = recv_ad_packet(this->socket, static_cast<void*>(&packet), sizeof(packet_t));
-        VLOG_F(TRACE, "Airdrop packet found...");
-        // block until packet found...
+std::vector<ad_recv_packet_t> AirdropClient::_receiveBatch(std::chrono::milliseconds timeout) {
+    std::array<ad_recv_packet_t, AIRDROP_RECV_BATCH> batch;
+    std::vector<ad_recv_packet_t> packets;
 
-        // in the destructor we close the socket. This will cause the worker thread
-        // to get kicked out of the recv call with an error. This is the only error
-        // that should cause this function to return an invalid packet.
+    VLOG_F(TRACE, "Airdrop worker waiting for airdrop packets...");
+    auto result = recv_ad_packets(this->socket, batch.data(), batch.size(),
+                                  std::max(timeout.count(), 0L));
 
-        if (this->stop_worker) {
-            return packet;  // dummy packet
-        }
+    // in the destructor we wake up the socket, which is the only way this
+    // should return without having timed out or read packets
+    if (this->stop_worker) {
+        return packets;
+    }
 
-        if (result.is_err) {
-            LOG_F(ERROR, "%s", result.data.err);
-            continue;
-        }
+    if (result.is_err) {
+        LOG_F(ERROR, "%s", result.data.err);
+        // don't spin on an error that won't go away
+        std::this_thread::sleep_for(10ms);
+        return packets;
+    }
 
-        // Should return the number of bytes read, which should be equal to the
-        // size of a packet. If this happens, we probably just read in some
-        // garbage data that shouldn't have been read by this program.
-        if (result.data.res != sizeof(packet_t)) {
+    for (int i = 0; i < result.data.res; i++) {
+        // Should be the size of a packet. If it isn't, we probably just read in
+        // some garbage data that shouldn't have been read by this program.
+        if (batch[i].len != sizeof(packet_t)) {
             LOG_F(ERROR, "recv read %d bytes, when a packet should be %lu. Ignoring...",
-                  result.data.res, sizeof(packet_t));
+                  batch[i].len, sizeof(packet_t));
             continue;
         }
 
         // TODO: helper to go from packet -> str
         uint8_t airdrop, state;
-        parseID(packet.id, &airdrop, &state);
-        VLOG_F(TRACE, "received airdrop packet: %hhu %hhu %hhu", packet.header, airdrop, state);
+        parseID(batch[i].packet.id, &airdrop, &state);
+        VLOG_F(TRACE, "received airdrop packet: %hhu %hhu %hhu", batch[i].packet.header,
+               airdrop, state);
+        packets.push_back(batch[i]);
+    }
+    return packets;
+}
+
+bool AirdropClient::_sendCopies(const packet_t& packet) {
+    for (int i = 0; i < std::max(this->config.redundancy, 1); i++) {
+        auto res = send_ad_packet(this->socket, packet);
+        if (res.is_err) {
+            LOG_F(ERROR, "%s", res.data.err);
+            return false;
+        }
+    }
+    return true;
+}
 
-        return packet;
+std::chrono::milliseconds AirdropClient::_retransmit() {
+    Lock lock(this->send_mut);
+
+    auto now = std::chrono::steady_clock::now();
+    auto next = now + std::chrono::milliseconds(AIRDROP_RECV_POLL_MS);
+    for (auto it = this->unacked.begin(); it != this->unacked.end();) {
+        if (it->next_retransmit <= now) {
+            if (it->retransmits >= this->config.max_retransmits) {
+                LOG_F(WARNING, "No ack for airdrop packet %hhu to airdrop %hhu after %d resends",
+                      it->packet.header, it->airdrop, it->retransmits);
+                it = this->unacked.erase(it);
+                continue;
+            }
+            this->_sendCopies(it->packet);
+            it->retransmits++;
+            it->next_retransmit = now + std::chrono::milliseconds(this->config.retransmit_ms);
+        }
+        next = std::min(next, it->next_retransmit);
+        it++;
     }
+    return std::chrono::ceil<std::chrono::milliseconds>(next - now);
+}
+
+void AirdropClient::_checkAcks(const packet_t& packet) {
+    uint8_t airdrop, state;
+    parseID(packet.id, &airdrop, &state);
+
+    Lock lock(this->send_mut);
+    std::erase_if(this->unacked, [&packet, airdrop](const Unacked& sent) {
+        return sent.ack_header == packet.header &&
+               (sent.airdrop == UDP2_ALL || sent.airdrop == airdrop);
+    });
 }
 
 void AirdropClient::_receiveWorker() {
+    set_send_thread();
     set_recv_thread();
     loguru::set_thread_name("airdrop receiver");
 
     while (true) {
-        packet_t packet = this->_receiveBlocking();
+        auto until_retransmit = this->_retransmit();
+        auto packets = this->_receiveBatch(until_retransmit);
 
         if (this->stop_worker) {
             return;  // kill worker :o
         }
 
-        if (this->_parseHeartbeats(packet)) {
-            continue;  // heartbeat, so we should not put it in the queue
-        }
+        for (const ad_recv_packet_t& received : packets) {
+            const packet_t& packet = received.packet;
+            if (this->_parseHeartbeats(received)) {
+                continue;  // heartbeat, so we should not put it in the queue
+            }
 
-        if (packet.header == SET_MODE) {
-            uint8_t airdrop, state;
-            parseID(packet.id, &airdrop, &state);
-            send_ad_packet(this->socket, makeModePacket(ACK_MODE, static_cast<airdrop_t>(airdrop),
-                                                        OBC_NULL, *this->mode));
-            LOG_F(INFO, "Received extra SET_MODE, reacking");
-            continue;
-        }
+            this->_checkAcks(packet);
+
+            if (packet.header == SET_MODE) {
+                uint8_t airdrop, state;
+                parseID(packet.id, &airdrop, &state);
+                Lock lock(this->send_mut);
+                send_ad_packet(this->socket,
+                               makeModePacket(ACK_MODE, static_cast<airdrop_t>(airdrop),
+                                              OBC_NULL, *this->mode));
+                LOG_F(INFO, "Received extra SET_MODE, reacking");
+                continue;
+            }
 
-        LOG_F(INFO, "RECEIVED AIRDROP PACKET %d %d", (int)packet.header, (int)packet.id);
+            LOG_F(INFO, "RECEIVED AIRDROP PACKET %d %d", (int)packet.header, (int)packet.id);
 
-        Lock lock(this->recv_mut);
-        this->recv_queue.emplace(packet);
+            if (!packet_ring_push(this->recv_ring, &packet)) {
+                LOG_F(WARNING, "Airdrop receive queue full, %lu packets dropped so far",
+                      packet_ring_dropped(this->recv_ring));
+            }
+        }
     }
 }
 
-bool AirdropClient::_parseHeartbeats(packet_t packet) {
+bool AirdropClient::_parseHeartbeats(const ad_recv_packet_t& received) {
+    const packet_t& packet = received.packet;
     if (packet.header != HEARTBEAT) {
         return false;
     }
@@ -212,7 +323,8 @@ bool AirdropClient::_parseHeartbeats(packet_t packet) {
     // Valid heartbeat packet, so packet.data is within
     // [1, 5] and corresponds to a bottle index, so we can
     // subtract 1 to get the index into the lastHeartbeat array.
-    this->last_heartbeat[airdrop - 1] = getUnixTime_ms();
+    // Stamped when it arrived, not when we got around to reading it
+    this->last_heartbeat[airdrop - 1] = std::chrono::milliseconds(received.recv_time_ms);
 
     LOG_F(INFO, "Packet heartbeat from %d", airdrop);
 
@@ -1,8 +1,16 @@
 // LINT_C_FILE
 
+// for recvmmsg
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #include "network/airdrop_sockets.h"
 
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <stdint.h>
@@ -39,12 +47,16 @@ void set_recv_thread() {
 ad_socket_result_t make_ad_socket(uint16_t recv_port, uint16_t send_port) {
     // send socket is simple
     static char err[AD_ERR_LEN];
-    int sock_fd;
+    // Whatever has been opened so far is closed again on failure, since the OBC
+    // retries this in a loop
+    int sock_fd = -1;
+    int wake_fd = -1;
+    int epoll_fd = -1;
 
     // Using IPv4 addrs with UDP datagrams
     if ((sock_fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0) {
         snprintf(&err[0], AD_ERR_LEN, "socket failed: %s", strerror(errno));
-        AD_RETURN_ERR_RESULT(socket, err);
+        goto fail;
     }
 
     // Allow broadcasting on the socket
@@ -53,7 +65,7 @@ ad_socket_result_t make_ad_socket(uint16_t recv_port, uint16_t send_port) {
                   (void*) &broadcast_permission,
                   sizeof(broadcast_permission)) < 0) {
         snprintf(&err[0], AD_ERR_LEN, "setsockopt broadcast failed: %s", strerror(errno));
-        AD_RETURN_ERR_RESULT(socket, err);
+        goto fail;
     }
 
     struct sockaddr_in RECV_ADDR = {
@@ -66,16 +78,67 @@ ad_socket_result_t make_ad_socket(uint16_t recv_port, uint16_t send_port) {
     // Bind the socket to the broadcast address for receiving
     if (bind(sock_fd, (struct sockaddr*) &RECV_ADDR, sizeof(RECV_ADDR)) < 0) {
         snprintf(&err[0], AD_ERR_LEN, "bind socket failed: %s", strerror(errno));
-        AD_RETURN_ERR_RESULT(socket, err);
+        goto fail;
+    }
+
+    // Have the kernel stamp packets as they come in, so heartbeats aren't
+    // late by however long they sat in the socket buffer
+    int timestamp = 1;
+    if (setsockopt(sock_fd, SOL_SOCKET, SO_TIMESTAMP, &timestamp, sizeof(timestamp)) < 0) {
+        snprintf(&err[0], AD_ERR_LEN, "setsockopt timestamp failed: %s", strerror(errno));
+        goto fail;
+    }
+
+    // recv_ad_packets waits in epoll and then drains the socket without blocking
+    ad_int_result_t nonblocking = set_socket_nonblocking(sock_fd);
+    if (nonblocking.is_err) {
+        snprintf(&err[0], AD_ERR_LEN, "%s", nonblocking.data.err);
+        goto fail;
+    }
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) {
+        snprintf(&err[0], AD_ERR_LEN, "eventfd failed: %s", strerror(errno));
+        goto fail;
+    }
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        snprintf(&err[0], AD_ERR_LEN, "epoll_create1 failed: %s", strerror(errno));
+        goto fail;
+    }
+
+    struct epoll_event sock_event = { .events = EPOLLIN, .data = { .fd = sock_fd } };
+    struct epoll_event wake_event = { .events = EPOLLIN, .data = { .fd = wake_fd } };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, sock_fd, &sock_event) < 0 ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &wake_event) < 0) {
+        snprintf(&err[0], AD_ERR_LEN, "epoll_ctl failed: %s", strerror(errno));
+        goto fail;
     }
 
     ad_socket_t s = {
         .recv_port = recv_port,
         .send_port = send_port,
         .fd = sock_fd,
+        .wake_fd = wake_fd,
+        .epoll_fd = epoll_fd,
     };
 
     AD_RETURN_SUCC_RESULT(socket, s);
+
+fail:
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+    if (wake_fd >= 0) {
+        close(wake_fd);
+    }
+    if (sock_fd >= 0) {
+        close(sock_fd);
+    }
+    {
+        AD_RETURN_ERR_RESULT(socket, err);
+    }
 }
 
 ad_int_result_t set_socket_nonblocking(int sock_fd) {
@@ -136,8 +199,99 @@ ad_int_result_t recv_ad_packet(ad_socket_t socket, void* buf, size_t buf_len) {
     AD_RETURN_SUCC_RESULT(int, bytes_read);
 }
 
+// Most packets recv_ad_packets will read in one call
+#define AD_MAX_BATCH 32
+
+ad_int_result_t recv_ad_packets(ad_socket_t socket, ad_recv_packet_t* packets,
+                                size_t max_packets, int timeout_ms) {
+    static char err[AD_ERR_LEN];
+
+    struct epoll_event events[2];
+    int num_events = epoll_wait(socket.epoll_fd, events, 2, timeout_ms);
+    if (num_events < 0) {
+        if (errno == EINTR) {
+            AD_RETURN_SUCC_RESULT(int, 0);
+        }
+        snprintf(&err[0], AD_ERR_LEN, "epoll_wait failed: %s", strerror_l(errno, _recv_locale));
+        AD_RETURN_ERR_RESULT(int, err);
+    }
+    if (num_events == 0) {
+        AD_RETURN_SUCC_RESULT(int, 0);
+    }
+    for (int i = 0; i < num_events; i++) {
+        if (events[i].data.fd == socket.wake_fd) {
+            // Reset the eventfd so the next call waits again
+            uint64_t count;
+            (void) read(socket.wake_fd, &count, sizeof(count));
+            AD_RETURN_SUCC_RESULT(int, AD_RECV_WOKEN);
+        }
+    }
+
+    if (max_packets > AD_MAX_BATCH) {
+        max_packets = AD_MAX_BATCH;
+    }
+
+    struct mmsghdr msgs[AD_MAX_BATCH];
+    struct iovec iovecs[AD_MAX_BATCH];
+    char control[AD_MAX_BATCH][CMSG_SPACE(sizeof(struct timeval))];
+    memset(msgs, 0, sizeof(msgs[0]) * max_packets);
+    for (size_t i = 0; i < max_packets; i++) {
+        iovecs[i].iov_base = &packets[i].packet;
+        iovecs[i].iov_len = sizeof(packet_t);
+        msgs[i].msg_hdr.msg_iov = &iovecs[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_control = control[i];
+        msgs[i].msg_hdr.msg_controllen = sizeof(control[i]);
+    }
+
+    int num_read = recvmmsg(socket.fd, msgs, max_packets, MSG_DONTWAIT, NULL);
+    if (num_read < 0) {
+        if (errno == EWOULDBLOCK || errno == EAGAIN) {
+            AD_RETURN_SUCC_RESULT(int, 0);
+        }
+        snprintf(&err[0], AD_ERR_LEN, "recvmmsg failed: %s", strerror_l(errno, _recv_locale));
+        AD_RETURN_ERR_RESULT(int, err);
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    for (int i = 0; i < num_read; i++) {
+        packets[i].len = msgs[i].msg_len;
+        if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            // Bigger than a packet, make sure it doesn't pass for one
+            packets[i].len = sizeof(packet_t) + 1;
+        }
+
+        struct timeval received = now;
+        struct cmsghdr* cmsg;
+        for (cmsg = CMSG_FIRSTHDR(&msgs[i].msg_hdr); cmsg != NULL;
+             cmsg = CMSG_NXTHDR(&msgs[i].msg_hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMP) {
+                memcpy(&received, CMSG_DATA(cmsg), sizeof(received));
+            }
+        }
+        packets[i].recv_time_ms =
+            (uint64_t) received.tv_sec * 1000 + (uint64_t) received.tv_usec / 1000;
+    }
+
+    AD_RETURN_SUCC_RESULT(int, num_read);
+}
+
+ad_int_result_t wake_ad_socket(ad_socket_t socket) {
+    static char err[AD_ERR_LEN];
+    uint64_t one = 1;
+    if (write(socket.wake_fd, &one, sizeof(one)) < 0) {
+        snprintf(&err[0], AD_ERR_LEN, "wake failed: %s", strerror(errno));
+        AD_RETURN_ERR_RESULT(int, err);
+    }
+
+    AD_RETURN_SUCC_RESULT(int, 0);
+}
+
 ad_int_result_t close_ad_socket(ad_socket_t socket) {
     static char err[AD_ERR_LEN];
+    close(socket.epoll_fd);
+    close(socket.wake_fd);
     if (close(socket.fd) < 0) {
         snprintf(&err[0], AD_ERR_LEN, "close failed: %s", strerror(errno));
 
@@ -0,0 +1,140 @@
+#include "network/connection_monitor.hpp"
+
+#include <google/protobuf/util/json_util.h>
+
+#include <algorithm>
+#include <list>
+#include <utility>
+
+#include "core/mission_state.hpp"
+#include "network/airdrop_client.hpp"
+#include "network/mavlink.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+ConnectionMonitor::ConnectionMonitor(MissionState* state,
+                                     std::chrono::milliseconds links_interval,
+                                     std::chrono::milliseconds camera_interval)
+    : state(state),
+      links_interval(links_interval),
+      camera_interval(camera_interval),
+      running(false) {
+    ConnectionStatus initial;
+    google::protobuf::util::MessageToJsonString(initial.info, &initial.json);
+    this->status = std::make_shared<const ConnectionStatus>(std::move(initial));
+}
+
+ConnectionMonitor::~ConnectionMonitor() { this->stop(); }
+
+void ConnectionMonitor::start() {
+    Lock lock(this->thread_mut);
+    if (this->running) {
+        return;
+    }
+    this->running = true;
+    this->thread = std::thread(&ConnectionMonitor::_run, this);
+}
+
+void ConnectionMonitor::stop() {
+    {
+        Lock lock(this->thread_mut);
+        if (!this->running) {
+            return;
+        }
+        this->running = false;
+    }
+    this->thread_cv.notify_all();
+    this->thread.join();
+}
+
+std::shared_ptr<const ConnectionStatus> ConnectionMonitor::latest() {
+    Lock lock(this->status_mut);
+    return this->status;
+}
+
+void ConnectionMonitor::probeNow() {
+    ConnectionStatus next = *this->latest();
+    this->_probeLinks(&next);
+    this->_probeCamera(&next);
+    this->_publish(std::move(next));
+}
+
+void ConnectionMonitor::_run() {
+    loguru::set_thread_name("conn monitor");
+
+    using Clock = std::chrono::steady_clock;
+    auto next_links = Clock::now();
+    auto next_camera = Clock::now();
+    while (true) {
+        {
+            Lock lock(this->thread_mut);
+            auto next = std::min(next_links, next_camera);
+            if (this->thread_cv.wait_until(lock, next, [this]() { return !this->running; })) {
+                return;
+            }
+        }
+
+        ConnectionStatus next = *this->latest();
+        const auto now = Clock::now();
+        if (now >= next_links) {
+            next_links = now + this->links_interval;
+            this->_probeLinks(&next);
+        }
+        if (now >= next_camera) {
+            next_camera = now + this->camera_interval;
+            this->_probeCamera(&next);
+        }
+        this->_publish(std::move(next));
+    }
+}
+
+void ConnectionMonitor::_probeLinks(ConnectionStatus* status) {
+    std::list<std::pair<AirdropType, std::chrono::milliseconds>> lost_airdrop_conns;
+    std::shared_ptr<AirdropClient> airdrop = this->state->getAirdrop();
+    if (airdrop == nullptr) {
+        lost_airdrop_conns.push_back({AirdropType::Water, 99999ms});
+        lost_airdrop_conns.push_back({AirdropType::Beacon, 99999ms});
+    } else {
+        lost_airdrop_conns = airdrop->getLostConnections(3s);
+    }
+
+    mavsdk::Telemetry::RcStatus mav_conn;
+    std::shared_ptr<MavlinkClient> mav = this->state->getMav();
+    if (mav == nullptr) {
+        mav_conn.is_available = false;
+        mav_conn.signal_strength_percent = 0.0;
+    } else {
+        mav_conn = mav->get_conn_status();
+    }
+
+    status->info.clear_dropped_airdrop_idx();
+    status->info.clear_ms_since_ad_heartbeat();
+    for (auto const& [airdrop_index, ms_since_last_heartbeat] : lost_airdrop_conns) {
+        status->info.add_dropped_airdrop_idx(airdrop_index);
+        status->info.add_ms_since_ad_heartbeat(ms_since_last_heartbeat.count());
+    }
+    status->info.set_mav_rc_good(mav_conn.is_available);
+    status->info.set_mav_rc_strength(mav_conn.signal_strength_percent);
+    status->links_checked = std::chrono::steady_clock::now();
+}
+
+void ConnectionMonitor::_probeCamera(ConnectionStatus* status) {
+    std::shared_ptr<CameraInterface> camera = this->state->getCamera();
+    bool camera_good = camera != nullptr && camera->isConnected();
+    if (camera_good != status->info.camera_good()) {
+        LOG_F(INFO, "Camera %s", camera_good ? "connected" : "disconnected");
+    }
+    status->info.set_camera_good(camera_good);
+    status->camera_checked = std::chrono::steady_clock::now();
+}
+
+void ConnectionMonitor::_publish(ConnectionStatus status) {
+    status.json.clear();
+    google::protobuf::util::MessageToJsonString(status.info, &status.json);
+    auto next = std::make_shared<const ConnectionStatus>(std::move(status));
+
+    Lock lock(this->status_mut);
+    this->status = std::move(next);
+}
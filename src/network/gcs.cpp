@@ -2,30 +2,52 @@
 
 #include <httplib.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
 #include <cstdint>
 #include <functional>
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <utility>
 
+#include <nlohmann/json.hpp>
+
+#include "camera/interface.hpp"
 #include "core/mission_parameters.hpp"
 #include "core/mission_state.hpp"
+#include "network/connection_monitor.hpp"
 #include "network/gcs_routes.hpp"
 #include "pathing/cartesian.hpp"
 #include "protos/obc.pb.h"
 #include "ticks/path_gen.hpp"
 #include "ticks/tick.hpp"
+#include "utilities/event_broker.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/locks.hpp"
 #include "utilities/logging.hpp"
 #include "utilities/serialize.hpp"
 
 GCSServer::GCSServer(uint16_t port, std::shared_ptr<MissionState> state)
-    : port{port}, state{state} {
+    : port{port},
+      state{state},
+      slow_request{state->config.network.gcs.server.slow_request_ms},
+      stopping{false} {
     if (port < 1024) {
         LOG_F(ERROR, "Ports 0-1023 are reserved. Using port %d as a fallback...", DEFAULT_GCS_PORT);
         port = DEFAULT_GCS_PORT;
     }
 
+    // Probe links on a thread of our own so handlers never wait on a camera ping
+    this->connection_monitor = std::make_shared<ConnectionMonitor>(
+        state.get(), std::chrono::milliseconds(CONNECTION_PROBE_INTERVAL_MS),
+        std::chrono::milliseconds(CAMERA_PROBE_INTERVAL_MS));
+    this->state->setConnectionMonitor(this->connection_monitor);
+    this->connection_monitor->start();
+
+    this->_configureServer();
     this->_bindHandlers();
 
     this->server_thread = std::thread([this, port]() {
@@ -36,22 +58,79 @@ GCSServer::GCSServer(uint16_t port, std::shared_ptr<MissionState> state)
         }
         LOG_F(INFO, "GCS Server stopped on port %d", port);
     });
+
+    this->events_thread = std::thread(&GCSServer::_publishEvents, this);
 }
 
 GCSServer::~GCSServer() {
     Lock lock(this->server_mut);
 
+    {
+        Lock events_lock(this->events_mut);
+        this->stopping = true;
+    }
+    this->events_cv.notify_all();
+    this->events_thread.join();
+    this->connection_monitor->stop();
+    // Jobs can hold onto the state, so finish them while it's still around
+    this->state->getJobs()->stop();
+
+    // Otherwise open event streams would hold up the server until their next keepalive
+    this->state->getEvents()->close();
     this->server.stop();
     this->server_thread.join();
 }
 
+void GCSServer::_configureServer() {
+    const auto& config = this->state->config.network.gcs.server;
+
+    // Enough workers that open /events streams and slow handlers don't starve the rest
+    const std::size_t threads = std::max(config.threads, 1);
+    this->server.new_task_queue = [threads]() { return new httplib::ThreadPool(threads); };
+    this->server.set_keep_alive_max_count(config.keep_alive_max_count);
+    this->server.set_keep_alive_timeout(config.keep_alive_timeout_s);
+    this->server.set_read_timeout(config.read_timeout_s);
+    this->server.set_write_timeout(config.write_timeout_s);
+    this->server.set_payload_max_length(static_cast<std::size_t>(config.payload_max_mb) << 20);
+    LOG_F(INFO, "GCS server using %zu worker threads", threads);
+}
+
+httplib::Server::Handler GCSServer::_timed(const char* route, httplib::Server::Handler handler) {
+    return [this, route, handler = std::move(handler)](const httplib::Request& request,
+                                                       httplib::Response& response) {
+        auto start = std::chrono::steady_clock::now();
+        handler(request, response);
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        this->metrics.record(route, response.status, elapsed);
+        // Only the commands, the GCS polls everything else too often to be worth keeping
+        if (request.method != "GET" && FlightRecorder::isRecording()) {
+            FlightRecorder::recordGcsRequest(request.method, route, response.status, elapsed);
+        }
+        if (elapsed >= this->slow_request) {
+            LOG_F(WARNING, "Slow request: %s %s took %ld ms (HTTP %d)", request.method.c_str(),
+                  route, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count(),
+                  response.status);
+        }
+    };
+}
+
 void GCSServer::_bindHandlers() {
     this->server.Get("/", [](const httplib::Request& request, httplib::Response& response) {
         response.status = 200;
         response.set_content("Fort-nite", "text/plain");
     });
+    // Not timed itself, so scraping doesn't skew the numbers
+    this->server.Get("/metrics", [this](const httplib::Request& request,
+                                        httplib::Response& response) {
+        response.status = 200;
+        response.set_content(this->metrics.toPrometheus(), "text/plain; version=0.0.4");
+    });
     BIND_HANDLER(Get, connections);
+    BIND_HANDLER(Get, jobs);
     BIND_HANDLER(Get, tick);
+    BIND_HANDLER(Get, events);
     BIND_HANDLER(Get, mission);
     BIND_HANDLER(Post, mission);
     BIND_HANDLER(Get, path, initial);
@@ -77,5 +156,82 @@ void GCSServer::_bindHandlers() {
     BIND_HANDLER(Get, obcstate);
 
     BIND_HANDLER(Post, camera, runpipeline);
+
+    BIND_HANDLER(Get, map, metadata);
+    BIND_HANDLER(Get, map, tile);
     // BIND_HANDLER(Get, oh, shit);
 }
+
+void GCSServer::_publishEvents() {
+    loguru::set_thread_name("gcs events");
+
+    using Clock = std::chrono::steady_clock;
+    auto periodOf = [](float rate_hz) {
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(1.0 / rate_hz));
+    };
+    const float telemetry_rate_hz = this->state->config.network.gcs.events.telemetry_rate_hz;
+    const float connections_rate_hz = this->state->config.network.gcs.events.connections_rate_hz;
+    // A rate of 0 turns that topic off
+    const bool telemetry_enabled = telemetry_rate_hz > 0;
+    const bool connections_enabled = connections_rate_hz > 0;
+    if (!telemetry_enabled && !connections_enabled) {
+        return;
+    }
+    const Clock::duration telemetry_period =
+        telemetry_enabled ? periodOf(telemetry_rate_hz) : Clock::duration::zero();
+    const Clock::duration connections_period =
+        connections_enabled ? periodOf(connections_rate_hz) : Clock::duration::zero();
+
+    std::shared_ptr<EventBroker> events = this->state->getEvents();
+    // Only publish what changed, so an idle OBC doesn't wake up every stream
+    std::string last_telemetry;
+    std::string last_connections;
+    std::optional<int> last_run_id;
+
+    // A topic that's off is never due
+    auto next_telemetry = telemetry_enabled ? Clock::now() : Clock::time_point::max();
+    auto next_connections = connections_enabled ? Clock::now() : Clock::time_point::max();
+    while (true) {
+        {
+            Lock lock(this->events_mut);
+            auto next = std::min(next_telemetry, next_connections);
+            if (this->events_cv.wait_until(lock, next, [this]() { return this->stopping; })) {
+                return;
+            }
+        }
+
+        const auto now = Clock::now();
+        if (telemetry_enabled && now >= next_telemetry) {
+            // Targets are checked along with telemetry, it's just a lookup
+            next_telemetry = now + telemetry_period;
+
+            std::optional<ImageTelemetry> telemetry =
+                queryMavlinkImageTelemetry(this->state->getMav());
+            if (telemetry.has_value()) {
+                std::string data = imageTelemetryToJson(telemetry.value()).dump();
+                if (data != last_telemetry) {
+                    events->publish("telemetry", data);
+                    last_telemetry = std::move(data);
+                }
+            }
+
+            std::shared_ptr<CVAggregator> cv = this->state->getCV();
+            std::optional<int> run_id = cv ? cv->getRunHistory().newestRunId() : std::nullopt;
+            if (run_id.has_value() && run_id != last_run_id) {
+                events->publish("targets", json{{"newest_run_id", run_id.value()}}.dump());
+                last_run_id = run_id;
+            }
+        }
+
+        if (connections_enabled && now >= next_connections) {
+            next_connections = now + connections_period;
+
+            std::shared_ptr<const ConnectionStatus> status = this->connection_monitor->latest();
+            if (status->json != last_connections) {
+                events->publish("connections", status->json);
+                last_connections = status->json;
+            }
+        }
+    }
+}
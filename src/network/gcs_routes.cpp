@@ -1,14 +1,21 @@
 #include <google/protobuf/util/json_util.h>
 #include <httplib.h>
 
+#include <algorithm>
+#include <chrono>
+#include <exception>
 #include <filesystem>
+#include <fstream>
+#include <iterator>
 #include <memory>
 #include <optional>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include <nlohmann/json.hpp>
 
+#include "camera/jpeg_encoder.hpp"
 #include "core/mission_state.hpp"
 #include "network/gcs_macros.hpp"
 #include "network/mavlink.hpp"
@@ -19,7 +26,10 @@
 #include "ticks/path_validate.hpp"
 #include "ticks/tick.hpp"
 #include "ticks/wait_for_takeoff.hpp"
+#include "utilities/constants.hpp"
+#include "utilities/event_broker.hpp"
 #include "utilities/http.hpp"
+#include "utilities/job_queue.hpp"
 #include "utilities/logging.hpp"
 #include "utilities/serialize.hpp"
 #include "cv/utilities.hpp"
@@ -52,42 +62,66 @@ using json = nlohmann::json;
 DEF_GCS_HANDLE(Get, connections) {
     LOG_REQUEST_TRACE("GET", "/connections");
 
-    std::list<std::pair<AirdropType, std::chrono::milliseconds>> lost_airdrop_conns;
-    if (state->getAirdrop() == nullptr) {
-        lost_airdrop_conns.push_back({AirdropType::Water, 99999ms});
-        lost_airdrop_conns.push_back({AirdropType::Beacon, 99999ms});
-    } else {
-        lost_airdrop_conns = state->getAirdrop()->getLostConnections(3s);
+    std::shared_ptr<ConnectionMonitor> monitor = state->getConnectionMonitor();
+    if (monitor == nullptr) {
+        LOG_RESPONSE(WARNING, "Connection monitor not running", SERVICE_UNAVAILABLE);
+        return;
     }
+    std::shared_ptr<const ConnectionStatus> status = monitor->latest();
 
-    mavsdk::Telemetry::RcStatus mav_conn;
+    auto ageOf = [now = std::chrono::steady_clock::now()](auto checked) {
+        return std::to_string(
+            std::chrono::duration_cast<std::chrono::milliseconds>(now - checked).count());
+    };
+    response.set_header("X-Links-Age-Ms", ageOf(status->links_checked));
+    response.set_header("X-Camera-Age-Ms", ageOf(status->camera_checked));
 
-    if (state->getMav() == nullptr) {
-        mav_conn.is_available = false;
-        mav_conn.signal_strength_percent = 0.0;
-    } else {
-        mav_conn = state->getMav()->get_conn_status();
-    }
+    LOG_RESPONSE(TRACE, "Returning conn info", OK, status->json.c_str(), mime::json);
+}
 
-    bool camera_good = false;
+static json jobToJson(const Job& job) {
+    static const char* states[] = {"queued", "running", "done"};
+    json out = {
+        {"id", job.id},
+        {"name", job.name},
+        {"state", states[static_cast<int>(job.state)]},
+        {"submitted_ms", std::chrono::duration_cast<std::chrono::milliseconds>(
+                             job.submitted.time_since_epoch()).count()},
+    };
+    if (job.result.has_value()) {
+        out["status"] = job.result->status;
+        out["body"] = job.result->body;
+    }
+    return out;
+}
 
-    if (state->getCamera()) {
-        camera_good = state->getCamera()->isConnected();
-    }
+DEF_GCS_HANDLE(Get, jobs) {
+    LOG_REQUEST_TRACE("GET", "/jobs");
 
-    OBCConnInfo info;
-    for (auto const& [airdrop_index, ms_since_last_heartbeat] : lost_airdrop_conns) {
-        info.add_dropped_airdrop_idx(airdrop_index);
-        info.add_ms_since_ad_heartbeat(ms_since_last_heartbeat.count());
+    std::shared_ptr<JobQueue> jobs = state->getJobs();
+    if (!request.has_param("id")) {
+        json out = json::array();
+        for (const Job& job : jobs->all()) {
+            out.push_back(jobToJson(job));
+        }
+        std::string output = out.dump();
+        LOG_RESPONSE(TRACE, "Returning all jobs", OK, output.c_str(), mime::json);
+        return;
     }
-    info.set_mav_rc_good(mav_conn.is_available);
-    info.set_mav_rc_strength(mav_conn.signal_strength_percent);
-    info.set_camera_good(camera_good);
 
-    std::string output;
-    google::protobuf::util::MessageToJsonString(info, &output);
-
-    LOG_RESPONSE(TRACE, "Returning conn info", OK, output.c_str(), mime::json);
+    std::optional<Job> job;
+    try {
+        job = jobs->get(std::stoull(request.get_param_value("id")));
+    } catch (const std::exception&) {
+        LOG_RESPONSE(WARNING, "Invalid job id", BAD_REQUEST);
+        return;
+    }
+    if (!job.has_value()) {
+        LOG_RESPONSE(WARNING, "No such job (it may have aged out)", NOT_FOUND);
+        return;
+    }
+    std::string output = jobToJson(job.value()).dump();
+    LOG_RESPONSE(TRACE, "Returning job", OK, output.c_str(), mime::json);
 }
 
 DEF_GCS_HANDLE(Get, tick) {
@@ -96,6 +130,53 @@ DEF_GCS_HANDLE(Get, tick) {
     LOG_RESPONSE(INFO, TICK_ID_TO_STR(state->getTickID()), OK);
 }
 
+DEF_GCS_HANDLE(Get, events) {
+    LOG_REQUEST("GET", "/events");
+
+    std::shared_ptr<EventBroker> events = state->getEvents();
+    // Each stream holds on to one of the server's worker threads for as long as it's open
+    if (!events->trySubscribe(GCS_MAX_EVENT_STREAMS)) {
+        LOG_RESPONSE(WARNING, "Too many event streams open", SERVICE_UNAVAILABLE);
+        return;
+    }
+
+    // Picking up where a dropped stream left off, otherwise start with everything
+    uint64_t cursor = 0;
+    if (request.has_header("Last-Event-ID")) {
+        try {
+            cursor = std::stoull(request.get_header_value("Last-Event-ID"));
+        } catch (const std::exception& e) {
+            cursor = 0;
+        }
+    }
+
+    response.set_header("Cache-Control", "no-cache");
+    response.set_chunked_content_provider(
+        mime::event_stream,
+        [events, cursor](size_t offset, httplib::DataSink& sink) mutable {
+            std::vector<Event> batch = events->waitForEvents(
+                &cursor, std::chrono::milliseconds(GCS_EVENTS_KEEPALIVE_MS));
+            if (events->isClosed()) {
+                sink.done();
+                return true;
+            }
+
+            std::string out;
+            for (const Event& event : batch) {
+                out += "id: " + std::to_string(event.id) + "\n";
+                out += "event: " + event.topic + "\n";
+                out += "data: " + event.data + "\n\n";
+            }
+            if (out.empty()) {
+                out = ": keepalive\n\n";
+            }
+            // false once the GCS has hung up, which ends the stream
+            return sink.write(out.data(), out.size());
+        },
+        [events](bool success) { events->unsubscribe(); });
+    response.status = OK;
+}
+
 DEF_GCS_HANDLE(Get, mission) {
     LOG_REQUEST("GET", "/mission");
 
@@ -240,21 +321,21 @@ DEF_GCS_HANDLE(Get, camera, capture) {
 
     std::optional<ImageData> image = cam->takePicture(1000ms, state->getMav());
 
-    if (state->config.camera.save_images_to_file) {
-        image->saveToFile(state->config.camera.save_dir);
-    }
-
     if (!image.has_value()) {
         LOG_RESPONSE(ERROR, "Failed to capture image", INTERNAL_SERVER_ERROR);
         return;
     }
 
+    if (state->config.camera.save_images_to_file) {
+        state->getImageSink()->save(image.value(), state->config.camera.save_dir);
+    }
+
     std::optional<ImageTelemetry> telemetry = image->TELEMETRY;
-    std::optional<cv::Mat> optCompressedImg = compressImg(image->DATA);
-    cv::Mat compressed_image = optCompressedImg.has_value() ?
-    optCompressedImg->clone() : image->DATA;
+
+    // One per server thread, so its buffers are reused from capture to capture
+    thread_local JpegEncoder encoder(state->config.network.gcs.images.capture);
     ManualImage manual_image;
-    manual_image.set_img_b64(cvMatToBase64(compressed_image));
+    manual_image.set_img_b64(encoder.encodeBase64(image->DATA));
 
     manual_image.set_timestamp(image->TIMESTAMP);
     if (telemetry.has_value()) {
@@ -329,73 +410,68 @@ DEF_GCS_HANDLE(Get, targets, all) {
         return;
     }
 
-    // 1) Lock aggregator & pop all new runs
-    std::vector<AggregatedRun> new_runs = aggregator->popAllRuns();
-    if (new_runs.empty()) {
+    std::optional<int> since;
+    std::size_t limit = TARGETS_PAGE_SIZE;
+    try {
+        if (request.has_param("since")) {
+            since = std::stoi(request.get_param_value("since"));
+        }
+        if (request.has_param("limit")) {
+            limit = std::stoul(request.get_param_value("limit"));
+        }
+    } catch (const std::exception& e) {
+        LOG_RESPONSE(WARNING, "since and limit must be integers", BAD_REQUEST);
+        return;
+    }
+    limit = std::clamp<std::size_t>(limit, 1, CV_RUN_HISTORY_SIZE);
+
+    // 1) Runs after the GCS's cursor. Without one, the runs no other cursorless
+    // request has gotten yet, which is how this endpoint used to behave.
+    RunHistory& history = aggregator->getRunHistory();
+    RunPage page = since.has_value() ? history.since(since.value(), limit)
+                                     : history.unsent(limit);
+
+    // The body stays a plain list of targets, so the cursor goes in the headers
+    response.set_header("X-Next-Since", std::to_string(page.next_since));
+    response.set_header("X-More-Runs", page.more ? "true" : "false");
+
+    // 2) Runs were serialized when they were added, so this is just concatenation
+    bool binary = request.get_param_value("format") == "proto" ||
+                  request.get_header_value("Accept").find(mime::protobuf) != std::string::npos;
+    if (binary) {
+        // Length delimited IdentifiedTarget messages, back to back
+        std::string body;
+        for (const auto& run : page.runs) {
+            appendDelimited(&body, run->proto);
+        }
+        LOG_F(INFO, "Sending %zu runs as protobuf (%zu bytes)", page.runs.size(), body.size());
+        response.set_content(body, mime::protobuf);
+        response.status = OK;
+        return;
+    }
+
+    if (page.runs.empty()) {
         // No new data
         LOG_RESPONSE(INFO, "No new runs found", OK, "[]", mime::json);
         return;
     }
 
-    // 2) Convert each AggregatedRun into ONE IdentifiedTarget proto
-    std::vector<IdentifiedTarget> out_data;
-    out_data.reserve(new_runs.size());  // Reserve space for efficiency
-
-    // get aggregate to store a record of these results
-    LockPtr<std::map<int, IdentifiedTarget>> records = aggregator->getCVRecord();
-    std::shared_ptr<std::map<int, IdentifiedTarget>> records_ptr = records.data;
-
-    for (const auto& run : new_runs) {
-        // Create ONE IdentifiedTarget message per AggregatedRun
-        IdentifiedTarget target;
-        // Set the run ID
-        target.set_run_id(run.run_id);
-
-        std::optional<cv::Mat> optCompressedImg = compressImg(run.annotatedImage);
-        cv::Mat compressed_image = optCompressedImg.has_value() ?
-        optCompressedImg->clone() : run.annotatedImage;
-        std::string b64 = cvMatToBase64(compressed_image);
-        target.set_picture(b64);
-
-        // Ensure coords and bboxes vectors are the same size (should be guaranteed by Aggregator
-        // logic)
-        if (run.coords.size() != run.bboxes.size()) {
-            LOG_F(ERROR,
-                  "Mismatch between coordinates (%zu) and bboxes (%zu) count in run_id %d. "
-                  "Skipping this run.",
-                  run.coords.size(), run.bboxes.size(), run.run_id);
-            continue;  // Skip this problematic run
-        }
-
-        // Add all coordinates and bounding boxes from this run
-        for (size_t i = 0; i < run.bboxes.size(); ++i) {
-            // Add coordinate
-            GPSCoord* proto_coord = target.add_coordinates();  // Use the plural field name
-            proto_coord->set_latitude(run.coords[i].latitude());
-            proto_coord->set_longitude(run.coords[i].longitude());
-            proto_coord->set_altitude(run.coords[i].altitude());
-
-            // Add bounding box
-            BboxProto* proto_bbox = target.add_bboxes();  // Use the plural field name
-            proto_bbox->set_x1(run.bboxes[i].x1);
-            proto_bbox->set_y1(run.bboxes[i].y1);
-            proto_bbox->set_x2(run.bboxes[i].x2);
-            proto_bbox->set_y2(run.bboxes[i].y2);
-        }
+    std::size_t json_size = 2;
+    for (const auto& run : page.runs) {
+        json_size += run->json.size() + 1;
+    }
+    std::string body;
+    body.reserve(json_size);
+    body += '[';
+    for (const auto& run : page.runs) {
+        body += run->json;
+        body += ',';
+    }
+    body.back() = ']';
 
-        // copy the target to a record object to store
-        IdentifiedTarget record;
-        record.CopyFrom(target);
-        // remove image
-        record.set_picture("");
-        records_ptr->insert_or_assign(run.run_id, target);
-        // Add the completed IdentifiedTarget (representing the whole run) to the output list
-        out_data.push_back(std::move(target));
-    }  // End loop over AggregatedRuns
-    // 3) Serialize the vector of IdentifiedTarget messages to JSON
-    // Ensure messagesToJson can handle a vector or use iterators correctly
-    std::string out_data_json = messagesToJson(out_data.begin(), out_data.end());
-    response.set_content(out_data_json.c_str(), mime::json);
+    // httplib gzips this on its own when the GCS accepts it (see httplib.cmake)
+    LOG_F(INFO, "Sending %zu runs as JSON (%zu bytes)", page.runs.size(), body.size());
+    response.set_content(body, mime::json);
     response.status = OK;
 }
 
@@ -527,9 +603,8 @@ DEF_GCS_HANDLE(Get, obcstate) {
     response.status = OK;
 }
 
-DEF_GCS_HANDLE(Post, camera, runpipeline) {
-    LOG_REQUEST("POST", "/camera/runpipeline");
-
+// Body of the POST /camera/runpipeline job
+static JobResult runCameraPipeline(std::shared_ptr<MissionState> state) {
     std::shared_ptr<CameraInterface> cam = state->getCamera();
 
     std::string yolo_model_dir = state->config.cv.yolo_model_dir;
@@ -537,17 +612,21 @@ DEF_GCS_HANDLE(Post, camera, runpipeline) {
     LOG_F(INFO, "Yolo Model: %s", yolo_model_dir.c_str());
 
     // Make a CVAggregator instance and set it in the state
-    state->setCV(std::make_shared<CVAggregator>(Pipeline(PipelineParams(
-        yolo_model_dir, state->config.cv.detection_threshold, state->config.cv.input_width,
-        state->config.cv.input_height))));
+    PipelineParams params(state->config.cv);
+    std::optional<Mission> mission = state->mission_params.getCachedMission();
+    if (mission.has_value()) {
+        params.searchBoundary.assign(mission->airdropboundary().begin(),
+                                     mission->airdropboundary().end());
+    }
+    state->setCV(std::make_shared<CVAggregator>(Pipeline(params), state->getMapper(),
+                                                state->config.network.gcs.images.targets));
 
     if (!cam->isConnected()) {
         LOG_F(INFO, "Camera not connected. Attempting to connect...");
         cam->connect();
         if (!cam->isConnected()) {
             LOG_F(ERROR, "Failed to connect to the camera after connection attempt.");
-            LOG_RESPONSE(ERROR, "Failed to connect to camera", NOT_FOUND);
-            return;
+            return JobResult{NOT_FOUND, "Failed to connect to camera"};
         }
         LOG_F(INFO, "Camera connected successfully.");
     }
@@ -556,17 +635,32 @@ DEF_GCS_HANDLE(Post, camera, runpipeline) {
 
     for (int i = 0; i < state->config.pathing.coverage.hover.pictures_per_stop; i++) {
         auto photo = state->getCamera()->takePicture(500ms, state->getMav());
-        if (state->config.camera.save_images_to_file) {
-            photo->saveToFile(state->config.camera.save_dir);
+        if (photo.has_value() && state->config.camera.save_images_to_file) {
+            // Clone since the pipeline draws its detections onto the original
+            state->getImageSink()->save(
+                ImageData{photo->DATA.clone(), photo->TIMESTAMP, photo->TELEMETRY},
+                state->config.camera.save_dir);
         }
 
         if (photo.has_value()) {
             // Run the pipeline on the photo
-            state->getCV()->runPipeline(photo.value());
+            state->getCV()->runPipeline(std::move(photo.value()));
         }
     }
 
-    LOG_RESPONSE(INFO, "Successfully ran camera Stream", OK);
+    LOG_F(INFO, "Successfully ran camera Stream");
+    return JobResult{OK, "Successfully ran camera Stream"};
+}
+
+DEF_GCS_HANDLE(Post, camera, runpipeline) {
+    LOG_REQUEST("POST", "/camera/runpipeline");
+
+    // Takes a picture per hover stop, far too long to hold a server thread for
+    uint64_t job_id = state->getJobs()->submit("/camera/runpipeline",
+                                               [state]() { return runCameraPipeline(state); });
+
+    std::string output = json{{"job_id", job_id}}.dump();
+    LOG_RESPONSE(INFO, "Queued camera pipeline run", ACCEPTED, output.c_str(), mime::json);
 }
 
 DEF_GCS_HANDLE(Post, rtl) {
@@ -575,6 +669,85 @@ DEF_GCS_HANDLE(Post, rtl) {
     LOG_RESPONSE(INFO, "RTL activated", OK);
 }
 
+DEF_GCS_HANDLE(Get, map, metadata) {
+    LOG_REQUEST("GET", "/map/metadata");
+
+    std::shared_ptr<MosaicIngest> mapper = state->getMapper();
+    if (mapper == nullptr || mapper->getPyramid() == nullptr) {
+        LOG_RESPONSE(WARNING, "Mapping is disabled", BAD_REQUEST);
+        return;
+    }
+
+    std::ifstream file(mapper->getPyramid()->metadataPath());
+    if (!file.is_open()) {
+        LOG_RESPONSE(INFO, "No map tiles yet", NOT_FOUND);
+        return;
+    }
+    nlohmann::json metadata = nlohmann::json::parse(file, nullptr, false);
+    if (metadata.is_discarded()) {
+        LOG_RESPONSE(ERROR, "Map metadata is corrupt", INTERNAL_SERVER_ERROR);
+        return;
+    }
+
+    // Corners in the same frame as the mission paths, so the map can be lined up with them
+    const std::optional<CartesianConverter<GPSProtoVec>>& converter =
+        state->getCartesianConverter();
+    if (converter.has_value()) {
+        const nlohmann::json& bounds = metadata["bounds"];
+        nlohmann::json corners = nlohmann::json::array();
+        for (auto [lat_key, lon_key] : {std::pair{"north", "west"}, std::pair{"north", "east"},
+                                        std::pair{"south", "east"}, std::pair{"south", "west"}}) {
+            GPSCoord corner;
+            corner.set_latitude(bounds[lat_key].get<double>());
+            corner.set_longitude(bounds[lon_key].get<double>());
+            corner.set_altitude(0);
+            XYZCoord xyz = converter->toXYZ(corner);
+            corners.push_back({{"x", xyz.x}, {"y", xyz.y}});
+        }
+        metadata["corners_xy"] = corners;
+    }
+
+    std::string json = metadata.dump();
+    LOG_RESPONSE(INFO, "Got map metadata", OK, json.c_str(), mime::json);
+}
+
+DEF_GCS_HANDLE(Get, map, tile) {
+    // The GCS asks for a lot of these at once, keep them out of the normal logs
+    LOG_REQUEST_TRACE("GET", "/map/tile");
+
+    std::shared_ptr<MosaicIngest> mapper = state->getMapper();
+    if (mapper == nullptr || mapper->getPyramid() == nullptr) {
+        LOG_RESPONSE(WARNING, "Mapping is disabled", BAD_REQUEST);
+        return;
+    }
+    if (!request.has_param("z") || !request.has_param("x") || !request.has_param("y")) {
+        LOG_RESPONSE(WARNING, "Expected z, x and y query parameters", BAD_REQUEST);
+        return;
+    }
+
+    int zoom, x, y;
+    try {
+        zoom = std::stoi(request.get_param_value("z"));
+        x = std::stoi(request.get_param_value("x"));
+        y = std::stoi(request.get_param_value("y"));
+    } catch (const std::exception& e) {
+        LOG_RESPONSE(WARNING, "Tile coordinates must be integers", BAD_REQUEST);
+        return;
+    }
+
+    std::ifstream file(mapper->getPyramid()->tilePath(zoom, x, y), std::ios::binary);
+    if (!file.is_open()) {
+        // Expected for anything outside the map, not worth logging
+        response.status = NOT_FOUND;
+        return;
+    }
+    std::string tile((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    response.set_header("Cache-Control", "no-cache");
+    response.set_content(tile, mime::png);
+    response.status = OK;
+}
+
 // DEF_GCS_HANDLE(Get, oh, shit) {
 //     LOG_REQUEST("GET", "/oh/shit");
 
@@ -11,14 +11,23 @@
 #include <atomic>
 #include <chrono>
 #include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <future>
 #include <iostream>
 #include <memory>
 #include <optional>
 #include <string>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include "core/mission_state.hpp"
+#include "network/mission_diff.hpp"
 #include "pathing/mission_path.hpp"
+#include "utilities/common.hpp"
+#include "utilities/constants.hpp"
+#include "utilities/flight_recorder.hpp"
 #include "utilities/locks.hpp"
 #include "utilities/logging.hpp"
 #include "utilities/obc_config.hpp"
@@ -26,7 +35,11 @@
 using namespace std::chrono_literals;  // NOLINT
 
 MavlinkClient::MavlinkClient(OBCConfig config)
-    : mavsdk(mavsdk::Mavsdk::Configuration(mavsdk::ComponentType::CompanionComputer)) {
+    : mavsdk(mavsdk::Mavsdk::Configuration(mavsdk::ComponentType::CompanionComputer)),
+      position_history(POSITION_HISTORY_SIZE, POSITION_HISTORY_MAX_STALENESS_MS),
+      attitude_history(ATTITUDE_HISTORY_SIZE, ATTITUDE_HISTORY_MAX_STALENESS_MS),
+      upload_timeout(config.network.mavlink.upload_timeout_s),
+      partial_upload(config.network.mavlink.partial_upload) {
     std::string link = config.network.mavlink.connect;
 
     LOG_F(INFO, "Connecting to Mav at %s", link.c_str());
@@ -66,6 +79,17 @@ MavlinkClient::MavlinkClient(OBCConfig config)
     this->passthrough = std::make_unique<mavsdk::MavlinkPassthrough>(system);
     this->param = std::make_unique<mavsdk::Param>(system);
 
+    // The next upload can't be diffed against what we last sent if something
+    // else (e.g. a ground station) has changed the mission since
+    this->mission->subscribe_mission_changed([this](bool) {
+        if (std::chrono::steady_clock::now().time_since_epoch().count() <
+            this->own_mission_change_until.load()) {
+            return;
+        }
+        LOG_F(INFO, "Mission changed on the autopilot");
+        this->uploaded_mission_stale = true;
+    });
+
     // iterate through all config parameters and upload to the plane
     for (const auto& [param, val] : config.mavlink_parameters.param_map) {
         LOG_F(INFO, "Setting %s to %d", param.c_str(), val);
@@ -134,6 +158,7 @@ MavlinkClient::MavlinkClient(OBCConfig config)
         this->data.altitude_msl_m = position.absolute_altitude_m;
         this->data.lat_deg = position.latitude_deg;
         this->data.lng_deg = position.longitude_deg;
+        this->recordTelemetry(TelemetrySource::POSITION, getUnixTime_ms().count());
     });
     this->telemetry->subscribe_flight_mode([this](mavsdk::Telemetry::FlightMode flight_mode) {
         std::ostringstream stream;
@@ -201,9 +226,17 @@ MavlinkClient::MavlinkClient(OBCConfig config)
         this->data.yaw_deg = attitude.yaw_deg;
         this->data.pitch_deg = attitude.pitch_deg;
         this->data.roll_deg = attitude.roll_deg;
+        this->recordTelemetry(TelemetrySource::ATTITUDE, getUnixTime_ms().count());
     });
 }
 
+MavlinkClient::MavlinkClient(Offline)
+    : mavsdk(mavsdk::Mavsdk::Configuration(mavsdk::ComponentType::CompanionComputer)),
+      position_history(POSITION_HISTORY_SIZE, POSITION_HISTORY_MAX_STALENESS_MS),
+      attitude_history(ATTITUDE_HISTORY_SIZE, ATTITUDE_HISTORY_MAX_STALENESS_MS),
+      upload_timeout(0),
+      partial_upload(false) {}
+
 // Implement the triggerRelay method
 bool MavlinkClient::triggerRelay(int relay_number, bool state) {
     if (!this->passthrough) {
@@ -233,7 +266,7 @@ bool MavlinkClient::triggerRelay(int relay_number, bool state) {
 }
 
 bool MavlinkClient::uploadMissionUntilSuccess(std::shared_ptr<MissionState> state,
-                                              bool upload_geofence, const MissionPath& path) const {
+                                              bool upload_geofence, const MissionPath& path) {
     if (upload_geofence) {
         if (!this->uploadGeofenceUntilSuccess(state)) {
             return false;
@@ -306,45 +339,274 @@ bool MavlinkClient::uploadGeofenceUntilSuccess(std::shared_ptr<MissionState> sta
 }
 
 bool MavlinkClient::uploadWaypointsUntilSuccess(std::shared_ptr<MissionState> state,
-                                                const MissionPath& waypoints) const {
+                                                const MissionPath& waypoints) {
     LOG_SCOPE_F(INFO, "Uploading waypoints");
+    Lock lock(this->upload_mut);
 
+    const auto items = waypoints.getCommands();
     while (true) {
-        LOG_F(INFO, "Sending waypoint information...");
+        if (this->uploaded_mission_stale.exchange(false)) {
+            this->uploaded_mission.clear();
+        }
 
-        std::mutex resultMut;
-        std::optional<mavsdk::MissionRaw::Result> result{};
+        MissionDiff diff = diffMission(this->uploaded_mission, items);
+        if (diff.kind == MissionDiff::Kind::UNCHANGED) {
+            // The autopilot may have lost it since (e.g. rebooted) without telling us
+            if (this->autopilotMissionSize() == items.size()) {
+                LOG_F(INFO, "Mission unchanged since last upload, not sending it again");
+                return true;
+            }
+            LOG_F(WARNING, "Autopilot no longer has the last mission uploaded");
+            this->uploaded_mission.clear();
+            diff = diffMission(this->uploaded_mission, items);
+        }
 
-        this->mission->upload_mission_async(
-            waypoints.getCommands(), [&result, &resultMut](const mavsdk::MissionRaw::Result& res) {
-                resultMut.lock();
-                result = res;
-                resultMut.unlock();
-            });
+        // Until its ack has come in, mission changes are our own
+        this->own_mission_change_until = std::chrono::steady_clock::time_point::max()
+                                             .time_since_epoch()
+                                             .count();
+
+        bool uploaded = false;
+        if (diff.kind == MissionDiff::Kind::PARTIAL && this->partial_upload &&
+            this->partial_supported) {
+            LOG_F(INFO, "Sending waypoints %d-%d of %lu...", diff.first, diff.last,
+                  items.size());
+            uploaded = this->uploadPartial(items, diff.first, diff.last);
+        }
 
-        while (true) {
-            // uh well you see
-            resultMut.lock();
-            if (result.has_value()) {
-                resultMut.unlock();
-                break;
-            }
-            resultMut.unlock();
+        if (!uploaded) {
+            LOG_F(INFO, "Sending waypoint information...");
+            uploaded = this->uploadAll(items);
         }
 
-        if (result.value() == mavsdk::MissionRaw::Result::Success) {
+        // MissionRaw may report the ack after we've seen it
+        this->own_mission_change_until =
+            (std::chrono::steady_clock::now() + MAV_OWN_MISSION_CHANGE_GRACE)
+                .time_since_epoch()
+                .count();
+
+        if (uploaded) {
             LOG_F(INFO, "Successfully uploaded mission");
-            break;
+            this->uploaded_mission = items;
+            return true;
+        }
+
+        // a failed upload can leave anything on the autopilot
+        this->uploaded_mission.clear();
+        LOG_F(ERROR, "Error uploading mission. Trying again.");
+        std::this_thread::sleep_for(MAV_UPLOAD_RETRY_WAIT);
+    }
+}
+
+std::optional<std::size_t> MavlinkClient::autopilotMissionSize() {
+    if (!this->passthrough) {
+        return {};
+    }
+
+    // Filled in by the passthrough callback, shared because it can still be
+    // running after we unsubscribe
+    struct Count {
+        std::mutex mut;
+        std::condition_variable cv;
+        std::optional<uint16_t> count;
+    };
+    auto count = std::make_shared<Count>();
+
+    const uint8_t our_sysid = this->passthrough->get_our_sysid();
+    const uint8_t target_sysid = this->passthrough->get_target_sysid();
+    const uint8_t target_compid = this->passthrough->get_target_compid();
+
+    auto count_handle = this->passthrough->subscribe_message(MAVLINK_MSG_ID_MISSION_COUNT,
+        [count, our_sysid](const mavlink_message_t& message) {
+            mavlink_mission_count_t mission_count;
+            mavlink_msg_mission_count_decode(&message, &mission_count);
+            if (mission_count.target_system != our_sysid ||
+                mission_count.mission_type != MAV_MISSION_TYPE_MISSION) {
+                return;
+            }
+
+            {
+                Lock lock(count->mut);
+                count->count = mission_count.count;
+            }
+            count->cv.notify_one();
+        });
+
+    // Only the first step of a download. The autopilot doesn't hold anything
+    // open for the items we never ask for.
+    this->passthrough->queue_message([=](mavsdk::MavlinkAddress address, uint8_t channel) {
+        mavlink_message_t message;
+        mavlink_msg_mission_request_list_pack_chan(address.system_id, address.component_id,
+                                                   channel, &message, target_sysid,
+                                                   target_compid, MAV_MISSION_TYPE_MISSION);
+        return message;
+    });
+
+    std::optional<std::size_t> size;
+    {
+        Lock lock(count->mut);
+        if (count->cv.wait_for(lock, this->upload_timeout,
+                               [&]() { return count->count.has_value(); })) {
+            size = count->count.value();
         } else {
-            LOG_S(ERROR) << "Error uploading mission: " << result.value() << ". Trying again.";
+            LOG_F(ERROR, "No mission count from the autopilot after %lds",
+                  this->upload_timeout.count());
         }
+    }
 
-        std::this_thread::sleep_for(500ms);
+    this->passthrough->unsubscribe_message(MAVLINK_MSG_ID_MISSION_COUNT, count_handle);
+    return size;
+}
+
+bool MavlinkClient::uploadAll(const std::vector<mavsdk::MissionRaw::MissionItem>& items) {
+    // shared so a result that comes in after we have given up has somewhere to go
+    auto promise = std::make_shared<std::promise<mavsdk::MissionRaw::Result>>();
+    auto result = promise->get_future();
+    this->mission->upload_mission_async(items,
+        [promise](const mavsdk::MissionRaw::Result& res) { promise->set_value(res); });
+
+    if (result.wait_for(this->upload_timeout) != std::future_status::ready) {
+        LOG_F(ERROR, "Mission upload timed out after %lds, cancelling",
+              this->upload_timeout.count());
+        this->mission->cancel_mission_upload();
+        return false;
     }
 
+    auto res = result.get();
+    if (res != mavsdk::MissionRaw::Result::Success) {
+        LOG_S(ERROR) << "Error uploading mission: " << res;
+        return false;
+    }
     return true;
 }
 
+bool MavlinkClient::uploadPartial(const std::vector<mavsdk::MissionRaw::MissionItem>& items,
+                                  int first, int last) {
+    // What the autopilot has sent back so far, filled in by the passthrough callbacks.
+    // Shared because a callback can still be running after we unsubscribe.
+    struct Transfer {
+        std::mutex mut;
+        std::condition_variable cv;
+        std::deque<uint16_t> requested;  // items asked for, in order
+        std::optional<uint8_t> ack;      // MAV_MISSION_RESULT, ends the transfer
+    };
+    auto transfer = std::make_shared<Transfer>();
+
+    const uint8_t our_sysid = this->passthrough->get_our_sysid();
+    const uint8_t target_sysid = this->passthrough->get_target_sysid();
+    const uint8_t target_compid = this->passthrough->get_target_compid();
+
+    auto on_request = [transfer, our_sysid](const mavlink_message_t& message) {
+        uint16_t seq;
+        uint8_t target_system, mission_type;
+        if (message.msgid == MAVLINK_MSG_ID_MISSION_REQUEST_INT) {
+            mavlink_mission_request_int_t request;
+            mavlink_msg_mission_request_int_decode(&message, &request);
+            seq = request.seq;
+            target_system = request.target_system;
+            mission_type = request.mission_type;
+        } else {
+            mavlink_mission_request_t request;
+            mavlink_msg_mission_request_decode(&message, &request);
+            seq = request.seq;
+            target_system = request.target_system;
+            mission_type = request.mission_type;
+        }
+        if (target_system != our_sysid || mission_type != MAV_MISSION_TYPE_MISSION) {
+            return;
+        }
+
+        {
+            Lock lock(transfer->mut);
+            transfer->requested.push_back(seq);
+        }
+        transfer->cv.notify_one();
+    };
+    auto on_ack = [transfer, our_sysid](const mavlink_message_t& message) {
+        mavlink_mission_ack_t ack;
+        mavlink_msg_mission_ack_decode(&message, &ack);
+        if (ack.target_system != our_sysid || ack.mission_type != MAV_MISSION_TYPE_MISSION) {
+            return;
+        }
+
+        {
+            Lock lock(transfer->mut);
+            transfer->ack = ack.type;
+        }
+        transfer->cv.notify_one();
+    };
+
+    auto request_int_handle =
+        this->passthrough->subscribe_message(MAVLINK_MSG_ID_MISSION_REQUEST_INT, on_request);
+    auto request_handle =
+        this->passthrough->subscribe_message(MAVLINK_MSG_ID_MISSION_REQUEST, on_request);
+    auto ack_handle = this->passthrough->subscribe_message(MAVLINK_MSG_ID_MISSION_ACK, on_ack);
+
+    this->passthrough->queue_message([=](mavsdk::MavlinkAddress address, uint8_t channel) {
+        mavlink_message_t message;
+        mavlink_msg_mission_write_partial_list_pack_chan(
+            address.system_id, address.component_id, channel, &message, target_sysid,
+            target_compid, first, last, MAV_MISSION_TYPE_MISSION);
+        return message;
+    });
+
+    bool success = false;
+    bool sent_any = false;
+    {
+        Lock lock(transfer->mut);
+        while (true) {
+            bool responded = transfer->cv.wait_for(lock, MAV_PARTIAL_UPLOAD_STEP_TIMEOUT, [&]() {
+                return transfer->ack.has_value() || !transfer->requested.empty();
+            });
+            if (!responded) {
+                LOG_F(WARNING, "Autopilot stopped responding to the partial mission upload");
+                break;
+            }
+
+            if (transfer->ack.has_value()) {
+                success = transfer->ack == MAV_MISSION_ACCEPTED;
+                if (transfer->ack == MAV_MISSION_UNSUPPORTED && !sent_any) {
+                    LOG_F(WARNING, "Autopilot doesn't support partial mission uploads");
+                    this->partial_supported = false;
+                } else if (!success) {
+                    LOG_F(WARNING, "Partial mission upload rejected: %d", *transfer->ack);
+                }
+                break;
+            }
+
+            uint16_t seq = transfer->requested.front();
+            transfer->requested.pop_front();
+            if (seq < first || seq > last) {
+                LOG_F(WARNING, "Autopilot asked for mission item %d outside of %d-%d", seq,
+                      first, last);
+                continue;
+            }
+
+            // the autopilot asks again for anything it didn't get, so resending is fine
+            const mavsdk::MissionRaw::MissionItem item = items.at(seq);
+            lock.unlock();
+            this->passthrough->queue_message([=](mavsdk::MavlinkAddress address,
+                                                 uint8_t channel) {
+                mavlink_message_t message;
+                mavlink_msg_mission_item_int_pack_chan(
+                    address.system_id, address.component_id, channel, &message, target_sysid,
+                    target_compid, seq, item.frame, item.command, item.current,
+                    item.autocontinue, item.param1, item.param2, item.param3, item.param4,
+                    item.x, item.y, item.z, item.mission_type);
+                return message;
+            });
+            lock.lock();
+            sent_any = true;
+        }
+    }
+
+    this->passthrough->unsubscribe_message(MAVLINK_MSG_ID_MISSION_REQUEST_INT,
+                                           request_int_handle);
+    this->passthrough->unsubscribe_message(MAVLINK_MSG_ID_MISSION_REQUEST, request_handle);
+    this->passthrough->unsubscribe_message(MAVLINK_MSG_ID_MISSION_ACK, ack_handle);
+    return success;
+}
+
 std::pair<double, double> MavlinkClient::latlng_deg() {
     Lock lock(this->data_mut);
     return {this->data.lat_deg, this->data.lng_deg};
@@ -390,6 +652,69 @@ double MavlinkClient::roll_deg() {
     return this->data.roll_deg;
 }
 
+std::optional<ImageTelemetry> MavlinkClient::telemetryAt(uint64_t timestamp_ms) const {
+    std::optional<ImageTelemetry> telemetry = this->position_history.at(timestamp_ms);
+    std::optional<ImageTelemetry> attitude = this->attitude_history.at(timestamp_ms);
+    if (!telemetry.has_value() || !attitude.has_value()) {
+        return {};
+    }
+    telemetry->yaw_deg = attitude->yaw_deg;
+    telemetry->pitch_deg = attitude->pitch_deg;
+    telemetry->roll_deg = attitude->roll_deg;
+    return telemetry;
+}
+
+void MavlinkClient::setTelemetry(const TelemetryRecord& telemetry, uint64_t timestamp_ms) {
+    Lock lock(this->data_mut);
+    this->data.lat_deg = telemetry.latitude_deg;
+    this->data.lng_deg = telemetry.longitude_deg;
+    this->data.altitude_agl_m = telemetry.altitude_agl_m;
+    this->data.altitude_msl_m = telemetry.altitude_msl_m;
+    this->data.groundspeed_m_s = telemetry.groundspeed_m_s;
+    this->data.airspeed_m_s = telemetry.airspeed_m_s;
+    this->data.heading_deg = telemetry.heading_deg;
+    this->data.yaw_deg = telemetry.yaw_deg;
+    this->data.pitch_deg = telemetry.pitch_deg;
+    this->data.roll_deg = telemetry.roll_deg;
+    this->data.armed = telemetry.armed != 0;
+    this->data.flight_mode = static_cast<mavsdk::Telemetry::FlightMode>(telemetry.flight_mode);
+    // A recorded sample has both, as they were at the time
+    this->recordTelemetry(TelemetrySource::ALL, timestamp_ms);
+}
+
+void MavlinkClient::recordTelemetry(TelemetrySource source, uint64_t timestamp_ms) {
+    const ImageTelemetry snapshot{.latitude_deg = this->data.lat_deg,
+                                  .longitude_deg = this->data.lng_deg,
+                                  .altitude_agl_m = this->data.altitude_agl_m,
+                                  .airspeed_m_s = this->data.airspeed_m_s,
+                                  .heading_deg = this->data.heading_deg,
+                                  .yaw_deg = this->data.yaw_deg,
+                                  .pitch_deg = this->data.pitch_deg,
+                                  .roll_deg = this->data.roll_deg};
+    if (source != TelemetrySource::ATTITUDE) {
+        this->position_history.push(timestamp_ms, snapshot);
+    }
+    if (source != TelemetrySource::POSITION) {
+        this->attitude_history.push(timestamp_ms, snapshot);
+    }
+
+    if (FlightRecorder::isRecording()) {
+        FlightRecorder::recordTelemetry(
+            TelemetryRecord{.latitude_deg = this->data.lat_deg,
+                            .longitude_deg = this->data.lng_deg,
+                            .altitude_agl_m = this->data.altitude_agl_m,
+                            .altitude_msl_m = this->data.altitude_msl_m,
+                            .groundspeed_m_s = this->data.groundspeed_m_s,
+                            .airspeed_m_s = this->data.airspeed_m_s,
+                            .heading_deg = this->data.heading_deg,
+                            .yaw_deg = this->data.yaw_deg,
+                            .pitch_deg = this->data.pitch_deg,
+                            .roll_deg = this->data.roll_deg,
+                            .armed = this->data.armed,
+                            .flight_mode = static_cast<uint8_t>(this->data.flight_mode)});
+    }
+}
+
 XYZCoord MavlinkClient::wind() {
     Lock lock(this->data_mut);
     return this->data.wind;
@@ -0,0 +1,29 @@
+#include "network/mission_diff.hpp"
+
+#include <vector>
+
+MissionDiff diffMission(const std::vector<mavsdk::MissionRaw::MissionItem>& uploaded,
+                        const std::vector<mavsdk::MissionRaw::MissionItem>& next) {
+    if (uploaded.empty() || uploaded.size() != next.size()) {
+        return MissionDiff{MissionDiff::Kind::FULL, 0, static_cast<int>(next.size()) - 1};
+    }
+
+    const int size = static_cast<int>(next.size());
+    int first = 0;
+    while (first < size && uploaded[first] == next[first]) {
+        first++;
+    }
+    if (first == size) {
+        return MissionDiff{MissionDiff::Kind::UNCHANGED, 0, -1};
+    }
+
+    int last = size - 1;
+    while (uploaded[last] == next[last]) {
+        last--;
+    }
+
+    if (first == 0 && last == size - 1) {
+        return MissionDiff{MissionDiff::Kind::FULL, first, last};
+    }
+    return MissionDiff{MissionDiff::Kind::PARTIAL, first, last};
+}
@@ -21,13 +21,41 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <sys/time.h>
 
 #include "udp_squared/protocol.h"
-#include "network/mock/packet_queue.h"
+#include "network/packet_ring.h"
+
+// Enough that a test which never reads one side doesn't start dropping
+#define MOCK_RING_CAPACITY 1024
+
+// Global variables to buffer the messages. Each direction is only ever
+// sent to by one side and read by the other, which is what the ring needs
+static packet_ring_t* obc_ring = NULL;
+static packet_ring_t* payload_ring = NULL;
+
+// Empties the ring for a new socket, including a leftover wake from closing
+// the last one. Done in place rather than recreating the ring so a thread
+// still holding on to an old socket never reads freed memory.
+static void reset_ring(packet_ring_t* ring) {
+    packet_t discard;
+    while (packet_ring_pop(ring, &discard)) {}
+    packet_ring_wait(ring, 0);
+}
 
-// Global variables to buffer the messages
-static packet_queue_t obc_queue;
-static packet_queue_t payload_queue;
+static packet_ring_t* send_ring_of(ad_socket_t socket) {
+    if (socket.send_port == UDP2_OBC_PORT) {
+        return obc_ring;
+    }
+    return payload_ring;  // assume payload otherwise for the purposes of simple testing
+}
+
+static packet_ring_t* recv_ring_of(ad_socket_t socket) {
+    if (socket.recv_port == UDP2_OBC_PORT) {
+        return obc_ring;
+    }
+    return payload_ring;  // assume payload otherwise for the purposes of simple testing
+}
 
 ad_socket_result_t make_ad_socket(uint16_t recv_port, uint16_t send_port) {
     if ((recv_port != UDP2_OBC_PORT) && (recv_port != UDP2_PAYLOAD_PORT) ||
@@ -36,67 +64,98 @@ ad_socket_result_t make_ad_socket(uint16_t recv_port, uint16_t send_port) {
         exit(1);
     }
 
+    // both directions have to exist before either side sends
+    if (obc_ring == NULL) {
+        obc_ring = packet_ring_create(MOCK_RING_CAPACITY);
+    }
+    if (payload_ring == NULL) {
+        payload_ring = packet_ring_create(MOCK_RING_CAPACITY);
+    }
+
     if (recv_port == UDP2_OBC_PORT) {
-        pqueue_init(&obc_queue);
+        reset_ring(obc_ring);
     } else if (recv_port == UDP2_PAYLOAD_PORT) {
-        pqueue_init(&payload_queue);
+        reset_ring(payload_ring);
     }
 
     ad_socket_t s = {
-        .fd = 0,
-        .recv_port = recv_port,
         .send_port = send_port,
+        .recv_port = recv_port,
+        .fd = 0,
+        .wake_fd = -1,
+        .epoll_fd = -1,
     };
 
     AD_RETURN_SUCC_RESULT(socket, s);
 }
 
 ad_int_result_t send_ad_packet(ad_socket_t socket, packet_t packet) {
-    static char err[1] = "";
-
-    packet_queue_t* q;
-    if (socket.send_port == UDP2_OBC_PORT) {
-        q = &obc_queue;
-    } else {  // assume payload otherwise for the purposes of simple testing
-        q = &payload_queue;
-    }
+    static char err[] = "mock socket buffer is full";
 
-    if (pqueue_full(q)) {
+    if (!packet_ring_push(send_ring_of(socket), &packet)) {
         AD_RETURN_ERR_RESULT(int, err);
     }
 
-    pqueue_push(q, packet);
-
     AD_RETURN_SUCC_RESULT(int, sizeof(packet_t));
 }
 
 ad_int_result_t recv_ad_packet(ad_socket_t socket, void* buf, size_t buf_len) {
     static char err[1] = "";
 
-    packet_queue_t* q;
-    if (socket.recv_port == UDP2_OBC_PORT) {
-        q = &obc_queue;
-    } else {  // assume payload otherwise for the purposes of simple testing
-        q = &payload_queue;
-    }
+    packet_ring_t* ring = recv_ring_of(socket);
 
     if (buf_len < sizeof(packet_t)) {
         AD_RETURN_ERR_RESULT(int, err);
     }
 
-    packet_t packet = pqueue_wait_pop(q);
+    packet_t packet;
+    while (!packet_ring_pop(ring, &packet)) {
+        if (packet_ring_wait(ring, -1) < 0) {
+            static char closed_err[] = "mock socket was closed";
+            char* err = closed_err;
+            AD_RETURN_ERR_RESULT(int, err);
+        }
+    }
 
     memcpy(buf, &packet, sizeof(packet_t));
 
     AD_RETURN_SUCC_RESULT(int, sizeof(packet_t));
 }
 
+ad_int_result_t recv_ad_packets(ad_socket_t socket, ad_recv_packet_t* packets,
+                                size_t max_packets, int timeout_ms) {
+    packet_ring_t* ring = recv_ring_of(socket);
+
+    int ready = packet_ring_wait(ring, timeout_ms);
+    if (ready < 0) {
+        AD_RETURN_SUCC_RESULT(int, AD_RECV_WOKEN);
+    }
+
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    uint64_t now_ms = (uint64_t) now.tv_sec * 1000 + (uint64_t) now.tv_usec / 1000;
+
+    int num_read = 0;
+    while (num_read < (int) max_packets && packet_ring_pop(ring, &packets[num_read].packet)) {
+        packets[num_read].len = sizeof(packet_t);
+        packets[num_read].recv_time_ms = now_ms;
+        num_read++;
+    }
+
+    AD_RETURN_SUCC_RESULT(int, num_read);
+}
+
+ad_int_result_t wake_ad_socket(ad_socket_t socket) {
+    packet_ring_wake(recv_ring_of(socket));
+    AD_RETURN_SUCC_RESULT(int, 0);
+}
+
 // Everything below here is not very interesting
 
 ad_int_result_t close_ad_socket(ad_socket_t socket) {
     // tell any threads that are waiting on data to stop
-    sem_post(&obc_queue._recv_sem);
-    sem_post(&payload_queue._recv_sem);
+    packet_ring_wake(obc_ring);
+    packet_ring_wake(payload_ring);
     AD_RETURN_SUCC_RESULT(int, 0);
 }
 
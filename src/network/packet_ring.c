@@ -0,0 +1,210 @@
+// LINT_C_FILE
+
+#include "network/packet_ring.h"
+
+#include <errno.h>
+#include <linux/futex.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "udp_squared/protocol.h"
+
+#define RING_CACHE_LINE 64
+#define RING_WAIT_SPINS 256
+
+#if defined(__x86_64__) || defined(__i386__)
+#define ring_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define ring_cpu_relax() __asm__ volatile("yield" ::: "memory")
+#else
+#define ring_cpu_relax() ((void) 0)
+#endif
+
+struct packet_ring {
+    // Consumer's line
+    _Alignas(RING_CACHE_LINE) atomic_size_t head;  // next slot to pop
+    size_t cached_tail;  // consumer's last look at tail, so it only rereads it when empty
+
+    // Producer's line
+    _Alignas(RING_CACHE_LINE) atomic_size_t tail;  // next slot to push
+    size_t cached_head;  // producer's last look at head, so it only rereads it when full
+    atomic_uint_least64_t pushed;
+    atomic_uint_least64_t dropped;
+
+    // Wait/notify, only touched when the consumer is (or is about to be) asleep
+    _Alignas(RING_CACHE_LINE) _Atomic uint32_t notify_seq;  // futex word
+    atomic_int waiting;
+    atomic_int woken;
+
+    // Read only after create
+    _Alignas(RING_CACHE_LINE) size_t mask;
+    packet_t slots[];
+};
+
+static long ring_futex(_Atomic uint32_t* word, int op, uint32_t val,
+                       const struct timespec* timeout) {
+    return syscall(SYS_futex, (uint32_t*) word, op | FUTEX_PRIVATE_FLAG, val, timeout, NULL, 0);
+}
+
+static void ring_notify(packet_ring_t* ring) {
+    atomic_fetch_add_explicit(&ring->notify_seq, 1, memory_order_relaxed);
+    ring_futex(&ring->notify_seq, FUTEX_WAKE, INT32_MAX, NULL);
+}
+
+packet_ring_t* packet_ring_create(size_t capacity) {
+    size_t size = 2;
+    while (size < capacity) {
+        size <<= 1;
+    }
+
+    size_t bytes = sizeof(packet_ring_t) + size * sizeof(packet_t);
+    bytes = (bytes + RING_CACHE_LINE - 1) / RING_CACHE_LINE * RING_CACHE_LINE;
+    packet_ring_t* ring = aligned_alloc(RING_CACHE_LINE, bytes);
+    if (ring == NULL) {
+        return NULL;
+    }
+    memset(ring, 0, bytes);
+
+    atomic_init(&ring->head, 0);
+    ring->cached_tail = 0;
+    atomic_init(&ring->tail, 0);
+    ring->cached_head = 0;
+    atomic_init(&ring->pushed, 0);
+    atomic_init(&ring->dropped, 0);
+    atomic_init(&ring->notify_seq, 0);
+    atomic_init(&ring->waiting, 0);
+    atomic_init(&ring->woken, 0);
+    ring->mask = size - 1;
+    return ring;
+}
+
+void packet_ring_destroy(packet_ring_t* ring) {
+    free(ring);
+}
+
+int packet_ring_push(packet_ring_t* ring, const packet_t* packet) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if (tail - ring->cached_head > ring->mask) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if (tail - ring->cached_head > ring->mask) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return 0;
+        }
+    }
+
+    ring->slots[tail & ring->mask] = *packet;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    atomic_fetch_add_explicit(&ring->pushed, 1, memory_order_relaxed);
+
+    // Pairs with the fence in packet_ring_wait: either the consumer sees the
+    // new tail before it sleeps, or we see that it is waiting and wake it
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&ring->waiting, memory_order_relaxed)) {
+        ring_notify(ring);
+    }
+    return 1;
+}
+
+int packet_ring_pop(packet_ring_t* ring, packet_t* out) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    if (head == ring->cached_tail) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head == ring->cached_tail) {
+            return 0;
+        }
+    }
+
+    *out = ring->slots[head & ring->mask];
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return 1;
+}
+
+int packet_ring_wait(packet_ring_t* ring, int timeout_ms) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    if (timeout_ms >= 0) {
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (long) (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+    }
+
+    // Packets tend to come in bursts, so spin a little before paying for a
+    // futex sleep and the producer's wake syscall
+    for (int i = 0; i < RING_WAIT_SPINS; i++) {
+        if (atomic_load_explicit(&ring->woken, memory_order_relaxed) ||
+            atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+            atomic_load_explicit(&ring->tail, memory_order_relaxed)) {
+            break;
+        }
+        ring_cpu_relax();
+    }
+
+    while (1) {
+        uint32_t seq = atomic_load_explicit(&ring->notify_seq, memory_order_acquire);
+        atomic_store_explicit(&ring->waiting, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        int ret = 2;  // keep waiting
+        if (atomic_exchange_explicit(&ring->woken, 0, memory_order_acq_rel)) {
+            ret = -1;
+        } else if (atomic_load_explicit(&ring->head, memory_order_relaxed) !=
+                   atomic_load_explicit(&ring->tail, memory_order_acquire)) {
+            ret = 1;
+        } else if (timeout_ms >= 0) {
+            struct timespec now;
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            struct timespec left = {
+                .tv_sec = deadline.tv_sec - now.tv_sec,
+                .tv_nsec = deadline.tv_nsec - now.tv_nsec,
+            };
+            if (left.tv_nsec < 0) {
+                left.tv_sec--;
+                left.tv_nsec += 1000000000;
+            }
+            if (left.tv_sec < 0) {
+                ret = 0;
+            } else {
+                ring_futex(&ring->notify_seq, FUTEX_WAIT, seq, &left);
+            }
+        } else {
+            ring_futex(&ring->notify_seq, FUTEX_WAIT, seq, NULL);
+        }
+
+        if (ret != 2) {
+            atomic_store_explicit(&ring->waiting, 0, memory_order_relaxed);
+            return ret;
+        }
+        // woken up, timed out or interrupted, so go back around and check why
+    }
+}
+
+void packet_ring_wake(packet_ring_t* ring) {
+    atomic_store_explicit(&ring->woken, 1, memory_order_release);
+    ring_notify(ring);
+}
+
+size_t packet_ring_size(packet_ring_t* ring) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    return tail - head;
+}
+
+size_t packet_ring_capacity(packet_ring_t* ring) {
+    return ring->mask + 1;
+}
+
+uint64_t packet_ring_pushed(packet_ring_t* ring) {
+    return atomic_load_explicit(&ring->pushed, memory_order_relaxed);
+}
+
+uint64_t packet_ring_dropped(packet_ring_t* ring) {
+    return atomic_load_explicit(&ring->dropped, memory_order_relaxed);
+}
@@ -0,0 +1,185 @@
+#include "network/replay_mavlink.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <utility>
+
+#include "core/mission_state.hpp"
+#include "utilities/common.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+ReplayFlight makeReplayFlight(const std::vector<FlightRecord>& records) {
+    ReplayFlight flight;
+    for (const FlightRecord& record : records) {
+        const uint64_t time_ms = record.time_us / 1000;
+
+        if (record.type == FlightRecordType::TELEMETRY) {
+            auto telemetry = record.as<TelemetryRecord>();
+            if (telemetry.has_value()) {
+                flight.telemetry.emplace_back(time_ms, telemetry.value());
+            }
+        } else if (record.type == FlightRecordType::TICK) {
+            auto tick = record.as<TickRecord>();
+            if (!tick.has_value()) {
+                continue;
+            }
+            const bool finished =
+                tick->from == static_cast<uint8_t>(TickID::FlyWaypoints) ||
+                tick->from == static_cast<uint8_t>(TickID::AirdropApproach) ||
+                (tick->from == static_cast<uint8_t>(TickID::FlySearch) &&
+                 tick->to == static_cast<uint8_t>(TickID::CVLoiter));
+            if (finished) {
+                flight.missions_finished.push_back(time_ms);
+            }
+        }
+    }
+    return flight;
+}
+
+ReplayMavlinkClient::ReplayMavlinkClient(ReplayFlight flight)
+    : MavlinkClient(Offline{}),
+      flight(std::move(flight)),
+      next_sample(0),
+      missions_uploaded(0),
+      mission_size(0) {
+    LOG_F(INFO, "Replaying %lu telemetry samples and %lu missions",
+          this->flight.telemetry.size(), this->flight.missions_finished.size());
+}
+
+void ReplayMavlinkClient::update() {
+    const uint64_t now_ms = getUnixTime_ms().count();
+
+    Lock lock(this->mut);
+    while (this->next_sample < this->flight.telemetry.size() &&
+           this->flight.telemetry[this->next_sample].first <= now_ms) {
+        // At the time it was recorded, not now, since update() only runs between ticks
+        const auto& [time_ms, telemetry] = this->flight.telemetry[this->next_sample];
+        this->setTelemetry(telemetry, time_ms);
+        this->next_sample++;
+    }
+}
+
+bool ReplayMavlinkClient::finished() const {
+    if (this->flight.telemetry.empty()) {
+        return true;
+    }
+    return static_cast<uint64_t>(getUnixTime_ms().count()) >
+           this->flight.telemetry.back().first;
+}
+
+bool ReplayMavlinkClient::uploadGeofenceUntilSuccess(std::shared_ptr<MissionState> state) const {
+    LOG_F(INFO, "Replay: geofence uploaded");
+    return true;
+}
+
+bool ReplayMavlinkClient::uploadWaypointsUntilSuccess(std::shared_ptr<MissionState> state,
+                                                      const MissionPath& waypoints) {
+    Lock lock(this->mut);
+    this->missions_uploaded++;
+    this->mission_size = waypoints.getCommands().size();
+    this->started_ms.reset();
+    LOG_F(INFO, "Replay: mission %d uploaded with %lu items", this->missions_uploaded - 1,
+          this->mission_size);
+    return true;
+}
+
+int32_t ReplayMavlinkClient::curr_waypoint() const {
+    Lock lock(this->mut);
+    return this->progress();
+}
+
+bool ReplayMavlinkClient::isMissionFinished() {
+    Lock lock(this->mut);
+    return static_cast<std::size_t>(this->progress()) == this->mission_size;
+}
+
+bool ReplayMavlinkClient::isAtFinalWaypoint() {
+    Lock lock(this->mut);
+    return static_cast<std::size_t>(this->progress()) + 1 == this->mission_size;
+}
+
+bool ReplayMavlinkClient::setMissionItem(int item) { return true; }
+
+size_t ReplayMavlinkClient::totalWaypoints() {
+    Lock lock(this->mut);
+    return this->mission_size;
+}
+
+mavsdk::Telemetry::RcStatus ReplayMavlinkClient::get_conn_status() {
+    mavsdk::Telemetry::RcStatus status;
+    status.was_available_once = true;
+    status.is_available = true;
+    status.signal_strength_percent = 100;
+    return status;
+}
+
+bool ReplayMavlinkClient::armAndHover(std::shared_ptr<MissionState> state) {
+    // Took off whenever the recording says it did
+    const double takeoff_alt = state->config.takeoff.altitude_m;
+    while (this->altitude_agl_m() < takeoff_alt) {
+        if (this->finished()) {
+            LOG_F(ERROR, "Replay: recording ended before reaching takeoff altitude");
+            return false;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    return true;
+}
+
+bool ReplayMavlinkClient::startMission() {
+    Lock lock(this->mut);
+    if (!this->started_ms.has_value()) {
+        this->started_ms = getUnixTime_ms().count();
+        LOG_F(INFO, "Replay: mission %d started", this->missions_uploaded - 1);
+    }
+    return true;
+}
+
+bool ReplayMavlinkClient::triggerRelay(int relay_number, bool state) {
+    LOG_F(INFO, "Replay: relay %d %s", relay_number, state ? "ON" : "OFF");
+    return true;
+}
+
+void ReplayMavlinkClient::KILL_THE_PLANE_DO_NOT_CALL_THIS_ACCIDENTALLY() {
+    LOG_F(ERROR, "Replay: plane killed");
+}
+
+void ReplayMavlinkClient::rtl() { LOG_F(INFO, "Replay: RTL"); }
+
+std::optional<uint64_t> ReplayMavlinkClient::finishMs() const {
+    if (!this->started_ms.has_value()) {
+        return {};
+    }
+
+    const std::size_t num_finished = this->flight.missions_finished.size();
+    const int mission = this->missions_uploaded - 1;
+    uint64_t finish_ms = *this->started_ms;
+    if (mission >= 0 && static_cast<std::size_t>(mission) < num_finished) {
+        finish_ms = this->flight.missions_finished[mission];
+    } else if (!this->flight.telemetry.empty()) {
+        finish_ms = this->flight.telemetry.back().first;
+    }
+    return std::max(finish_ms, *this->started_ms);
+}
+
+int32_t ReplayMavlinkClient::progress() const {
+    std::optional<uint64_t> finish_ms = this->finishMs();
+    if (!finish_ms.has_value()) {
+        return 0;
+    }
+
+    const uint64_t now_ms = getUnixTime_ms().count();
+    if (now_ms >= *finish_ms) {
+        return this->mission_size;
+    }
+    if (now_ms <= *this->started_ms) {
+        return 0;
+    }
+    const double done = static_cast<double>(now_ms - *this->started_ms) /
+                        static_cast<double>(*finish_ms - *this->started_ms);
+    return static_cast<int32_t>(done * this->mission_size);
+}
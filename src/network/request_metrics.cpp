@@ -0,0 +1,76 @@
+#include "network/request_metrics.hpp"
+
+#include <algorithm>
+#include <sstream>
+
+#include "utilities/locks.hpp"
+
+void RequestMetrics::record(const std::string& route, int status,
+                            std::chrono::microseconds duration) {
+    // First bucket the request fits in, or the +Inf one past the end
+    auto bucket = std::lower_bound(BUCKETS_MS.begin(), BUCKETS_MS.end(), duration,
+                                   [](int bound_ms, std::chrono::microseconds d) {
+                                       return std::chrono::milliseconds(bound_ms) < d;
+                                   });
+
+    Lock lock(this->mut);
+    Histogram& histogram = this->routes[route];
+    histogram.buckets[std::distance(BUCKETS_MS.begin(), bucket)]++;
+    histogram.count++;
+    if (status >= 500) {
+        histogram.errors++;
+    }
+    histogram.total += duration;
+    histogram.max = std::max(histogram.max, duration);
+}
+
+std::optional<RequestMetrics::Histogram> RequestMetrics::get(const std::string& route) const {
+    Lock lock(this->mut);
+    auto it = this->routes.find(route);
+    if (it == this->routes.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+std::string RequestMetrics::toPrometheus() const {
+    // Copy out so requests aren't held up while this is formatted
+    std::map<std::string, Histogram> routes;
+    {
+        Lock lock(this->mut);
+        routes = this->routes;
+    }
+
+    std::ostringstream out;
+    out << "# HELP obc_gcs_request_duration_seconds Time spent in GCS route handlers\n"
+        << "# TYPE obc_gcs_request_duration_seconds histogram\n";
+    for (const auto& [route, histogram] : routes) {
+        uint64_t cumulative = 0;
+        for (std::size_t i = 0; i < BUCKETS_MS.size(); i++) {
+            cumulative += histogram.buckets[i];
+            out << "obc_gcs_request_duration_seconds_bucket{route=\"" << route << "\",le=\""
+                << BUCKETS_MS[i] / 1000.0 << "\"} " << cumulative << '\n';
+        }
+        out << "obc_gcs_request_duration_seconds_bucket{route=\"" << route
+            << "\",le=\"+Inf\"} " << histogram.count << '\n'
+            << "obc_gcs_request_duration_seconds_sum{route=\"" << route << "\"} "
+            << histogram.total.count() / 1e6 << '\n'
+            << "obc_gcs_request_duration_seconds_count{route=\"" << route << "\"} "
+            << histogram.count << '\n';
+    }
+
+    out << "# HELP obc_gcs_request_errors_total GCS requests answered with a 5xx status\n"
+        << "# TYPE obc_gcs_request_errors_total counter\n";
+    for (const auto& [route, histogram] : routes) {
+        out << "obc_gcs_request_errors_total{route=\"" << route << "\"} " << histogram.errors
+            << '\n';
+    }
+
+    out << "# HELP obc_gcs_request_duration_max_seconds Slowest request to each GCS route\n"
+        << "# TYPE obc_gcs_request_duration_max_seconds gauge\n";
+    for (const auto& [route, histogram] : routes) {
+        out << "obc_gcs_request_duration_max_seconds{route=\"" << route << "\"} "
+            << histogram.max.count() / 1e6 << '\n';
+    }
+    return out.str();
+}
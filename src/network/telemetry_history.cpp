@@ -0,0 +1,158 @@
+#include "network/telemetry_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+// Indices into TelemetryHistory::Fields, in ImageTelemetry order
+enum Field {
+    LATITUDE,
+    LONGITUDE,
+    ALTITUDE_AGL,
+    AIRSPEED,
+    HEADING,
+    YAW,
+    PITCH,
+    ROLL,
+};
+
+// a + frac * (b - a), going whichever way around the circle is shorter
+double lerpAngle(double a, double b, double frac) {
+    return a + frac * std::remainder(b - a, 360.0);
+}
+}  // namespace
+
+TelemetryHistory::TelemetryHistory(std::size_t capacity, uint64_t max_staleness_ms)
+    : capacity(std::max<std::size_t>(capacity, 2)),
+      max_staleness_ms(max_staleness_ms),
+      slots(std::make_unique<Slot[]>(this->capacity)),
+      count(0) {}
+
+void TelemetryHistory::push(uint64_t timestamp_ms, const ImageTelemetry& telemetry) {
+    uint64_t index = this->count.load(std::memory_order_relaxed);
+    Slot& slot = this->slots[index % this->capacity];
+
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.timestamp_ms.store(timestamp_ms, std::memory_order_relaxed);
+    Fields fields = toFields(telemetry);
+    for (std::size_t i = 0; i < NUM_FIELDS; i++) {
+        slot.fields[i].store(fields[i], std::memory_order_relaxed);
+    }
+
+    slot.seq.store(2 * (index + 1), std::memory_order_release);
+    this->count.store(index + 1, std::memory_order_release);
+}
+
+std::optional<ImageTelemetry> TelemetryHistory::at(uint64_t timestamp_ms) const {
+    uint64_t num_samples = this->count.load(std::memory_order_acquire);
+    if (num_samples == 0) {
+        return {};
+    }
+
+    std::optional<Sample> after = this->read(num_samples - 1);
+    if (!after.has_value()) {
+        return {};
+    }
+    if (timestamp_ms >= after->timestamp_ms) {
+        if (timestamp_ms - after->timestamp_ms > this->max_staleness_ms) {
+            return {};
+        }
+        return fromFields(after->fields);
+    }
+
+    // Frames are looked up right after they are captured, so walking back from
+    // the newest sample only ever goes a few samples deep
+    uint64_t oldest = num_samples > this->capacity ? num_samples - this->capacity : 0;
+    for (uint64_t index = num_samples - 1; index > oldest; index--) {
+        std::optional<Sample> before = this->read(index - 1);
+        if (!before.has_value()) {
+            // the writer has lapped us, everything older is gone too
+            return {};
+        }
+        if (before->timestamp_ms <= timestamp_ms) {
+            return fromFields(interpolate(before.value(), after.value(), timestamp_ms));
+        }
+        after = before;
+    }
+
+    return {};
+}
+
+std::optional<uint64_t> TelemetryHistory::newestTimestamp() const {
+    uint64_t num_samples = this->count.load(std::memory_order_acquire);
+    if (num_samples == 0) {
+        return {};
+    }
+    std::optional<Sample> newest = this->read(num_samples - 1);
+    if (!newest.has_value()) {
+        return {};
+    }
+    return newest->timestamp_ms;
+}
+
+std::size_t TelemetryHistory::size() const {
+    return std::min<uint64_t>(this->count.load(std::memory_order_acquire), this->capacity);
+}
+
+std::optional<TelemetryHistory::Sample> TelemetryHistory::read(uint64_t index) const {
+    const Slot& slot = this->slots[index % this->capacity];
+
+    uint64_t seq_before = slot.seq.load(std::memory_order_acquire);
+    if (seq_before != 2 * (index + 1)) {
+        return {};
+    }
+
+    Sample sample;
+    sample.timestamp_ms = slot.timestamp_ms.load(std::memory_order_relaxed);
+    for (std::size_t i = 0; i < NUM_FIELDS; i++) {
+        sample.fields[i] = slot.fields[i].load(std::memory_order_relaxed);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.seq.load(std::memory_order_relaxed) != seq_before) {
+        return {};
+    }
+    return sample;
+}
+
+TelemetryHistory::Fields TelemetryHistory::toFields(const ImageTelemetry& telemetry) {
+    return {telemetry.latitude_deg, telemetry.longitude_deg, telemetry.altitude_agl_m,
+            telemetry.airspeed_m_s, telemetry.heading_deg,   telemetry.yaw_deg,
+            telemetry.pitch_deg,    telemetry.roll_deg};
+}
+
+ImageTelemetry TelemetryHistory::fromFields(const Fields& fields) {
+    return ImageTelemetry{.latitude_deg = fields[LATITUDE],
+                          .longitude_deg = fields[LONGITUDE],
+                          .altitude_agl_m = fields[ALTITUDE_AGL],
+                          .airspeed_m_s = fields[AIRSPEED],
+                          .heading_deg = fields[HEADING],
+                          .yaw_deg = fields[YAW],
+                          .pitch_deg = fields[PITCH],
+                          .roll_deg = fields[ROLL]};
+}
+
+TelemetryHistory::Fields TelemetryHistory::interpolate(const Sample& before, const Sample& after,
+                                                       uint64_t timestamp_ms) {
+    double frac = 0;
+    if (after.timestamp_ms > before.timestamp_ms) {
+        frac = static_cast<double>(timestamp_ms - before.timestamp_ms) /
+               static_cast<double>(after.timestamp_ms - before.timestamp_ms);
+    }
+
+    Fields fields;
+    for (std::size_t i = 0; i < NUM_FIELDS; i++) {
+        fields[i] = before.fields[i] + frac * (after.fields[i] - before.fields[i]);
+    }
+
+    // heading is [0, 360), yaw and roll are (-180, 180]
+    double heading = std::fmod(lerpAngle(before.fields[HEADING], after.fields[HEADING], frac),
+                               360.0);
+    fields[HEADING] = heading < 0 ? heading + 360.0 : heading;
+    fields[YAW] = std::remainder(lerpAngle(before.fields[YAW], after.fields[YAW], frac), 360.0);
+    fields[ROLL] = std::remainder(lerpAngle(before.fields[ROLL], after.fields[ROLL], frac),
+                                  360.0);
+    return fields;
+}
@@ -1,11 +1,31 @@
 #include "network/udp_client.hpp"
+#include <netinet/in.h>
 #include <sys/select.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+
+#include "utilities/logging.hpp"
 
 UDPClient::UDPClient(asio::io_context* io_context_, std::string ip, int port)
-    : socket_(*io_context_) {
+    : socket_(*io_context_),
+      batch_buf_(RECV_BATCH_SIZE * (sizeof(ChunkHeader) + MAX_CHUNK_SIZE)),
+      batch_iovecs_(RECV_BATCH_SIZE),
+      batch_msgs_(RECV_BATCH_SIZE) {
     this->ip = ip;
     this->port = port;
+
+    const size_t slot_size = sizeof(ChunkHeader) + MAX_CHUNK_SIZE;
+    for (size_t i = 0; i < RECV_BATCH_SIZE; i++) {
+        this->batch_iovecs_[i].iov_base = this->batch_buf_.data() + i * slot_size;
+        this->batch_iovecs_[i].iov_len = slot_size;
+        std::memset(&this->batch_msgs_[i], 0, sizeof(mmsghdr));
+        this->batch_msgs_[i].msg_hdr.msg_iov = &this->batch_iovecs_[i];
+        this->batch_msgs_[i].msg_hdr.msg_iovlen = 1;
+    }
 }
 
 bool UDPClient::connect() {
@@ -26,6 +46,11 @@ bool UDPClient::connect() {
     setsockopt(this->socket_.native_handle(), SOL_SOCKET, SO_RCVTIMEO, &read_timeout,
                sizeof(read_timeout));
 
+    // A whole frame arrives in one burst, don't let the kernel drop the tail of it
+    int recv_buffer = RECV_BUFFER_BYTES;
+    setsockopt(this->socket_.native_handle(), SOL_SOCKET, SO_RCVBUF, &recv_buffer,
+               sizeof(recv_buffer));
+
     LOG_F(INFO, "Connected to %s on port %d", this->ip.c_str(), this->port);
     return true;
 }
@@ -39,14 +64,16 @@ void UDPClient::setReceiveTimeout(int timeout_ms) {
                sizeof(read_timeout));
 }
 
-bool UDPClient::waitForData() {
+bool UDPClient::waitForData() { return this->waitForData(this->current_timeout_ms_); }
+
+bool UDPClient::waitForData(int timeout_ms) {
     fd_set fds;
     FD_ZERO(&fds);
     FD_SET(this->socket_.native_handle(), &fds);
 
     struct timeval tv;
-    tv.tv_sec = this->current_timeout_ms_ / 1000;
-    tv.tv_usec = (this->current_timeout_ms_ % 1000) * 1000;
+    tv.tv_sec = timeout_ms / 1000;
+    tv.tv_usec = (timeout_ms % 1000) * 1000;
 
     int rv = select(this->socket_.native_handle() + 1, &fds, NULL, NULL, &tv);
 
@@ -60,13 +87,16 @@ bool UDPClient::waitForData() {
     return true;
 }
 
+asio::ip::udp::endpoint UDPClient::serverEndpoint() const {
+    return asio::ip::udp::endpoint(asio::ip::make_address(this->ip), this->port);
+}
+
 // send a request to the server
 bool UDPClient::send(std::uint8_t request) {
     boost::system::error_code ec;
-    asio::ip::udp::endpoint endpoint_(
-        asio::ip::udp::endpoint(asio::ip::make_address(this->ip), this->port));
+    asio::ip::udp::endpoint endpoint_ = this->serverEndpoint();
 
-    LOG_F(INFO, "Sending request %c", request);
+    VLOG_F(DEBUG, "Sending request %c", request);
 
     int bytesSent = this->socket_.send_to(asio::buffer(&request, sizeof(request)),
                                           endpoint_, 0, ec);
@@ -106,11 +136,30 @@ Header UDPClient::recvHeader() {
 }
 
 std::vector<std::uint8_t> UDPClient::recvBody(const int mem_size, const int total_chunks) {
+    std::vector<std::uint8_t> buf;
+    if (!this->recvBody(buf, mem_size, total_chunks)) {
+        return {};
+    }
+    return buf;
+}
+
+bool UDPClient::recvBody(std::vector<std::uint8_t>& buf, const int mem_size,
+                         const int total_chunks) {
+    // no reallocation when buf already held a plane this size
+    buf.resize(mem_size);
+    return this->recvBody(std::span<std::uint8_t>(buf), mem_size, total_chunks);
+}
+
+bool UDPClient::recvBody(std::span<std::uint8_t> buf, const int mem_size,
+                         const int total_chunks) {
     boost::system::error_code ec;
     asio::ip::udp::endpoint sender_endpoint;
 
+    if (mem_size < 0 || static_cast<size_t>(mem_size) != buf.size()) {
+        LOG_F(ERROR, "Plane is %d bytes, expected %zu", mem_size, buf.size());
+        return false;
+    }
     const int bufSize = mem_size;
-    std::vector<std::uint8_t> buf(bufSize);
     std::vector<bool> received_chunks(total_chunks, false);
 
     int chunks_received_count = 0;
@@ -124,7 +173,7 @@ std::vector<std::uint8_t> UDPClient::recvBody(const int mem_size, const int tota
     while (chunks_received_count < total_chunks) {
         if (!this->waitForData()) {
              LOG_F(WARNING, "Timeout waiting for body chunks.");
-             return {};
+             return false;
         }
 
         size_t bytesRead = this->socket_.receive_from(asio::buffer(chunk_buf),
@@ -132,13 +181,16 @@ std::vector<std::uint8_t> UDPClient::recvBody(const int mem_size, const int tota
 
         if (ec) {
              LOG_F(ERROR, "Receive chunk failed: %s", ec.message().c_str());
-             // Return what we have or empty? Returning empty signals failure.
-             return {};
+             return false;
         }
 
         if (bytesRead < sizeof(uint32_t)) continue;
 
         uint32_t chunk_idx = ntohl(*reinterpret_cast<uint32_t*>(chunk_buf));
+        if (chunk_idx >= static_cast<uint32_t>(total_chunks)) {
+             LOG_F(ERROR, "Chunk index %u out of range", chunk_idx);
+             continue;
+        }
         size_t data_size = bytesRead - sizeof(uint32_t);
         size_t offset = chunk_idx * CHUNK_SIZE;
 
@@ -156,8 +208,8 @@ std::vector<std::uint8_t> UDPClient::recvBody(const int mem_size, const int tota
         }
     }
 
-    LOG_F(INFO, "Successfully reconstructed plane: %lu bytes", buf.size());
-    return buf;
+    VLOG_F(DEBUG, "Successfully reconstructed plane: %lu bytes", buf.size());
+    return true;
 }
 
 char UDPClient::recvPing() {
@@ -178,3 +230,288 @@ char UDPClient::recvPing() {
 
     return c;
 }
+
+size_t UDPClient::pathChunkSize() {
+    // IP_MTU is only known once the socket is connected to the server
+    boost::system::error_code ec;
+    this->socket_.connect(this->serverEndpoint(), ec);
+
+    int mtu = 1500;
+    socklen_t len = sizeof(mtu);
+    if (ec || getsockopt(this->socket_.native_handle(), IPPROTO_IP, IP_MTU, &mtu, &len) != 0) {
+        LOG_F(WARNING, "Could not get path MTU to %s, assuming %d", this->ip.c_str(), mtu);
+    }
+
+    // IPv4 header, UDP header, then our own
+    int chunk_size = mtu - 20 - 8 - static_cast<int>(sizeof(ChunkHeader));
+    return std::clamp<size_t>(std::max(chunk_size, 0), CHUNK_SIZE, MAX_CHUNK_SIZE);
+}
+
+bool UDPClient::negotiate(int timeout_ms) {
+    boost::system::error_code ec;
+    this->negotiated_ = false;
+    this->chunk_size_ = CHUNK_SIZE;
+
+    size_t requested = this->pathChunkSize();
+    HelloPacket hello{htonl(HELLO_MAGIC), htonl(static_cast<uint32_t>(requested))};
+    this->socket_.send_to(asio::buffer(&hello, sizeof(hello)), this->serverEndpoint(), 0, ec);
+    if (ec) {
+        LOG_F(WARNING, "Failed to send hello: %s", ec.message().c_str());
+        return false;
+    }
+
+    HelloPacket reply{};
+    size_t bytes_read = 0;
+    if (this->waitForData(timeout_ms)) {
+        asio::ip::udp::endpoint sender_endpoint;
+        bytes_read = this->socket_.receive_from(asio::buffer(&reply, sizeof(reply)),
+                                                sender_endpoint, 0, ec);
+    }
+    if (ec || bytes_read != sizeof(reply) || ntohl(reply.magic) != HELLO_MAGIC) {
+        LOG_F(INFO, "Camera doesn't support selective retransmit, using %zu byte chunks",
+              this->chunk_size_);
+        return false;
+    }
+
+    size_t accepted = ntohl(reply.chunk_size);
+    if (accepted == 0 || accepted > requested) {
+        LOG_F(WARNING, "Camera picked an invalid chunk size %zu, using %zu byte chunks",
+              accepted, this->chunk_size_);
+        return false;
+    }
+
+    this->negotiated_ = true;
+    this->chunk_size_ = accepted;
+    LOG_F(INFO, "Using transport v2 with %zu byte chunks", this->chunk_size_);
+    return true;
+}
+
+bool UDPClient::isNegotiated() const { return this->negotiated_; }
+
+size_t UDPClient::chunkSize() const { return this->chunk_size_; }
+
+TransferStats UDPClient::lastTransferStats() const { return this->last_stats_; }
+
+bool UDPClient::recvFrame(std::vector<std::vector<std::uint8_t>>& planes) {
+    planes.resize(NUM_PLANES);
+    return this->recvFrameInto([&](uint32_t plane, uint32_t mem_size) {
+        planes[plane].resize(mem_size);
+        return planes[plane].data();
+    });
+}
+
+bool UDPClient::recvFrame(const std::array<std::span<std::uint8_t>, NUM_PLANES>& planes) {
+    return this->recvFrameInto([&](uint32_t plane, uint32_t mem_size) -> std::uint8_t* {
+        if (mem_size != planes[plane].size()) {
+            LOG_F(ERROR, "Plane %u is %u bytes, expected %zu", plane, mem_size,
+                  planes[plane].size());
+            return nullptr;
+        }
+        return planes[plane].data();
+    });
+}
+
+bool UDPClient::recvFrameInto(const PlaneBufferFn& plane_buffer) {
+    struct PlaneState {
+        bool has_header = false;
+        uint32_t total_chunks = 0;
+        uint32_t num_received = 0;
+        std::vector<bool> received;
+        std::uint8_t* data = nullptr;
+        size_t mem_size = 0;
+    };
+    std::array<PlaneState, NUM_PLANES> states;
+
+    TransferStats stats;
+    std::optional<uint32_t> frame_id;
+    std::optional<uint32_t> received_before_nack;
+    uint32_t num_received = 0;
+
+    auto complete = [&]() {
+        return std::all_of(states.begin(), states.end(), [](const PlaneState& state) {
+            return state.has_header && state.num_received == state.total_chunks;
+        });
+    };
+
+    // Anything from an older frame (late retransmits) is ignored. The first
+    // datagram from any other frame decides which frame this is.
+    auto acceptFrame = [&](uint32_t id) {
+        if (!frame_id.has_value()) {
+            if (this->last_frame_id_.has_value() && id == this->last_frame_id_.value()) {
+                return false;
+            }
+            frame_id = id;
+        }
+        return id == frame_id.value();
+    };
+
+    const auto deadline =
+        std::chrono::steady_clock::now() + std::chrono::milliseconds(this->current_timeout_ms_);
+    const size_t slot_size = sizeof(ChunkHeader) + MAX_CHUNK_SIZE;
+
+    while (!complete()) {
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0) {
+            LOG_F(WARNING, "Timed out receiving frame (%u of %u chunks)", num_received,
+                  stats.chunks);
+            this->last_stats_ = stats;
+            return false;
+        }
+
+        // Until the frame starts there is nothing to NACK, so wait out the full timeout
+        int wait_ms = static_cast<int>(remaining);
+        if (frame_id.has_value()) {
+            wait_ms = std::min(wait_ms, NACK_IDLE_TIMEOUT_MS);
+        }
+
+        if (!this->waitForData(wait_ms)) {
+            if (!frame_id.has_value()) {
+                continue;
+            }
+            if (stats.nack_rounds >= MAX_NACK_ROUNDS) {
+                LOG_F(WARNING, "Gave up on frame %u after %u NACK rounds", frame_id.value(),
+                      stats.nack_rounds);
+                this->last_stats_ = stats;
+                return false;
+            }
+            if (!received_before_nack.has_value()) {
+                received_before_nack = num_received;
+            }
+
+            for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+                const PlaneState& state = states[plane];
+                std::vector<uint32_t> missing;
+                if (state.has_header) {
+                    for (uint32_t i = 0; i < state.total_chunks; i++) {
+                        if (!state.received[i]) {
+                            missing.push_back(i);
+                        }
+                    }
+                    if (missing.empty()) {
+                        continue;
+                    }
+                }
+                this->sendNacks(frame_id.value(), plane, missing);
+                stats.chunks_nacked += state.has_header ? missing.size() : 1;
+            }
+            stats.nack_rounds++;
+            continue;
+        }
+
+        int num_msgs = recvmmsg(this->socket_.native_handle(), this->batch_msgs_.data(),
+                                RECV_BATCH_SIZE, MSG_DONTWAIT, nullptr);
+        stats.recv_calls++;
+        if (num_msgs < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+                continue;
+            }
+            LOG_F(ERROR, "recvmmsg failed: %s", std::strerror(errno));
+            this->last_stats_ = stats;
+            return false;
+        }
+
+        for (int msg = 0; msg < num_msgs; msg++) {
+            const std::uint8_t* datagram = this->batch_buf_.data() + msg * slot_size;
+            size_t len = this->batch_msgs_[msg].msg_len;
+            if (len < sizeof(uint32_t)) {
+                continue;
+            }
+            uint32_t magic;
+            std::memcpy(&magic, datagram, sizeof(magic));
+            magic = ntohl(magic);
+
+            if (magic == FRAME_MAGIC && len == sizeof(FrameHeader)) {
+                FrameHeader header;
+                std::memcpy(&header, datagram, sizeof(header));
+                uint32_t plane = ntohl(header.plane);
+                if (!acceptFrame(ntohl(header.frame_id)) || plane >= NUM_PLANES ||
+                    states[plane].has_header) {
+                    continue;
+                }
+                uint32_t total_chunks = ntohl(header.total_chunks);
+                uint32_t mem_size = ntohl(header.mem_size);
+                if (total_chunks != (mem_size + this->chunk_size_ - 1) / this->chunk_size_) {
+                    LOG_F(ERROR, "Plane %u header doesn't add up: %u chunks for %u bytes",
+                          plane, total_chunks, mem_size);
+                    continue;
+                }
+                std::uint8_t* data = plane_buffer(plane, mem_size);
+                if (data == nullptr) {
+                    continue;
+                }
+                PlaneState& state = states[plane];
+                state.has_header = true;
+                state.total_chunks = total_chunks;
+                state.received.assign(total_chunks, false);
+                state.data = data;
+                state.mem_size = mem_size;
+                stats.chunks += total_chunks;
+            } else if (magic == CHUNK_MAGIC && len >= sizeof(ChunkHeader)) {
+                ChunkHeader header;
+                std::memcpy(&header, datagram, sizeof(header));
+                uint32_t plane = ntohl(header.plane);
+                uint32_t chunk_idx = ntohl(header.chunk_idx);
+                // Chunks that beat their plane's header get NACKed along with the header
+                if (!acceptFrame(ntohl(header.frame_id)) || plane >= NUM_PLANES ||
+                    !states[plane].has_header || chunk_idx >= states[plane].total_chunks) {
+                    continue;
+                }
+
+                PlaneState& state = states[plane];
+                if (state.received[chunk_idx]) {
+                    stats.duplicates++;
+                    continue;
+                }
+                size_t data_size = len - sizeof(ChunkHeader);
+                size_t offset = static_cast<size_t>(chunk_idx) * this->chunk_size_;
+                if (data_size > this->chunk_size_ || offset + data_size > state.mem_size) {
+                    LOG_F(ERROR, "Chunk %u of plane %u exceeds buffer bounds", chunk_idx, plane);
+                    continue;
+                }
+                std::memcpy(state.data + offset, datagram + sizeof(ChunkHeader),
+                            data_size);
+                state.received[chunk_idx] = true;
+                state.num_received++;
+                num_received++;
+            }
+        }
+    }
+
+    stats.chunks_lost = received_before_nack.has_value()
+                            ? stats.chunks - received_before_nack.value() : 0;
+    this->last_frame_id_ = frame_id;
+    this->last_stats_ = stats;
+
+    if (stats.chunks_lost > 0) {
+        LOG_F(WARNING, "Frame %u lost %u of %u chunks, recovered in %u NACK rounds",
+              frame_id.value(), stats.chunks_lost, stats.chunks, stats.nack_rounds);
+    }
+    return true;
+}
+
+void UDPClient::sendNacks(uint32_t frame_id, uint32_t plane,
+                          const std::vector<uint32_t>& missing) {
+    boost::system::error_code ec;
+    std::vector<uint32_t> packet;
+
+    size_t sent = 0;
+    do {
+        size_t count = std::min(missing.size() - sent, MAX_NACK_INDICES);
+        const size_t header_words = sizeof(NackPacket) / sizeof(uint32_t);
+        packet.resize(header_words + count);
+        NackPacket nack{htonl(NACK_MAGIC), htonl(frame_id), htonl(plane),
+                        htonl(static_cast<uint32_t>(count))};
+        std::memcpy(packet.data(), &nack, sizeof(nack));
+        for (size_t i = 0; i < count; i++) {
+            packet[header_words + i] = htonl(missing[sent + i]);
+        }
+
+        this->socket_.send_to(asio::buffer(packet), this->serverEndpoint(), 0, ec);
+        if (ec) {
+            LOG_F(WARNING, "Failed to send NACK: %s", ec.message().c_str());
+            return;
+        }
+        sent += count;
+    } while (sent < missing.size());
+}
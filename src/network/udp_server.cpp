@@ -1,4 +1,8 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <filesystem>
+#include <thread>
 #include "network/udp_server.hpp"
 
 // TODO: Didn't touch this for the most part since its for mocking.
@@ -26,8 +30,8 @@ cv::Mat UDPServer::createYUV() {
     return yuv_img;
 }
 
-UDPServer::UDPServer(asio::io_context* io_context_, std::string ip, int port)
-    : socket_(*io_context_) {
+UDPServer::UDPServer(asio::io_context* io_context_, std::string ip, int port, double drop_rate)
+    : socket_(*io_context_), drop_rate(drop_rate), rng(std::random_device{}()) {
     this->ip = ip;
     this->port = port;
 }
@@ -63,84 +67,217 @@ bool UDPServer::start() {
     return true;
 }
 
+void UDPServer::setFrame(cv::Mat yuv) { this->frame = yuv; }
+
+void UDPServer::capturePlanes() {
+    cv::Mat img = this->frame.empty() ? createYUV() : this->frame;
+    if (!img.isContinuous()) {
+        img = img.clone();
+    }
+
+    if (img.total() * img.elemSize() != IMG_BUFFER) {
+        std::cout << "size: " << img.total() * img.elemSize() << " expected: " << IMG_BUFFER
+                  << '\n';
+        this->planes.clear();
+        return;
+    }
+
+    // Pad each row out to the stride libcamera uses, like the real camera does
+    const std::uint8_t* src = img.data;
+    this->planes.assign(NUM_PLANES, {});
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        uint32_t width = plane == 0 ? IMG_WIDTH : IMG_WIDTH / 2;
+        uint32_t height = plane == 0 ? IMG_HEIGHT : IMG_HEIGHT / 2;
+        uint32_t stride = plane == 0 ? STRIDE_Y : STRIDE_UV;
+
+        this->planes[plane].assign(static_cast<size_t>(stride) * height, 0);
+        for (uint32_t row = 0; row < height; row++) {
+            memcpy(this->planes[plane].data() + row * stride, src, width);
+            src += width;
+        }
+    }
+}
+
 void UDPServer::send(asio::ip::udp::endpoint & endpoint) {
     // Note: use the endpoint from recv() to send back
 
+    std::cout << "Taking picture (reads in image)" << '\n';
+    this->capturePlanes();
+    if (this->planes.empty()) {
+        return;
+    }
+
+    if (!this->negotiated) {
+        this->sendLegacy(endpoint);
+        return;
+    }
+
+    this->frame_id++;
+    size_t total_chunks = 0;
+    size_t dropped = 0;
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        this->sendFrameHeader(plane, endpoint);
+
+        uint32_t plane_chunks = (this->planes[plane].size() + this->chunk_size - 1) /
+                                this->chunk_size;
+        total_chunks += plane_chunks;
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        for (uint32_t i = 0; i < plane_chunks; i++) {
+            if (dist(this->rng) < this->drop_rate) {
+                dropped++;
+                continue;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            if (!this->sendChunk(plane, i, endpoint)) {
+                return;
+            }
+        }
+    }
+
+    std::cout << "Sent frame " << this->frame_id << ": " << total_chunks << " chunks of "
+              << this->chunk_size << " bytes, dropped " << dropped << '\n';
+}
+
+void UDPServer::sendLegacy(asio::ip::udp::endpoint & endpoint) {
     boost::system::error_code header_ec;
     boost::system::error_code body_ec;
 
-    std::cout << "Taking picture (reads in image)" << '\n';
+    int totalBytesSent = 0;
+    for (const std::vector<std::uint8_t>& imgBuffer : this->planes) {
+        const size_t buf_size = imgBuffer.size();
+        uint32_t total_chunks = (buf_size + CHUNK_SIZE - 1) / CHUNK_SIZE;
 
-    // cv::Mat img = createBGR();
-    cv::Mat img = createYUV();
+        Header header;
 
-    std:: cout << "Putting image into buffer" << '\n';
+        header.magic = htonl(EXPECTED_MAGIC);
+        header.mem_size = htonl(buf_size);
+        header.total_chunks = htonl(total_chunks);
 
-    cv::Mat flatten = img.reshape(1, img.total() * img.channels());
-    std::vector<std::uint8_t> imgBuffer = img.isContinuous() ? flatten : flatten.clone();
+        // send header
+        this->socket_.send_to(asio::buffer(&header, sizeof(header)), endpoint, 0, header_ec);
 
-    if (imgBuffer.size() != IMG_BUFFER) {
-        std::cout << "size: " << imgBuffer.size() << " expected: " << IMG_BUFFER << '\n';
-        return;
-    }
+        if (header_ec) {
+            std::cout << "Sending header failed: " << header_ec.message() << '\n';
+            return;
+        }
 
-    uint32_t total_chunks = imgBuffer.size() / CHUNK_SIZE;
+        // send body
+        for (uint32_t i = 0; i < total_chunks; i++) {
+            const size_t offset = i * CHUNK_SIZE;
+            const size_t remaining = buf_size - offset;
+            const size_t data_size = std::min(CHUNK_SIZE, remaining);
 
-    Header header;
+            std::vector<char> packet(sizeof(uint32_t) + data_size);
 
-    header.magic = htonl(EXPECTED_MAGIC);
-    header.mem_size = htonl(CHUNK_SIZE);
-    header.total_chunks = htonl(total_chunks);
+            // puts chunk index as the header
+            uint32_t* index_ptr = reinterpret_cast<uint32_t*>(packet.data());
+            *index_ptr = htonl(i);
 
-    // send header
-    int bytesSentHeader = this->socket_.send_to(asio::buffer(&header, sizeof(header)),
-                                                endpoint, 0, header_ec);
+            memcpy(packet.data() + sizeof(uint32_t), imgBuffer.data() + offset, data_size);
 
-    if (header_ec) {
-        std::cout << "Sending header failed: " << header_ec.message() << '\n';
-        return;
-    }
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            int bytesSentBody = this->socket_.send_to(asio::buffer(packet), endpoint, 0,
+                                                      body_ec);
 
-    std::cout << "Read bytes (header): " << bytesSentHeader << '\n';
+            totalBytesSent += (bytesSentBody - sizeof(uint32_t));
 
-    // send body
+            if (body_ec) {
+                std::cout << "Sending body failed: " << body_ec.message()  << '\n';
+                return;
+            }
+        }
+    }
 
-    const int buf_size = imgBuffer.size();
+    std::cout << "Finished sending " << totalBytesSent << " bytes" << '\n';
+}
 
-    std::cout << "Total chunks: " << imgBuffer.size() / CHUNK_SIZE << '\n';
+void UDPServer::sendFrameHeader(uint32_t plane, asio::ip::udp::endpoint & endpoint) {
+    boost::system::error_code ec;
+    uint32_t mem_size = this->planes[plane].size();
+    FrameHeader header{htonl(FRAME_MAGIC), htonl(this->frame_id), htonl(plane),
+                       htonl((mem_size + this->chunk_size - 1) / this->chunk_size),
+                       htonl(mem_size)};
+    this->socket_.send_to(asio::buffer(&header, sizeof(header)), endpoint, 0, ec);
+    if (ec) {
+        std::cout << "Sending frame header failed: " << ec.message() << '\n';
+    }
+}
 
-    int totalBytesSent = 0;
+bool UDPServer::sendChunk(uint32_t plane, uint32_t chunk_idx,
+                          asio::ip::udp::endpoint & endpoint) {
+    boost::system::error_code ec;
+    const std::vector<std::uint8_t>& buf = this->planes[plane];
+    const size_t offset = static_cast<size_t>(chunk_idx) * this->chunk_size;
+    if (offset >= buf.size()) {
+        return true;
+    }
+    const size_t data_size = std::min(this->chunk_size, buf.size() - offset);
 
-    for (uint32_t i = 0; i < total_chunks; i++) {
-        const size_t offset = i * CHUNK_SIZE;
-        const size_t remaining = buf_size - offset;
-        const size_t data_size = std::min(CHUNK_SIZE, remaining);
+    ChunkHeader header{htonl(CHUNK_MAGIC), htonl(this->frame_id), htonl(plane),
+                       htonl(chunk_idx)};
+    std::array<asio::const_buffer, 2> packet{
+        asio::buffer(&header, sizeof(header)), asio::buffer(buf.data() + offset, data_size)};
+    this->socket_.send_to(packet, endpoint, 0, ec);
+    if (ec) {
+        std::cout << "Sending chunk failed: " << ec.message() << '\n';
+        return false;
+    }
+    return true;
+}
 
-        std::vector<char> packet(sizeof(uint32_t) + data_size);
+void UDPServer::handleHello(const std::uint8_t* data, asio::ip::udp::endpoint & endpoint) {
+    boost::system::error_code ec;
+    HelloPacket hello;
+    memcpy(&hello, data, sizeof(hello));
 
-        // puts chunk index as the header
-        uint32_t* index_ptr = reinterpret_cast<uint32_t*>(packet.data());
-        *index_ptr = htonl(i);
+    this->chunk_size = std::clamp<size_t>(ntohl(hello.chunk_size), 1, MAX_CHUNK_SIZE);
+    this->negotiated = true;
+    std::cout << "Client said hello, using " << this->chunk_size << " byte chunks" << '\n';
 
+    HelloPacket reply{htonl(HELLO_MAGIC), htonl(static_cast<uint32_t>(this->chunk_size))};
+    this->socket_.send_to(asio::buffer(&reply, sizeof(reply)), endpoint, 0, ec);
+    if (ec) {
+        std::cout << "Sending hello failed: " << ec.message() << '\n';
+    }
+}
 
-        memcpy(packet.data() + sizeof(uint32_t), imgBuffer.data() + offset, data_size);
+void UDPServer::handleNack(const std::uint8_t* data, size_t len,
+                           asio::ip::udp::endpoint & endpoint) {
+    NackPacket nack;
+    memcpy(&nack, data, sizeof(nack));
+    uint32_t nack_frame = ntohl(nack.frame_id);
+    uint32_t plane = ntohl(nack.plane);
+    uint32_t count = ntohl(nack.count);
 
-        std::this_thread::sleep_for(std::chrono::microseconds(50));
-        int bytesSentBody = this->socket_.send_to(asio::buffer(packet), endpoint, 0, body_ec);
+    if (nack_frame != this->frame_id || plane >= this->planes.size()) {
+        std::cout << "Ignoring NACK for frame " << nack_frame << " plane " << plane << '\n';
+        return;
+    }
+    if (len < sizeof(NackPacket) + count * sizeof(uint32_t)) {
+        std::cout << "Truncated NACK" << '\n';
+        return;
+    }
 
-        totalBytesSent += (bytesSentBody - sizeof(uint32_t));
+    if (count == 0) {
+        // the client never got the header, so it needs everything
+        this->sendFrameHeader(plane, endpoint);
+        uint32_t plane_chunks = (this->planes[plane].size() + this->chunk_size - 1) /
+                                this->chunk_size;
+        for (uint32_t i = 0; i < plane_chunks; i++) {
+            if (!this->sendChunk(plane, i, endpoint)) {
+                return;
+            }
+        }
+        return;
+    }
 
-        if (body_ec) {
-            std::cout << "Sending body failed: " << body_ec.message()  << '\n';
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t chunk_idx;
+        memcpy(&chunk_idx, data + sizeof(NackPacket) + i * sizeof(uint32_t), sizeof(chunk_idx));
+        if (!this->sendChunk(plane, ntohl(chunk_idx), endpoint)) {
             return;
         }
     }
-
-    std::cout << "Finished sending " << totalBytesSent << " bytes" << '\n';
-
-    // int bytesSentBody = this->socket_.send_to(asio::buffer(imgBuffer), endpoint, 0, body_ec);
-
-    // std::cout << "Read bytes (body): " << bytesSentBody << '\n';
 }
 
 // expecting a request from the client
@@ -148,18 +285,33 @@ void UDPServer::recv() {
     boost::system::error_code ec;
     asio::ip::udp::endpoint client_endpoint;
 
-    char request;
+    std::array<std::uint8_t, 65536> buf;
 
-    int bytesRead = this->socket_.receive_from(asio::buffer(&request, sizeof(request)),
-                                               client_endpoint, 0, ec);
+    size_t bytesRead = this->socket_.receive_from(asio::buffer(buf), client_endpoint, 0, ec);
 
     if (ec) {
         std::cout << "Failed to read request: " << ec.message() << '\n';
+        return;
     }
 
-    std::cout << "Bytes read (request): " << bytesRead << '\n';
+    // Single byte requests are the original protocol, anything longer is v2
+    if (bytesRead == 1) {
+        handleRequest(static_cast<char>(buf[0]), client_endpoint);
+        return;
+    }
 
-    handleRequest(request, client_endpoint);
+    uint32_t magic = 0;
+    if (bytesRead >= sizeof(magic)) {
+        memcpy(&magic, buf.data(), sizeof(magic));
+        magic = ntohl(magic);
+    }
+    if (magic == HELLO_MAGIC && bytesRead == sizeof(HelloPacket)) {
+        handleHello(buf.data(), client_endpoint);
+    } else if (magic == NACK_MAGIC && bytesRead >= sizeof(NackPacket)) {
+        handleNack(buf.data(), bytesRead, client_endpoint);
+    } else {
+        std::cout << "Invalid packet of " << bytesRead << " bytes" << '\n';
+    }
 }
 
 void UDPServer::handleRequest(char request, asio::ip::udp::endpoint & endpoint) {
@@ -167,8 +319,12 @@ void UDPServer::handleRequest(char request, asio::ip::udp::endpoint & endpoint)
         this->send(endpoint);
     } else if (request == 'e') {
         this->shutdown();
+    } else if (request == 's' || request == 'l') {
+        std::cout << "Unsupported request: " << request << '\n';
     } else {
-        std::cout << "Invalid request: " << request << '\n';
+        // Anything else is a ping, which the camera echoes back
+        boost::system::error_code ec;
+        this->socket_.send_to(asio::buffer(&request, sizeof(request)), endpoint, 0, ec);
     }
 }
 
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <chrono>
+#include <utility>
 
 #include "pathing/environment.hpp"
 #include "ticks/airdrop_prep.hpp"
@@ -74,15 +75,18 @@ Tick* FlySearchTick::tick() {
     LOG_F(INFO, "FlySearch Area reached (%zu, %d)", this->curr_mission_item, curr_waypoint);
         for (int i = 0; i < this->state->config.pathing.coverage.hover.pictures_per_stop; i++) {
         auto photo = this->state->getCamera()->takePicture(500ms, this->state->getMav());
-            if (state->config.camera.save_images_to_file) {
-                photo->saveToFile(state->config.camera.save_dir);
+            if (photo.has_value() && state->config.camera.save_images_to_file) {
+                // Clone since the pipeline draws its detections onto the original
+                this->state->getImageSink()->save(
+                    ImageData{photo->DATA.clone(), photo->TIMESTAMP, photo->TELEMETRY},
+                    state->config.camera.save_dir);
             }
 
             if (photo.has_value()) {
                 // Update the last photo time
                 this->last_photo_time = getUnixTime_ms();
                 // Run the pipeline on the photo
-                this->state->getCV()->runPipeline(photo.value());
+                this->state->getCV()->runPipeline(std::move(photo.value()));
             }
         }
         this->curr_mission_item = curr_waypoint;
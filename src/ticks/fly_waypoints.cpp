@@ -3,6 +3,7 @@
 #include <chrono>
 #include <future>
 #include <memory>
+#include <utility>
 
 #include "pathing/static.hpp"
 #include "ticks/fly_search.hpp"
@@ -57,15 +58,18 @@ Tick* FlyWaypointsTick::tick() {
             auto now = getUnixTime_ms();
             if ((now - this->last_photo_time) >= 300ms) {
                 auto photo = this->state->getCamera()->takePicture(100ms, this->state->getMav());
-                if (state->config.camera.save_images_to_file) {
-                    photo->saveToFile(state->config.camera.save_dir);
+                if (photo.has_value() && state->config.camera.save_images_to_file) {
+                    // Clone since the pipeline draws its detections onto the original
+                    this->state->getImageSink()->save(
+                        ImageData{photo->DATA.clone(), photo->TIMESTAMP, photo->TELEMETRY},
+                        state->config.camera.save_dir);
                 }
 
                 if (photo.has_value()) {
                     // Update the last photo time
                     this->last_photo_time = getUnixTime_ms();
                     // Run the pipeline on the photo
-                    this->state->getCV()->runPipeline(photo.value());
+                    this->state->getCV()->runPipeline(std::move(photo.value()));
                 }
             }
         } else {
@@ -1,9 +1,13 @@
 #include "ticks/manual_landing.hpp"
 
 #include <memory>
+#include <string>
+
+#include <opencv2/imgcodecs.hpp>
 
 #include "cv/mapping.hpp"
 #include "ticks/ids.hpp"
+#include "utilities/common.hpp"
 #include "utilities/constants.hpp"
 
 namespace fs = std::filesystem;
@@ -15,13 +19,10 @@ std::chrono::milliseconds ManualLandingTick::getWait() const { return MANUAL_LAN
 
 Tick* ManualLandingTick::tick() {
     if (state->getDroppedAirdrops().size() >= NUM_AIRDROPS) {
-        if (state->getMappingIsDone() == false) {
-            // Currently does a two pass at the end
-            // Probably should update for next year to optimize it.
-
-            cv::Stitcher::Mode scan_mode = cv::Stitcher::SCANS;
-            // Direct stitching of all images in the mapping folder
-
+        if (state->getMappingIsDone() == false && saveStreamedMap()) {
+            state->setMappingIsDone(true);
+            LOG_F(INFO, "Mapping complete.");
+        } else if (state->getMappingIsDone() == false) {
             fs::path base_dir = "../images/mapping";
             fs::path output_dir = base_dir / "output";
 
@@ -30,18 +31,32 @@ Tick* ManualLandingTick::tick() {
                 fs::create_directories(output_dir);
             }
 
+            // Same memory budget as the streamed map, spilling next to this run's output
+            MosaicParams mosaic_params(state->config.cv);
+            mosaic_params.spill_dir = output_dir / "spill";
+
             // TODO: Change this to be a config setting later
-            Mapping mapper;
+            Mapping mapper(MAPPING_STITCH_THREADS, mosaic_params);
             const int chunk_size = 5;
             const int chunk_overlap = 2;
             const int max_dim = 3000;
 
-            LOG_F(INFO, "First pass stitching...");
-            mapper.firstPass(base_dir.string(), output_dir.string(), chunk_size,
-            chunk_overlap, scan_mode, max_dim, true);
+            // Images saved with telemetry can be placed directly, which doesn't
+            // need any full stitching passes
+            LOG_F(INFO, "Building mosaic from image telemetry...");
+            if (mapper.incrementalPass(base_dir.string(), output_dir.string(), max_dim, true) > 0) {
+                mapper.saveMosaic(output_dir.string());
+            } else {
+                // No telemetry to go off of, fall back to the two pass stitch
+                cv::Stitcher::Mode scan_mode = cv::Stitcher::SCANS;
 
-            LOG_F(INFO, "Second pass stitching...");
-            mapper.secondPass(output_dir.string(), scan_mode, max_dim, true);
+                LOG_F(INFO, "First pass stitching...");
+                mapper.firstPass(base_dir.string(), output_dir.string(), chunk_size,
+                chunk_overlap, scan_mode, max_dim, true);
+
+                LOG_F(INFO, "Second pass stitching...");
+                mapper.secondPass(output_dir.string(), scan_mode, max_dim, true);
+            }
             state->setMappingIsDone(true);
 
             LOG_F(INFO, "Mapping complete.");
@@ -58,3 +73,32 @@ Tick* ManualLandingTick::tick() {
 
     return nullptr;
 }
+
+bool ManualLandingTick::saveStreamedMap() {
+    std::shared_ptr<MosaicIngest> mapper = state->getMapper();
+    if (!mapper) {
+        return false;
+    }
+
+    // Wait for the last frames from the CV aggregator to be placed
+    mapper->flush();
+    MosaicStats stats = mapper->getStats();
+    if (stats.frames_added == 0) {
+        LOG_F(WARNING, "Streamed map is empty, falling back to stitching saved images");
+        return false;
+    }
+    LOG_F(INFO, "Streamed map has %zu frames (%zu refined, %zu skipped, %zu dropped)",
+          stats.frames_added, stats.frames_refined, stats.frames_skipped, mapper->numDropped());
+
+    cv::Mat rendered = mapper->render(MOSAIC_MAX_RENDER_DIM);
+    fs::path output_dir = state->config.cv.mapping.output_dir;
+    fs::create_directories(output_dir);
+    fs::path map_path =
+        output_dir / ("mosaic_" + std::to_string(getUnixTime_s().count()) + ".jpg");
+    if (!cv::imwrite(map_path.string(), rendered)) {
+        LOG_F(ERROR, "Failed to save streamed map to %s", map_path.c_str());
+        return false;
+    }
+    LOG_F(INFO, "Streamed map saved to %s", map_path.c_str());
+    return true;
+}
@@ -3,6 +3,7 @@
 #include <httplib.h>
 
 #include <memory>
+#include <optional>
 #include <string>
 
 #include "core/mission_state.hpp"
@@ -35,10 +36,23 @@ Tick* MissionPrepTick::tick() {
         LOG_F(INFO, "Instantiating CV Aggregator with the following models:");
         LOG_F(INFO, "Yolo Model: %s", yolo_model_dir.c_str());
 
+        // Only search frames over the airdrop boundary
+        PipelineParams params(this->state->config.cv);
+        std::optional<Mission> mission = this->state->mission_params.getCachedMission();
+        if (mission.has_value()) {
+            params.searchBoundary.assign(mission->airdropboundary().begin(),
+                                         mission->airdropboundary().end());
+        }
+
+        // New mission, so start a new map
+        std::shared_ptr<MosaicIngest> mapper = this->state->getMapper();
+        if (mapper) {
+            mapper->reset();
+        }
+
         // Make a CVAggregator instance and set it in the state
-        this->state->setCV(std::make_shared<CVAggregator>(Pipeline(PipelineParams(
-            yolo_model_dir, this->state->config.cv.detection_threshold,
-            this->state->config.cv.input_width, this->state->config.cv.input_height))));
+        this->state->setCV(std::make_shared<CVAggregator>(
+            Pipeline(params), mapper, this->state->config.network.gcs.images.targets));
 
         this->state->setMappingIsDone(false);
         return new PathGenTick(this->state);
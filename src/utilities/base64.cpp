@@ -23,98 +23,167 @@
 
    René Nyffenegger rene.nyffenegger@adp-gmbh.ch
 
+   Altered for obcpp: table driven encode/decode into pre-sized buffers,
+   with NEON encode/decode loops on aarch64.
+
 */
 
 #include "utilities/base64.hpp"
-#include <iostream>
 
-static const std::string base64_chars =
-             "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-             "abcdefghijklmnopqrstuvwxyz"
-             "0123456789+/";
+#include <array>
+#include <cstdint>
+#include <cstring>
 
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
-static inline bool is_base64(unsigned char c) {
-  return (isalnum(c) || (c == '+') || (c == '/'));
-}
+static constexpr char base64_chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+    "abcdefghijklmnopqrstuvwxyz"
+    "0123456789+/";
 
-std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
-  std::string ret;
-  int i = 0;
-  int j = 0;
-  unsigned char char_array_3[3];
-  unsigned char char_array_4[4];
-
-  while (in_len--) {
-    char_array_3[i++] = *(bytes_to_encode++);
-    if (i == 3) {
-      char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-      char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-      char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-      char_array_4[3] = char_array_3[2] & 0x3f;
-
-      for (i = 0; (i <4) ; i++)
-        ret += base64_chars[char_array_4[i]];
-      i = 0;
+// Both characters for every 12 bit value, so 3 input bytes take 2 lookups
+static constexpr std::array<std::array<char, 2>, 4096> base64_pairs = []() {
+    std::array<std::array<char, 2>, 4096> pairs{};
+    for (int i = 0; i < 4096; i++) {
+        pairs[i] = {base64_chars[i >> 6], base64_chars[i & 0x3f]};
     }
-  }
-
-  if (i) {
-    for (j = i; j < 3; j++)
-      char_array_3[j] = '\0';
-
-    char_array_4[0] = (char_array_3[0] & 0xfc) >> 2;
-    char_array_4[1] = ((char_array_3[0] & 0x03) << 4) + ((char_array_3[1] & 0xf0) >> 4);
-    char_array_4[2] = ((char_array_3[1] & 0x0f) << 2) + ((char_array_3[2] & 0xc0) >> 6);
-    char_array_4[3] = char_array_3[2] & 0x3f;
+    return pairs;
+}();
+
+// 6 bit value of every character, 0xff if it isn't part of the alphabet
+static constexpr std::array<uint8_t, 256> base64_values = []() {
+    std::array<uint8_t, 256> values{};
+    values.fill(0xff);
+    for (int i = 0; i < 64; i++) {
+        values[static_cast<unsigned char>(base64_chars[i])] = i;
+    }
+    return values;
+}();
+
+std::size_t base64_encoded_size(std::size_t len) { return (len + 2) / 3 * 4; }
+
+void base64_encode_into(unsigned char const* in, std::size_t len, char* out) {
+    std::size_t i = 0;
+
+#if defined(__aarch64__)
+    // 48 bytes -> 64 characters at a time. vld3 splits every 3rd byte into its
+    // own register, so each output character is a few shifts and one lookup.
+    const auto* alphabet = reinterpret_cast<const uint8_t*>(base64_chars);
+    const uint8x16x4_t lut = {{vld1q_u8(alphabet), vld1q_u8(alphabet + 16),
+                               vld1q_u8(alphabet + 32), vld1q_u8(alphabet + 48)}};
+    const uint8x16_t mask = vdupq_n_u8(0x3f);
+    for (; i + 48 <= len; i += 48) {
+        uint8x16x3_t bytes = vld3q_u8(in + i);
+        uint8x16x4_t idx;
+        idx.val[0] = vshrq_n_u8(bytes.val[0], 2);
+        idx.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(bytes.val[1], 4), vshlq_n_u8(bytes.val[0], 4)),
+                              mask);
+        idx.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(bytes.val[2], 6), vshlq_n_u8(bytes.val[1], 2)),
+                              mask);
+        idx.val[3] = vandq_u8(bytes.val[2], mask);
+
+        uint8x16x4_t chars;
+        for (int k = 0; k < 4; k++) {
+            chars.val[k] = vqtbl4q_u8(lut, idx.val[k]);
+        }
+        vst4q_u8(reinterpret_cast<uint8_t*>(out), chars);
+        out += 64;
+    }
+#endif
 
-    for (j = 0; (j < i + 1); j++)
-      ret += base64_chars[char_array_4[j]];
+    for (; i + 3 <= len; i += 3) {
+        uint32_t group = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        std::memcpy(out, base64_pairs[group >> 12].data(), 2);
+        std::memcpy(out + 2, base64_pairs[group & 0xfff].data(), 2);
+        out += 4;
+    }
 
-    while ((i++ < 3))
-      ret += '=';
-  }
+    const std::size_t rest = len - i;
+    if (rest > 0) {
+        uint32_t group = in[i] << 16;
+        if (rest == 2) {
+            group |= in[i + 1] << 8;
+        }
+        out[0] = base64_chars[(group >> 18) & 0x3f];
+        out[1] = base64_chars[(group >> 12) & 0x3f];
+        out[2] = rest == 2 ? base64_chars[(group >> 6) & 0x3f] : '=';
+        out[3] = '=';
+    }
+}
 
-  return ret;
+std::string base64_encode(unsigned char const* bytes_to_encode, unsigned int in_len) {
+    std::string ret(base64_encoded_size(in_len), '\0');
+    base64_encode_into(bytes_to_encode, in_len, ret.data());
+    return ret;
 }
 
 std::string base64_decode(std::string const& encoded_string) {
-  int in_len = encoded_string.size();
-  int i = 0;
-  int j = 0;
-  int in_ = 0;
-  unsigned char char_array_4[4], char_array_3[3];
-  std::string ret;
-
-  while (in_len-- && (encoded_string[in_] != '=') && is_base64(encoded_string[in_])) {
-    char_array_4[i++] = encoded_string[in_]; in_++;
-    if (i ==4) {
-      for (i = 0; i <4; i++)
-        char_array_4[i] = base64_chars.find(char_array_4[i]);
-
-      char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-      char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-      char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
-
-      for (i = 0; (i < 3); i++)
-        ret += char_array_3[i];
-      i = 0;
+    // Like the original, decode up to the padding or the first character that
+    // isn't base64
+    std::size_t len = 0;
+    while (len < encoded_string.size() &&
+           base64_values[static_cast<unsigned char>(encoded_string[len])] != 0xff) {
+        len++;
     }
-  }
-
-  if (i) {
-    for (j = i; j <4; j++)
-      char_array_4[j] = 0;
 
-    for (j = 0; j <4; j++)
-      char_array_4[j] = base64_chars.find(char_array_4[j]);
-
-    char_array_3[0] = (char_array_4[0] << 2) + ((char_array_4[1] & 0x30) >> 4);
-    char_array_3[1] = ((char_array_4[1] & 0xf) << 4) + ((char_array_4[2] & 0x3c) >> 2);
-    char_array_3[2] = ((char_array_4[2] & 0x3) << 6) + char_array_4[3];
+    const std::size_t num_groups = len / 4;
+    const std::size_t rest = len % 4;
+    std::string ret(num_groups * 3 + (rest > 1 ? rest - 1 : 0), '\0');
+
+    const auto* in = reinterpret_cast<const unsigned char*>(encoded_string.data());
+    char* out = ret.data();
+    std::size_t g = 0;
+
+#if defined(__aarch64__)
+    // 64 characters -> 48 bytes at a time, the encoder's loop backwards. Every
+    // character up to len is already known to be in the alphabet, so all of
+    // them are below 128 and two 64 entry lookups cover every one.
+    const uint8x16x4_t lut_lo = {{vld1q_u8(base64_values.data()),
+                                  vld1q_u8(base64_values.data() + 16),
+                                  vld1q_u8(base64_values.data() + 32),
+                                  vld1q_u8(base64_values.data() + 48)}};
+    const uint8x16x4_t lut_hi = {{vld1q_u8(base64_values.data() + 64),
+                                  vld1q_u8(base64_values.data() + 80),
+                                  vld1q_u8(base64_values.data() + 96),
+                                  vld1q_u8(base64_values.data() + 112)}};
+    const uint8x16_t offset = vdupq_n_u8(64);
+    for (; g + 16 <= num_groups; g += 16, in += 64, out += 48) {
+        uint8x16x4_t chars = vld4q_u8(in);
+        uint8x16x4_t values;
+        for (int k = 0; k < 4; k++) {
+            // Out of range indices give 0 from vqtbl4q and leave the lane alone in vqtbx4q
+            values.val[k] = vqtbx4q_u8(vqtbl4q_u8(lut_lo, chars.val[k]), lut_hi,
+                                       vsubq_u8(chars.val[k], offset));
+        }
+
+        uint8x16x3_t bytes;
+        bytes.val[0] = vorrq_u8(vshlq_n_u8(values.val[0], 2), vshrq_n_u8(values.val[1], 4));
+        bytes.val[1] = vorrq_u8(vshlq_n_u8(values.val[1], 4), vshrq_n_u8(values.val[2], 2));
+        bytes.val[2] = vorrq_u8(vshlq_n_u8(values.val[2], 6), values.val[3]);
+        vst3q_u8(reinterpret_cast<uint8_t*>(out), bytes);
+    }
+#endif
+
+    for (; g < num_groups; g++, in += 4, out += 3) {
+        uint32_t group = (base64_values[in[0]] << 18) | (base64_values[in[1]] << 12) |
+                         (base64_values[in[2]] << 6) | base64_values[in[3]];
+        out[0] = static_cast<char>(group >> 16);
+        out[1] = static_cast<char>(group >> 8);
+        out[2] = static_cast<char>(group);
+    }
 
-    for (j = 0; (j < i - 1); j++) ret += char_array_3[j];
-  }
+    if (rest > 1) {
+        uint32_t group = (base64_values[in[0]] << 18) | (base64_values[in[1]] << 12);
+        if (rest == 3) {
+            group |= base64_values[in[2]] << 6;
+        }
+        out[0] = static_cast<char>(group >> 16);
+        if (rest == 3) {
+            out[1] = static_cast<char>(group >> 8);
+        }
+    }
 
-  return ret;
+    return ret;
 }
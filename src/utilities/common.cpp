@@ -1,17 +1,30 @@
 #include "utilities/common.hpp"
 
+#include <atomic>
 #include <chrono>
 #include <utility>
 #include <vector>
 
 #include "utilities/datatypes.hpp"
 
+namespace {
+std::atomic<UnixTimeSource> time_source{nullptr};
+}  // namespace
+
 std::chrono::seconds getUnixTime_s() {
-    const auto now = std::chrono::system_clock::now();
-    return std::chrono::duration_cast<std::chrono::seconds>(now.time_since_epoch());
+    return std::chrono::duration_cast<std::chrono::seconds>(getUnixTime_ms());
 }
 
 std::chrono::milliseconds getUnixTime_ms() {
+    UnixTimeSource source = time_source.load(std::memory_order_acquire);
+    if (source != nullptr) {
+        return source();
+    }
+
     const auto now = std::chrono::system_clock::now();
     return std::chrono::duration_cast<std::chrono::milliseconds>(now.time_since_epoch());
 }
+
+void setUnixTimeSource(UnixTimeSource source) {
+    time_source.store(source, std::memory_order_release);
+}
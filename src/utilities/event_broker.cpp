@@ -0,0 +1,72 @@
+#include "utilities/event_broker.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "utilities/locks.hpp"
+
+EventBroker::EventBroker() : last_id(0), closed(false), num_subscribers(0) {}
+
+void EventBroker::publish(const std::string& topic, std::string data) {
+    {
+        Lock lock(this->mut);
+        Topic& entry = this->topics[topic];
+        entry.data = std::move(data);
+        entry.id = ++this->last_id;
+    }
+    this->cv.notify_all();
+}
+
+std::vector<Event> EventBroker::waitForEvents(uint64_t* cursor,
+                                              std::chrono::milliseconds timeout) {
+    Lock lock(this->mut);
+    // From before the OBC restarted and the ids started over
+    if (*cursor > this->last_id) {
+        *cursor = 0;
+    }
+    this->cv.wait_for(lock, timeout,
+                      [this, cursor]() { return this->closed || this->last_id > *cursor; });
+
+    std::vector<Event> events;
+    if (this->closed) {
+        return events;
+    }
+    for (const auto& [topic, entry] : this->topics) {
+        if (entry.id > *cursor) {
+            events.push_back(Event{topic, entry.data, entry.id});
+        }
+    }
+    std::sort(events.begin(), events.end(),
+              [](const Event& a, const Event& b) { return a.id < b.id; });
+    *cursor = this->last_id;
+    return events;
+}
+
+void EventBroker::close() {
+    {
+        Lock lock(this->mut);
+        this->closed = true;
+    }
+    this->cv.notify_all();
+}
+
+bool EventBroker::isClosed() {
+    Lock lock(this->mut);
+    return this->closed;
+}
+
+bool EventBroker::trySubscribe(std::size_t max_subscribers) {
+    Lock lock(this->mut);
+    if (this->num_subscribers >= max_subscribers) {
+        return false;
+    }
+    this->num_subscribers++;
+    return true;
+}
+
+void EventBroker::unsubscribe() {
+    Lock lock(this->mut);
+    if (this->num_subscribers > 0) {
+        this->num_subscribers--;
+    }
+}
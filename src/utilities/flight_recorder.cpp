@@ -0,0 +1,391 @@
+#include "utilities/flight_recorder.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "utilities/constants.hpp"
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+static_assert((FLIGHT_RECORDER_THREAD_BUFFER_SIZE & (FLIGHT_RECORDER_THREAD_BUFFER_SIZE - 1)) == 0,
+              "FLIGHT_RECORDER_THREAD_BUFFER_SIZE must be a power of two");
+
+namespace {
+
+/*
+ Byte ring that one thread appends whole records to and the writer thread
+ drains. tail only ever moves past complete records, so everything between
+ head and tail can be copied straight into the file.
+ */
+struct ThreadBuffer {
+    explicit ThreadBuffer(uint16_t id)
+        : id(id), data(new uint8_t[FLIGHT_RECORDER_THREAD_BUFFER_SIZE]) {}
+
+    const uint16_t id;
+    std::unique_ptr<uint8_t[]> data;
+
+    // Writer's line
+    alignas(64) std::atomic<uint64_t> head{0};
+
+    // Recording thread's line
+    alignas(64) std::atomic<uint64_t> tail{0};
+    uint64_t cached_head{0};  // so head is only reread when the buffer looks full
+    std::atomic<uint64_t> dropped{0};
+
+    // Set once the thread is gone, so the writer can forget the buffer once it's empty
+    std::atomic_bool exited{false};
+};
+
+std::mutex buffers_mut;
+std::vector<std::shared_ptr<ThreadBuffer>> buffers;  // guarded by buffers_mut
+uint16_t next_thread_id = 0;                          // guarded by buffers_mut
+
+// Lets the writer know when the thread that owns the buffer exits
+struct ThreadBufferHandle {
+    std::shared_ptr<ThreadBuffer> buffer;
+
+    ~ThreadBufferHandle() {
+        if (this->buffer) {
+            this->buffer->exited.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadBufferHandle this_thread_buffer;
+
+ThreadBuffer* threadBuffer() {
+    if (!this_thread_buffer.buffer) {
+        Lock lock(buffers_mut);
+        this_thread_buffer.buffer = std::make_shared<ThreadBuffer>(next_thread_id++);
+        buffers.push_back(this_thread_buffer.buffer);
+    }
+    return this_thread_buffer.buffer.get();
+}
+
+void copyIn(ThreadBuffer* buffer, uint64_t pos, const void* src, std::size_t size) {
+    const std::size_t offset = pos & (FLIGHT_RECORDER_THREAD_BUFFER_SIZE - 1);
+    const std::size_t first = std::min(size, FLIGHT_RECORDER_THREAD_BUFFER_SIZE - offset);
+    std::memcpy(buffer->data.get() + offset, src, first);
+    std::memcpy(buffer->data.get(), static_cast<const uint8_t*>(src) + first, size - first);
+}
+
+void copyOut(const ThreadBuffer* buffer, uint64_t pos, uint8_t* dst, std::size_t size) {
+    const std::size_t offset = pos & (FLIGHT_RECORDER_THREAD_BUFFER_SIZE - 1);
+    const std::size_t first = std::min(size, FLIGHT_RECORDER_THREAD_BUFFER_SIZE - offset);
+    std::memcpy(dst, buffer->data.get() + offset, first);
+    std::memcpy(dst + first, buffer->data.get(), size - first);
+}
+
+uint64_t nowUs() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+}  // namespace
+
+std::atomic_bool FlightRecorder::recording(false);
+
+std::unique_ptr<FlightRecorder> FlightRecorder::open(const std::string& path) {
+    bool expected = false;
+    if (!FlightRecorder::recording.compare_exchange_strong(expected, true)) {
+        LOG_F(ERROR, "Can't record a flight to %s, already recording one", path.c_str());
+        return nullptr;
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_F(ERROR, "Could not open flight log %s: %s", path.c_str(), std::strerror(errno));
+        FlightRecorder::recording = false;
+        return nullptr;
+    }
+
+    void* map = MAP_FAILED;
+    if (ftruncate(fd, FLIGHT_RECORDER_CHUNK_SIZE) == 0) {
+        map = mmap(nullptr, FLIGHT_RECORDER_CHUNK_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                   0);
+    }
+    if (map == MAP_FAILED) {
+        LOG_F(ERROR, "Could not map flight log %s: %s", path.c_str(), std::strerror(errno));
+        ::close(fd);
+        FlightRecorder::recording = false;
+        return nullptr;
+    }
+
+    FlightLogHeader header{};
+    std::memcpy(header.magic, FLIGHT_LOG_MAGIC, sizeof(header.magic));
+    header.version = FLIGHT_LOG_VERSION;
+    header.start_time_us = nowUs();
+    std::memcpy(map, &header, sizeof(header));
+
+    {
+        // Skip anything left over from the last recorder, and only count what's
+        // dropped from here on
+        Lock lock(buffers_mut);
+        for (auto& buffer : buffers) {
+            buffer->head.store(buffer->tail.load(std::memory_order_acquire),
+                               std::memory_order_release);
+            buffer->dropped = 0;
+        }
+    }
+
+    LOG_F(INFO, "Recording flight to %s", path.c_str());
+    return std::unique_ptr<FlightRecorder>(
+        new FlightRecorder(fd, static_cast<uint8_t*>(map), FLIGHT_RECORDER_CHUNK_SIZE));
+}
+
+FlightRecorder::FlightRecorder(int fd, uint8_t* map, std::size_t map_size)
+    : fd(fd), map(map), map_size(map_size), written(sizeof(FlightLogHeader)), stopping(false) {
+    this->writer = std::thread(&FlightRecorder::_writerLoop, this);
+}
+
+FlightRecorder::~FlightRecorder() {
+    FlightRecorder::recording = false;
+    {
+        Lock lock(this->writer_mut);
+        this->stopping = true;
+    }
+    this->writer_cv.notify_all();
+    this->writer.join();
+
+    // Anything recorded while we were stopping
+    Lock lock(this->writer_mut);
+    this->_flush();
+
+    munmap(this->map, this->map_size);
+    if (ftruncate(this->fd, this->written) != 0) {
+        LOG_F(ERROR, "Could not trim flight log: %s", std::strerror(errno));
+    }
+    ::close(this->fd);
+    LOG_F(INFO, "Flight recorder closed after %lu bytes", this->written);
+}
+
+void FlightRecorder::recordTelemetry(const TelemetryRecord& telemetry) {
+    _record(FlightRecordType::TELEMETRY, &telemetry, sizeof(telemetry));
+}
+
+void FlightRecorder::recordTick(std::optional<TickID> from, std::optional<TickID> to) {
+    if (!isRecording()) {
+        return;
+    }
+
+    TickRecord record{};
+    record.from = from.has_value() ? static_cast<uint8_t>(*from) : FLIGHT_RECORD_NO_TICK;
+    record.to = to.has_value() ? static_cast<uint8_t>(*to) : FLIGHT_RECORD_NO_TICK;
+    _record(FlightRecordType::TICK, &record, sizeof(record));
+}
+
+void FlightRecorder::recordDetections(int run_id, uint64_t image_time_ms,
+                                      const std::vector<DetectionRecord>& detections) {
+    DetectionsRecord record{run_id, static_cast<uint32_t>(detections.size()), image_time_ms};
+    _record(FlightRecordType::DETECTIONS, &record, sizeof(record), detections.data(),
+            detections.size() * sizeof(DetectionRecord));
+}
+
+void FlightRecorder::recordGcsRequest(const std::string& method, const char* route, int status,
+                                      std::chrono::microseconds duration) {
+    if (!isRecording()) {
+        return;
+    }
+
+    std::string request = method + " " + route;
+    GcsRequestRecord record{static_cast<uint16_t>(status),
+                            static_cast<uint16_t>(request.size()),
+                            static_cast<uint32_t>(duration.count())};
+    _record(FlightRecordType::GCS_REQUEST, &record, sizeof(record), request.data(),
+            request.size());
+}
+
+void FlightRecorder::_record(FlightRecordType type, const void* payload, std::size_t size,
+                             const void* extra, std::size_t extra_size) {
+    if (!isRecording()) {
+        return;
+    }
+
+    ThreadBuffer* buffer = threadBuffer();
+    const std::size_t total = sizeof(FlightRecordHeader) + size + extra_size;
+
+    const uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+    if (tail + total - buffer->cached_head > FLIGHT_RECORDER_THREAD_BUFFER_SIZE) {
+        buffer->cached_head = buffer->head.load(std::memory_order_acquire);
+        if (tail + total - buffer->cached_head > FLIGHT_RECORDER_THREAD_BUFFER_SIZE) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    FlightRecordHeader header{static_cast<uint32_t>(size + extra_size),
+                              static_cast<uint16_t>(type), buffer->id, nowUs()};
+    copyIn(buffer, tail, &header, sizeof(header));
+    copyIn(buffer, tail + sizeof(header), payload, size);
+    if (extra_size > 0) {
+        copyIn(buffer, tail + sizeof(header) + size, extra, extra_size);
+    }
+    buffer->tail.store(tail + total, std::memory_order_release);
+}
+
+uint64_t FlightRecorder::dropped() {
+    Lock lock(buffers_mut);
+    uint64_t total = 0;
+    for (const auto& buffer : buffers) {
+        total += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+std::size_t FlightRecorder::size() {
+    Lock lock(this->writer_mut);
+    return this->written;
+}
+
+void FlightRecorder::_writerLoop() {
+    loguru::set_thread_name("flight recorder");
+
+    Lock lock(this->writer_mut);
+    while (!this->stopping) {
+        this->writer_cv.wait_for(lock, FLIGHT_RECORDER_FLUSH_INTERVAL);
+        this->_flush();
+    }
+}
+
+void FlightRecorder::_flush() {
+    std::vector<std::shared_ptr<ThreadBuffer>> snapshot;
+    {
+        Lock lock(buffers_mut);
+        snapshot = buffers;
+    }
+
+    const std::size_t before = this->written;
+    for (const auto& buffer : snapshot) {
+        const uint64_t head = buffer->head.load(std::memory_order_relaxed);
+        const uint64_t tail = buffer->tail.load(std::memory_order_acquire);
+        const std::size_t size = tail - head;
+        if (size == 0) {
+            continue;
+        }
+
+        if (this->_reserve(size)) {
+            copyOut(buffer.get(), head, this->map + this->written, size);
+            this->written += size;
+        }
+        buffer->head.store(tail, std::memory_order_release);
+    }
+
+    {
+        // exited is checked first so a record written just before the thread
+        // exited is never mistaken for an empty buffer
+        Lock lock(buffers_mut);
+        std::erase_if(buffers, [](const std::shared_ptr<ThreadBuffer>& buffer) {
+            return buffer->exited.load(std::memory_order_acquire) &&
+                   buffer->head.load(std::memory_order_relaxed) ==
+                       buffer->tail.load(std::memory_order_acquire);
+        });
+    }
+
+    if (this->written > before) {
+        // Start getting it to disk now rather than all at once when we close
+        msync(this->map, this->written, MS_ASYNC);
+    }
+}
+
+bool FlightRecorder::_reserve(std::size_t size) {
+    if (this->written + size <= this->map_size) {
+        return true;
+    }
+
+    std::size_t new_size = this->map_size;
+    while (new_size < this->written + size) {
+        new_size += FLIGHT_RECORDER_CHUNK_SIZE;
+    }
+
+    if (ftruncate(this->fd, new_size) != 0) {
+        LOG_F(ERROR, "Could not grow flight log: %s", std::strerror(errno));
+        return false;
+    }
+    void* map = mremap(this->map, this->map_size, new_size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        LOG_F(ERROR, "Could not remap flight log: %s", std::strerror(errno));
+        return false;
+    }
+
+    this->map = static_cast<uint8_t*>(map);
+    this->map_size = new_size;
+    return true;
+}
+
+std::vector<DetectionRecord> FlightRecord::detections() const {
+    std::vector<DetectionRecord> detections;
+    auto record = this->as<DetectionsRecord>();
+    if (!record.has_value()) {
+        return detections;
+    }
+
+    const std::size_t fits = (this->payload.size() - sizeof(DetectionsRecord)) /
+                             sizeof(DetectionRecord);
+    detections.resize(std::min<std::size_t>(record->count, fits));
+    std::memcpy(detections.data(), this->payload.data() + sizeof(DetectionsRecord),
+                detections.size() * sizeof(DetectionRecord));
+    return detections;
+}
+
+std::string FlightRecord::gcsRequest() const {
+    auto record = this->as<GcsRequestRecord>();
+    if (!record.has_value()) {
+        return "";
+    }
+    return this->payload.substr(sizeof(GcsRequestRecord), record->request_size);
+}
+
+std::optional<std::vector<FlightRecord>> readFlightLog(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        return {};
+    }
+    std::string contents((std::istreambuf_iterator<char>(file)),
+                         std::istreambuf_iterator<char>());
+
+    FlightLogHeader header;
+    if (contents.size() < sizeof(header)) {
+        return {};
+    }
+    std::memcpy(&header, contents.data(), sizeof(header));
+    if (std::memcmp(header.magic, FLIGHT_LOG_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != FLIGHT_LOG_VERSION) {
+        return {};
+    }
+
+    std::vector<FlightRecord> records;
+    std::size_t pos = sizeof(header);
+    while (contents.size() - pos >= sizeof(FlightRecordHeader)) {
+        FlightRecordHeader record_header;
+        std::memcpy(&record_header, contents.data() + pos, sizeof(record_header));
+        pos += sizeof(record_header);
+
+        if (static_cast<FlightRecordType>(record_header.type) == FlightRecordType::END ||
+            contents.size() - pos < record_header.size) {
+            break;
+        }
+
+        records.push_back(FlightRecord{static_cast<FlightRecordType>(record_header.type),
+                                       record_header.thread, record_header.time_us,
+                                       contents.substr(pos, record_header.size)});
+        pos += record_header.size;
+    }
+
+    std::stable_sort(records.begin(), records.end(),
+                     [](const FlightRecord& a, const FlightRecord& b) {
+                         return a.time_us < b.time_us;
+                     });
+    return records;
+}
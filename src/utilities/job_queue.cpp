@@ -0,0 +1,124 @@
+#include "utilities/job_queue.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <string>
+#include <tuple>
+#include <utility>
+
+#include "utilities/locks.hpp"
+#include "utilities/logging.hpp"
+
+JobQueue::JobQueue(std::size_t history_size)
+    : history_size(history_size), next_id(1), stopping(false) {
+    this->worker = std::thread(&JobQueue::_run, this);
+}
+
+JobQueue::~JobQueue() { this->stop(); }
+
+uint64_t JobQueue::submit(const std::string& name, std::function<JobResult()> fn) {
+    uint64_t id;
+    {
+        Lock lock(this->mut);
+        for (const Job& job : this->jobs) {
+            if (job.name == name && job.state != Job::State::Done) {
+                return job.id;
+            }
+        }
+
+        id = this->next_id++;
+        this->jobs.push_back(Job{id, name, Job::State::Queued, {},
+                                 std::chrono::system_clock::now()});
+        this->pending.emplace_back(id, std::move(fn));
+    }
+    this->cv.notify_one();
+    return id;
+}
+
+std::optional<Job> JobQueue::get(uint64_t id) {
+    Lock lock(this->mut);
+    Job* job = this->_find(id);
+    if (job == nullptr) {
+        return {};
+    }
+    return *job;
+}
+
+std::vector<Job> JobQueue::all() {
+    Lock lock(this->mut);
+    return std::vector<Job>(this->jobs.begin(), this->jobs.end());
+}
+
+void JobQueue::stop() {
+    {
+        Lock lock(this->mut);
+        if (this->stopping) {
+            return;
+        }
+        this->stopping = true;
+    }
+    this->cv.notify_all();
+    this->worker.join();
+
+    // Nothing will run these, so finish them for whoever is polling
+    Lock lock(this->mut);
+    for (const auto& [id, fn] : this->pending) {
+        Job* job = this->_find(id);
+        job->state = Job::State::Done;
+        job->result = JobResult{503, "Job queue stopped before the job ran"};
+    }
+    this->pending.clear();
+}
+
+void JobQueue::_run() {
+    loguru::set_thread_name("jobs");
+
+    while (true) {
+        uint64_t id;
+        std::function<JobResult()> fn;
+        {
+            Lock lock(this->mut);
+            this->cv.wait(lock, [this]() { return this->stopping || !this->pending.empty(); });
+            if (this->stopping) {
+                return;
+            }
+            std::tie(id, fn) = std::move(this->pending.front());
+            this->pending.pop_front();
+            this->_find(id)->state = Job::State::Running;
+        }
+
+        JobResult result;
+        try {
+            result = fn();
+        } catch (const std::exception& e) {
+            LOG_F(ERROR, "Job %s threw: %s", std::to_string(id).c_str(), e.what());
+            result = JobResult{500, e.what()};
+        }
+        // Let go of whatever the job captured before it's marked done
+        fn = nullptr;
+
+        Lock lock(this->mut);
+        Job* job = this->_find(id);
+        job->state = Job::State::Done;
+        job->result = std::move(result);
+
+        // Trim the oldest finished jobs, unfinished ones are still needed
+        std::size_t num_done = std::count_if(this->jobs.begin(), this->jobs.end(),
+            [](const Job& j) { return j.state == Job::State::Done; });
+        auto it = this->jobs.begin();
+        while (num_done > this->history_size && it != this->jobs.end()) {
+            if (it->state == Job::State::Done) {
+                it = this->jobs.erase(it);
+                num_done--;
+            } else {
+                it++;
+            }
+        }
+    }
+}
+
+Job* JobQueue::_find(uint64_t id) {
+    auto it = std::find_if(this->jobs.begin(), this->jobs.end(),
+                           [id](const Job& job) { return job.id == id; });
+    return it == this->jobs.end() ? nullptr : &*it;
+}
@@ -51,12 +51,33 @@ OBCConfig::OBCConfig(int argc, char* argv[]) {
     // to the config file. Otherwise they will be output to the terminal but not saved to
     // the file.
     SET_CONFIG_OPT(logging, dir);
+    SET_CONFIG_OPT(logging, flight_recorder);
     initLogging(this->logging.dir, true, argc, argv);
 
     SET_CONFIG_OPT(network, mavlink, connect);
     SET_CONFIG_OPT(network, mavlink, log_params);
     SET_CONFIG_OPT(network, mavlink, telem_poll_rate);
+    SET_CONFIG_OPT(network, mavlink, upload_timeout_s);
+    SET_CONFIG_OPT(network, mavlink, partial_upload);
+    SET_CONFIG_OPT(network, airdrop, redundancy);
+    SET_CONFIG_OPT(network, airdrop, retransmit_ms);
+    SET_CONFIG_OPT(network, airdrop, max_retransmits);
     SET_CONFIG_OPT(network, gcs, port);
+    SET_CONFIG_OPT(network, gcs, events, telemetry_rate_hz);
+    SET_CONFIG_OPT(network, gcs, events, connections_rate_hz);
+    SET_CONFIG_OPT(network, gcs, server, threads);
+    SET_CONFIG_OPT(network, gcs, server, keep_alive_max_count);
+    SET_CONFIG_OPT(network, gcs, server, keep_alive_timeout_s);
+    SET_CONFIG_OPT(network, gcs, server, read_timeout_s);
+    SET_CONFIG_OPT(network, gcs, server, write_timeout_s);
+    SET_CONFIG_OPT(network, gcs, server, payload_max_mb);
+    SET_CONFIG_OPT(network, gcs, server, slow_request_ms);
+    SET_CONFIG_OPT(network, gcs, images, capture, quality);
+    SET_CONFIG_OPT(network, gcs, images, capture, max_dim);
+    SET_CONFIG_OPT(network, gcs, images, capture, denoise);
+    SET_CONFIG_OPT(network, gcs, images, targets, quality);
+    SET_CONFIG_OPT(network, gcs, images, targets, max_dim);
+    SET_CONFIG_OPT(network, gcs, images, targets, denoise);
 
     SET_CONFIG_OPT(pathing, laps);
     SET_CONFIG_OPT(pathing, rrt, iterations_per_waypoint);
@@ -82,6 +103,15 @@ OBCConfig::OBCConfig(int argc, char* argv[]) {
     SET_CONFIG_OPT(cv, detection_threshold);
     SET_CONFIG_OPT(cv, input_width);
     SET_CONFIG_OPT(cv, input_height);
+    SET_CONFIG_OPT(cv, tiling, enabled);
+    SET_CONFIG_OPT(cv, tiling, tile_size);
+    SET_CONFIG_OPT(cv, tiling, overlap);
+    SET_CONFIG_OPT(cv, mapping, enabled);
+    SET_CONFIG_OPT(cv, mapping, max_dim);
+    SET_CONFIG_OPT(cv, mapping, meters_per_px);
+    SET_CONFIG_OPT(cv, mapping, output_dir);
+    SET_CONFIG_OPT(cv, mapping, min_zoom);
+    SET_CONFIG_OPT(cv, mapping, memory_budget_mb);
     SET_CONFIG_OPT_VARIANT(AirdropDropMethod, pathing, approach, drop_method);
     SET_CONFIG_OPT(pathing, approach, drop_angle_rad);
     SET_CONFIG_OPT(pathing, approach, drop_altitude_m);
@@ -0,0 +1,57 @@
+#include "utilities/replay_clock.hpp"
+
+#include <chrono>
+
+#include "utilities/common.hpp"
+
+std::atomic<ReplayClock*> ReplayClock::installed(nullptr);
+
+ReplayClock::ReplayClock(uint64_t start_ms, double speed)
+    : start_ms(start_ms),
+      speed_factor(speed),
+      started(std::chrono::steady_clock::now()),
+      advanced_ms(0) {}
+
+ReplayClock::~ReplayClock() { this->uninstall(); }
+
+bool ReplayClock::install() {
+    ReplayClock* expected = nullptr;
+    if (!ReplayClock::installed.compare_exchange_strong(expected, this)) {
+        return expected == this;
+    }
+    setUnixTimeSource(&ReplayClock::installedNow);
+    return true;
+}
+
+void ReplayClock::uninstall() {
+    if (ReplayClock::installed.load() == this) {
+        setUnixTimeSource(nullptr);
+        ReplayClock::installed = nullptr;
+    }
+}
+
+uint64_t ReplayClock::nowMs() const {
+    uint64_t now_ms = this->start_ms + this->advanced_ms.load(std::memory_order_acquire);
+    if (this->speed_factor > 0) {
+        std::chrono::duration<double, std::milli> elapsed =
+            std::chrono::steady_clock::now() - this->started;
+        now_ms += static_cast<uint64_t>(elapsed.count() * this->speed_factor);
+    }
+    return now_ms;
+}
+
+double ReplayClock::speed() const { return this->speed_factor; }
+
+void ReplayClock::advance(std::chrono::milliseconds by) {
+    this->advanced_ms.fetch_add(by.count(), std::memory_order_acq_rel);
+}
+
+std::chrono::milliseconds ReplayClock::installedNow() {
+    ReplayClock* clock = ReplayClock::installed.load(std::memory_order_acquire);
+    if (clock == nullptr) {
+        // Uninstalled while this call was on its way here
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch());
+    }
+    return std::chrono::milliseconds(clock->nowMs());
+}
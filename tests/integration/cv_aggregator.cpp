@@ -4,6 +4,7 @@
 #include <loguru.hpp>
 #include <opencv2/opencv.hpp>
 #include <thread>
+#include <utility>
 #include <vector>
 
 #include "cv/aggregator.hpp"
@@ -56,7 +57,7 @@ int main() {
         }
         // Create an ImageData instance for each image
         ImageData imageData(image, 0, mockTelemetry);
-        aggregator.runPipeline(imageData);
+        aggregator.runPipeline(std::move(imageData));
     }
 
     // Let the worker threads finish
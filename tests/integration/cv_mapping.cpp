@@ -65,6 +65,13 @@ int main() {
         std::cout << "==> Merging all partial chunk images into final...\n";
         mapper.secondPass(output_dir.string(), scan_mode, max_dim, true);
 
+        StitchTimings timings = mapper.getTimings();
+        std::cout << "Stitching time (ms): features " << timings.find_features_ms
+                  << ", matching " << timings.matching_ms
+                  << ", bundle adjust " << timings.bundle_adjust_ms
+                  << ", warp " << timings.warp_ms
+                  << ", blend " << timings.blend_ms << "\n";
+
         std::cout << "Integration test completed.\n";
     } catch (const std::exception& e) {
         std::cerr << "Exception in incremental integration test: " << e.what() << "\n";
@@ -153,6 +160,36 @@ int main() {
         return 1;
     }
 
+    // =========================================================================
+    // Test 3: Incremental Mosaic Integration Test
+    // Only places images that have a <timestamp>.json telemetry file next to them
+    // =========================================================================
+    std::cout << "\n" << std::string(60, '=') << "\n";
+    std::cout << "Starting Incremental Mosaic Integration Test\n";
+    std::cout << std::string(60, '=') << "\n";
+
+    try {
+        fs::path base_dir = "../tests/integration/mapping";
+        fs::path direct_test_dir = base_dir / "direct_test_images";
+        fs::path mosaic_output_dir = base_dir / "mosaic_output";
+
+        Mapping mosaic_mapper;
+        const int max_dim = 3000;
+        int num_added = mosaic_mapper.incrementalPass(direct_test_dir.string(),
+                                                      mosaic_output_dir.string(), max_dim, true);
+        std::cout << "Added " << num_added << " images to the mosaic.\n";
+
+        if (num_added > 0 && mosaic_mapper.saveMosaic(mosaic_output_dir.string())) {
+            std::cout << "Check the following directory for results: " << mosaic_output_dir
+                      << "\n";
+        } else {
+            std::cout << "No images with telemetry found, skipping mosaic output.\n";
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Exception in incremental mosaic integration test: " << e.what() << "\n";
+        return 1;
+    }
+
     std::cout << "\n" << std::string(60, '=') << "\n";
     std::cout << "All integration tests completed successfully!\n";
     std::cout << std::string(60, '=') << "\n";
@@ -0,0 +1,203 @@
+#include <cstdio>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "ticks/ids.hpp"
+#include "utilities/flight_recorder.hpp"
+
+/**
+ * Exports a flight log written by FlightRecorder for looking at after a flight.
+ *
+ * arg 1 --> flight log (<logging.dir>/<unix time>.flight)
+ * arg 2 --> json (default) for one JSON object per line, or csv
+ * arg 3 --> only this record type: telemetry, ticks, detections or gcs.
+ *           Required for csv, since each type has different columns.
+ *
+ * e.g. bin/flight_log logs/1718000000.flight csv telemetry > telemetry.csv
+ */
+
+namespace {
+
+std::optional<FlightRecordType> parseType(const std::string& type) {
+    if (type == "telemetry") return FlightRecordType::TELEMETRY;
+    if (type == "ticks") return FlightRecordType::TICK;
+    if (type == "detections") return FlightRecordType::DETECTIONS;
+    if (type == "gcs") return FlightRecordType::GCS_REQUEST;
+    return {};
+}
+
+std::string tickName(uint8_t id) {
+    if (id == FLIGHT_RECORD_NO_TICK) {
+        return "Null";
+    }
+    return TICK_ID_TO_STR(static_cast<TickID>(id));
+}
+
+nlohmann::json toJson(const FlightRecord& record) {
+    nlohmann::json out = {{"time_us", record.time_us}, {"thread", record.thread}};
+
+    switch (record.type) {
+        case FlightRecordType::TELEMETRY: {
+            auto t = record.as<TelemetryRecord>().value_or(TelemetryRecord{});
+            out["type"] = "telemetry";
+            out["latitude_deg"] = t.latitude_deg;
+            out["longitude_deg"] = t.longitude_deg;
+            out["altitude_agl_m"] = t.altitude_agl_m;
+            out["altitude_msl_m"] = t.altitude_msl_m;
+            out["groundspeed_m_s"] = t.groundspeed_m_s;
+            out["airspeed_m_s"] = t.airspeed_m_s;
+            out["heading_deg"] = t.heading_deg;
+            out["yaw_deg"] = t.yaw_deg;
+            out["pitch_deg"] = t.pitch_deg;
+            out["roll_deg"] = t.roll_deg;
+            out["armed"] = t.armed != 0;
+            out["flight_mode"] = t.flight_mode;
+            break;
+        }
+        case FlightRecordType::TICK: {
+            auto t = record.as<TickRecord>().value_or(TickRecord{});
+            out["type"] = "tick";
+            out["from"] = tickName(t.from);
+            out["to"] = tickName(t.to);
+            break;
+        }
+        case FlightRecordType::DETECTIONS: {
+            auto run = record.as<DetectionsRecord>().value_or(DetectionsRecord{});
+            out["type"] = "detections";
+            out["run_id"] = run.run_id;
+            out["image_time_ms"] = run.image_time_ms;
+            out["detections"] = nlohmann::json::array();
+            for (const auto& det : record.detections()) {
+                out["detections"].push_back({{"latitude_deg", det.latitude_deg},
+                                             {"longitude_deg", det.longitude_deg},
+                                             {"altitude_m", det.altitude_m},
+                                             {"bbox", {det.x1, det.y1, det.x2, det.y2}}});
+            }
+            break;
+        }
+        case FlightRecordType::GCS_REQUEST: {
+            auto req = record.as<GcsRequestRecord>().value_or(GcsRequestRecord{});
+            out["type"] = "gcs";
+            out["request"] = record.gcsRequest();
+            out["status"] = req.status;
+            out["duration_us"] = req.duration_us;
+            break;
+        }
+        default:
+            out["type"] = static_cast<int>(record.type);
+            break;
+    }
+    return out;
+}
+
+void printCsvHeader(FlightRecordType type) {
+    switch (type) {
+        case FlightRecordType::TELEMETRY:
+            std::printf("time_us,latitude_deg,longitude_deg,altitude_agl_m,altitude_msl_m,"
+                        "groundspeed_m_s,airspeed_m_s,heading_deg,yaw_deg,pitch_deg,roll_deg,"
+                        "armed,flight_mode\n");
+            break;
+        case FlightRecordType::TICK:
+            std::printf("time_us,from,to\n");
+            break;
+        case FlightRecordType::DETECTIONS:
+            // One row per detection
+            std::printf("time_us,run_id,image_time_ms,latitude_deg,longitude_deg,altitude_m,"
+                        "x1,y1,x2,y2\n");
+            break;
+        case FlightRecordType::GCS_REQUEST:
+            std::printf("time_us,request,status,duration_us\n");
+            break;
+        default:
+            break;
+    }
+}
+
+void printCsvRow(const FlightRecord& record) {
+    switch (record.type) {
+        case FlightRecordType::TELEMETRY: {
+            auto t = record.as<TelemetryRecord>().value_or(TelemetryRecord{});
+            std::printf("%lu,%.8f,%.8f,%.3f,%.3f,%.3f,%.3f,%.2f,%.2f,%.2f,%.2f,%d,%d\n",
+                        record.time_us, t.latitude_deg, t.longitude_deg, t.altitude_agl_m,
+                        t.altitude_msl_m, t.groundspeed_m_s, t.airspeed_m_s, t.heading_deg,
+                        t.yaw_deg, t.pitch_deg, t.roll_deg, t.armed, t.flight_mode);
+            break;
+        }
+        case FlightRecordType::TICK: {
+            auto t = record.as<TickRecord>().value_or(TickRecord{});
+            std::printf("%lu,%s,%s\n", record.time_us, tickName(t.from).c_str(),
+                        tickName(t.to).c_str());
+            break;
+        }
+        case FlightRecordType::DETECTIONS: {
+            auto run = record.as<DetectionsRecord>().value_or(DetectionsRecord{});
+            for (const auto& det : record.detections()) {
+                std::printf("%lu,%d,%lu,%.8f,%.8f,%.3f,%d,%d,%d,%d\n", record.time_us,
+                            run.run_id, run.image_time_ms, det.latitude_deg, det.longitude_deg,
+                            det.altitude_m, det.x1, det.y1, det.x2, det.y2);
+            }
+            break;
+        }
+        case FlightRecordType::GCS_REQUEST: {
+            auto req = record.as<GcsRequestRecord>().value_or(GcsRequestRecord{});
+            std::printf("%lu,%s,%u,%u\n", record.time_us, record.gcsRequest().c_str(),
+                        req.status, req.duration_us);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0]
+                  << " <flight log> [json|csv] [telemetry|ticks|detections|gcs]" << std::endl;
+        return 1;
+    }
+
+    const std::string format = (argc >= 3) ? argv[2] : "json";
+    std::optional<FlightRecordType> only;
+    if (argc >= 4) {
+        only = parseType(argv[3]);
+        if (!only.has_value()) {
+            std::cerr << "unknown record type " << argv[3] << std::endl;
+            return 1;
+        }
+    }
+    if (format != "json" && format != "csv") {
+        std::cerr << "unknown format " << format << std::endl;
+        return 1;
+    }
+    if (format == "csv" && !only.has_value()) {
+        std::cerr << "csv needs a record type" << std::endl;
+        return 1;
+    }
+
+    auto records = readFlightLog(argv[1]);
+    if (!records.has_value()) {
+        std::cerr << argv[1] << " is not a flight log" << std::endl;
+        return 1;
+    }
+
+    if (format == "csv") {
+        printCsvHeader(*only);
+    }
+    for (const auto& record : *records) {
+        if (only.has_value() && record.type != *only) {
+            continue;
+        }
+        if (format == "csv") {
+            printCsvRow(record);
+        } else {
+            std::printf("%s\n", toJson(record).dump().c_str());
+        }
+    }
+    return 0;
+}
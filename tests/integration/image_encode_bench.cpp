@@ -0,0 +1,127 @@
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <opencv2/opencv.hpp>
+
+#include "camera/interface.hpp"
+#include "camera/jpeg_encoder.hpp"
+#include "cv/utilities.hpp"
+#include "utilities/base64.hpp"
+#include "utilities/obc_config.hpp"
+
+/**
+ * Compares how fast images for the GCS get encoded, on a full resolution
+ * 1456x1088 frame:
+ *  - the byte at a time base64 encoder it used to use vs base64_encode
+ *  - compressImg + cvMatToBase64 (what GET /camera/capture and the CV
+ *    aggregator used to do) vs JpegEncoder with a few configs
+ *
+ * arg 1 --> image to encode (optional, a synthetic frame is used otherwise)
+ * arg 2 --> iterations (default 10)
+ */
+
+namespace {
+// The old utilities/base64.cpp encoder, appending one character at a time
+std::string naiveBase64(const unsigned char* bytes, std::size_t len) {
+    static const char chars[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string ret;
+    std::size_t i = 0;
+    for (; i + 3 <= len; i += 3) {
+        ret += chars[bytes[i] >> 2];
+        ret += chars[((bytes[i] & 0x03) << 4) | (bytes[i + 1] >> 4)];
+        ret += chars[((bytes[i + 1] & 0x0f) << 2) | (bytes[i + 2] >> 6)];
+        ret += chars[bytes[i + 2] & 0x3f];
+    }
+    if (i < len) {
+        unsigned char rest[3] = {bytes[i], i + 1 < len ? bytes[i + 1] : unsigned char{0}, 0};
+        ret += chars[rest[0] >> 2];
+        ret += chars[((rest[0] & 0x03) << 4) | (rest[1] >> 4)];
+        ret += i + 1 < len ? chars[(rest[1] & 0x0f) << 2] : '=';
+        ret += '=';
+    }
+    return ret;
+}
+
+// Average ms per call of fn
+double timeIt(int iterations, const std::function<void()>& fn) {
+    fn();  // warm up, e.g. so the encoders have their buffers
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) {
+        fn();
+    }
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+void report(const char* name, double ms, std::size_t bytes_in, std::size_t bytes_out) {
+    std::printf("%-36s %9.2f ms  %8.1f MB/s in  %9zu bytes out\n", name, ms,
+                bytes_in / 1e6 / (ms / 1e3), bytes_out);
+}
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    cv::Mat image;
+    if (argc > 1) {
+        image = cv::imread(argv[1]);
+        if (image.empty()) {
+            std::fprintf(stderr, "Error: Failed to load image: %s\n", argv[1]);
+            return 1;
+        }
+    } else {
+        // Smooth with some noise, so it compresses about like a real frame
+        image.create(1088, 1456, CV_8UC3);
+        for (int r = 0; r < image.rows; r++) {
+            for (int c = 0; c < image.cols; c++) {
+                image.at<cv::Vec3b>(r, c) = cv::Vec3b(r % 256, c % 256, (r + c) % 256);
+            }
+        }
+        cv::Mat noise(image.size(), CV_8UC3);
+        cv::randn(noise, 0, 12);
+        image += noise;
+    }
+    const int iterations = argc > 2 ? std::stoi(argv[2]) : 10;
+    const std::size_t frame_bytes = image.total() * image.elemSize();
+    std::printf("%dx%d frame, %d iterations\n\n", image.cols, image.rows, iterations);
+
+    std::vector<uchar> jpeg;
+    cv::imencode(".jpg", image, jpeg);
+
+    std::string out;
+    report("base64 byte at a time (old)",
+           timeIt(iterations, [&]() { out = naiveBase64(jpeg.data(), jpeg.size()); }),
+           jpeg.size(), out.size());
+    report("base64_encode",
+           timeIt(iterations, [&]() { out = base64_encode(jpeg.data(), jpeg.size()); }),
+           jpeg.size(), out.size());
+    if (out != naiveBase64(jpeg.data(), jpeg.size())) {
+        std::fprintf(stderr, "Error: base64_encode doesn't match the old encoder\n");
+        return 1;
+    }
+    std::string decoded;
+    report("base64_decode", timeIt(iterations, [&]() { decoded = base64_decode(out); }),
+           out.size(), decoded.size());
+    std::printf("\n");
+
+    report("compressImg + cvMatToBase64 (old)", timeIt(iterations, [&]() {
+               std::optional<cv::Mat> compressed = compressImg(image);
+               out = cvMatToBase64(compressed.value_or(image));
+           }), frame_bytes, out.size());
+
+    const std::pair<const char*, ImageEncodingConfig> configs[] = {
+        {"JpegEncoder q80 full res", {80, 0, false}},
+        {"JpegEncoder q60 1024px", {60, 1024, false}},
+        {"JpegEncoder q60 1024px denoised", {60, 1024, true}},
+        {"JpegEncoder q60 full res denoised", {60, 0, true}},
+    };
+    for (const auto& [name, config] : configs) {
+        JpegEncoder encoder(config);
+        report(name, timeIt(iterations, [&]() { out = encoder.encodeBase64(image); }),
+               frame_bytes, out.size());
+    }
+    return 0;
+}
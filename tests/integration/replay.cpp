@@ -0,0 +1,293 @@
+#include <httplib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera/replay.hpp"
+#include "core/mission_state.hpp"
+#include "core/obc.hpp"
+#include "cv/aggregator.hpp"
+#include "network/replay_mavlink.hpp"
+#include "ticks/ids.hpp"
+#include "utilities/flight_recorder.hpp"
+#include "utilities/http.hpp"
+#include "utilities/logging.hpp"
+#include "utilities/obc_config.hpp"
+#include "utilities/replay_clock.hpp"
+
+/**
+ * Replays a recorded flight through the whole OBC, tick state machine and
+ * all, then reports how long each tick and each CV pipeline stage took.
+ *
+ * The autopilot is a ReplayMavlinkClient playing back the flight log's
+ * telemetry, and the camera a ReplayCamera playing back the images saved on
+ * the flight. Everything runs on a ReplayClock set to when the flight was
+ * recorded. This sends the GCS requests the OBC waits on itself, at the times
+ * they were recorded if the flight log has them.
+ *
+ * arg 1-4 --> same as bin/obcpp (configs dir, config, plane, flight type)
+ * arg 5   --> flight log written by FlightRecorder
+ * arg 6   --> directory of the flight's images (<unix ms>.jpg)
+ * arg 7   --> how many times faster than real time to replay. 0 (default)
+ *             runs as fast as possible, and runs the same way every time:
+ *             the clock only moves between ticks, once the CV has caught up.
+ * arg 8   --> mission to upload, ../tests/integration/util/mission_data_2024.json
+ *             by default
+ *
+ * e.g. bin/replay ../configs dev stickbug sitl logs/1718000000.flight images/
+ */
+
+using namespace std::chrono_literals;  // NOLINT
+
+namespace {
+
+// A GCS request the OBC waits on, and the tick it waits for it in
+struct GcsStep {
+    TickID tick;
+    std::string route;
+    std::string body;
+};
+
+// Recorded times of every request sent to each route, oldest first
+std::map<std::string, std::deque<uint64_t>> recordedRequests(
+    const std::vector<FlightRecord>& records) {
+    std::map<std::string, std::deque<uint64_t>> requests;
+    for (const FlightRecord& record : records) {
+        if (record.type != FlightRecordType::GCS_REQUEST) {
+            continue;
+        }
+        // "METHOD /route"
+        const std::string request = record.gcsRequest();
+        const std::size_t space = request.find(' ');
+        if (space != std::string::npos) {
+            requests[request.substr(space + 1)].push_back(record.time_us / 1000);
+        }
+    }
+    return requests;
+}
+
+bool post(httplib::Client* gcs, const std::string& route, const std::string& body) {
+    // The GCS server may still be starting up
+    for (int attempt = 0; attempt < 50; attempt++) {
+        auto response = gcs->Post(route, body, mime::json);
+        if (response) {
+            LOG_F(INFO, "Replay: POST %s -> %d", route.c_str(), response->status);
+            return response->status == OK;
+        }
+        std::this_thread::sleep_for(100ms);
+    }
+    LOG_F(ERROR, "Replay: could not reach the GCS server for POST %s", route.c_str());
+    return false;
+}
+
+// Ticks that wait on work done in the background. Those waits are taken for
+// real even when replaying as fast as possible, so the work gets done.
+bool waitsOnBackgroundWork(TickID tick) {
+    return tick == TickID::PathGen || tick == TickID::MavUpload ||
+           tick == TickID::ActiveTakeoff;
+}
+
+struct TickTimes {
+    std::vector<int64_t> took_us;  // how long each doTick took
+    uint64_t replayed_ms = 0;      // time on the replay clock spent in the tick
+};
+
+double percentileMs(const std::vector<int64_t>& sorted_us, double p) {
+    const std::size_t i =
+        std::min(sorted_us.size() - 1, static_cast<std::size_t>(p * sorted_us.size()));
+    return sorted_us[i] / 1000.0;
+}
+
+void printTickReport(const std::map<TickID, TickTimes>& ticks) {
+    std::printf("\n%-16s %7s %9s %9s %9s %9s %11s\n", "tick", "runs", "mean ms", "p50 ms",
+                "p95 ms", "max ms", "replayed s");
+    for (auto [id, times] : ticks) {
+        std::sort(times.took_us.begin(), times.took_us.end());
+        int64_t total_us = 0;
+        for (int64_t us : times.took_us) {
+            total_us += us;
+        }
+        std::printf("%-16s %7zu %9.3f %9.3f %9.3f %9.3f %11.1f\n", TICK_ID_TO_STR(id),
+                    times.took_us.size(), total_us / 1000.0 / times.took_us.size(),
+                    percentileMs(times.took_us, 0.5), percentileMs(times.took_us, 0.95),
+                    times.took_us.back() / 1000.0, times.replayed_ms / 1000.0);
+    }
+}
+
+void printStageReport(const PipelineStageStats& stats) {
+    const std::pair<const char*, PipelineStageStats::Stage> stages[] = {
+        {"preprocess", stats.preprocess}, {"roi gate", stats.roi_gate},
+        {"detect", stats.detect},         {"localize", stats.localize},
+        {"annotate", stats.annotate},
+    };
+
+    std::printf("\n%-16s %7s %9s %9s %11s\n", "cv stage", "runs", "mean ms", "max ms",
+                "total s");
+    for (const auto& [name, stage] : stages) {
+        const double total_ms = stage.total.count() / 1000.0;
+        std::printf("%-16s %7lu %9.3f %9.3f %11.3f\n", name, stage.count,
+                    stage.count > 0 ? total_ms / stage.count : 0.0, stage.max.count() / 1000.0,
+                    total_ms / 1000.0);
+    }
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 7) {
+        std::cerr << "usage: " << argv[0]
+                  << " <configs dir> <config> <plane> <flight type> <flight log> <image dir>"
+                  << " [speed] [mission json]" << std::endl;
+        return 1;
+    }
+
+    const std::string flight_log = argv[5];
+    const std::string image_dir = argv[6];
+    const double speed = (argc >= 8) ? std::stod(argv[7]) : 0.0;
+    const std::string mission_file =
+        (argc >= 9) ? argv[8] : "../tests/integration/util/mission_data_2024.json";
+
+    char* config_argv[] = {argv[0], argv[1], argv[2], argv[3], argv[4]};
+    OBCConfig config(5, config_argv);
+    // Don't record the replay
+    config.logging.flight_recorder = false;
+
+    auto records = readFlightLog(flight_log);
+    if (!records.has_value()) {
+        std::cerr << flight_log << " is not a flight log" << std::endl;
+        return 1;
+    }
+    ReplayFlight flight = makeReplayFlight(*records);
+    if (flight.telemetry.empty()) {
+        std::cerr << flight_log << " has no telemetry to replay" << std::endl;
+        return 1;
+    }
+
+    std::ifstream mission_in(mission_file);
+    if (!mission_in) {
+        std::cerr << "could not open " << mission_file << std::endl;
+        return 1;
+    }
+    std::stringstream mission;
+    mission << mission_in.rdbuf();
+
+    // Take off however the recorded flight did
+    std::map<std::string, std::deque<uint64_t>> requests = recordedRequests(*records);
+    std::string takeoff = "/takeoff/manual";
+    if (requests.contains("/takeoff/autonomous") &&
+        (!requests.contains("/takeoff/manual") ||
+         requests["/takeoff/autonomous"].front() < requests["/takeoff/manual"].front())) {
+        takeoff = "/takeoff/autonomous";
+    }
+    const std::vector<GcsStep> steps = {
+        {TickID::MissionPrep, "/mission", mission.str()},
+        {TickID::PathValidate, "/path/initial/validate", ""},
+        {TickID::WaitForTakeoff, takeoff, ""},
+        // No targets, which keeps the ones the OBC clustered itself
+        {TickID::CVLoiter, "/targets/matched", "[]"},
+    };
+
+    ReplayClock clock(flight.telemetry.front().first, speed);
+    clock.install();
+
+    auto mav = std::make_shared<ReplayMavlinkClient>(std::move(flight));
+    mav->update();
+    auto camera = std::make_shared<ReplayCamera>(config.camera, image_dir);
+
+    // No payload to connect to
+    OBC obc(config, mav, camera, false);
+    std::shared_ptr<MissionState> state = obc.getState();
+    httplib::Client gcs("localhost", config.network.gcs.port);
+
+    std::map<TickID, TickTimes> ticks;
+    bool sent = false;  // whether the current tick's GCS step has been sent
+    const auto started = std::chrono::steady_clock::now();
+    const uint64_t started_ms = clock.nowMs();
+
+    obc.run([&](const OBC::TickReport& report) {
+        ticks[report.ran].took_us.push_back(report.took.count());
+        ticks[report.ran].replayed_ms += report.wait.count();
+
+        if (report.next == TickID::MissionDone) {
+            LOG_F(INFO, "Replay: mission done");
+            return false;
+        }
+        if (mav->finished()) {
+            LOG_F(WARNING, "Replay: recording ended in %s", TICK_ID_TO_STR(report.next));
+            return false;
+        }
+
+        if (report.ran != report.next) {
+            sent = false;
+        }
+        for (const GcsStep& step : steps) {
+            if (sent || step.tick != report.next) {
+                continue;
+            }
+            std::deque<uint64_t>& recorded = requests[step.route];
+            if (!recorded.empty() && clock.nowMs() < recorded.front()) {
+                continue;
+            }
+            if (!recorded.empty()) {
+                recorded.pop_front();
+            }
+            post(&gcs, step.route, step.body);
+            sent = true;
+        }
+
+        if (speed > 0) {
+            std::this_thread::sleep_for(
+                std::chrono::duration<double, std::milli>(report.wait.count() / speed));
+        } else {
+            std::shared_ptr<CVAggregator> cv = state->getCV();
+            if (waitsOnBackgroundWork(report.ran)) {
+                std::this_thread::sleep_for(report.wait);
+            } else if (cv != nullptr) {
+                while (cv->pending() > 0) {
+                    std::this_thread::sleep_for(1ms);
+                }
+            }
+            clock.advance(report.wait);
+        }
+        mav->update();
+        return true;
+    });
+
+    const auto wall_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                             std::chrono::steady_clock::now() - started)
+                             .count();
+    const uint64_t replayed_ms = clock.nowMs() - started_ms;
+
+    std::size_t runs = 0;
+    std::size_t detections = 0;
+    std::shared_ptr<CVAggregator> cv = state->getCV();
+    if (cv != nullptr) {
+        while (cv->pending() > 0) {
+            std::this_thread::sleep_for(10ms);
+        }
+        LockPtr<CVResults> results = cv->getResults();
+        runs = results.data->total_runs;
+        detections = results.data->total_detections;
+    }
+
+    std::printf("\nReplayed %.1f s of flight in %.1f s, ended in %s\n", replayed_ms / 1000.0,
+                wall_ms / 1000.0, TICK_ID_TO_STR(state->getTickID()));
+    std::printf("%zu recorded frames, %zu run through CV, %zu detections\n",
+                camera->numFrames(), runs, detections);
+    printTickReport(ticks);
+    if (cv != nullptr) {
+        printStageReport(cv->getPipelineStageStats());
+    }
+    return 0;
+}
@@ -66,3 +66,54 @@ TEST(AirdropClientTest, ObcSendToPayload) {
         num_received++;
     }
 }
+
+// Reads everything the payload gets within timeout, counting packets with header
+static int countReceived(ad_socket_t socket, uint8_t header, std::chrono::milliseconds timeout) {
+    int count = 0;
+    ad_recv_packet_t packets[16];
+    auto end = std::chrono::steady_clock::now() + timeout;
+    while (std::chrono::steady_clock::now() < end) {
+        auto result = recv_ad_packets(socket, packets, 16, 20);
+        for (int i = 0; !result.is_err && i < result.data.res; i++) {
+            if (packets[i].packet.header == header) {
+                count++;
+            }
+        }
+    }
+    return count;
+}
+
+// No airdrop packet has an ack yet, so ACK_MODE stands in for one here
+TEST(AirdropClientTest, AckStopsRetransmits) {
+    SETUP_NETWORK(GUIDED, client, payload_socket);
+
+    ASSERT_TRUE(client.send(makeArmPacket(ARM, UDP2_A, OBC_NULL, 100), ACK_MODE));
+    EXPECT_EQ(client.numUnacked(), 1);
+
+    // an ack from the wrong airdrop doesn't count
+    send_ad_packet(payload_socket, makeModePacket(ACK_MODE, UDP2_B, OBC_NULL, GUIDED));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client.numUnacked(), 1);
+
+    send_ad_packet(payload_socket, makeModePacket(ACK_MODE, UDP2_A, OBC_NULL, GUIDED));
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    EXPECT_EQ(client.numUnacked(), 0);
+}
+
+TEST(AirdropClientTest, GivesUpAfterMaxRetransmits) {
+    auto result2 = make_ad_socket(UDP2_PAYLOAD_PORT, UDP2_OBC_PORT);
+    auto result1 = make_ad_socket(UDP2_OBC_PORT, UDP2_PAYLOAD_PORT);
+    ASSERT_FALSE(result2.is_err);
+    ASSERT_FALSE(result1.is_err);
+    auto payload_socket = result2.data.res;
+    send_ad_packet(payload_socket, makeModePacket(SET_MODE, UDP2_A, OBC_NULL, GUIDED));
+    AirdropClient client(result1.data.res, AirdropLinkConfig{1, 10, 2});
+    // clear out the handshake and anything earlier tests left behind
+    countReceived(payload_socket, ARM, std::chrono::milliseconds(50));
+
+    ASSERT_TRUE(client.send(makeArmPacket(ARM, UDP2_A, OBC_NULL, 100), ACK_MODE));
+
+    // the original plus two resends, then nothing
+    EXPECT_EQ(countReceived(payload_socket, ARM, std::chrono::milliseconds(300)), 3);
+    EXPECT_EQ(client.numUnacked(), 0);
+}
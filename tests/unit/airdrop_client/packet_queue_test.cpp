@@ -3,9 +3,14 @@
 #include <future>
 #include <thread>
 #include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
 
 extern "C" {
     #include "network/mock/packet_queue.h"
+    #include "network/packet_ring.h"
     #include "udp_squared/protocol.h"
     #include "network/airdrop_sockets.h"
 }
@@ -160,4 +165,168 @@ TEST(PacketQueueTest, PopWaitMultiThreaded) {
     uint8_t airdrop, state;
     parseID(p.id, &airdrop, &state);
     ASSERT_EQ(airdrop, UDP2_B);
-}
\ No newline at end of file
+}
+
+TEST(PacketRingTest, PushPopWrapsAround) {
+    packet_ring_t* ring = packet_ring_create(100);
+    ASSERT_NE(ring, nullptr);
+    ASSERT_EQ(packet_ring_capacity(ring), 128);
+
+    packet_t out;
+    ASSERT_FALSE(packet_ring_pop(ring, &out));
+
+    // go around a few times so the indices wrap
+    for (int i = 0; i < 1000; i++) {
+        packet_t in = makeModePacket(SET_MODE, UDP2_B, OBC_NULL, GUIDED);
+        in.data[0] = i % 256;
+        ASSERT_TRUE(packet_ring_push(ring, &in));
+        ASSERT_EQ(packet_ring_size(ring), 1);
+        ASSERT_TRUE(packet_ring_pop(ring, &out));
+        ASSERT_EQ(out.header, SET_MODE);
+        ASSERT_EQ(out.data[0], i % 256);
+    }
+    ASSERT_EQ(packet_ring_size(ring), 0);
+    ASSERT_EQ(packet_ring_pushed(ring), 1000);
+    ASSERT_EQ(packet_ring_dropped(ring), 0);
+
+    packet_ring_destroy(ring);
+}
+
+// A full ring should drop new packets, keep the old ones and count the drops
+TEST(PacketRingTest, CountsDropsWhenFull) {
+    packet_ring_t* ring = packet_ring_create(4);
+    ASSERT_EQ(packet_ring_capacity(ring), 4);
+
+    for (int i = 0; i < 6; i++) {
+        packet_t in = makeResetPacket(UDP2_A);
+        in.data[0] = i;
+        ASSERT_EQ(packet_ring_push(ring, &in), i < 4);
+    }
+    ASSERT_EQ(packet_ring_size(ring), 4);
+    ASSERT_EQ(packet_ring_pushed(ring), 4);
+    ASSERT_EQ(packet_ring_dropped(ring), 2);
+
+    packet_t out;
+    for (int i = 0; i < 4; i++) {
+        ASSERT_TRUE(packet_ring_pop(ring, &out));
+        ASSERT_EQ(out.data[0], i);
+    }
+    ASSERT_FALSE(packet_ring_pop(ring, &out));
+
+    packet_ring_destroy(ring);
+}
+
+TEST(PacketRingTest, WaitTimesOutWakesAndNotifies) {
+    packet_ring_t* ring = packet_ring_create(8);
+
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(packet_ring_wait(ring, 50), 0);
+    ASSERT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(50));
+
+    // a wake before the wait still counts, once
+    packet_ring_wake(ring);
+    ASSERT_EQ(packet_ring_wait(ring, 1000), -1);
+    ASSERT_EQ(packet_ring_wait(ring, 0), 0);
+
+    auto pusher = std::async(std::launch::async, [ring]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        packet_t p = makeResetPacket(UDP2_B);
+        packet_ring_push(ring, &p);
+    });
+    ASSERT_EQ(packet_ring_wait(ring, -1), 1);
+    pusher.get();
+
+    auto waker = std::async(std::launch::async, [ring]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        packet_ring_wake(ring);
+    });
+    packet_t out;
+    ASSERT_TRUE(packet_ring_pop(ring, &out));
+    ASSERT_EQ(packet_ring_wait(ring, -1), -1);
+    waker.get();
+
+    packet_ring_destroy(ring);
+}
+
+namespace {
+const uint32_t STRESS_PACKETS = 500000;
+
+packet_t sequencedPacket(uint32_t seq) {
+    packet_t p = makeResetPacket(UDP2_A);
+    std::memcpy(p.data, &seq, sizeof(seq));
+    return p;
+}
+
+uint32_t sequenceOf(const packet_t& p) {
+    uint32_t seq;
+    std::memcpy(&seq, p.data, sizeof(seq));
+    return seq;
+}
+
+// Pushes STRESS_PACKETS numbered packets from another thread through the ring,
+// checks they all come out in order and returns how long it took
+std::chrono::duration<double> stressRing(std::size_t capacity) {
+    packet_ring_t* ring = packet_ring_create(capacity);
+
+    auto start = std::chrono::steady_clock::now();
+    auto producer = std::async(std::launch::async, [ring]() {
+        for (uint32_t i = 0; i < STRESS_PACKETS; i++) {
+            packet_t p = sequencedPacket(i);
+            while (!packet_ring_push(ring, &p)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    uint32_t expected = 0;
+    packet_t p;
+    while (expected < STRESS_PACKETS) {
+        if (!packet_ring_pop(ring, &p)) {
+            packet_ring_wait(ring, 100);
+            continue;
+        }
+        EXPECT_EQ(sequenceOf(p), expected);
+        expected++;
+    }
+    producer.get();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    EXPECT_EQ(packet_ring_pushed(ring), STRESS_PACKETS);
+    packet_ring_destroy(ring);
+    return elapsed;
+}
+
+// Same thing through the semaphore queue the mock sockets used to use
+std::chrono::duration<double> stressQueue() {
+    auto q = std::make_unique<packet_queue_t>();
+    pqueue_init(q.get());
+
+    auto start = std::chrono::steady_clock::now();
+    auto producer = std::async(std::launch::async, [&q]() {
+        for (uint32_t i = 0; i < STRESS_PACKETS; i++) {
+            while (pqueue_full(q.get())) {
+                std::this_thread::yield();
+            }
+            pqueue_push(q.get(), sequencedPacket(i));
+        }
+    });
+
+    for (uint32_t expected = 0; expected < STRESS_PACKETS; expected++) {
+        EXPECT_EQ(sequenceOf(pqueue_wait_pop(q.get())), expected);
+    }
+    producer.get();
+    return std::chrono::steady_clock::now() - start;
+}
+}  // namespace
+
+// Hammers both queues with one producer and one consumer thread. Timings are
+// printed rather than asserted on, so this doesn't flake on a loaded machine.
+TEST(PacketRingTest, StressAgainstSemaphoreQueue) {
+    auto ring_time = stressRing(MAX_PACKETS);
+    auto queue_time = stressQueue();
+
+    std::printf("%u packets: packet_ring %.1f ms (%.1f Mpkt/s), "
+                "packet_queue %.1f ms (%.1f Mpkt/s)\n", STRESS_PACKETS,
+                ring_time.count() * 1000, STRESS_PACKETS / ring_time.count() / 1e6,
+                queue_time.count() * 1000, STRESS_PACKETS / queue_time.count() / 1e6);
+}
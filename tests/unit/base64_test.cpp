@@ -0,0 +1,41 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "utilities/base64.hpp"
+
+namespace {
+std::string encode(const std::string& s) {
+    return base64_encode(reinterpret_cast<const unsigned char*>(s.data()), s.size());
+}
+}  // namespace
+
+// Test vectors from RFC 4648
+TEST(Base64, EncodesWithPadding) {
+    EXPECT_EQ(encode(""), "");
+    EXPECT_EQ(encode("f"), "Zg==");
+    EXPECT_EQ(encode("fo"), "Zm8=");
+    EXPECT_EQ(encode("foo"), "Zm9v");
+    EXPECT_EQ(encode("foob"), "Zm9vYg==");
+    EXPECT_EQ(encode("fooba"), "Zm9vYmE=");
+    EXPECT_EQ(encode("foobar"), "Zm9vYmFy");
+    EXPECT_EQ(base64_encoded_size(6), 8);
+    EXPECT_EQ(base64_encoded_size(7), 12);
+}
+
+// Long enough to go through the vectorized loop and the leftovers after it
+TEST(Base64, RoundTripsEveryLength) {
+    std::string bytes;
+    for (int len = 0; len < 200; len++) {
+        std::string encoded = encode(bytes);
+        ASSERT_EQ(encoded.size(), base64_encoded_size(len));
+        ASSERT_EQ(base64_decode(encoded), bytes) << "length " << len;
+        bytes.push_back(static_cast<char>(len * 37 + 11));
+    }
+}
+
+TEST(Base64, DecodeStopsAtInvalidCharacters) {
+    EXPECT_EQ(base64_decode("Zm9vYmFy"), "foobar");
+    EXPECT_EQ(base64_decode("Zm9v!YmFy"), "foo");
+    EXPECT_EQ(base64_decode("Zm8=Zm9v"), "fo");
+}
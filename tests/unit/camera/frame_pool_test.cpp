@@ -0,0 +1,61 @@
+#include <gtest/gtest.h>
+
+#include <utility>
+#include <vector>
+
+#include <opencv2/core/mat.hpp>
+
+#include "camera/frame_pool.hpp"
+
+// A buffer should only be handed out again once every outside header is gone
+TEST(FramePool, RecyclesReleasedBuffers) {
+    FramePool pool(16, 32, CV_8UC3, 2);
+
+    cv::Mat first = pool.acquire();
+    EXPECT_EQ(first.rows, 16);
+    EXPECT_EQ(first.cols, 32);
+    EXPECT_EQ(first.type(), CV_8UC3);
+    EXPECT_EQ(pool.size(), 1);
+    EXPECT_EQ(pool.available(), 0);
+
+    uchar* first_data = first.data;
+    first.release();
+    EXPECT_EQ(pool.available(), 1);
+
+    cv::Mat second = pool.acquire();
+    EXPECT_EQ(second.data, first_data);
+    EXPECT_EQ(pool.size(), 1);
+}
+
+// Moving a frame around (like the CV aggregator does) must keep it checked out
+TEST(FramePool, MovedFramesStayCheckedOut) {
+    FramePool pool(8, 8, CV_8UC1, 2);
+
+    cv::Mat frame = pool.acquire();
+    uchar* data = frame.data;
+
+    std::vector<cv::Mat> queue;
+    queue.push_back(std::move(frame));
+    cv::Mat view = queue.back()(cv::Rect(0, 0, 4, 4));
+    queue.clear();
+    EXPECT_EQ(pool.available(), 0);
+
+    cv::Mat other = pool.acquire();
+    EXPECT_NE(other.data, data);
+    EXPECT_EQ(pool.size(), 2);
+
+    view.release();
+    EXPECT_EQ(pool.available(), 1);
+}
+
+// Once the pool is full, acquire should still succeed without growing the pool
+TEST(FramePool, OverflowAllocatesOutsidePool) {
+    FramePool pool(4, 4, CV_8UC1, 1);
+
+    cv::Mat a = pool.acquire();
+    cv::Mat b = pool.acquire();
+    EXPECT_NE(a.data, b.data);
+    EXPECT_EQ(b.rows, 4);
+    EXPECT_EQ(pool.size(), 1);
+    EXPECT_EQ(pool.overflows(), 1);
+}
@@ -0,0 +1,68 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <nlohmann/json.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "camera/image_sink.hpp"
+
+namespace fs = std::filesystem;
+
+class ImageSinkTest : public ::testing::Test {
+ protected:
+    fs::path dir;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "obcpp_image_sink_test";
+        fs::remove_all(dir);
+        fs::create_directories(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+};
+
+TEST_F(ImageSinkTest, WritesImagesAndTelemetry) {
+    ImageSink sink(8, 2);
+
+    cv::Mat image(32, 48, CV_8UC3, cv::Scalar(0, 128, 255));
+    ImageTelemetry telemetry{32.88, -117.23, 30.0, 15.0, 90.0, 0.0, 0.0, 0.0};
+
+    EXPECT_TRUE(sink.write(dir / "raw.png", image));
+    EXPECT_TRUE(sink.save(ImageData{image, 1234, telemetry}, dir));
+    sink.flush();
+
+    EXPECT_EQ(sink.numWritten(), 2);
+    EXPECT_EQ(sink.numDropped(), 0);
+
+    cv::Mat decoded = cv::imread((dir / "raw.png").string());
+    ASSERT_FALSE(decoded.empty());
+    EXPECT_EQ(cv::norm(decoded, image, cv::NORM_INF), 0);
+
+    EXPECT_TRUE(fs::exists(dir / "1234.jpg"));
+    std::ifstream telemetry_file(dir / "1234.json");
+    nlohmann::json telemetry_json = nlohmann::json::parse(telemetry_file);
+    EXPECT_DOUBLE_EQ(telemetry_json.at("heading_deg").get<double>(), 90.0);
+}
+
+TEST_F(ImageSinkTest, RejectsEmptyImages) {
+    ImageSink sink(8, 2);
+    EXPECT_FALSE(sink.save(ImageData{cv::Mat(), 1234, {}}, dir));
+    EXPECT_FALSE(sink.save(ImageData{cv::Mat(4, 4, CV_8UC3), 0, {}}, dir));
+}
+
+// Whatever is still queued when the sink goes away should still make it to disk
+TEST_F(ImageSinkTest, DrainsOnDestruction) {
+    {
+        ImageSink sink(16, 4);
+        for (int i = 0; i < 10; i++) {
+            sink.write(dir / (std::to_string(i) + ".jpg"), cv::Mat(16, 16, CV_8UC3));
+        }
+    }
+
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(fs::exists(dir / (std::to_string(i) + ".jpg")));
+    }
+}
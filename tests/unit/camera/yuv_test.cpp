@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "camera/yuv.hpp"
+
+namespace {
+const int WIDTH = 64;
+const int HEIGHT = 48;
+// Padded out like libcamera's strides
+const int STRIDE_Y = 80;
+const int STRIDE_UV = 40;
+
+// Random strided planes in one buffer, plus the same image packed as plain I420
+YUVImage randomImage(cv::Mat* packed) {
+    cv::Mat buffer(1, YUVImage::bufferSize(HEIGHT, STRIDE_Y, STRIDE_UV), CV_8UC1);
+    cv::randu(buffer, 0, 256);
+    YUVImage image = YUVImage::fromPlanes(buffer, WIDTH, HEIGHT, STRIDE_Y, STRIDE_UV);
+
+    packed->create(HEIGHT * 3 / 2, WIDTH, CV_8UC1);
+    uint8_t* dst = packed->data;
+    for (const cv::Mat* plane : {&image.y, &image.u, &image.v}) {
+        for (int row = 0; row < plane->rows; row++) {
+            std::memcpy(dst, plane->ptr(row), plane->cols);
+            dst += plane->cols;
+        }
+    }
+    return image;
+}
+}  // namespace
+
+TEST(YUVImage, ViewsPlanesInBuffer) {
+    cv::Mat buffer(1, YUVImage::bufferSize(HEIGHT, STRIDE_Y, STRIDE_UV), CV_8UC1);
+    YUVImage image = YUVImage::fromPlanes(buffer, WIDTH, HEIGHT, STRIDE_Y, STRIDE_UV);
+    ASSERT_FALSE(image.empty());
+    EXPECT_EQ(image.size(), cv::Size(WIDTH, HEIGHT));
+    EXPECT_EQ(image.u.size(), cv::Size(WIDTH / 2, HEIGHT / 2));
+    EXPECT_EQ(image.y.step, STRIDE_Y);
+    EXPECT_EQ(image.u.step, STRIDE_UV);
+    EXPECT_EQ(image.u.data, buffer.data + STRIDE_Y * HEIGHT);
+    EXPECT_EQ(image.v.data, buffer.data + STRIDE_Y * HEIGHT + STRIDE_UV * HEIGHT / 2);
+
+    // too small for the strides
+    cv::Mat small(1, WIDTH * HEIGHT * 3 / 2, CV_8UC1);
+    EXPECT_TRUE(YUVImage::fromPlanes(small, WIDTH, HEIGHT, STRIDE_Y, STRIDE_UV).empty());
+}
+
+// Converting from the strided planes should match OpenCV on the packed image
+TEST(YUVImage, MatchesOpenCVConversion) {
+    cv::Mat packed;
+    YUVImage image = randomImage(&packed);
+
+    cv::Mat expected;
+    cv::cvtColor(packed, expected, cv::COLOR_YUV2BGR_I420);
+    cv::Mat actual;
+    yuvToBgr(image, actual);
+
+    ASSERT_EQ(actual.size(), expected.size());
+    ASSERT_EQ(actual.type(), CV_8UC3);
+    EXPECT_LE(cv::norm(actual, expected, cv::NORM_INF), 1);
+}
+
+// Crops snap to even pixels so the chroma planes still line up with the luma
+TEST(YUVImage, CropAlignsToChroma) {
+    cv::Mat packed;
+    YUVImage image = randomImage(&packed);
+
+    cv::Point origin;
+    YUVImage crop = image.crop(cv::Rect(5, 3, 20, 11), &origin);
+    EXPECT_EQ(origin, cv::Point(4, 2));
+    EXPECT_EQ(crop.size(), cv::Size(20, 12));
+    EXPECT_EQ(crop.u.size(), cv::Size(10, 6));
+    EXPECT_EQ(crop.y.data, image.y.ptr(2) + 4);
+    EXPECT_EQ(crop.v.data, image.v.ptr(1) + 2);
+
+    cv::Mat full;
+    yuvToBgr(image, full);
+    cv::Mat cropped;
+    yuvToBgr(crop, cropped);
+    EXPECT_EQ(cv::norm(cropped, full(cv::Rect(origin, crop.size())), cv::NORM_INF), 0);
+
+    EXPECT_TRUE(image.crop(cv::Rect(10, 10, 1, 1)).empty());
+}
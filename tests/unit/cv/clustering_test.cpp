@@ -0,0 +1,52 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "cv/clustering.hpp"
+#include "utilities/datatypes.hpp"
+
+// ~1 meter in degrees of latitude
+const double ONE_METER_DEG = 1.0 / 111320.0;
+
+TEST(OnlineClustering, GroupsNearbyDetections) {
+    OnlineClustering clustering(5.0);
+
+    GPSCoord base = makeGPSCoord(38.31568, -76.55006, 0);
+    int first = clustering.addDetection(AirdropType::Water, base, 0.9);
+    int second = clustering.addDetection(
+        AirdropType::Water, makeGPSCoord(base.latitude() + 2 * ONE_METER_DEG,
+                                         base.longitude(), 0), 0.9);
+    int far = clustering.addDetection(
+        AirdropType::Water, makeGPSCoord(base.latitude() + 50 * ONE_METER_DEG,
+                                         base.longitude(), 0), 0.9);
+
+    EXPECT_EQ(first, second);
+    EXPECT_NE(first, far);
+    EXPECT_EQ(clustering.getClusters(AirdropType::Water).size(), 2);
+
+    // Same spot, different type, should not join the water cluster
+    clustering.addDetection(AirdropType::Beacon, base, 0.5);
+    EXPECT_EQ(clustering.getClusters(AirdropType::Beacon).size(), 1);
+    EXPECT_EQ(clustering.getClusters(AirdropType::Water).size(), 2);
+}
+
+TEST(OnlineClustering, BestEstimateIsWeightedCenterOfStrongestCluster) {
+    OnlineClustering clustering(5.0);
+    EXPECT_FALSE(clustering.bestEstimate(AirdropType::Water).has_value());
+
+    GPSCoord base = makeGPSCoord(38.31568, -76.55006, 0);
+    // Strong cluster: two detections 3m apart, the second with 3x the confidence
+    clustering.addDetection(AirdropType::Water, base, 0.25);
+    clustering.addDetection(
+        AirdropType::Water, makeGPSCoord(base.latitude() + 3 * ONE_METER_DEG,
+                                         base.longitude(), 0), 0.75);
+    // Weak outlier far away
+    clustering.addDetection(
+        AirdropType::Water, makeGPSCoord(base.latitude() - 100 * ONE_METER_DEG,
+                                         base.longitude(), 0), 0.4);
+
+    auto best = clustering.bestEstimate(AirdropType::Water);
+    ASSERT_TRUE(best.has_value());
+    EXPECT_NEAR(best->latitude(), base.latitude() + 2.25 * ONE_METER_DEG, 0.1 * ONE_METER_DEG);
+    EXPECT_NEAR(best->longitude(), base.longitude(), 1e-9);
+}
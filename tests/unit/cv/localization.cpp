@@ -297,3 +297,83 @@ TEST(CVLocalization, DistanceAccuracy) {
     };
 }
 
+
+// projectToImage should undo localize, so projecting a localized point lands back on the bbox
+TEST(CVLocalization, ProjectToImageRoundTrip) {
+    GSDLocalization gsdLocalization;
+
+    const std::vector<ImageTelemetry> telemetries = {
+        ImageTelemetry(32.8811581, -117.2353253, 45.722, 0.0, 207.85, 0.0, 0.0, 0.0),
+        ImageTelemetry(38.31568, -76.55006, 30.0, 0.0, 15.0, 0.0, 0.0, 0.0),
+    };
+    const std::vector<Bbox> bboxes = {
+        Bbox(1290, 664, 1294, 666),
+        Bbox(100, 1400, 102, 1402),
+        Bbox(1000, 700, 1002, 702),
+    };
+
+    for (const auto& telemetry : telemetries) {
+        for (const auto& bbox : bboxes) {
+            GPSCoord coord = gsdLocalization.localize(telemetry, bbox);
+            std::vector<cv::Point2f> pixels = gsdLocalization.projectToImage(telemetry, {coord});
+            ASSERT_EQ(pixels.size(), 1);
+            EXPECT_NEAR(pixels[0].x, (bbox.x1 + bbox.x2) / 2, 0.5);
+            EXPECT_NEAR(pixels[0].y, (bbox.y1 + bbox.y2) / 2, 0.5);
+        }
+    }
+}
+
+// Every box in the batch lands where the GSD model puts it, with the camera
+// looking along the heading: image up is straight ahead of the plane
+TEST(CVLocalization, BatchLocalizesEachBox) {
+    GSDLocalization gsdLocalization;
+
+    struct TestCase {
+        ImageTelemetry telemetry;
+        std::vector<Bbox> bboxes;
+        std::vector<GPSCoord> expected;
+    };
+
+    const std::vector<TestCase> testCases = {
+        {
+            ImageTelemetry(32.8811581, -117.2353253, 45.722, 0.0, 207.85, 0.0, 0.0, 0.0),
+            {Bbox(1290, 664, 1294, 666), Bbox(100, 1400, 102, 1402),
+             Bbox(1013, 100, 1015, 300), Bbox(0, 0, 2028, 1520)},
+            {
+                makeGPSCoord(32.88116816, -117.23540105, 0),  // 7.08m W, 1.12m N
+                makeGPSCoord(32.88118884, -117.23503642, 0),  // 27.01m E, 3.42m N
+                makeGPSCoord(32.88104956, -117.23539359, 0),  // 6.38m W, 12.08m S
+                makeGPSCoord(32.8811581, -117.2353253, 0),    // image center
+            },
+        },
+        {
+            ImageTelemetry(38.31568, -76.55006, 30.0, 0.0, 15.0, 0.0, 0.0, 0.0),
+            {Bbox(1290, 664, 1294, 666), Bbox(100, 1400, 102, 1402),
+             Bbox(1013, 100, 1015, 300), Bbox(0, 0, 2028, 1520)},
+            {
+                makeGPSCoord(38.31568285, -76.55000627, 0),  // 4.69m E, 0.32m N
+                makeGPSCoord(38.31562493, -76.55025208, 0),  // 16.78m W, 6.13m S
+                makeGPSCoord(38.31575780, -76.55003343, 0),  // 2.32m E, 8.66m N
+                makeGPSCoord(38.31568, -76.55006, 0),        // image center
+            },
+        },
+    };
+
+    for (const auto& testCase : testCases) {
+        std::vector<double> latitudes(testCase.bboxes.size());
+        std::vector<double> longitudes(testCase.bboxes.size());
+        gsdLocalization.localize(testCase.telemetry, testCase.bboxes, latitudes, longitudes);
+
+        for (std::size_t i = 0; i < testCase.bboxes.size(); i++) {
+            SCOPED_TRACE(::testing::Message() << "bbox " << i);
+            EXPECT_NEAR(latitudes[i], testCase.expected[i].latitude(), 1e-7);
+            EXPECT_NEAR(longitudes[i], testCase.expected[i].longitude(), 1e-7);
+        }
+    }
+
+    std::vector<double> longitude(1);
+    std::vector<double> too_short;
+    EXPECT_THROW(gsdLocalization.localize(testCases[0].telemetry, testCases[0].bboxes, too_short,
+                                          longitude),
+                 std::invalid_argument);
+}
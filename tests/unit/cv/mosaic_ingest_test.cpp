@@ -0,0 +1,37 @@
+#include <gtest/gtest.h>
+
+#include <optional>
+
+#include <opencv2/core.hpp>
+
+#include "cv/localization.hpp"
+#include "cv/mosaic_ingest.hpp"
+
+namespace {
+const ImageTelemetry TELEMETRY(38.31568, -76.55006, 30.0, 0.0, 30.0, 0.0, 0.0, 0.0);
+
+ImageData makeImage(std::optional<ImageTelemetry> telemetry) {
+    cv::Mat frame(IMG_HEIGHT_PX, IMG_WIDTH_PX, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    return ImageData{frame, 0, telemetry};
+}
+}  // namespace
+
+// Frames without telemetry can't be placed, so they shouldn't even be queued
+TEST(CVMosaicIngest, RejectsFramesWithoutTelemetry) {
+    MosaicIngest ingest(MosaicParams(), 800, false, 4);
+    EXPECT_FALSE(ingest.push(makeImage(std::nullopt)));
+    ingest.flush();
+    EXPECT_EQ(ingest.getStats().frames_added, 0);
+}
+
+TEST(CVMosaicIngest, FlushWaitsForQueuedFrames) {
+    MosaicIngest ingest(MosaicParams(), 800, false, 4);
+    ASSERT_TRUE(ingest.push(makeImage(TELEMETRY)));
+    ingest.flush();
+    EXPECT_EQ(ingest.getStats().frames_added, 1);
+    EXPECT_FALSE(ingest.render().empty());
+
+    ingest.reset();
+    EXPECT_EQ(ingest.getStats().frames_added, 0);
+}
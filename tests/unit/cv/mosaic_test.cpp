@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "cv/localization.hpp"
+#include "cv/mosaic.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+const ImageTelemetry TELEMETRY(38.31568, -76.55006, 30.0, 0.0, 30.0, 0.0, 0.0, 0.0);
+
+cv::Mat makeFrame() {
+    cv::Mat frame(IMG_HEIGHT_PX, IMG_WIDTH_PX, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    return frame;
+}
+}  // namespace
+
+// Telemetry placement should put pixels at the same spot on the ground as localize does
+TEST(CVMosaic, SeedAgreesWithLocalization) {
+    IncrementalMosaic mosaic;
+    ASSERT_TRUE(mosaic.addFrame(makeFrame(), TELEMETRY));
+
+    GSDLocalization gsdLocalization;
+    cv::Matx33d seed = mosaic.seedHomography(cv::Size(IMG_WIDTH_PX, IMG_HEIGHT_PX), TELEMETRY);
+
+    const std::vector<Bbox> bboxes = {
+        Bbox(300, 200, 300, 200),
+        Bbox(1500, 1200, 1500, 1200),
+        Bbox(1800, 100, 1800, 100),
+    };
+    for (const Bbox& bbox : bboxes) {
+        cv::Vec3d canvas = seed * cv::Vec3d(bbox.x1, bbox.y1, 1.0);
+        GPSCoord placed = mosaic.toGPS({canvas[0] / canvas[2], canvas[1] / canvas[2]});
+        GPSCoord localized = gsdLocalization.localize(TELEMETRY, bbox);
+
+        // ~1cm
+        EXPECT_NEAR(placed.latitude(), localized.latitude(), 1e-7);
+        EXPECT_NEAR(placed.longitude(), localized.longitude(), 1e-7);
+    }
+}
+
+TEST(CVMosaic, TilesCoverFrame) {
+    MosaicParams params;
+    params.meters_per_px = 0.05;
+    params.tile_size = 256;
+    IncrementalMosaic mosaic(params);
+
+    // Downscaled copies of the sensor image land on the same footprint
+    cv::Mat frame;
+    cv::resize(makeFrame(), frame, cv::Size(IMG_WIDTH_PX / 2, IMG_HEIGHT_PX / 2));
+    ASSERT_TRUE(mosaic.addFrame(frame, ImageTelemetry(38.31568, -76.55006, 30.0, 0.0, 0.0,
+                                                      0.0, 0.0, 0.0)));
+
+    // 30m up the frame covers ~32.5m x 24.3m, centered on the first frame
+    cv::Rect bounds = mosaic.bounds();
+    EXPECT_NEAR(bounds.width, 650, 2);
+    EXPECT_NEAR(bounds.height, 487, 2);
+    EXPECT_TRUE(bounds.contains(cv::Point(0, 0)));
+
+    // x tiles -2..1, y tiles -1..0
+    MosaicStats stats = mosaic.getStats();
+    EXPECT_EQ(stats.frames_added, 1);
+    EXPECT_EQ(stats.tiles, 8);
+
+    cv::Mat rendered = mosaic.render();
+    EXPECT_EQ(rendered.size(), bounds.size());
+    // Most of the canvas should be covered, apart from the border pixels with no weight
+    cv::Mat gray;
+    cv::cvtColor(rendered, gray, cv::COLOR_BGR2GRAY);
+    EXPECT_GT(cv::countNonZero(gray), bounds.area() * 9 / 10);
+
+    fs::path dir = fs::temp_directory_path() / "obcpp_mosaic_test";
+    fs::remove_all(dir);
+    EXPECT_EQ(mosaic.saveDirtyTiles(dir), 8);
+    EXPECT_TRUE(fs::exists(dir / "tile_-2_-1.png"));
+    // Nothing changed since
+    EXPECT_EQ(mosaic.saveDirtyTiles(dir), 0);
+    fs::remove_all(dir);
+}
+
+TEST(CVMosaic, SkipsBadFrames) {
+    IncrementalMosaic mosaic;
+
+    ImageTelemetry on_ground = TELEMETRY;
+    on_ground.altitude_agl_m = 0;
+    EXPECT_FALSE(mosaic.addFrame(makeFrame(), on_ground));
+    EXPECT_FALSE(mosaic.addFrame(cv::Mat(), TELEMETRY));
+
+    MosaicStats stats = mosaic.getStats();
+    EXPECT_EQ(stats.frames_added, 0);
+    EXPECT_EQ(stats.frames_skipped, 2);
+    EXPECT_TRUE(mosaic.render().empty());
+}
+
+// Going over the memory budget moves old tiles to disk without changing the map
+TEST(CVMosaic, SpillsOverBudget) {
+    fs::path spill_dir = fs::temp_directory_path() / "obcpp_mosaic_spill_test";
+    fs::remove_all(spill_dir);
+
+    MosaicParams params;
+    params.tile_size = 256;
+    IncrementalMosaic unbounded(params);
+    params.memory_budget_bytes = 1;
+    params.spill_dir = spill_dir;
+    {
+        IncrementalMosaic bounded(params);
+
+        // ~110m apart, so the second frame never touches the first one's tiles
+        ImageTelemetry north = TELEMETRY;
+        north.latitude_deg += 0.001;
+        for (const ImageTelemetry& telemetry : {TELEMETRY, north}) {
+            cv::Mat frame = makeFrame();
+            ASSERT_TRUE(unbounded.addFrame(frame, telemetry));
+            ASSERT_TRUE(bounded.addFrame(frame, telemetry));
+        }
+
+        MosaicStats stats = bounded.getStats();
+        EXPECT_EQ(stats.tiles, unbounded.getStats().tiles);
+        EXPECT_GT(stats.tiles_spilled, 0);
+        EXPECT_LT(stats.resident_bytes, unbounded.getStats().resident_bytes);
+        EXPECT_TRUE(fs::exists(spill_dir));
+
+        cv::Mat expected = unbounded.render();
+        cv::Mat rendered = bounded.render();
+        ASSERT_EQ(rendered.size(), expected.size());
+        EXPECT_EQ(cv::norm(rendered, expected, cv::NORM_INF), 0);
+
+        // Scaled down render keeps the aspect ratio
+        cv::Mat small = bounded.render(500);
+        EXPECT_NEAR(std::max(small.cols, small.rows), 500, 1);
+    }
+    EXPECT_FALSE(fs::exists(spill_dir));
+}
@@ -0,0 +1,102 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include "cv/run_history.hpp"
+#include "protos/obc.pb.h"
+#include "utilities/serialize.hpp"
+
+namespace {
+IdentifiedTarget makeTarget(double latitude) {
+    IdentifiedTarget target;
+    target.set_picture("picture");
+    GPSCoord* coord = target.add_coordinates();
+    coord->set_latitude(latitude);
+    return target;
+}
+}  // namespace
+
+TEST(RunHistory, PagesThroughRunsInOrder) {
+    RunHistory history(16);
+    for (int i = 0; i < 5; i++) {
+        EXPECT_EQ(history.add(makeTarget(i)), i);
+    }
+
+    RunPage page = history.since(-1, 2);
+    ASSERT_EQ(page.runs.size(), 2);
+    EXPECT_EQ(page.runs[0]->run_id, 0);
+    EXPECT_EQ(page.runs[1]->run_id, 1);
+    EXPECT_EQ(page.next_since, 1);
+    EXPECT_TRUE(page.more);
+
+    page = history.since(page.next_since, 10);
+    ASSERT_EQ(page.runs.size(), 3);
+    EXPECT_EQ(page.runs.front()->run_id, 2);
+    EXPECT_EQ(page.next_since, 4);
+    EXPECT_FALSE(page.more);
+
+    // caught up, the cursor stays put
+    page = history.since(4, 10);
+    EXPECT_TRUE(page.runs.empty());
+    EXPECT_EQ(page.next_since, 4);
+}
+
+// Stored encodings should round trip to the target that was added
+TEST(RunHistory, EncodesOnAdd) {
+    RunHistory history(4);
+    history.add(makeTarget(32.5));
+
+    RunPage page = history.since(-1, 1);
+    ASSERT_EQ(page.runs.size(), 1);
+
+    IdentifiedTarget parsed;
+    ASSERT_TRUE(parsed.ParseFromString(page.runs[0]->proto));
+    EXPECT_EQ(parsed.run_id(), 0);
+    EXPECT_EQ(parsed.picture(), "picture");
+    ASSERT_EQ(parsed.coordinates_size(), 1);
+    EXPECT_DOUBLE_EQ(parsed.coordinates(0).latitude(), 32.5);
+
+    IdentifiedTarget from_json;
+    ASSERT_TRUE(google::protobuf::util::JsonStringToMessage(page.runs[0]->json, &from_json).ok());
+    EXPECT_EQ(from_json.SerializeAsString(), parsed.SerializeAsString());
+
+    std::string delimited;
+    appendDelimited(&delimited, page.runs[0]->proto);
+    ASSERT_EQ(static_cast<uint8_t>(delimited[0]), page.runs[0]->proto.size());
+    EXPECT_EQ(delimited.substr(1), page.runs[0]->proto);
+}
+
+TEST(RunHistory, DropsOldestAndSkipsThem) {
+    RunHistory history(3);
+    for (int i = 0; i < 5; i++) {
+        history.add(makeTarget(i));
+    }
+    EXPECT_EQ(history.size(), 3);
+
+    RunPage page = history.since(0, 10);
+    ASSERT_EQ(page.runs.size(), 3);
+    EXPECT_EQ(page.runs.front()->run_id, 2);
+
+    // a cursor from a previous run of the OBC starts over
+    page = history.since(100, 10);
+    ASSERT_EQ(page.runs.size(), 3);
+    EXPECT_EQ(page.runs.front()->run_id, 2);
+}
+
+TEST(RunHistory, UnsentOnlyReturnsEachRunOnce) {
+    RunHistory history(16);
+    history.add(makeTarget(0));
+    history.add(makeTarget(1));
+
+    RunPage page = history.unsent(1);
+    ASSERT_EQ(page.runs.size(), 1);
+    EXPECT_EQ(page.runs[0]->run_id, 0);
+
+    page = history.unsent(10);
+    ASSERT_EQ(page.runs.size(), 1);
+    EXPECT_EQ(page.runs[0]->run_id, 1);
+
+    EXPECT_TRUE(history.unsent(10).runs.empty());
+    history.add(makeTarget(2));
+    EXPECT_EQ(history.unsent(10).runs.size(), 1);
+}
@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+#include "cv/stitching.hpp"
+
+namespace {
+cv::detail::CameraParams translation(float dx, float dy) {
+    cv::detail::CameraParams camera;
+    camera.R = (cv::Mat_<float>(3, 3) << 1, 0, dx, 0, 1, dy, 0, 0, 1);
+    return camera;
+}
+}  // namespace
+
+TEST(CVStitching, FeatureCacheReusesFeatures) {
+    cv::Mat image(480, 640, CV_8UC3);
+    cv::randu(image, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    FeatureCache cache;
+    double work_scale = registrationScale(image.size());
+    EXPECT_DOUBLE_EQ(work_scale, 1.0);
+
+    cv::detail::ImageFeatures first = findFeatures(image, "a.jpg:3000", work_scale, &cache);
+    cv::detail::ImageFeatures second = findFeatures(image, "a.jpg:3000", work_scale, &cache);
+    EXPECT_EQ(cache.size(), 1);
+    EXPECT_EQ(cache.misses(), 1);
+    EXPECT_EQ(cache.hits(), 1);
+    EXPECT_EQ(first.keypoints.size(), second.keypoints.size());
+
+    // Same file at a different scale is a different entry
+    findFeatures(image, "a.jpg:3000", 0.5, &cache);
+    EXPECT_EQ(cache.size(), 2);
+
+    // No key, no caching
+    findFeatures(image, "", work_scale, &cache);
+    EXPECT_EQ(cache.size(), 2);
+}
+
+TEST(CVStitching, RegistrationScaleCapsMegapixels) {
+    // 3000x2000 = 6MP -> sqrt(0.6 / 6)
+    EXPECT_NEAR(registrationScale(cv::Size(3000, 2000)), std::sqrt(0.1), 1e-9);
+}
+
+TEST(CVStitching, TimingsAddUp) {
+    StitchTimings total;
+    StitchTimings chunk;
+    chunk.find_features_ms = 1;
+    chunk.matching_ms = 2;
+    chunk.bundle_adjust_ms = 3;
+    chunk.warp_ms = 4;
+    chunk.blend_ms = 5;
+
+    total += chunk;
+    total += chunk;
+    EXPECT_DOUBLE_EQ(total.matching_ms, 4);
+    EXPECT_DOUBLE_EQ(total.total_ms(), 30);
+}
+
+// Chunk 2 is estimated relative to its own first image, which is the last image of chunk 1
+TEST(CVStitching, ChainChunkCameras) {
+    std::vector<ChunkCameras> chunks = {
+        {{"a", "b"}, {translation(0, 0), translation(10, 0)}},
+        {},  // failed chunk, skipped
+        {{"b", "c"}, {translation(0, 0), translation(10, 5)}},
+    };
+
+    auto chained = chainChunkCameras(chunks);
+    ASSERT_TRUE(chained.has_value());
+    ASSERT_EQ(chained->size(), 3);
+
+    const cv::Mat& c = chained->at("c").camera.R;
+    EXPECT_FLOAT_EQ(c.at<float>(0, 2), 20);
+    EXPECT_FLOAT_EQ(c.at<float>(1, 2), 5);
+    EXPECT_EQ(chained->at("a").chunk, 0);
+    EXPECT_EQ(chained->at("b").chunk, 0);
+    EXPECT_EQ(chained->at("c").chunk, 2);
+}
+
+TEST(CVStitching, ChainChunkCamerasDisconnected) {
+    std::vector<ChunkCameras> chunks = {
+        {{"a", "b"}, {translation(0, 0), translation(10, 0)}},
+        {{"c", "d"}, {translation(0, 0), translation(10, 0)}},
+    };
+    EXPECT_FALSE(chainChunkCameras(chunks).has_value());
+}
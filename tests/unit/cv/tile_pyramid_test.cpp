@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <filesystem>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+#include "cv/localization.hpp"
+#include "cv/mosaic.hpp"
+#include "cv/tile_pyramid.hpp"
+#include "utilities/constants.hpp"
+
+namespace fs = std::filesystem;
+
+namespace {
+const ImageTelemetry TELEMETRY(38.31568, -76.55006, 30.0, 0.0, 30.0, 0.0, 0.0, 0.0);
+
+double metersPerPx(int zoom, double latitude_deg) {
+    return 2 * M_PI * EARTH_RADIUS_METERS * std::cos(latitude_deg * M_PI / 180) /
+           (TilePyramid::TILE_SIZE * std::pow(2.0, zoom));
+}
+}  // namespace
+
+class TilePyramidTest : public ::testing::Test {
+ protected:
+    fs::path dir;
+
+    void SetUp() override {
+        dir = fs::temp_directory_path() / "obcpp_tile_pyramid_test";
+        fs::remove_all(dir);
+    }
+
+    void TearDown() override { fs::remove_all(dir); }
+};
+
+TEST(TilePyramidMath, PixelRoundTrip) {
+    for (int zoom : {0, 10, 21}) {
+        cv::Point2d px = TilePyramid::toPixel(TELEMETRY.latitude_deg, TELEMETRY.longitude_deg,
+                                              zoom);
+        GPSCoord gps = TilePyramid::toGPS(px, zoom);
+        EXPECT_NEAR(gps.latitude(), TELEMETRY.latitude_deg, 1e-9);
+        EXPECT_NEAR(gps.longitude(), TELEMETRY.longitude_deg, 1e-9);
+    }
+
+    // Zoom 0 is one tile covering the whole world
+    cv::Point2d origin = TilePyramid::toPixel(0, 0, 0);
+    EXPECT_NEAR(origin.x, TilePyramid::TILE_SIZE / 2.0, 1e-9);
+    EXPECT_NEAR(origin.y, TilePyramid::TILE_SIZE / 2.0, 1e-9);
+}
+
+// The top level should be as detailed as the mosaic but no more
+TEST(TilePyramidMath, MaxZoomMatchesMosaicResolution) {
+    const double meters_per_px = 0.05;
+    int zoom = TilePyramid::maxZoomFor(meters_per_px, TELEMETRY.latitude_deg);
+    EXPECT_GE(metersPerPx(zoom, TELEMETRY.latitude_deg), meters_per_px);
+    EXPECT_LT(metersPerPx(zoom + 1, TELEMETRY.latitude_deg), meters_per_px);
+}
+
+TEST_F(TilePyramidTest, UpdatesEveryZoomUnderTheFrame) {
+    IncrementalMosaic mosaic;
+    cv::Mat frame(IMG_HEIGHT_PX, IMG_WIDTH_PX, CV_8UC3);
+    cv::randu(frame, cv::Scalar::all(0), cv::Scalar::all(255));
+    ASSERT_TRUE(mosaic.addFrame(frame, TELEMETRY));
+
+    int max_zoom = TilePyramid::maxZoomFor(mosaic.getParams().meters_per_px,
+                                           TELEMETRY.latitude_deg);
+    TilePyramid pyramid(dir, max_zoom - 3, 4);
+    EXPECT_GT(pyramid.update(mosaic, mosaic.takeChangedRegions()), 0);
+    ASSERT_EQ(pyramid.getMaxZoom(), max_zoom);
+    EXPECT_TRUE(fs::exists(pyramid.metadataPath()));
+
+    for (int zoom = max_zoom - 3; zoom <= max_zoom; zoom++) {
+        cv::Point2d px = TilePyramid::toPixel(TELEMETRY.latitude_deg, TELEMETRY.longitude_deg,
+                                              zoom);
+        fs::path tile_path = pyramid.tilePath(zoom, static_cast<int>(px.x) / TilePyramid::TILE_SIZE,
+                                              static_cast<int>(px.y) / TilePyramid::TILE_SIZE);
+        cv::Mat tile = cv::imread(tile_path.string(), cv::IMREAD_UNCHANGED);
+        ASSERT_FALSE(tile.empty()) << "missing tile at zoom " << zoom;
+        EXPECT_EQ(tile.type(), CV_8UC4);
+        EXPECT_EQ(tile.cols, TilePyramid::TILE_SIZE);
+    }
+
+    // Nothing changed since, so there's nothing to redo
+    EXPECT_EQ(pyramid.update(mosaic, mosaic.takeChangedRegions()), 0);
+
+    pyramid.clear();
+    EXPECT_FALSE(fs::exists(dir));
+    EXPECT_FALSE(pyramid.getMaxZoom().has_value());
+}
@@ -0,0 +1,57 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include "cv/tiling.hpp"
+
+// Every pixel should be covered, and every tile should stay inside the image
+TEST(CVTiling, TilesCoverImage) {
+    const cv::Size imageSize(1436, 1088);
+    std::vector<cv::Rect> tiles = makeTiles(imageSize, 640, 0.2f);
+
+    // stride of 512 -> x starts {0, 512, 796}, y starts {0, 448}
+    EXPECT_EQ(tiles.size(), 6);
+
+    cv::Mat covered = cv::Mat::zeros(imageSize, CV_8UC1);
+    for (const cv::Rect& tile : tiles) {
+        EXPECT_EQ(tile.width, 640);
+        EXPECT_EQ(tile.height, 640);
+        EXPECT_EQ(tile & cv::Rect(cv::Point(0, 0), imageSize), tile);
+        covered(tile).setTo(1);
+    }
+    EXPECT_EQ(cv::countNonZero(covered), imageSize.area());
+}
+
+TEST(CVTiling, ImageSmallerThanTile) {
+    std::vector<cv::Rect> tiles = makeTiles(cv::Size(300, 200), 640, 0.2f);
+    ASSERT_EQ(tiles.size(), 1);
+    EXPECT_EQ(tiles[0], cv::Rect(0, 0, 300, 200));
+}
+
+TEST(CVTiling, OffsetDetections) {
+    std::vector<Detection> dets = {{10, 20, 30, 40, 0.9f, 0}};
+    offsetDetections(dets, cv::Point(512, 448));
+    EXPECT_FLOAT_EQ(dets[0].x1, 522);
+    EXPECT_FLOAT_EQ(dets[0].y1, 468);
+    EXPECT_FLOAT_EQ(dets[0].x2, 542);
+    EXPECT_FLOAT_EQ(dets[0].y2, 488);
+}
+
+// A target split across a tile seam should come back as one box covering both halves
+TEST(CVTiling, MergeAcrossSeam) {
+    std::vector<Detection> dets = {
+        {500, 100, 560, 160, 0.8f, 1},  // full box from the left tile
+        {512, 100, 560, 160, 0.6f, 1},  // clipped box from the right tile
+        {900, 900, 950, 950, 0.7f, 1},  // unrelated target
+        {505, 105, 555, 155, 0.9f, 0},  // overlapping, but different class
+    };
+
+    std::vector<Detection> merged = mergeTileDetections(dets, 0.5f);
+    ASSERT_EQ(merged.size(), 3);
+
+    EXPECT_EQ(merged[0].class_id, 0);
+    EXPECT_FLOAT_EQ(merged[1].confidence, 0.8f);
+    EXPECT_FLOAT_EQ(merged[1].x1, 500);
+    EXPECT_FLOAT_EQ(merged[1].x2, 560);
+    EXPECT_FLOAT_EQ(merged[2].x1, 900);
+}
@@ -62,3 +62,9 @@ TEST(CVUtilities, CropValidAndInvalidSizes) {
         EXPECT_EQ(cropped.cols, testCase.expectedCroppedImg.cols);
     }
 }
+
+TEST(CVUtilities, NumberedOutputPath) {
+    EXPECT_EQ(numberedOutputPath("out.jpg", 3), "out_3.jpg");
+    EXPECT_EQ(numberedOutputPath("/tmp/run.1/out.png", 0), "/tmp/run.1/out_0.png");
+    EXPECT_EQ(numberedOutputPath("/tmp/run.1/out", 12), "/tmp/run.1/out_12.jpg");
+}
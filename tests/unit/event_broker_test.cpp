@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "utilities/event_broker.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+// A subscriber only gets the newest value of a topic, however many it missed
+TEST(EventBroker, CoalescesPerTopic) {
+    EventBroker broker;
+    broker.publish("telemetry", "1");
+    broker.publish("tick", "Takeoff");
+    broker.publish("telemetry", "2");
+    broker.publish("telemetry", "3");
+
+    uint64_t cursor = 0;
+    std::vector<Event> events = broker.waitForEvents(&cursor, 0ms);
+    ASSERT_EQ(events.size(), 2);
+    EXPECT_EQ(events[0].topic, "tick");
+    EXPECT_EQ(events[0].data, "Takeoff");
+    EXPECT_EQ(events[1].topic, "telemetry");
+    EXPECT_EQ(events[1].data, "3");
+    EXPECT_EQ(cursor, events[1].id);
+
+    // nothing new
+    EXPECT_TRUE(broker.waitForEvents(&cursor, 0ms).empty());
+
+    broker.publish("tick", "Search");
+    events = broker.waitForEvents(&cursor, 0ms);
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].data, "Search");
+}
+
+// A GCS still holding an id from before the OBC restarted starts over
+TEST(EventBroker, ResetsCursorFromBeforeRestart) {
+    EventBroker broker;
+    broker.publish("tick", "MissionPrep");
+
+    uint64_t cursor = 1000;
+    std::vector<Event> events = broker.waitForEvents(&cursor, 0ms);
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].data, "MissionPrep");
+    EXPECT_EQ(cursor, events[0].id);
+}
+
+TEST(EventBroker, WakesWaitingSubscribers) {
+    EventBroker broker;
+    uint64_t cursor = 0;
+
+    std::thread publisher([&broker]() {
+        std::this_thread::sleep_for(20ms);
+        broker.publish("tick", "Airdrop");
+    });
+    std::vector<Event> events = broker.waitForEvents(&cursor, 5s);
+    publisher.join();
+    ASSERT_EQ(events.size(), 1);
+    EXPECT_EQ(events[0].data, "Airdrop");
+
+    std::thread closer([&broker]() {
+        std::this_thread::sleep_for(20ms);
+        broker.close();
+    });
+    auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(broker.waitForEvents(&cursor, 5s).empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, 5s);
+    EXPECT_TRUE(broker.isClosed());
+    closer.join();
+}
+
+TEST(EventBroker, LimitsSubscribers) {
+    EventBroker broker;
+    EXPECT_TRUE(broker.trySubscribe(2));
+    EXPECT_TRUE(broker.trySubscribe(2));
+    EXPECT_FALSE(broker.trySubscribe(2));
+    broker.unsubscribe();
+    EXPECT_TRUE(broker.trySubscribe(2));
+}
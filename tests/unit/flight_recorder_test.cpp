@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "utilities/flight_recorder.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+namespace {
+
+std::string logPath(const std::string& name) {
+    return (std::filesystem::temp_directory_path() /
+            (name + "_" + std::to_string(getpid()) + ".flight")).string();
+}
+
+TelemetryRecord telemetry(double latitude) {
+    TelemetryRecord record{};
+    record.latitude_deg = latitude;
+    record.longitude_deg = -117.0;
+    record.altitude_agl_m = 30.0;
+    record.armed = 1;
+    return record;
+}
+
+}  // namespace
+
+// Nothing is recorded, and nothing breaks, while no recorder is open
+TEST(FlightRecorder, RecordsNothingWhenClosed) {
+    EXPECT_FALSE(FlightRecorder::isRecording());
+    FlightRecorder::recordTelemetry(telemetry(32.0));
+    FlightRecorder::recordTick(TickID::Takeoff, TickID::FlyWaypoints);
+
+    std::string path = logPath("closed");
+    {
+        auto recorder = FlightRecorder::open(path);
+        ASSERT_NE(recorder, nullptr);
+    }
+    auto records = readFlightLog(path);
+    ASSERT_TRUE(records.has_value());
+    EXPECT_TRUE(records->empty());
+    std::remove(path.c_str());
+}
+
+// Records from several threads all come back, in the order they were made
+TEST(FlightRecorder, RoundTripsFromManyThreads) {
+    const int num_threads = 4;
+    const int per_thread = 2000;
+
+    std::string path = logPath("threads");
+    std::size_t size = 0;
+    {
+        auto recorder = FlightRecorder::open(path);
+        ASSERT_NE(recorder, nullptr);
+        EXPECT_TRUE(FlightRecorder::isRecording());
+
+        std::vector<std::thread> threads;
+        for (int t = 0; t < num_threads; t++) {
+            threads.emplace_back([t]() {
+                for (int i = 0; i < per_thread; i++) {
+                    FlightRecorder::recordTelemetry(telemetry(t * per_thread + i));
+                    if (i % 256 == 0) {
+                        // give the writer a chance so nothing is dropped
+                        std::this_thread::sleep_for(1ms);
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        EXPECT_EQ(recorder->dropped(), 0);
+        recorder.reset();
+    }
+    EXPECT_FALSE(FlightRecorder::isRecording());
+
+    auto records = readFlightLog(path);
+    ASSERT_TRUE(records.has_value());
+    ASSERT_EQ(records->size(), num_threads * per_thread);
+
+    std::vector<bool> seen(num_threads * per_thread, false);
+    for (std::size_t i = 0; i < records->size(); i++) {
+        const FlightRecord& record = records->at(i);
+        ASSERT_EQ(record.type, FlightRecordType::TELEMETRY);
+        if (i > 0) {
+            EXPECT_LE(records->at(i - 1).time_us, record.time_us);
+        }
+        auto data = record.as<TelemetryRecord>();
+        ASSERT_TRUE(data.has_value());
+        seen[static_cast<int>(data->latitude_deg)] = true;
+    }
+    for (bool s : seen) {
+        EXPECT_TRUE(s);
+    }
+
+    // the zero filled tail of the mapping is trimmed off
+    size = std::filesystem::file_size(path);
+    EXPECT_EQ(size, sizeof(FlightLogHeader) +
+                        records->size() * (sizeof(FlightRecordHeader) + sizeof(TelemetryRecord)));
+    std::remove(path.c_str());
+}
+
+TEST(FlightRecorder, DecodesEveryRecordType) {
+    std::string path = logPath("types");
+    {
+        auto recorder = FlightRecorder::open(path);
+        ASSERT_NE(recorder, nullptr);
+
+        FlightRecorder::recordTick({}, TickID::MissionPrep);
+        FlightRecorder::recordTick(TickID::MissionPrep, TickID::PathGen);
+        FlightRecorder::recordDetections(7, 123456, {
+            {32.1, -117.1, 20.0, 1, 2, 3, 4},
+            {32.2, -117.2, 21.0, 5, 6, 7, 8},
+        });
+        FlightRecorder::recordGcsRequest("POST", "/mission", 200, 1500us);
+    }
+
+    auto records = readFlightLog(path);
+    ASSERT_TRUE(records.has_value());
+    ASSERT_EQ(records->size(), 4);
+
+    auto first = records->at(0).as<TickRecord>();
+    ASSERT_TRUE(first.has_value());
+    EXPECT_EQ(first->from, FLIGHT_RECORD_NO_TICK);
+    EXPECT_EQ(first->to, static_cast<uint8_t>(TickID::MissionPrep));
+
+    auto second = records->at(1).as<TickRecord>();
+    ASSERT_TRUE(second.has_value());
+    EXPECT_EQ(second->from, static_cast<uint8_t>(TickID::MissionPrep));
+    EXPECT_EQ(second->to, static_cast<uint8_t>(TickID::PathGen));
+
+    ASSERT_EQ(records->at(2).type, FlightRecordType::DETECTIONS);
+    auto run = records->at(2).as<DetectionsRecord>();
+    ASSERT_TRUE(run.has_value());
+    EXPECT_EQ(run->run_id, 7);
+    EXPECT_EQ(run->image_time_ms, 123456);
+    auto detections = records->at(2).detections();
+    ASSERT_EQ(detections.size(), 2);
+    EXPECT_DOUBLE_EQ(detections[1].latitude_deg, 32.2);
+    EXPECT_EQ(detections[1].x2, 7);
+
+    ASSERT_EQ(records->at(3).type, FlightRecordType::GCS_REQUEST);
+    auto request = records->at(3).as<GcsRequestRecord>();
+    ASSERT_TRUE(request.has_value());
+    EXPECT_EQ(request->status, 200);
+    EXPECT_EQ(request->duration_us, 1500);
+    EXPECT_EQ(records->at(3).gcsRequest(), "POST /mission");
+    std::remove(path.c_str());
+}
+
+// A log the OBC never got to close, or that was cut off mid record, still reads
+TEST(FlightRecorder, ReadsUnfinishedLogs) {
+    std::string path = logPath("unfinished");
+    {
+        auto recorder = FlightRecorder::open(path);
+        ASSERT_NE(recorder, nullptr);
+        FlightRecorder::recordTelemetry(telemetry(1.0));
+        FlightRecorder::recordTelemetry(telemetry(2.0));
+    }
+    const std::size_t size = std::filesystem::file_size(path);
+
+    // what's left when the recorder doesn't get to trim the file
+    std::filesystem::resize_file(path, size + 4096);
+    auto records = readFlightLog(path);
+    ASSERT_TRUE(records.has_value());
+    EXPECT_EQ(records->size(), 2);
+
+    // the last record only half written
+    std::filesystem::resize_file(path, size - sizeof(TelemetryRecord) / 2);
+    records = readFlightLog(path);
+    ASSERT_TRUE(records.has_value());
+    EXPECT_EQ(records->size(), 1);
+    std::remove(path.c_str());
+
+    std::ofstream(path) << "not a flight log";
+    EXPECT_FALSE(readFlightLog(path).has_value());
+    std::remove(path.c_str());
+}
+
+TEST(FlightRecorder, OnlyOneOpenAtATime) {
+    std::string path = logPath("first");
+    std::string other = logPath("second");
+    {
+        auto recorder = FlightRecorder::open(path);
+        ASSERT_NE(recorder, nullptr);
+        EXPECT_EQ(FlightRecorder::open(other), nullptr);
+        EXPECT_TRUE(FlightRecorder::isRecording());
+    }
+    auto recorder = FlightRecorder::open(other);
+    EXPECT_NE(recorder, nullptr);
+    recorder.reset();
+    std::remove(path.c_str());
+    std::remove(other.c_str());
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <future>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+
+#include "utilities/job_queue.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+namespace {
+// Polls until the job finishes or a second passes
+std::optional<Job> waitForJob(JobQueue* jobs, uint64_t id) {
+    for (int i = 0; i < 100; i++) {
+        std::optional<Job> job = jobs->get(id);
+        if (job.has_value() && job->state == Job::State::Done) {
+            return job;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    return jobs->get(id);
+}
+}  // namespace
+
+TEST(JobQueue, RunsJobsAndKeepsResults) {
+    JobQueue jobs(4);
+    uint64_t id = jobs.submit("echo", []() { return JobResult{200, "hi"}; });
+
+    std::optional<Job> job = waitForJob(&jobs, id);
+    ASSERT_TRUE(job.has_value());
+    ASSERT_EQ(job->state, Job::State::Done);
+    ASSERT_TRUE(job->result.has_value());
+    EXPECT_EQ(job->result->status, 200);
+    EXPECT_EQ(job->result->body, "hi");
+
+    EXPECT_FALSE(jobs.get(id + 100).has_value());
+}
+
+// Submitting while the same job is still waiting gets the original back
+TEST(JobQueue, CoalescesUnfinishedJobs) {
+    JobQueue jobs(4);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    uint64_t first = jobs.submit("slow", [released]() {
+        released.wait();
+        return JobResult{200, ""};
+    });
+    EXPECT_EQ(jobs.submit("slow", []() { return JobResult{500, ""}; }), first);
+    uint64_t other = jobs.submit("other", []() { return JobResult{200, ""}; });
+    EXPECT_NE(other, first);
+
+    release.set_value();
+    ASSERT_EQ(waitForJob(&jobs, first)->result->status, 200);
+    ASSERT_EQ(waitForJob(&jobs, other)->state, Job::State::Done);
+
+    // done, so this one actually runs
+    EXPECT_NE(jobs.submit("slow", []() { return JobResult{200, ""}; }), first);
+}
+
+TEST(JobQueue, ExceptionsFailTheJob) {
+    JobQueue jobs(4);
+    uint64_t id = jobs.submit("throws", []() -> JobResult {
+        throw std::runtime_error("nope");
+    });
+
+    std::optional<Job> job = waitForJob(&jobs, id);
+    ASSERT_TRUE(job.has_value() && job->result.has_value());
+    EXPECT_EQ(job->result->status, 500);
+    EXPECT_EQ(job->result->body, "nope");
+}
+
+// Jobs that never got to run are finished with an error, not left queued
+TEST(JobQueue, StopFailsQueuedJobs) {
+    JobQueue jobs(4);
+    std::promise<void> release;
+    std::shared_future<void> released = release.get_future().share();
+
+    uint64_t running = jobs.submit("slow", [released]() {
+        released.wait();
+        return JobResult{200, ""};
+    });
+    uint64_t queued = jobs.submit("queued", []() { return JobResult{200, ""}; });
+    while (jobs.get(running)->state != Job::State::Running) {
+        std::this_thread::sleep_for(1ms);
+    }
+
+    // Let the running job finish once stop() is already waiting on it
+    std::thread releaser([&release]() {
+        std::this_thread::sleep_for(100ms);
+        release.set_value();
+    });
+    jobs.stop();
+    releaser.join();
+
+    EXPECT_EQ(jobs.get(running)->result->status, 200);
+    std::optional<Job> job = jobs.get(queued);
+    ASSERT_TRUE(job.has_value());
+    EXPECT_EQ(job->state, Job::State::Done);
+    ASSERT_TRUE(job->result.has_value());
+    EXPECT_EQ(job->result->status, 503);
+}
+
+TEST(JobQueue, DropsOldestFinishedJobs) {
+    JobQueue jobs(2);
+    uint64_t last = 0;
+    for (int i = 0; i < 5; i++) {
+        last = jobs.submit("job", []() { return JobResult{200, ""}; });
+        waitForJob(&jobs, last);
+    }
+    EXPECT_EQ(jobs.all().size(), 2);
+    EXPECT_TRUE(jobs.get(last).has_value());
+}
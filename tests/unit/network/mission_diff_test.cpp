@@ -0,0 +1,62 @@
+#include <gtest/gtest.h>
+
+#include <cmath>
+#include <vector>
+
+#include "network/mission_diff.hpp"
+
+namespace {
+std::vector<mavsdk::MissionRaw::MissionItem> makeMission(int size) {
+    std::vector<mavsdk::MissionRaw::MissionItem> items;
+    for (int i = 0; i < size; i++) {
+        mavsdk::MissionRaw::MissionItem item{};
+        item.seq = i;
+        item.current = i == 0;
+        item.autocontinue = 1;
+        item.param4 = NAN;  // like MissionPath's yaw, should still compare equal
+        item.x = 320000000 + i;
+        item.y = -1170000000 - i;
+        item.z = 30;
+        items.push_back(item);
+    }
+    return items;
+}
+}  // namespace
+
+TEST(MissionDiff, UnknownMissionIsSentInFull) {
+    MissionDiff diff = diffMission({}, makeMission(5));
+    EXPECT_EQ(diff.kind, MissionDiff::Kind::FULL);
+}
+
+TEST(MissionDiff, SameMissionIsNotSent) {
+    MissionDiff diff = diffMission(makeMission(5), makeMission(5));
+    EXPECT_EQ(diff.kind, MissionDiff::Kind::UNCHANGED);
+}
+
+TEST(MissionDiff, ChangedItemsInTheMiddleAreSentAlone) {
+    auto next = makeMission(10);
+    next[3].z = 40;
+    next[6].x += 100;
+
+    MissionDiff diff = diffMission(makeMission(10), next);
+    EXPECT_EQ(diff.kind, MissionDiff::Kind::PARTIAL);
+    EXPECT_EQ(diff.first, 3);
+    EXPECT_EQ(diff.last, 6);
+
+    next = makeMission(10);
+    next[9].z = 40;
+    diff = diffMission(makeMission(10), next);
+    EXPECT_EQ(diff.kind, MissionDiff::Kind::PARTIAL);
+    EXPECT_EQ(diff.first, 9);
+    EXPECT_EQ(diff.last, 9);
+}
+
+TEST(MissionDiff, ResizedOrEntirelyChangedMissionIsSentInFull) {
+    EXPECT_EQ(diffMission(makeMission(10), makeMission(11)).kind, MissionDiff::Kind::FULL);
+    EXPECT_EQ(diffMission(makeMission(10), makeMission(9)).kind, MissionDiff::Kind::FULL);
+
+    auto next = makeMission(10);
+    next[0].z = 40;
+    next[9].z = 40;
+    EXPECT_EQ(diffMission(makeMission(10), next).kind, MissionDiff::Kind::FULL);
+}
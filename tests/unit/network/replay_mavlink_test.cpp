@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera/interface.hpp"
+#include "network/replay_mavlink.hpp"
+#include "pathing/mission_path.hpp"
+#include "ticks/ids.hpp"
+#include "utilities/common.hpp"
+#include "utilities/datatypes.hpp"
+#include "utilities/flight_recorder.hpp"
+#include "utilities/replay_clock.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+namespace {
+template <typename T>
+FlightRecord makeRecord(FlightRecordType type, uint64_t time_ms, const T& value) {
+    return FlightRecord{.type = type,
+                        .thread = 0,
+                        .time_us = time_ms * 1000,
+                        .payload = std::string(reinterpret_cast<const char*>(&value), sizeof(T))};
+}
+
+FlightRecord makeTick(uint64_t time_ms, TickID from, TickID to) {
+    return makeRecord(FlightRecordType::TICK, time_ms,
+                      TickRecord{static_cast<uint8_t>(from), static_cast<uint8_t>(to)});
+}
+
+TelemetryRecord makeTelemetry(double altitude_agl_m) {
+    TelemetryRecord telemetry{};
+    telemetry.latitude_deg = 32.88;
+    telemetry.longitude_deg = -117.23;
+    telemetry.altitude_agl_m = altitude_agl_m;
+    return telemetry;
+}
+
+// Telemetry every second from from_ms to to_ms, climbing a meter each time
+ReplayFlight makeFlight(uint64_t from_ms, uint64_t to_ms, std::vector<uint64_t> finished) {
+    ReplayFlight flight;
+    for (uint64_t time_ms = from_ms; time_ms <= to_ms; time_ms += 1000) {
+        flight.telemetry.emplace_back(time_ms, makeTelemetry((time_ms - from_ms) / 1000.0));
+    }
+    flight.missions_finished = std::move(finished);
+    return flight;
+}
+
+MissionPath makeMission() {
+    return MissionPath(MissionPath::Type::FORWARD, {makeGPSCoord(32.88, -117.23, 30),
+                                                    makeGPSCoord(32.89, -117.23, 30),
+                                                    makeGPSCoord(32.89, -117.24, 30),
+                                                    makeGPSCoord(32.88, -117.24, 30)});
+}
+}  // namespace
+
+// At speed 0 the clock only moves when it's told to
+TEST(ReplayClock, OnlyMovesWhenAdvanced) {
+    ReplayClock clock(1000, 0);
+    EXPECT_EQ(clock.nowMs(), 1000);
+
+    std::this_thread::sleep_for(5ms);
+    EXPECT_EQ(clock.nowMs(), 1000);
+
+    clock.advance(250ms);
+    EXPECT_EQ(clock.nowMs(), 1250);
+}
+
+TEST(ReplayClock, InstalledClockIsTheUnixTime) {
+    {
+        ReplayClock clock(1000, 0);
+        ASSERT_TRUE(clock.install());
+        EXPECT_EQ(getUnixTime_ms().count(), 1000);
+        EXPECT_EQ(getUnixTime_s().count(), 1);
+
+        ReplayClock other(5000, 0);
+        EXPECT_FALSE(other.install());
+        EXPECT_EQ(getUnixTime_ms().count(), 1000);
+    }
+
+    // Back on the system clock once it's gone
+    EXPECT_GT(getUnixTime_ms().count(), 1000000000000);
+}
+
+// Missions are taken as finished when the recorded OBC moved on from waiting for them
+TEST(ReplayFlight, ExtractsTelemetryAndMissionFinishes) {
+    const std::vector<FlightRecord> records = {
+        makeRecord(FlightRecordType::TELEMETRY, 1000, makeTelemetry(0)),
+        makeTick(1500, TickID::Takeoff, TickID::FlyWaypoints),
+        makeRecord(FlightRecordType::TELEMETRY, 2000, makeTelemetry(10)),
+        makeTick(2000, TickID::FlyWaypoints, TickID::MavUpload),
+        makeTick(2500, TickID::MavUpload, TickID::FlySearch),
+        makeTick(3000, TickID::FlySearch, TickID::CVLoiter),
+        makeTick(3500, TickID::CVLoiter, TickID::AirdropPrep),
+        makeTick(4000, TickID::AirdropApproach, TickID::FlyWaypoints),
+        makeRecord(FlightRecordType::GCS_REQUEST, 4500, GcsRequestRecord{}),
+    };
+
+    ReplayFlight flight = makeReplayFlight(records);
+    ASSERT_EQ(flight.telemetry.size(), 2);
+    EXPECT_EQ(flight.telemetry[0].first, 1000);
+    EXPECT_EQ(flight.telemetry[1].first, 2000);
+    EXPECT_DOUBLE_EQ(flight.telemetry[1].second.altitude_agl_m, 10);
+    EXPECT_EQ(flight.missions_finished, (std::vector<uint64_t>{2000, 3000, 4000}));
+}
+
+TEST(ReplayMavlinkClient, PlaysBackTelemetryUpToTheClock) {
+    ReplayClock clock(1000, 0);
+    ASSERT_TRUE(clock.install());
+
+    ReplayMavlinkClient mav(makeFlight(1000, 3000, {}));
+    mav.update();
+    EXPECT_DOUBLE_EQ(mav.altitude_agl_m(), 0);
+
+    clock.advance(1500ms);
+    mav.update();
+    EXPECT_DOUBLE_EQ(mav.altitude_agl_m(), 1);
+    EXPECT_FALSE(mav.finished());
+
+    clock.advance(500ms);
+    mav.update();
+    EXPECT_DOUBLE_EQ(mav.altitude_agl_m(), 2);
+    EXPECT_FALSE(mav.finished());
+
+    clock.advance(1ms);
+    EXPECT_TRUE(mav.finished());
+}
+
+// Samples played back together in one update() keep the times they were recorded at
+TEST(ReplayMavlinkClient, InterpolatesAtRecordedTimes) {
+    ReplayClock clock(1000, 0);
+    ASSERT_TRUE(clock.install());
+
+    ReplayMavlinkClient mav(makeFlight(1000, 3000, {}));
+    clock.advance(2000ms);
+    mav.update();
+
+    std::optional<ImageTelemetry> telemetry = mav.telemetryAt(1500);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_DOUBLE_EQ(telemetry->altitude_agl_m, 0.5);
+
+    telemetry = mav.telemetryAt(2750);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_DOUBLE_EQ(telemetry->altitude_agl_m, 1.75);
+}
+
+// Each mission is flown until the recorded finish, then the end of the recording
+TEST(ReplayMavlinkClient, FliesMissionsUntilTheRecordedFinish) {
+    ReplayClock clock(1000, 0);
+    ASSERT_TRUE(clock.install());
+
+    ReplayMavlinkClient mav(makeFlight(1000, 11000, {5000}));
+    ASSERT_TRUE(mav.uploadWaypointsUntilSuccess(nullptr, makeMission()));
+    const std::size_t size = mav.totalWaypoints();
+    ASSERT_EQ(size, makeMission().getCommands().size());
+    ASSERT_GT(size, 1);
+
+    // Nothing happens until it's started
+    clock.advance(1000ms);
+    EXPECT_EQ(mav.curr_waypoint(), 0);
+    EXPECT_FALSE(mav.isMissionFinished());
+
+    ASSERT_TRUE(mav.startMission());
+    clock.advance(1500ms);
+    EXPECT_EQ(mav.curr_waypoint(), static_cast<int32_t>(size / 2));
+    EXPECT_FALSE(mav.isMissionFinished());
+
+    clock.advance(1500ms);
+    EXPECT_EQ(mav.curr_waypoint(), static_cast<int32_t>(size));
+    EXPECT_TRUE(mav.isMissionFinished());
+
+    // No recorded finish for the second one
+    ASSERT_TRUE(mav.uploadWaypointsUntilSuccess(nullptr, makeMission()));
+    ASSERT_TRUE(mav.startMission());
+    clock.advance(5000ms);
+    EXPECT_FALSE(mav.isMissionFinished());
+    clock.advance(1000ms);
+    EXPECT_TRUE(mav.isMissionFinished());
+}
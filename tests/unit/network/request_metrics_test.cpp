@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include "network/request_metrics.hpp"
+
+using namespace std::chrono_literals;  // NOLINT
+
+TEST(RequestMetrics, BucketsByLatency) {
+    RequestMetrics metrics;
+    metrics.record("/tick", 200, 500us);
+    metrics.record("/tick", 200, 1ms);     // bounds are inclusive
+    metrics.record("/tick", 500, 30ms);
+    metrics.record("/tick", 200, 20s);     // past the last bound
+
+    std::optional<RequestMetrics::Histogram> tick = metrics.get("/tick");
+    ASSERT_TRUE(tick.has_value());
+    EXPECT_EQ(tick->count, 4);
+    EXPECT_EQ(tick->errors, 1);
+    EXPECT_EQ(tick->buckets[0], 2);   // <= 1 ms
+    EXPECT_EQ(tick->buckets[5], 1);   // (25, 50] ms
+    EXPECT_EQ(tick->buckets.back(), 1);
+    EXPECT_EQ(tick->max, 20s);
+
+    EXPECT_FALSE(metrics.get("/mission").has_value());
+}
+
+TEST(RequestMetrics, PrometheusBucketsAreCumulative) {
+    RequestMetrics metrics;
+    metrics.record("/connections", 200, 1ms);
+    metrics.record("/connections", 200, 3ms);
+
+    std::string text = metrics.toPrometheus();
+    EXPECT_NE(text.find("obc_gcs_request_duration_seconds_bucket{route=\"/connections\","
+                        "le=\"0.001\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("obc_gcs_request_duration_seconds_bucket{route=\"/connections\","
+                        "le=\"0.005\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("obc_gcs_request_duration_seconds_bucket{route=\"/connections\","
+                        "le=\"+Inf\"} 2\n"), std::string::npos);
+    EXPECT_NE(text.find("obc_gcs_request_duration_seconds_count{route=\"/connections\"} 2\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("obc_gcs_request_errors_total{route=\"/connections\"} 0\n"),
+              std::string::npos);
+}
@@ -0,0 +1,109 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <optional>
+#include <thread>
+
+#include "camera/interface.hpp"
+#include "network/telemetry_history.hpp"
+
+namespace {
+ImageTelemetry makeTelemetry(double value, double heading_deg, double yaw_deg) {
+    return ImageTelemetry{.latitude_deg = value,
+                          .longitude_deg = value,
+                          .altitude_agl_m = value,
+                          .airspeed_m_s = value,
+                          .heading_deg = heading_deg,
+                          .yaw_deg = yaw_deg,
+                          .pitch_deg = value,
+                          .roll_deg = value};
+}
+}  // namespace
+
+// A frame between two samples should get the pose partway between them
+TEST(TelemetryHistory, InterpolatesBetweenSamples) {
+    TelemetryHistory history(16, 100);
+    history.push(1000, makeTelemetry(10, 10, 10));
+    history.push(1100, makeTelemetry(20, 20, 20));
+    history.push(1200, makeTelemetry(40, 40, 40));
+
+    std::optional<ImageTelemetry> telemetry = history.at(1150);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_DOUBLE_EQ(telemetry->latitude_deg, 30);
+    EXPECT_DOUBLE_EQ(telemetry->altitude_agl_m, 30);
+    EXPECT_DOUBLE_EQ(telemetry->heading_deg, 30);
+    EXPECT_DOUBLE_EQ(telemetry->pitch_deg, 30);
+
+    telemetry = history.at(1000);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_DOUBLE_EQ(telemetry->latitude_deg, 10);
+}
+
+// Turning through north shouldn't swing the heading all the way around
+TEST(TelemetryHistory, InterpolatesAnglesAcrossWraparound) {
+    TelemetryHistory history(16, 100);
+    history.push(1000, makeTelemetry(0, 350, 170));
+    history.push(1100, makeTelemetry(0, 10, -170));
+
+    std::optional<ImageTelemetry> telemetry = history.at(1025);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_NEAR(telemetry->heading_deg, 355, 1e-9);
+    EXPECT_NEAR(telemetry->yaw_deg, 175, 1e-9);
+
+    telemetry = history.at(1075);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_NEAR(telemetry->heading_deg, 5, 1e-9);
+    EXPECT_NEAR(telemetry->yaw_deg, -175, 1e-9);
+}
+
+TEST(TelemetryHistory, OutsideWindowIsEmpty) {
+    TelemetryHistory history(4, 100);
+    EXPECT_FALSE(history.at(1000).has_value());
+    EXPECT_FALSE(history.newestTimestamp().has_value());
+
+    for (uint64_t i = 0; i < 6; i++) {
+        history.push(1000 + i * 100, makeTelemetry(static_cast<double>(i), 0, 0));
+    }
+    EXPECT_EQ(history.size(), 4);
+    EXPECT_EQ(history.newestTimestamp(), 1500);
+
+    // first two samples were overwritten
+    EXPECT_FALSE(history.at(1150).has_value());
+    EXPECT_TRUE(history.at(1250).has_value());
+
+    // a little past the newest sample just holds it
+    std::optional<ImageTelemetry> telemetry = history.at(1550);
+    ASSERT_TRUE(telemetry.has_value());
+    EXPECT_DOUBLE_EQ(telemetry->latitude_deg, 5);
+    EXPECT_FALSE(history.at(1601).has_value());
+}
+
+// Readers racing the writer must only ever see whole samples
+TEST(TelemetryHistory, ConcurrentReadsSeeConsistentSamples) {
+    TelemetryHistory history(8, 1000);
+    std::atomic<bool> done{false};
+
+    std::thread writer([&]() {
+        for (uint64_t i = 1; i <= 20000; i++) {
+            history.push(i, makeTelemetry(static_cast<double>(i), 0, 0));
+        }
+        done = true;
+    });
+
+    std::size_t num_read = 0;
+    while (!done) {
+        std::optional<uint64_t> newest = history.newestTimestamp();
+        if (!newest.has_value()) {
+            continue;
+        }
+        std::optional<ImageTelemetry> telemetry = history.at(newest.value());
+        if (telemetry.has_value()) {
+            // every field was written with the same value as the timestamp
+            EXPECT_DOUBLE_EQ(telemetry->latitude_deg, telemetry->altitude_agl_m);
+            EXPECT_DOUBLE_EQ(telemetry->latitude_deg, telemetry->roll_deg);
+            num_read++;
+        }
+    }
+    writer.join();
+    EXPECT_GT(num_read, 0);
+}
@@ -0,0 +1,120 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <opencv2/core.hpp>
+
+#include "network/rpi_connection.hpp"
+#include "network/udp_client.hpp"
+#include "network/udp_server.hpp"
+
+namespace {
+const char LOOPBACK_IP[] = "127.0.0.1";
+
+// Runs a mock camera on loopback until the test is done with it
+class MockCameraServer {
+ public:
+    MockCameraServer(int port, double drop_rate, cv::Mat frame)
+        : server(&io_context, LOOPBACK_IP, port, drop_rate), done(false) {
+        server.setFrame(frame);
+        EXPECT_TRUE(server.start());
+        thread = std::thread([this]() {
+            while (!this->done) {
+                this->server.recv();
+            }
+        });
+    }
+
+    // The server is blocked in recv, so poke it once it is told to stop
+    void stop(UDPClient* client) {
+        done = true;
+        client->send('e');
+        thread.join();
+    }
+
+ private:
+    boost::asio::io_context io_context;
+    UDPServer server;
+    std::atomic<bool> done;
+    std::thread thread;
+};
+
+cv::Mat randomFrame() {
+    cv::Mat frame(IMG_HEIGHT * 3 / 2, IMG_WIDTH, CV_8UC1);
+    cv::randu(frame, 0, 256);
+    return frame;
+}
+
+// Every row of every plane should match the frame, ignoring the stride padding
+void expectPlanesMatch(const std::vector<std::vector<uint8_t>>& planes, const cv::Mat& frame) {
+    ASSERT_EQ(planes.size(), NUM_PLANES);
+    ASSERT_EQ(planes[0].size(), STRIDE_Y * IMG_HEIGHT);
+    ASSERT_EQ(planes[1].size(), STRIDE_UV * IMG_HEIGHT / 2);
+    ASSERT_EQ(planes[2].size(), STRIDE_UV * IMG_HEIGHT / 2);
+
+    const uint8_t* src = frame.data;
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        uint32_t width = plane == 0 ? IMG_WIDTH : IMG_WIDTH / 2;
+        uint32_t height = plane == 0 ? IMG_HEIGHT : IMG_HEIGHT / 2;
+        uint32_t stride = plane == 0 ? STRIDE_Y : STRIDE_UV;
+        for (uint32_t row = 0; row < height; row++) {
+            ASSERT_EQ(std::memcmp(planes[plane].data() + row * stride, src, width), 0)
+                << "plane " << plane << " row " << row;
+            src += width;
+        }
+    }
+}
+}  // namespace
+
+// Without a hello the camera speaks the original one plane at a time protocol
+TEST(UDPTransport, LegacyFrame) {
+    cv::Mat frame = randomFrame();
+    MockCameraServer server(25591, 0.0, frame);
+
+    boost::asio::io_context io_context;
+    UDPClient client(&io_context, LOOPBACK_IP, 25591);
+    ASSERT_TRUE(client.connect());
+    EXPECT_FALSE(client.isNegotiated());
+
+    ASSERT_TRUE(client.send('I'));
+    std::vector<std::vector<uint8_t>> planes(NUM_PLANES);
+    for (uint32_t plane = 0; plane < NUM_PLANES; plane++) {
+        Header header = client.recvHeader();
+        ASSERT_EQ(header.magic, EXPECTED_MAGIC);
+        ASSERT_TRUE(client.recvBody(planes[plane], header.mem_size, header.total_chunks));
+    }
+    expectPlanesMatch(planes, frame);
+
+    server.stop(&client);
+}
+
+// Chunks the camera drops the first time around should be NACKed and resent
+TEST(UDPTransport, RecoversDroppedChunks) {
+    cv::Mat frame = randomFrame();
+    MockCameraServer server(25592, 0.05, frame);
+
+    boost::asio::io_context io_context;
+    UDPClient client(&io_context, LOOPBACK_IP, 25592);
+    ASSERT_TRUE(client.connect());
+    ASSERT_TRUE(client.negotiate(NEGOTIATE_TIMEOUT_MS));
+    EXPECT_GT(client.chunkSize(), CHUNK_SIZE);
+
+    for (int i = 0; i < 2; i++) {
+        ASSERT_TRUE(client.send('I'));
+        std::vector<std::vector<uint8_t>> planes;
+        ASSERT_TRUE(client.recvFrame(planes));
+        expectPlanesMatch(planes, frame);
+
+        TransferStats stats = client.lastTransferStats();
+        EXPECT_GT(stats.chunks, 0);
+        EXPECT_GT(stats.chunks_lost, 0);
+        EXPECT_GE(stats.chunks_nacked, stats.chunks_lost);
+        EXPECT_GT(stats.nack_rounds, 0);
+    }
+
+    server.stop(&client);
+}